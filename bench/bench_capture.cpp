@@ -0,0 +1,74 @@
+// Capture with half resolution: on the sensor (FakeCamera standing in for a
+// camera that bins or skips, so only the reduced frame reaches the host)
+// against full-resolution grabs halved by the broker's host kernels.
+// The camera is never the limit, so fps is the capture path's ceiling,
+// cpu_us the process CPU per frame, and link_MBps what a real camera would
+// push over USB at that rate.
+#include <benchmark/benchmark.h>
+#include <ctime>
+#include <memory>
+#include "cambuffer_recorder_ng/FakeCamera.hpp"
+#include "cambuffer_recorder_ng/FrameBroker.hpp"
+
+using namespace cambuffer_recorder_ng;
+
+static double process_cpu_s()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// path: 0 = full resolution, 1 = 2x2 on the sensor, 2 = 2x2 on the host
+static void BM_CaptureDownsample(benchmark::State& state)
+{
+    const int path = static_cast<int>(state.range(0));
+    const auto mode = state.range(1) ? Downsampling::Skipping : Downsampling::Binning;
+    FakeCamera::Options o;
+    o.width = 2048;
+    o.height = 1088;
+    o.fps = 100000.0;
+    o.format = state.range(2) ? PixelFormat::Bayer16 : PixelFormat::Bayer8;
+    o.frames = 4;
+    o.downsampling = path == 1;
+    auto cam = std::make_shared<FakeCamera>(o);
+    cam->open();
+    int w = o.width, h = o.height;
+    if (path == 1) cam->set_downsampling(2, mode, w, h);
+
+    FrameBroker broker;
+    auto q = broker.add_consumer("bench", DropPolicy::Block, 8);
+    FrameBroker::Options bo;
+    bo.pool_frames = 16;
+    bo.downsample = path == 2 ? 2 : 1;
+    bo.downsample_mode = mode;
+    cam->start();
+    broker.start(cam, w, h, bo);
+
+    FramePtr f;
+    q->pop(f, 1000);   // first frame, pool warm
+    f.reset();
+    const double cpu0 = process_cpu_s();
+    for (auto _ : state) {
+        if (!q->pop(f, 1000)) {
+            state.SkipWithError("no frames");
+            break;
+        }
+        benchmark::DoNotOptimize(f->data);
+        f.reset();
+    }
+    const double cpu = process_cpu_s() - cpu0;
+    broker.stop();
+    cam->stop();
+
+    const double n = static_cast<double>(state.iterations());
+    const double link_bytes = static_cast<double>(w) * h * bytes_per_pixel(o.format);
+    state.counters["fps"] = benchmark::Counter(n, benchmark::Counter::kIsRate);
+    state.counters["cpu_us"] = n > 0 ? cpu * 1e6 / n : 0.0;
+    state.counters["link_MBps"] = benchmark::Counter(n * link_bytes / 1e6, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_CaptureDownsample)
+    ->ArgNames({"path", "skip", "deep"})
+    ->Args({0, 0, 0})->Args({1, 0, 0})->Args({2, 0, 0})->Args({1, 1, 0})->Args({2, 1, 0})
+    ->Args({0, 0, 1})->Args({1, 0, 1})->Args({2, 0, 1})->Args({2, 1, 1})
+    ->UseRealTime();
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+namespace bench {
+
+// Typical ROIs: the 2048x704 working ROI and the full MQ022CG sensor.
+#define CAMBUFFER_BENCH_SIZES ->Args({2048, 704})->Args({2048, 1088})
+
+/// RAW8 frame with a smooth gradient plus mild noise, so compressors see
+/// something closer to a real scene than a constant or random buffer.
+inline std::vector<uint8_t> synthetic_bayer(int w, int h, uint32_t seed = 1)
+{
+    std::vector<uint8_t> f(static_cast<size_t>(w) * h);
+    uint32_t s = seed;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            s = s * 1664525u + 1013904223u;
+            f[static_cast<size_t>(y) * w + x] =
+                static_cast<uint8_t>(((x >> 2) + (y >> 1) + (x & 1) * 40 + (s >> 29)) & 0xff);
+        }
+    return f;
+}
+
+/// Scratch directory for I/O benchmarks: $CAMBUFFER_BENCH_DIR, else tmpfs.
+inline std::string scratch_dir()
+{
+    const char* d = std::getenv("CAMBUFFER_BENCH_DIR");
+    return d ? std::string(d) : std::string("/dev/shm");
+}
+
+} // namespace bench
+} // namespace cambuffer_recorder_ng
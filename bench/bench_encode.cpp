@@ -0,0 +1,55 @@
+// FfmpegWriter encode rate across libx264 presets.
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <unistd.h>
+#include "cambuffer_recorder_ng/DebayerHalf.hpp"
+#include "cambuffer_recorder_ng/FfmpegWriter.hpp"
+#include "bench_common.hpp"
+
+using namespace cambuffer_recorder_ng;
+
+static const char* kPresets[] = {"ultrafast", "superfast", "veryfast", "faster", "fast"};
+
+// range(0): preset index; range(1): 0 = full-res Bayer in, 1 = half-res BGR (debayer_half_bgr)
+static void BM_FfmpegEncode(benchmark::State& state)
+{
+    const char* preset = kPresets[state.range(0)];
+    const bool half = state.range(1) != 0;
+    const int sw = 2048, sh = 704;
+    auto bayer = bench::synthetic_bayer(sw, sh);
+
+    std::vector<uint8_t> bgr;
+    int w = sw, h = sh, stride = sw;
+    AVPixelFormat fmt = AV_PIX_FMT_BAYER_GBRG8;
+    const uint8_t* input = bayer.data();
+    if (half) {
+        w = sw / 2; h = sh / 2; stride = w * 3;
+        bgr.resize(static_cast<size_t>(stride) * h);
+        debayer_half_bgr(bayer.data(), sw, sh, sw, bgr.data(), BayerPattern::GBRG);
+        fmt = AV_PIX_FMT_BGR24;
+        input = bgr.data();
+    }
+
+    const std::string path = bench::scratch_dir() + "/cambuffer_bench_" +
+                             std::to_string(getpid()) + ".mp4";
+    FfmpegWriter writer;
+    writer.set_codec_option("preset", preset);
+    if (!writer.open(path, w, h, 100, "libx264", fmt)) {
+        state.SkipWithError("cannot open encoder");
+        return;
+    }
+    int64_t n = 0;
+    for (auto _ : state) {
+        writer.write_frame(input, stride, n * 10'000'000LL);
+        n++;
+    }
+    writer.close();     // flushes delayed frames, part of the real cost
+    std::remove(path.c_str());
+
+    state.SetLabel(std::string(preset) + (half ? " half-bgr" : " full-bayer"));
+    state.counters["fps"] = benchmark::Counter(static_cast<double>(n), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FfmpegEncode)
+    ->ArgsProduct({{0, 1, 2, 3, 4}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,81 @@
+// XRAW write throughput and LZ4 compression (xi_xraw_ringbuffer_lz4.cpp).
+// Point CAMBUFFER_BENCH_DIR at the SSD under test; the default is /dev/shm.
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <filesystem>
+#include <unistd.h>
+#include "cambuffer_recorder_ng/XrawWriter.hpp"
+#include "bench_common.hpp"
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#include <lz4frame.h>
+#endif
+
+using namespace cambuffer_recorder_ng;
+
+static void BM_XrawWrite(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    auto frame = bench::synthetic_bayer(w, h);
+    const std::string prefix = bench::scratch_dir() + "/cambuffer_bench_" + std::to_string(getpid());
+
+    XrawWriter writer;
+    if (!writer.open(prefix, w, h, 256ULL * 1024 * 1024)) {
+        state.SkipWithError("cannot open XRAW output");
+        return;
+    }
+    uint64_t n = 0;
+    for (auto _ : state) {
+        if (!writer.write_frame(n, n * 10'000'000ULL, frame.data(), w)) {
+            state.SkipWithError("write failed");
+            break;
+        }
+        n++;
+    }
+    writer.close();
+
+    for (uint32_t i = 0; i < writer.files_opened(); ++i) {
+        char name[4096];
+        snprintf(name, sizeof(name), "%s_%04u.xraw", prefix.c_str(), i);
+        std::remove(name);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(n * frame.size()));
+    state.counters["fps"] = benchmark::Counter(static_cast<double>(n), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_XrawWrite) CAMBUFFER_BENCH_SIZES ->UseRealTime();
+
+#ifdef HAVE_LZ4
+// Exactly what the ring-buffer tool does per frame.
+static void BM_Lz4Frame(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    auto frame = bench::synthetic_bayer(w, h);
+    std::vector<uint8_t> out(LZ4F_compressFrameBound(frame.size(), nullptr));
+    size_t comp = 0;
+    for (auto _ : state) {
+        comp = LZ4F_compressFrame(out.data(), out.size(), frame.data(), frame.size(), nullptr);
+        benchmark::DoNotOptimize(comp);
+    }
+    state.SetBytesProcessed(state.iterations() * frame.size());
+    state.counters["ratio"] = static_cast<double>(frame.size()) / comp;
+}
+BENCHMARK(BM_Lz4Frame) CAMBUFFER_BENCH_SIZES;
+
+// Block API across acceleration levels (1 = default, higher = faster/larger).
+static void BM_Lz4Fast(benchmark::State& state)
+{
+    const int w = 2048, h = 704;
+    auto frame = bench::synthetic_bayer(w, h);
+    std::vector<char> out(LZ4_compressBound(static_cast<int>(frame.size())));
+    int comp = 0;
+    for (auto _ : state) {
+        comp = LZ4_compress_fast(reinterpret_cast<const char*>(frame.data()), out.data(),
+                                 static_cast<int>(frame.size()), static_cast<int>(out.size()),
+                                 static_cast<int>(state.range(0)));
+        benchmark::DoNotOptimize(comp);
+    }
+    state.SetBytesProcessed(state.iterations() * frame.size());
+    state.counters["ratio"] = static_cast<double>(frame.size()) / comp;
+}
+BENCHMARK(BM_Lz4Fast)->Arg(1)->Arg(4)->Arg(16);
+#endif
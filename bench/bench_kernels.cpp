@@ -0,0 +1,307 @@
+// Half-resolution Bayer kernels vs. the OpenCV path used by the overlay tools.
+#include <benchmark/benchmark.h>
+#include <opencv2/imgproc.hpp>
+#include "cambuffer_recorder_ng/AutoExposure.hpp"
+#include "cambuffer_recorder_ng/BayerStats.hpp"
+#include "cambuffer_recorder_ng/DebayerHalf.hpp"
+#include "cambuffer_recorder_ng/Decimate.hpp"
+#include "cambuffer_recorder_ng/JpegEncoder.hpp"
+#include "cambuffer_recorder_ng/MotionDetector.hpp"
+#include "cambuffer_recorder_ng/RawPack.hpp"
+#include "cambuffer_recorder_ng/TextOverlay.hpp"
+#include "cambuffer_recorder_ng/Thumbnail.hpp"
+#include "bench_common.hpp"
+
+using namespace cambuffer_recorder_ng;
+
+static void BM_DebayerHalfBgr(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint8_t> dst(static_cast<size_t>(w / 2) * (h / 2) * 3);
+    for (auto _ : state) {
+        debayer_half_bgr(src.data(), w, h, w, dst.data(), BayerPattern::GBRG);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_DebayerHalfBgr) CAMBUFFER_BENCH_SIZES;
+
+static void BM_DebayerHalfGray(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint8_t> dst(static_cast<size_t>(w / 2) * (h / 2));
+    for (auto _ : state) {
+        debayer_half_gray(src.data(), w, h, w, dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_DebayerHalfGray) CAMBUFFER_BENCH_SIZES;
+
+static void BM_BayerHalfPreserveCfa(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint8_t> dst(static_cast<size_t>(w / 2) * (h / 2));
+    int ow = 0, oh = 0;
+    for (auto _ : state) {
+        bayer_half_preserve_cfa(src.data(), w, h, w, dst.data(), ow, oh, BayerPattern::GBRG);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_BayerHalfPreserveCfa) CAMBUFFER_BENCH_SIZES;
+
+static void BM_BayerHalfPreserveCfa16(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint16_t> dst(static_cast<size_t>(w / 2) * (h / 2));
+    int ow = 0, oh = 0;
+    for (auto _ : state) {
+        bayer_half_preserve_cfa(src.data(), w, h, w, dst.data(), ow, oh, BayerPattern::GBRG);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_BayerHalfPreserveCfa16) CAMBUFFER_BENCH_SIZES;
+
+// Preview thumbnails: factor (4/8) x {gray, rgb}.
+static void BM_BayerThumbnail(benchmark::State& state)
+{
+    const int w = 2048, h = 1088, factor = state.range(0);
+    const bool color = state.range(1) != 0;
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint8_t> dst(static_cast<size_t>(w / factor) * (h / factor) * 3);
+    int ow = 0, oh = 0;
+    for (auto _ : state) {
+        if (color) bayer_thumbnail_rgb(src.data(), w, h, w, factor, BayerPattern::GBRG, dst.data(), ow, oh);
+        else       bayer_thumbnail_gray(src.data(), w, h, w, factor, dst.data(), ow, oh);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_BayerThumbnail)->ArgsProduct({{4, 8}, {0, 1}});
+
+// Decimated green plane, SAD against the background and its update, per processed frame.
+static void BM_MotionDetect(benchmark::State& state)
+{
+    const int w = 2048, h = 1088;
+    auto src = bench::synthetic_bayer(w, h);
+    Frame f;
+    f.data = src.data();
+    f.width = w;
+    f.height = h;
+    f.stride = w;
+    MotionDetector md;
+    MotionDetector::Options opt;
+    opt.factor = static_cast<int>(state.range(0));
+    md.configure(opt);
+    MotionDetector::Event ev;
+    for (auto _ : state) {
+        f.ts_ns += 10000000;
+        benchmark::DoNotOptimize(md.process(f, ev));
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_MotionDetect)->Arg(4)->Arg(8);
+
+// Sparse per-channel histograms; Arg = CFA cells sampled (the budget is 0.1 ms a frame).
+static void BM_BayerStats(benchmark::State& state)
+{
+    const int w = 2048, h = 1088;
+    auto src = bench::synthetic_bayer(w, h);
+    BayerStats st;
+    for (auto _ : state) {
+        bayer_stats_sparse(src.data(), w, h, w, BayerPattern::GBRG, static_cast<int>(state.range(0)), st);
+        benchmark::DoNotOptimize(st.sum);
+    }
+    state.counters["samples"] = static_cast<double>(st.count[0] + st.count[1] + st.count[2]);
+}
+BENCHMARK(BM_BayerStats)->Arg(2048)->Arg(8192)->Arg(32768);
+
+// Statistics plus controller step, as the AE thread runs it per processed frame.
+static void BM_AutoExposure(benchmark::State& state)
+{
+    const int w = 2048, h = 1088;
+    auto src = bench::synthetic_bayer(w, h);
+    Frame f;
+    f.data = src.data();
+    f.width = w;
+    f.height = h;
+    f.stride = w;
+    AutoExposure ae;
+    ae.configure(AutoExposure::Options{});
+    double e = 0.0, g = 0.0;
+    for (auto _ : state) {
+        f.seq++;
+        benchmark::DoNotOptimize(ae.process(f, e, g));
+    }
+}
+BENCHMARK(BM_AutoExposure);
+
+// White balance pass ahead of swscale debayering of a full frame.
+static void BM_BayerWhiteBalance(benchmark::State& state)
+{
+    const int w = 2048, h = 1088;
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint8_t> dst(src.size());
+    for (auto _ : state) {
+        bayer_white_balance(src.data(), w, h, w, BayerPattern::GBRG, 328, 366, dst.data(), w);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_BayerWhiteBalance);
+
+// 10/12-bit samples, as XiCamera delivers them in XI_RAW16.
+static std::vector<uint16_t> synthetic_deep(int w, int h, int bits)
+{
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint16_t> deep(src.size());
+    for (size_t i = 0; i < src.size(); ++i)
+        deep[i] = static_cast<uint16_t>(src[i] << (bits - 8) | (i & ((1u << (bits - 8)) - 1)));
+    return deep;
+}
+
+// XRAW write path: arg 10 or 12 bits. Bytes counted at the 16-bit input.
+static void BM_PackRaw(benchmark::State& state)
+{
+    const int w = 2048, h = 1088, bits = state.range(0);
+    const auto src = synthetic_deep(w, h, bits);
+    std::vector<uint8_t> dst(raw10_bytes(src.size()) + raw12_bytes(src.size()));
+    for (auto _ : state) {
+        if (bits == 10) pack_raw10(src.data(), src.size(), dst.data());
+        else pack_raw12(src.data(), src.size(), dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size() * 2);
+    state.SetLabel(raw_pack_avx2() ? "avx2" : "scalar");
+}
+BENCHMARK(BM_PackRaw)->Arg(10)->Arg(12);
+
+// Replay / transcode path.
+static void BM_UnpackRaw(benchmark::State& state)
+{
+    const int w = 2048, h = 1088, bits = state.range(0);
+    const auto src = synthetic_deep(w, h, bits);
+    std::vector<uint8_t> packed(raw10_bytes(src.size()) + raw12_bytes(src.size()));
+    std::vector<uint16_t> dst(src.size());
+    if (bits == 10) pack_raw10(src.data(), src.size(), packed.data());
+    else pack_raw12(src.data(), src.size(), packed.data());
+    for (auto _ : state) {
+        if (bits == 10) unpack_raw10(packed.data(), dst.size(), dst.data());
+        else unpack_raw12(packed.data(), dst.size(), dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * dst.size() * 2);
+    state.SetLabel(raw_pack_avx2() ? "avx2" : "scalar");
+}
+BENCHMARK(BM_UnpackRaw)->Arg(10)->Arg(12);
+
+// MP4 path for 10-bit input: shift to full scale with the white balance gains.
+static void BM_BayerWhiteBalance16(benchmark::State& state)
+{
+    const int w = 2048, h = 1088;
+    const auto src = synthetic_deep(w, h, 10);
+    std::vector<uint16_t> dst(src.size());
+    for (auto _ : state) {
+        bayer_white_balance(src.data(), w, h, w * 2, BayerPattern::GBRG, 328, 366, 10, dst.data(), w * 2);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size() * 2);
+}
+BENCHMARK(BM_BayerWhiteBalance16);
+
+// Full preview step: 4x RGB thumbnail + JPEG q70.
+static void BM_PreviewJpeg(benchmark::State& state)
+{
+    const int w = 2048, h = 1088, factor = state.range(0);
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint8_t> thumb(static_cast<size_t>(w / factor) * (h / factor) * 3), jpeg;
+    JpegEncoder enc;
+    int ow = 0, oh = 0;
+    for (auto _ : state) {
+        bayer_thumbnail_rgb(src.data(), w, h, w, factor, BayerPattern::GBRG, thumb.data(), ow, oh);
+        enc.encode(thumb.data(), ow, oh, 3, 70, jpeg);
+        benchmark::DoNotOptimize(jpeg.data());
+    }
+    state.counters["jpeg_bytes"] = static_cast<double>(jpeg.size());
+}
+BENCHMARK(BM_PreviewJpeg)->Arg(4)->Arg(8);
+
+// xi_ffmpeg_rgb_overlay_decimate.cpp: resize(INTER_AREA) then convertTo(x1.7).
+static void BM_DecimateOpenCv(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    cv::Mat frame(h, w, CV_8UC3);
+    cv::randu(frame, 0, 160);
+    cv::Mat outframe(h / 2, w / 2, CV_8UC3);
+    for (auto _ : state) {
+        cv::resize(frame, outframe, outframe.size(), 0, 0, cv::INTER_AREA);
+        outframe.convertTo(outframe, -1, 1.7, 0);
+        benchmark::DoNotOptimize(outframe.data);
+    }
+    state.SetBytesProcessed(state.iterations() * frame.total() * frame.elemSize());
+}
+BENCHMARK(BM_DecimateOpenCv) CAMBUFFER_BENCH_SIZES;
+
+// The same in one pass: 2x2 sums times 1.7 / 4, saturated.
+static void BM_DecimateGainRgb(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    cv::Mat frame(h, w, CV_8UC3);
+    cv::randu(frame, 0, 160);
+    std::vector<uint8_t> dst(static_cast<size_t>(w / 2) * (h / 2) * 3);
+    for (auto _ : state) {
+        decimate_2x2_gain(frame.data, w, h, static_cast<int>(frame.step), 3, 1.7, dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * frame.total() * frame.elemSize());
+}
+BENCHMARK(BM_DecimateGainRgb) CAMBUFFER_BENCH_SIZES;
+
+static void BM_DecimateGainBayer(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    auto src = bench::synthetic_bayer(w, h);
+    std::vector<uint8_t> dst(static_cast<size_t>(w / 2) * (h / 2));
+    int ow = 0, oh = 0;
+    for (auto _ : state) {
+        bayer_decimate_2x2_gain(src.data(), w, h, w, 1.7, dst.data(), ow, oh);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_DecimateGainBayer) CAMBUFFER_BENCH_SIZES;
+
+// xi_ffmpeg_rgb_overlay.cpp: two cv::putText calls per frame, here on the gray plane.
+static void BM_OverlayPutText(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    cv::Mat y(h, w, CV_8UC1);
+    cv::randu(y, 0, 200);
+    uint64_t n = 0;
+    for (auto _ : state) {
+        cv::putText(y, "F" + std::to_string(n++), {10, 40}, cv::FONT_HERSHEY_SIMPLEX, 1.0, 235, 2);
+        cv::putText(y, "12:34:56.789", {w - 230, 40}, cv::FONT_HERSHEY_SIMPLEX, 1.0, 235, 2);
+        benchmark::DoNotOptimize(y.data);
+    }
+}
+BENCHMARK(BM_OverlayPutText) CAMBUFFER_BENCH_SIZES;
+
+static void BM_OverlayAtlas(benchmark::State& state)
+{
+    const int w = state.range(0), h = state.range(1);
+    auto y = bench::synthetic_bayer(w, h);
+    TextOverlay overlay;
+    uint64_t n = 0;
+    for (auto _ : state) {
+        overlay.stamp(y.data(), w, w, h, n, n * 40000000ull);
+        ++n;
+        benchmark::DoNotOptimize(y.data());
+    }
+}
+BENCHMARK(BM_OverlayAtlas) CAMBUFFER_BENCH_SIZES;
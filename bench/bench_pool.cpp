@@ -0,0 +1,48 @@
+// BufferPool acquire/release, uncontended and across a producer/consumer pair.
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "cambuffer_recorder_ng/BufferPool.hpp"
+
+using namespace cambuffer_recorder_ng;
+
+static void BM_PoolAcquireRelease(benchmark::State& state)
+{
+    BufferPool pool(2048 * 704, 32);
+    for (auto _ : state) {
+        uint8_t* b = pool.acquire();
+        benchmark::DoNotOptimize(b);
+        pool.release(b);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PoolAcquireRelease);
+
+// One thread acquires (capture side), another releases (writer side).
+static void BM_PoolHandoff(benchmark::State& state)
+{
+    BufferPool pool(2048 * 704, static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t*> ring(static_cast<size_t>(state.range(0)));
+    std::atomic<size_t> head{0}, tail{0};
+    std::atomic<bool> done{false};
+
+    std::thread consumer([&] {
+        while (!done || tail != head) {
+            if (tail == head) { std::this_thread::yield(); continue; }
+            pool.release(ring[tail % ring.size()]);
+            tail++;
+        }
+    });
+
+    for (auto _ : state) {
+        uint8_t* b = pool.acquire();
+        while (head - tail >= ring.size()) std::this_thread::yield();
+        ring[head % ring.size()] = b;
+        head++;
+    }
+    done = true;
+    consumer.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PoolHandoff)->Arg(4)->Arg(32)->UseRealTime();
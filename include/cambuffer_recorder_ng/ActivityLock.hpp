@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief "A recorder is capturing" flag shared between processes.
+ *
+ * Every active recorder holds a shared flock() on one well-known file; a
+ * background job asks busy(), which tries for the exclusive lock without
+ * waiting. The kernel drops the lock when its holder exits or crashes, so a
+ * dead recorder can never leave the flag stuck on.
+ */
+class ActivityLock {
+public:
+    ActivityLock() = default;
+    ~ActivityLock() { release(); }
+    ActivityLock(const ActivityLock&) = delete;
+    ActivityLock& operator=(const ActivityLock&) = delete;
+
+    /// Take the shared lock on `path` (created if missing) until release().
+    bool acquire(const std::string& path);
+    void release();
+    bool held() const { return fd_ >= 0; }
+
+    /// True while any process holds `path` through acquire().
+    static bool busy(const std::string& path);
+
+private:
+    int fd_ = -1;
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "cambuffer_recorder_ng/BayerStats.hpp"
+#include "cambuffer_recorder_ng/FrameBroker.hpp"
+#include "cambuffer_recorder_ng/ICamera.hpp"
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Host-side auto exposure and gray-world white balance, fed by a latest-only consumer.
+ *
+ * Every Nth frame is reduced to per-channel histograms of a sparse sample
+ * (bayer_stats_sparse, ~8k CFA cells, well under 0.1 ms) and the controller
+ * steers the green mean towards `target`. Corrections are made on the total
+ * exposure (time x linear gain), damped in the log domain and skipped inside
+ * a dead band; when more than `max_clipped` of the greens sit in the top bin
+ * the exposure only goes down. Time is used first, up to `max_exposure_us`
+ * or, if 0, `frame_fill` of the frame period at `fps` so the frame rate
+ * holds; gain covers the rest up to `max_gain_db`. After a change the next
+ * `settle_frames` frames are ignored, as the sensor takes a frame or two.
+ *
+ * The camera applies new settings between grabs (ICamera::set_exposure), so
+ * capture never waits on this thread. White balance gains (G / R and G / B of
+ * the unclipped means, smoothed) go to a shared WhiteBalance read by the
+ * debayer stage.
+ */
+class AutoExposure {
+public:
+    struct Options {
+        int every_n = 2;                // broker seq multiples of N; 0/1 = newest frame
+        int sample_cells = 8192;        // CFA cells read per frame
+        double target = 0.4;            // green mean, fraction of full scale
+        double tolerance = 0.06;        // dead band, relative to the target
+        double max_clipped = 0.02;      // green fraction in the top bin
+        double damping = 0.5;           // fraction of the log correction per step
+        int settle_frames = 3;
+        double exposure_us = 10000.0;   // starting point, as programmed at activation
+        double gain_db = 0.0;
+        double min_exposure_us = 20.0;
+        double max_exposure_us = 0.0;   // 0 = frame_fill x 1 / fps
+        double fps = 30.0;
+        double frame_fill = 0.9;
+        double max_gain_db = 12.0;
+        bool exposure = true;           // false = white balance only
+        bool awb = true;
+        double awb_rate = 0.2;          // IIR weight of the newest estimate
+        double wb_r = 1.0, wb_b = 1.0;  // starting gains
+        double awb_min = 0.25, awb_max = 4.0;
+        ThreadPolicy policy;            // normally the Process role
+        std::string name = "ae";
+    };
+
+    struct State {
+        uint64_t processed = 0;
+        uint64_t changes = 0;           // exposure/gain updates sent to the camera
+        double exposure_us = 0.0;
+        double gain_db = 0.0;
+        double mean = 0.0;              // green, fraction of full scale
+        double clipped = 0.0;           // green fraction in the top bin
+        double wb_r = 1.0, wb_b = 1.0;
+        double last_us = 0.0;           // statistics + controller of the last frame
+        bool camera_control = true;     // false once the camera refused set_exposure
+    };
+
+    AutoExposure() = default;
+    ~AutoExposure() { stop(); }
+
+    /// `camera` may be null (statistics and white balance only), as may `wb`.
+    bool start(std::shared_ptr<FrameQueue> source, const Options& opt,
+               std::shared_ptr<ICamera> camera, std::shared_ptr<WhiteBalance> wb);
+    void stop();
+    State state() const;
+
+    /// One frame through the controller, on the caller's thread (start() not
+    /// needed, but configure() is). Returns true when the exposure or gain
+    /// changed; the new values are then in exposure_us / gain_db.
+    bool configure(const Options& opt);
+    bool process(const Frame& f, double& exposure_us, double& gain_db);
+
+    /// Longest exposure the controller will use.
+    double exposure_cap_us() const;
+
+private:
+    void loop();
+
+    std::shared_ptr<FrameQueue> source_;
+    std::shared_ptr<ICamera> camera_;
+    std::shared_ptr<WhiteBalance> wb_;
+    Options opt_;
+
+    BayerStats stats_;
+    double exposure_us_ = 0.0, gain_db_ = 0.0;
+    double wb_r_ = 1.0, wb_b_ = 1.0;
+    uint64_t settle_until_ = 0;     // broker seq
+    bool warned_format_ = false;
+
+    State state_;
+    mutable std::mutex state_mtx_;
+
+    std::thread worker_;
+    std::atomic<bool> running_{false};
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/// Per-channel (R, G, B) statistics of a RAW8 mosaic (deeper ones scaled to
+/// 8 bits); both G sites count as G.
+struct BayerStats {
+    static constexpr int kBins = 64;    // value >> 2
+    enum Channel { R, G, B };
+
+    uint32_t hist[3][kBins] = {};
+    uint64_t sum[3] = {};
+    uint32_t count[3] = {};
+
+    double mean(int c) const { return count[c] ? static_cast<double>(sum[c]) / count[c] : 0.0; }
+    /// Value (0..255, bin resolution) below which fraction `p` of the samples lie.
+    double percentile(int c, double p) const;
+    /// Fraction of samples in the top bin (>= 252), i.e. at or near saturation.
+    double clipped(int c) const { return count[c] ? static_cast<double>(hist[c][kBins - 1]) / count[c] : 0.0; }
+    /// Mean over the unclipped samples, from the histogram (bin centres).
+    double mean_unclipped(int c) const;
+};
+
+/// Histograms and sums from a sparse grid of runs of 8 CFA cells (16 pixels)
+/// on both rows of a cell row pair, spaced about evenly in x and y so that
+/// roughly `cells` cells are read; everything is read when the frame is
+/// smaller than that. SSE2 loads, bins and sums each run (psadbw per site);
+/// the counting goes to four per-site tables, folded into channels at the
+/// end, so consecutive increments never hit the same table.
+void bayer_stats_sparse(const uint8_t* src, int w, int h, int stride, BayerPattern pattern,
+                        int cells, BayerStats& out);
+
+/// The same for 16-bit samples with `bits` valid bits (stride in bytes); the
+/// top 8 bits are binned and summed, so the results read as for RAW8. Scalar.
+void bayer_stats_sparse(const uint16_t* src, int w, int h, int stride, int bits, BayerPattern pattern,
+                        int cells, BayerStats& out);
+
+/// R and B gains for the debayer stage, as one atomic word so readers never
+/// see half an update. Fixed point, 1/256 steps (256 = 1.0, up to 127.99).
+class WhiteBalance {
+public:
+    void set(double r, double b);
+    void get(int& r_q8, int& b_q8) const
+    {
+        const uint32_t v = packed_.load(std::memory_order_relaxed);
+        r_q8 = static_cast<int>(v & 0xffff);
+        b_q8 = static_cast<int>(v >> 16);
+    }
+    bool unity() const { return packed_.load(std::memory_order_relaxed) == (256u | 256u << 16); }
+
+private:
+    std::atomic<uint32_t> packed_{256u | 256u << 16};
+};
+
+/// Multiply the R and B sites of a RAW8 mosaic by Q8 gains (rounded, saturated
+/// at 255); G passes through. src and dst may be the same buffer. SSE2.
+void bayer_white_balance(const uint8_t* src, int w, int h, int src_stride, BayerPattern pattern,
+                         int r_q8, int b_q8, uint8_t* dst, int dst_stride);
+
+/// 16-bit mosaic of `bits`-deep samples: also shifts them up to full 16-bit
+/// scale, which is what 16-bit consumers such as swscale expect (saturated
+/// at 65535; gains of 256 make it a plain shift). Strides in bytes. SSE2.
+void bayer_white_balance(const uint16_t* src, int w, int h, int src_stride, BayerPattern pattern,
+                         int r_q8, int b_q8, int bits, uint16_t* dst, int dst_stride);
+
+} // namespace cambuffer_recorder_ng
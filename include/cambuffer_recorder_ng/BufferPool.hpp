@@ -24,6 +24,9 @@ public:
     /// Get a pointer to a free buffer (blocking if none available).
     uint8_t* acquire();
 
+    /// As acquire(), but gives up after `timeout_ms` and returns nullptr.
+    uint8_t* acquire_for(int timeout_ms);
+
     /// Return a previously acquired buffer to the pool.
     void release(uint8_t* buf);
 
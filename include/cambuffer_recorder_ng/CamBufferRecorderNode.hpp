@@ -2,29 +2,64 @@
 
 #include <rclcpp/rclcpp.hpp>
 #include <rclcpp_lifecycle/lifecycle_node.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <sensor_msgs/msg/image.hpp>
+#include <sensor_msgs/msg/compressed_image.hpp>
 #include <thread>
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <vector>
 
+#include "cambuffer_recorder_ng/ActivityLock.hpp"
+#include "cambuffer_recorder_ng/AutoExposure.hpp"
 #include "cambuffer_recorder_ng/XiCamera.hpp"
 #include "cambuffer_recorder_ng/FakeCamera.hpp"
 #include "cambuffer_recorder_ng/GenTLCamera.hpp"
+#include "cambuffer_recorder_ng/FrameBroker.hpp"
+#include "cambuffer_recorder_ng/MotionDetector.hpp"
+#include "cambuffer_recorder_ng/Preview.hpp"
 #include "cambuffer_recorder_ng/Recorder.hpp"
+#include "cambuffer_recorder_ng/FrameSynchronizer.hpp"
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
 
 namespace cambuffer_recorder_ng
 {
 
 /**
- * @brief Lifecycle node that wraps a camera and Recorder.
+ * @brief Lifecycle node that wraps one or more cameras and Recorders.
  *
- * When configured, it initializes the camera.
- * When activated, it starts streaming and recording to disk.
+ * When configured, it initializes the camera(s).
+ * When activated, it starts streaming and recording to disk: per camera a
+ * FrameBroker owns the grab loop and fans each frame out to the Recorder
+ * (lossless) and the node's stats loop (latest-only).
  * When deactivated, it stops and joins all threads.
+ *
+ * With more than one entry in `device_indices` it runs in multi-camera mode:
+ * one channel (camera, broker, writer, capture thread pinned to the matching
+ * entry of `capture_cpus`) per device, with a FrameSynchronizer matching the
+ * channels' frames by trigger count and reporting per-camera drops.
+ *
+ * Per-stage latency histograms (StageLatency) are published on /diagnostics
+ * at `diagnostics_rate_hz` while active and dumped as CSV on deactivation;
+ * with `trace_enable` the per-frame stage timeline is written as a trace.
+ * With `publish_every_n` > 0 every Nth frame is also published as a raw
+ * sensor_msgs/Image (loaned when the RMW supports it, otherwise handed off
+ * as a unique_ptr so composed subscribers get it without serialization).
+ * `preview_enable` adds a low-rate JPEG thumbnail on preview/image_raw/compressed.
+ * `motion_enable` runs a MotionDetector per camera: Start/End events go out on
+ * motion/events and, with `motion_gate`, limit recording to the active periods.
+ * `ae_enable` / `awb_enable` run an AutoExposure per camera that steers its
+ * exposure and gain and the white balance applied before MP4 debayering.
+ * The node is registered as an rclcpp_components component.
+ *
+ * Thread scheduling/affinity comes from the `thread.<role>.*` parameters and
+ * every thread's outcome is reported on /diagnostics as well.
  */
 class CamBufferRecorderNode : public rclcpp_lifecycle::LifecycleNode
 {
 public:
-    CamBufferRecorderNode();
+    explicit CamBufferRecorderNode(const rclcpp::NodeOptions& options = rclcpp::NodeOptions());
 
     using CallbackReturn =
         rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn;
@@ -36,18 +71,70 @@ protected:
 
 private:
     void run_loop();
+    rcl_interfaces::msg::SetParametersResult
+    on_parameters(const std::vector<rclcpp::Parameter>& params);
 
-    std::shared_ptr<ICamera> camera_;
-    //std::shared_ptr<XiCamera> camera_;
-    //std::shared_ptr<GenTLCamera> camera_;
-    //std::shared_ptr<FakeCamera> camera_;
-    std::shared_ptr<Recorder> recorder_;
+    struct Channel {
+        int device_index = 0;
+        int capture_cpu = -1;
+        std::shared_ptr<ICamera> camera;
+        //std::shared_ptr<XiCamera> camera;
+        //std::shared_ptr<GenTLCamera> camera;
+        //std::shared_ptr<FakeCamera> camera;
+        std::shared_ptr<FrameBroker> broker;     // sole caller of camera->grab()
+        std::shared_ptr<Recorder> recorder;      // lossless consumer
+        std::shared_ptr<FrameQueue> stats;       // latest-only consumer for run_loop
+        std::shared_ptr<FrameQueue> image_queue; // latest-only consumer for image_pub
+        rclcpp_lifecycle::LifecyclePublisher<sensor_msgs::msg::Image>::SharedPtr image_pub;
+        std::shared_ptr<FrameQueue> preview_queue;   // latest-only, depth 1
+        std::shared_ptr<Preview> preview;
+        rclcpp_lifecycle::LifecyclePublisher<sensor_msgs::msg::CompressedImage>::SharedPtr preview_pub;
+        std::shared_ptr<FrameQueue> motion_queue;    // latest-only, depth 1
+        std::shared_ptr<MotionDetector> motion;
+        rclcpp_lifecycle::LifecyclePublisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr motion_pub;
+        std::shared_ptr<FrameQueue> ae_queue;        // latest-only, depth 1
+        std::shared_ptr<AutoExposure> ae;
+        std::shared_ptr<WhiteBalance> wb;            // read by the recorder and preview
+        int width = 0, height = 0;                   // what the camera delivers
+        int sensor_downsample = 1;                   // factor the camera applies
+        int host_downsample = 1;                     // ... or the broker, when the camera cannot
+        Downsampling downsample_mode = Downsampling::Binning;
+        bool exposure_control = false;               // camera took exposure_us / gain_db
+        double exposure_us = 0.0, gain_db = 0.0;     // as programmed at configure
+    };
+
+    std::shared_ptr<ICamera> make_camera(const std::string& backend, size_t index) const;
+    std::string channel_path(const std::string& base, size_t i) const;
+    ThreadPolicy role_policy(ThreadRole role) const;
+    void log_sync_stats();
+    void stop_channels();
+    void publish_loop(size_t channel, int every_n);
+    rclcpp::Time stamp_of(size_t channel, const Frame& f);
+    void start_preview(size_t channel);
+    MotionDetector::Options motion_options() const;
+    void start_motion(size_t channel, MotionDetector::Options mo);
+    void start_ae(size_t channel);
+    void publish_diagnostics();
+    void dump_latency(const std::string& output_path);
+    void dump_trace(const std::string& output_path);
+
+    std::vector<Channel> channels_;
+    std::deque<std::atomic<int64_t>> clock_offset_ns_;   // per channel: ROS time - camera ts
+    FrameSynchronizer sync_;
 
     std::thread worker_;
+    std::vector<std::thread> image_threads_;
     std::atomic<bool> running_{false};
+    ActivityLock activity_;   // held while active, so background jobs back off
+    OnSetParametersCallbackHandle::SharedPtr param_cb_;
+
+    rclcpp_lifecycle::LifecyclePublisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diag_pub_;
+    rclcpp::TimerBase::SharedPtr diag_timer_;
 
     int width_{640};
     int height_{480};
+    int offset_x_{0};
+    int offset_y_{0};
     int fps_{30};
 };
 
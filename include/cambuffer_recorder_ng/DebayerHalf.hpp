@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
+
+namespace cambuffer_recorder_ng {
+
+// Half-resolution Bayer kernels shared by the pipeline and cambuffer_bench.
+// All take RAW8 input with `stride` bytes per row (width + padding_x) and
+// write packed output; odd trailing rows/columns are ignored.
+
+/// One BGR24 pixel per 2x2 cell (the two greens averaged). BGR order for FFmpeg.
+void debayer_half_bgr(const uint8_t* src, int w, int h, int stride,
+                      uint8_t* dst, BayerPattern pattern);
+
+/// One gray pixel per 2x2 cell: (R + G1 + G2 + B) / 4.
+void debayer_half_gray(const uint8_t* src, int w, int h, int stride, uint8_t* dst);
+
+/// Half-resolution mosaic with the input's CFA layout: every 4x4 input block
+/// becomes one 2x2 cell whose sites average the four same-colour input sites,
+/// so the output still debayers to colour. out_w = (in_w / 4) * 2, likewise
+/// out_h. The layout is kept whatever `pattern` is; it only documents it.
+void bayer_half_preserve_cfa(const uint8_t* in, int in_w, int in_h, int stride,
+                             uint8_t* out, int& out_w, int& out_h,
+                             BayerPattern pattern);
+
+/// The same binning, additive: each site is the 10-bit sum of its four inputs
+/// (0..1020) in 16 bits, for low light where averaging would throw away signal.
+void bayer_half_preserve_cfa(const uint8_t* in, int in_w, int in_h, int stride,
+                             uint16_t* out, int& out_w, int& out_h,
+                             BayerPattern pattern);
+
+} // namespace cambuffer_recorder_ng
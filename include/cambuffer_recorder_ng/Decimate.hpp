@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+
+namespace cambuffer_recorder_ng {
+
+// 2x2 area decimation with a gain, fused into one pass: each output sample is
+// the 16-bit sum of four input samples of the same channel, scaled by
+// gain / 4 in fixed point (1/256 steps, up to 127.99), rounded and saturated
+// to 8 bits. Replaces cv::resize(INTER_AREA) followed by convertTo(gain),
+// which reads and writes the half-size image twice. Odd trailing rows and
+// columns are ignored; SSE2 where available.
+
+/// Interleaved input with `channels` bytes per pixel (1 = gray, 3 = RGB/BGR, ...).
+/// Output is packed, (w / 2) x (h / 2) pixels of `channels` bytes.
+void decimate_2x2_gain(const uint8_t* src, int w, int h, int stride, int channels,
+                       double gain, uint8_t* dst);
+
+/// RAW8 mosaic, each CFA colour on its own: an output site sums the four
+/// same-colour sites of its 4x4 input block, so the output is a mosaic of the
+/// same pattern, out_w = (w / 4) * 2, out_h = (h / 4) * 2, packed.
+void bayer_decimate_2x2_gain(const uint8_t* src, int w, int h, int stride, double gain,
+                             uint8_t* dst, int& out_w, int& out_h);
+
+// Host stand-ins for a sensor's own 2x2 downsampling, in the layout the
+// sensor would send. `period` is the CFA period (2 Bayer, 1 gray/RGB): each
+// output site comes from the four same-colour sites of its block, so the
+// output is (w / 2p * p) x (h / 2p * p) and keeps the pattern. Strides in bytes.
+
+/// Skipping: the first of the four sites, `bpp` bytes per pixel. SSE2 when
+/// bpp * period is 1, 2 or 4 (RAW8, Mono16, Bayer8, Bayer16).
+void skip_2x2(const uint8_t* src, int w, int h, int stride, int bpp, int period,
+              uint8_t* dst, int dst_stride);
+
+/// Binning of 16-bit samples: rounded mean of the four sites. SSE2.
+void bin_2x2_16(const uint16_t* src, int w, int h, int stride, int period,
+                uint16_t* dst, int dst_stride);
+
+} // namespace cambuffer_recorder_ng
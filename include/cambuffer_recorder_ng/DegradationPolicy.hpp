@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Escalation ladder for a writer that cannot keep up.
+ *
+ * Fed one observation per frame (queue fill and load = work per frame /
+ * frame period). Sustained overload for `escalate_ns` activates the next
+ * step; sustained health for `recover_ns` backs one step off. Between the
+ * two bands nothing changes, and the long recover window versus the short
+ * escalate window is what keeps the level from flapping. Level k means
+ * steps[0..k) are active.
+ */
+class DegradationPolicy {
+public:
+    enum class Step { Compress, HalfRes, Decimate, Drop };
+
+    struct Options {
+        std::vector<Step> steps{Step::Compress, Step::HalfRes, Step::Decimate, Step::Drop};
+        double high_water = 0.6;       // queue fill counted as falling behind
+        double low_water = 0.2;        // queue fill counted as healthy
+        double overload_ratio = 1.0;   // load at or above: falling behind
+        double recover_ratio = 0.7;    // load at or below: healthy
+        uint64_t escalate_ns = 250000000ull;
+        uint64_t recover_ns = 2000000000ull;
+    };
+
+    struct Change {
+        int from = 0, to = 0;
+        std::string from_name, to_name;   // "normal" or the step name at that level
+        uint64_t ts_ns = 0;
+        double fill = 0, load = 0;
+        std::string describe() const;     // one line, used in logs and file metadata
+    };
+
+    static const char* step_name(Step s);
+    static bool parse_step(const std::string& name, Step& out);
+
+    void reset(const Options& opt);
+
+    /// Returns true when the level changed; details in last_change().
+    bool update(uint64_t now_ns, double fill, double load);
+
+    int level() const { return level_; }
+    bool active(Step s) const;
+    const Options& options() const { return opt_; }
+    const Change& last_change() const { return change_; }
+
+private:
+    std::string level_name(int level) const;
+
+    Options opt_;
+    int level_ = 0;
+    uint64_t behind_since_ = 0;
+    uint64_t healthy_since_ = 0;
+    Change change_;
+};
+
+} // namespace cambuffer_recorder_ng
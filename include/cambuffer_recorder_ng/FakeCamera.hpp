@@ -2,58 +2,81 @@
 #include <vector>
 #include <cstdint>
 #include <chrono>
-#include <thread>
 #include <random>
 #include "cambuffer_recorder_ng/ICamera.hpp"
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
 
 namespace cambuffer_recorder_ng {
 
 /**
- * @brief Simple fake camera that generates synthetic gradient frames.
+ * @brief Deterministic synthetic camera for pipeline tests without hardware.
+ *
+ * A ring of frames is rendered once in open(); grab() only hands out
+ * pointers into it, so delivery cost is independent of resolution. Frames
+ * are paced against an absolute deadline clock (no accumulated sleep error),
+ * which holds exact rates into the thousands of fps. Frame numbers behave
+ * like a camera counter: they keep running through injected drops, stalls
+ * and consumer overruns, so gaps show up exactly as they would on hardware.
  */
 class FakeCamera : public ICamera {
 public:
+    struct Options {
+        int width = 640;
+        int height = 480;
+        double fps = 30.0;
+        PixelFormat format = PixelFormat::Bayer8;
+        BayerPattern pattern = BayerPattern::GBRG;
+        int bit_depth = 10;         // Mono16/Bayer16 only: valid bits, 9..16
+        int frames = 16;            // pre-rendered frames cycled through
+        int queue_frames = 4;       // frames "buffered" before overruns count as drops
+        double drop_prob = 0.0;     // chance each frame is lost in transport
+        int jitter_us = 0;          // +/- uniform delivery jitter
+        int stall_every = 0;        // every N frames, stop delivering for stall_ms (0 = off)
+        int stall_ms = 0;
+        bool downsampling = false;  // accept set_downsampling() like a sensor that bins / skips
+        uint32_t seed = 1;
+    };
+
     FakeCamera(int width = 640, int height = 480, int fps = 30)
-        : width_(width), height_(height), fps_(fps), frame_bytes_(width * height)
-    {
-        buffer_.resize(frame_bytes_);
-    }
+        : FakeCamera(Options{width, height, static_cast<double>(fps)}) {}
+    explicit FakeCamera(const Options& opt) : opt_(opt) {}
 
-    void open(int device_index = 0) override {}
-    void start() override { running_ = true; }
+    void open(int device_index = 0) override;
+    void start() override;
     void stop() override { running_ = false; }
 
     bool grab(uint8_t*& data, size_t& size, uint64_t& ts,
-              int& width, int& height, int& stride, int timeout_ms = 100) override
-    {
-        if (!running_) return false;
-        static uint64_t counter = 0;
-        counter++;
-
-        // Simple moving gradient pattern
-        for (int y = 0; y < height_; ++y) {
-            for (int x = 0; x < width_; ++x)
-                buffer_[y * width_ + x] = static_cast<uint8_t>((x + y + counter) % 255);
-        }
-
-        data = buffer_.data();
-        size = buffer_.size();
-        width = width_;
-        height = height_;
-        stride = width_;
-        ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                 std::chrono::steady_clock::now().time_since_epoch()).count();
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / fps_));
-        return true;
-    }
+              int& width, int& height, int& stride, int timeout_ms = 100) override;
+
+    uint64_t frame_number() const override { return counter_; }
+    PixelFormat pixel_format() const override { return opt_.format; }
+    BayerPattern bayer_pattern() const override { return opt_.pattern; }
+    int bit_depth() const override { return is_16bit(opt_.format) ? opt_.bit_depth : 8; }
+    /// With Options::downsampling, re-renders the ring at the reduced size,
+    /// so grab() hands out as few bytes as a downsampling sensor would send.
+    bool set_downsampling(int factor, Downsampling mode, int& width, int& height) override;
+
+    /// Frames deliberately lost so far (drops + stalls + overruns).
+    uint64_t injected_drops() const { return injected_drops_; }
 
 private:
-    int width_, height_, fps_;
-    size_t frame_bytes_;
+    using Clock = std::chrono::steady_clock;
+
+    void render();
+    static void wait_until(Clock::time_point t);
+
+    Options opt_;
+    int full_w_ = 0, full_h_ = 0;   // opt_.width/height before downsampling
     bool running_{false};
-    std::vector<uint8_t> buffer_;
+    std::vector<std::vector<uint8_t>> frames_;
+    size_t frame_bytes_ = 0;
+
+    Clock::duration period_{};
+    Clock::time_point next_{};      // nominal exposure time of frame counter_ + 1
+    uint64_t counter_ = 0;
+    uint64_t last_stall_ = 0;       // stall period (counter_ / stall_every) last stalled in
+    uint64_t injected_drops_ = 0;
+    std::mt19937 rng_;
 };
 
 } // namespace cambuffer_recorder_ng
-
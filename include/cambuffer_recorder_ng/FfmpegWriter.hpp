@@ -1,19 +1,73 @@
 #pragma once
 #include <string>
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <memory>
 #include <mutex>
+#include <utility>
+#include <vector>
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
 }
+#include "cambuffer_recorder_ng/BayerStats.hpp"
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
+#include "cambuffer_recorder_ng/TextOverlay.hpp"
 
 namespace cambuffer_recorder_ng {
 
+/// FFmpeg input format for frames in our layout (RAW8 Bayer goes in as bayer_*8,
+/// Bayer16 as bayer_*16le).
+inline AVPixelFormat to_av_format(PixelFormat fmt, BayerPattern pattern)
+{
+    switch (fmt) {
+        case PixelFormat::Rgb24: return AV_PIX_FMT_RGB24;
+        case PixelFormat::Mono8: return AV_PIX_FMT_GRAY8;
+        case PixelFormat::Mono16: return AV_PIX_FMT_GRAY16LE;
+        case PixelFormat::Bayer16:
+            switch (pattern) {
+                case BayerPattern::RGGB: return AV_PIX_FMT_BAYER_RGGB16LE;
+                case BayerPattern::GRBG: return AV_PIX_FMT_BAYER_GRBG16LE;
+                case BayerPattern::BGGR: return AV_PIX_FMT_BAYER_BGGR16LE;
+                case BayerPattern::GBRG: break;
+            }
+            return AV_PIX_FMT_BAYER_GBRG16LE;
+        case PixelFormat::Bayer8: break;
+    }
+    switch (pattern) {
+        case BayerPattern::RGGB: return AV_PIX_FMT_BAYER_RGGB8;
+        case BayerPattern::GRBG: return AV_PIX_FMT_BAYER_GRBG8;
+        case BayerPattern::BGGR: return AV_PIX_FMT_BAYER_BGGR8;
+        case BayerPattern::GBRG: break;
+    }
+    return AV_PIX_FMT_BAYER_GBRG8;
+}
+
 /**
  * @brief Simple wrapper around FFmpeg for encoding RGB frames to video.
  *
+ * The input pixel format defaults to RGB24; raw sensor frames can be passed
+ * straight in as e.g. AV_PIX_FMT_BAYER_GBRG8 and swscale debayers them.
+ * 10/12-bit sensor data goes in as bayer_*16le / gray16le together with
+ * set_input_bit_depth().
+ *
+ * With set_fragment_ms() the file is written as fragments (fragmented MP4, or
+ * Matroska clusters for .mkv): it is playable while being written, a crash
+ * loses at most the fragment in progress, and close() no longer has to write
+ * a moov that grows with the recording.
+ *
+ * With set_segment() the output rolls to <stem>_0000<ext>, <stem>_0001<ext>, ...
+ * by size or duration. The encoder keeps running across the boundary; the
+ * next file's muxer is opened (header written) in the background ahead of
+ * time, the switch happens on the next keyframe (one is forced when the limit
+ * is hit), and the finished file's trailer is written in the background too.
+ * Each segment's timestamps start at zero. If the next file cannot be opened
+ * the current one simply grows; the open is retried with a back-off (1 s,
+ * doubling to 30 s) and never waited for on the frame path.
+ *
  * Usage:
  *   FfmpegWriter writer;
  *   writer.open("out.mp4", 1024, 350, 100, "libx264");
@@ -29,14 +83,70 @@ public:
               int width,
               int height,
               int fps,
-              const std::string& codec_name = "libx264");
+              const std::string& codec_name = "libx264",
+              AVPixelFormat input_fmt = AV_PIX_FMT_RGB24);
+
+    /// Fragment duration for the next open(); also caps the GOP so every fragment
+    /// starts on a keyframe. 0 = classic MP4 with the index written at close().
+    void set_fragment_ms(int ms) { fragment_ms_ = ms > 0 ? ms : 0; }
+
+    /// Roll to a new segment once it reaches max_bytes or max_ms (0 = no limit);
+    /// both 0 (the default) writes the single file named in open().
+    void set_segment(uint64_t max_bytes, int max_ms)
+    { segment_bytes_ = max_bytes; segment_ms_ = max_ms > 0 ? max_ms : 0; }
+
+    /// Pixel format the encoder gets at the next open() (default YUV420P); e.g.
+    /// GRAY8 with GRAY8 input keeps raw Bayer bit-exact for FFV1.
+    void set_encoder_format(AVPixelFormat fmt) { enc_fmt_ = fmt; }
+
+    /// Private codec option applied at the next open(), e.g. ("preset", "veryfast").
+    void set_codec_option(const std::string& key, const std::string& value)
+    { codec_opts_.emplace_back(key, value); }
 
-    bool write_frame(const uint8_t* rgb_data, int stride_bytes, int64_t pts_ns = 0);
+    /// Stamp frame number and time into the encoder's first (Y / gray) plane
+    /// after conversion; nullptr (the default) turns it off.
+    void set_overlay(std::shared_ptr<const TextOverlay> overlay) { overlay_ = std::move(overlay); }
+
+    /// R/B gains for Bayer input, applied in one pass before swscale debayers
+    /// (skipped while they are 1.0); read on every frame, so they may change
+    /// while recording. nullptr (the default) turns it off.
+    void set_white_balance(std::shared_ptr<const WhiteBalance> wb) { wb_ = std::move(wb); }
+
+    /// Valid low bits of 16-bit input (e.g. 10 or 12); swscale reads 16-bit
+    /// formats as full scale, so the samples are shifted up in the white
+    /// balance pass. 0 or 16 (the default) passes them as they are.
+    void set_input_bit_depth(int bits) { input_bits_ = bits; }
+
+    /// `frame_number` is what the overlay shows; -1 = this writer's frame count.
+    bool write_frame(const uint8_t* rgb_data, int stride_bytes, int64_t pts_ns = 0,
+                     int64_t frame_number = -1);
     void close();
 
+    /// Leave `n` frame slots empty so later frames keep their place in time.
+    void skip_frames(int n);
+
+    /// Scale the target bitrate relative to the one at open(); takes effect on
+    /// the next frame for encoders that reconfigure on the fly (libx264).
+    void scale_bitrate(double factor);
+
+    /// Container metadata tag, written with the trailer (MP4 keeps custom keys).
+    /// Fragmented MP4 writes its moov at open(), so later tags are not kept there.
+    void set_metadata(const std::string& key, const std::string& value);
+
     bool is_open() const { return fmt_ctx_ != nullptr; }
+    int segment_index() const { return segment_index_; }
 
 private:
+    bool segmenting() const { return segment_bytes_ > 0 || segment_ms_ > 0; }
+    std::string segment_name(int index) const;
+    AVFormatContext* open_muxer(const std::string& filename) const;
+    static void finish_muxer(AVFormatContext* ctx);
+    void prepare_next();
+    void poll_next();
+    bool segment_full() const;
+    void switch_segment(int64_t start_pts);
+    void write_packet(AVPacket* pkt);
+
     std::mutex mtx_;
     AVFormatContext* fmt_ctx_ = nullptr;
     AVCodecContext* codec_ctx_ = nullptr;
@@ -44,8 +154,32 @@ private:
     SwsContext* sws_ctx_ = nullptr;
     AVFrame* frame_yuv_ = nullptr;
     AVPacket* pkt_ = nullptr;
+    AVCodecParameters* params_ = nullptr;   // immutable after open(), read by open_muxer()
     int width_ = 0, height_ = 0, fps_ = 0;
+    AVPixelFormat input_fmt_ = AV_PIX_FMT_RGB24;
+    AVPixelFormat enc_fmt_ = AV_PIX_FMT_YUV420P;
     int64_t frame_index_ = 0;
+    int64_t base_bit_rate_ = 8'000'000;
+    int fragment_ms_ = 0;
+
+    std::string filename_;
+    uint64_t segment_bytes_ = 0;
+    int segment_ms_ = 0;
+    int segment_index_ = 0;
+    int64_t segment_start_pts_ = 0;      // codec time base
+    bool rotate_pending_ = false;        // past the limit, switching on the next keyframe
+    bool key_forced_ = false;            // the one forced keyframe of this rotation is asked for
+    std::string next_name_;
+    std::future<AVFormatContext*> next_;
+    AVFormatContext* next_ctx_ = nullptr;   // next_ once it has opened
+    int open_failures_ = 0;
+    std::chrono::steady_clock::time_point retry_at_{};
+    std::vector<std::future<void>> finishing_;
+    std::vector<std::pair<std::string, std::string>> codec_opts_;
+    std::shared_ptr<const TextOverlay> overlay_;
+    std::shared_ptr<const WhiteBalance> wb_;
+    std::vector<uint8_t> wb_buf_;
+    int input_bits_ = 0;
 };
 
 } // namespace cambuffer_recorder_ng
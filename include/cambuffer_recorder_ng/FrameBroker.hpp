@@ -0,0 +1,150 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cambuffer_recorder_ng/BufferPool.hpp"
+#include "cambuffer_recorder_ng/ICamera.hpp"
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/// One captured frame, packed rows (stride == width * bytes per pixel).
+struct Frame {
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+    int width = 0, height = 0, stride = 0;
+    PixelFormat format = PixelFormat::Bayer8;
+    BayerPattern pattern = BayerPattern::GBRG;
+    int bit_depth = 8;           // valid low bits of each sample (Mono16/Bayer16: 10..16)
+    uint64_t ts_ns = 0;          // camera timestamp
+    uint64_t frame_number = 0;   // camera counter (gaps = drops)
+    uint64_t seq = 0;            // broker sequence, no gaps
+};
+
+/// Shared, read-only handle; the pool slot is returned when the last holder lets go.
+using FramePtr = std::shared_ptr<const Frame>;
+
+enum class DropPolicy {
+    Block,    // lossless: the broker waits for space (recorder)
+    Latest    // never blocks the broker: oldest queued frame is dropped (preview, stats)
+};
+
+/**
+ * @brief Bounded per-consumer frame queue fed by a FrameBroker.
+ */
+class FrameQueue {
+public:
+    FrameQueue(std::string name, DropPolicy policy, size_t capacity)
+        : name_(std::move(name)), policy_(policy), capacity_(capacity ? capacity : 1),
+          trace_id_(next_trace_id()) {}
+
+    /// Wait up to timeout_ms for a frame; false on timeout or once closed and drained.
+    bool pop(FramePtr& out, int timeout_ms);
+
+    const std::string& name() const { return name_; }
+    DropPolicy policy() const { return policy_; }
+    size_t capacity() const { return capacity_; }
+    uint64_t delivered() const { return delivered_; }
+    uint64_t dropped() const { return dropped_; }
+    size_t depth() const;
+    bool closed() const;
+
+private:
+    friend class FrameBroker;
+    void push(FramePtr frame, uint64_t now_ns);
+    void close();
+    void reopen();
+    static uint32_t next_trace_id();
+
+    struct Entry { FramePtr frame; uint64_t enqueued_ns; };
+
+    std::string name_;
+    DropPolicy policy_;
+    size_t capacity_;
+    uint32_t trace_id_;            // tells this queue's dwell spans apart in the trace
+    std::deque<Entry> q_;
+    bool closed_ = false;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::atomic<uint64_t> delivered_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+/**
+ * @brief Sole owner of a camera's grab loop, fanning frames out to consumers.
+ *
+ * One capture thread grabs, copies the active pixels once into a pooled
+ * slot, and hands the same ref-counted Frame to every registered
+ * FrameQueue. Block consumers apply backpressure; Latest consumers only ever
+ * see the freshest frames. The camera must already be started.
+ *
+ * For a camera that cannot downsample on the sensor, Options::downsample
+ * halves the resolution on the host instead, fused into that one copy: the
+ * slots (and every consumer) see the reduced frame, the full-size one never
+ * leaves the grab buffer.
+ */
+class FrameBroker {
+public:
+    struct Options {
+        size_t pool_frames = 32;
+        int grab_timeout_ms = 100;
+        ThreadPolicy capture_policy;
+        std::string name = "broker";
+        int downsample = 1;          // 1, or 2: host 2x2 binning / skipping
+        Downsampling downsample_mode = Downsampling::Binning;
+    };
+
+    /// Frame size the broker publishes for a `width` x `height` camera under
+    /// `factor` (in place). False if the host cannot reduce by that factor.
+    static bool downsampled_size(PixelFormat format, int factor, int& width, int& height);
+
+    FrameBroker() = default;
+    ~FrameBroker() { stop(); }
+
+    /// Register a consumer; may be called before or after start().
+    std::shared_ptr<FrameQueue> add_consumer(const std::string& name, DropPolicy policy, size_t capacity);
+
+    /// Called on the capture thread for every frame, before fan-out (keep it cheap).
+    void set_on_frame(std::function<void(const Frame&)> fn) { on_frame_ = std::move(fn); }
+
+    /// width/height: what the camera delivers (before any host downsampling).
+    bool start(std::shared_ptr<ICamera> camera, int width, int height, const Options& opt);
+    void stop();
+
+    uint64_t frames_captured() const { return captured_; }
+    int width() const { return width_; }     // published frames
+    int height() const { return height_; }
+    std::vector<std::shared_ptr<FrameQueue>> consumers() const;
+
+private:
+    void capture_loop();
+    void copy_downsampled(const uint8_t* data, int w, int h, int stride, uint8_t* slot) const;
+
+    std::shared_ptr<ICamera> camera_;
+    std::shared_ptr<BufferPool> pool_;    // shared with every outstanding FramePtr
+    Options opt_;
+    int in_width_ = 0, in_height_ = 0;   // camera frames
+    int width_ = 0, height_ = 0;         // published frames
+    size_t row_bytes_ = 0;
+    PixelFormat format_ = PixelFormat::Bayer8;
+    int bit_depth_ = 8;
+    BayerPattern pattern_ = BayerPattern::GBRG;
+
+    std::function<void(const Frame&)> on_frame_;
+    std::vector<std::shared_ptr<FrameQueue>> consumers_;
+    mutable std::mutex consumers_mtx_;
+
+    std::thread capture_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> captured_{0};
+};
+
+} // namespace cambuffer_recorder_ng
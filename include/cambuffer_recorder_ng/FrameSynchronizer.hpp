@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Assembles matched frame sets from several hardware-triggered cameras.
+ *
+ * Each capture thread reports (camera, frame_number, ts) after a grab. Frames
+ * are keyed by trigger count: the first camera to report anchors the key
+ * space, and every other camera is lined up by timestamp, taking the offset
+ * of the recent key whose time is within max_skew of its frame. A frame that
+ * matches none is held back until a later key does match it (its partner was
+ * simply not in yet); otherwise it is discarded. A set is complete once every
+ * camera has reported its key. Counter gaps are counted as drops for the
+ * camera concerned, and sets that fall out of the matching window incomplete
+ * are discarded and counted. Several complete sets in a row over max_skew
+ * mean the offsets are wrong (e.g. a camera missed a pulse its counter did
+ * not see); all cameras are then lined up again.
+ */
+class FrameSynchronizer {
+public:
+    struct CameraStats {
+        uint64_t frames = 0;        // frames reported
+        uint64_t dropped = 0;       // missing trigger counts (counter gaps)
+        uint64_t unaligned = 0;     // discarded while being lined up by timestamp
+        int64_t  last_skew_ns = 0;  // ts - first ts of the last completed set
+    };
+    struct Stats {
+        uint64_t matched_sets = 0;
+        uint64_t incomplete_sets = 0;
+        uint64_t skew_violations = 0;   // complete sets spread wider than max_skew
+        uint64_t resyncs = 0;           // times the cameras were lined up again
+        std::vector<CameraStats> cameras;
+    };
+
+    /// (trigger index, per-camera timestamps) for every complete set.
+    using SetCallback = std::function<void(uint64_t, const std::vector<uint64_t>&)>;
+
+    void reset(size_t n_cameras, int64_t max_skew_ns, size_t window = 64);
+    void set_callback(SetCallback cb) { callback_ = std::move(cb); }
+
+    /// Thread-safe; called from each camera's capture thread.
+    void observe(size_t camera, uint64_t frame_number, uint64_t ts_ns);
+
+    Stats stats() const;
+    size_t cameras() const { return n_; }
+
+private:
+    struct Pending {
+        std::vector<uint64_t> ts;
+        std::vector<bool> have;
+        size_t count = 0;
+    };
+    struct Early {                  // last frame of a camera that could not be lined up
+        bool have = false;
+        uint64_t frame_number = 0;
+        uint64_t ts = 0;
+    };
+
+    static constexpr int kResyncAfter = 3;   // consecutive complete sets over max_skew
+
+    bool align(size_t camera, uint64_t frame_number, uint64_t ts_ns);
+    void adopt_early(uint64_t key, uint64_t ts_ns, Pending& p);
+    void resync();
+
+    size_t n_ = 0;
+    int64_t max_skew_ns_ = 0;
+    size_t window_ = 64;
+
+    std::vector<bool> have_base_;
+    std::vector<int64_t> base_;             // key = frame_number - base
+    std::vector<Early> early_;
+    std::vector<bool> have_last_;
+    std::vector<uint64_t> last_key_;
+    std::map<uint64_t, Pending> pending_;   // key = trigger index
+    std::map<uint64_t, uint64_t> key_ts_;   // first timestamp seen per recent key
+    uint64_t newest_key_ = 0;
+    uint64_t next_anchor_key_ = 0;          // keys keep rising across a resync
+    int over_skew_ = 0;                     // consecutive complete sets over max_skew
+
+    Stats stats_;
+    SetCallback callback_;
+    mutable std::mutex mtx_;
+};
+
+} // namespace cambuffer_recorder_ng
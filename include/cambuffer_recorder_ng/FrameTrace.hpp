@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "cambuffer_recorder_ng/LatencyStats.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Optional per-frame stage timeline, exported as a Chrome/Perfetto trace.
+ *
+ * Each thread appends {stage, frame, begin, end} to its own preallocated ring
+ * (oldest events are overwritten, so the tail leading up to a drop survives).
+ * Disabled, a trace point costs one relaxed load. Export with write_json()
+ * once the recording threads have stopped; open in ui.perfetto.dev or
+ * chrome://tracing.
+ */
+class FrameTracer {
+public:
+    struct Event {
+        uint64_t begin_ns;
+        uint64_t end_ns;
+        uint64_t frame;
+        uint32_t track;   // which queue a QueueDwell span belongs to
+        Stage stage;
+    };
+
+    static FrameTracer& global();
+
+    /// Start recording; rings are sized to `ring_events` per thread.
+    void enable(size_t ring_events);
+    void disable() { enabled_.store(false, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /// Label the calling thread in the exported trace.
+    void name_thread(const std::string& name);
+
+    void add(Stage s, uint64_t frame, uint64_t begin_ns, uint64_t end_ns, uint32_t track = 0)
+    {
+        Ring& r = local();
+        r.events[r.head % r.events.size()] = {begin_ns, end_ns, frame, track, s};
+        r.head++;
+    }
+
+    /// Chrome trace-event JSON; QueueDwell becomes async spans keyed by queue and frame.
+    bool write_json(const std::string& path) const;
+
+    /// Drop all rings (call between recordings, with no traced thread running).
+    void clear();
+
+private:
+    struct Ring {
+        std::vector<Event> events;
+        uint64_t head = 0;
+        int tid = 0;
+        std::string name;
+    };
+
+    Ring& local();
+
+    std::atomic<bool> enabled_{false};
+    size_t ring_events_ = 1 << 16;
+    std::atomic<uint64_t> epoch_{0};   // bumped by clear(); stale thread_local rings re-register
+    std::deque<Ring> rings_;
+    mutable std::mutex mtx_;
+};
+
+/// Feed one finished stage to the latency histograms and, if on, the tracer.
+inline void stage_done(Stage s, uint64_t frame, uint64_t begin_ns, uint64_t end_ns, uint32_t track = 0)
+{
+    StageLatency::global().record(s, end_ns - begin_ns);
+    auto& tr = FrameTracer::global();
+    if (tr.enabled()) tr.add(s, frame, begin_ns, end_ns, track);
+}
+
+} // namespace cambuffer_recorder_ng
@@ -28,7 +28,7 @@ public:
 
     bool grab(uint8_t*& data, size_t& size, uint64_t& ts,
               int& width, int& height, int& stride, int timeout_ms = 100) override;
-
+    uint64_t frame_number() const override { return frame_id_; }
 
 private:
     // dynamic library handle
@@ -43,6 +43,7 @@ private:
 
     std::vector<uint8_t> buffer_;
     std::atomic<bool> running_{false};
+    uint64_t frame_id_ = 0;
     bool use_gc_path_ = false; // true if GC* symbols were found/used
 
     struct BufRec { void* hBuf = nullptr; void* pData = nullptr; size_t sz = 0; };
@@ -2,9 +2,14 @@
 #include <cstdint>
 #include <cstddef>
 #include <stdexcept>
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
 
 namespace cambuffer_recorder_ng {
 
+/// On-sensor resolution reduction: binning combines neighbouring same-colour
+/// sites, skipping reads only one of them. Both keep the Bayer pattern.
+enum class Downsampling { Binning, Skipping };
+
 class ICamera {
 public:
     virtual ~ICamera() = default;
@@ -16,7 +21,46 @@ public:
 
     virtual bool grab(uint8_t*& data, size_t& size, uint64_t& ts,
                       int& width, int& height, int& stride, int timeout_ms = 100) = 0;
+
+    /// Layout of the buffers grab() returns.
+    virtual PixelFormat pixel_format() const { return PixelFormat::Bayer8; }
+    virtual BayerPattern bayer_pattern() const { return BayerPattern::GBRG; }
+    /// Valid bits per sample: 8 for the 8-bit formats, 10..16 for Mono16/Bayer16.
+    virtual int bit_depth() const { return 8; }
+
+    /// Camera-side frame/trigger counter of the most recent successful grab()
+    /// (0 if the backend has none). Gaps in this sequence are dropped frames.
+    virtual uint64_t frame_number() const { return 0; }
+
+    /// Request a sensor ROI. Values are rounded in place to what the backend
+    /// will actually use. Returns false if the backend has no ROI support, or
+    /// if it is streaming and the size would change (only offsets may move).
+    virtual bool set_roi(int& width, int& height, int& offset_x, int& offset_y)
+    {
+        (void)width; (void)height; (void)offset_x; (void)offset_y;
+        return false;
+    }
+
+    /// Reduce the resolution `factor` times in each direction on the camera,
+    /// before the data crosses the link (1 = full resolution). Only while
+    /// stopped. The ROI is reset and from then on given in reduced pixels;
+    /// width/height receive the new full frame. Returns false, leaving the
+    /// camera as it was, if the backend cannot; the broker can do it instead.
+    virtual bool set_downsampling(int factor, Downsampling mode, int& width, int& height)
+    {
+        (void)factor; (void)mode; (void)width; (void)height;
+        return false;
+    }
+
+    /// Exposure time (us) and gain (dB), rounded in place to what the backend
+    /// will use. While streaming this must not stall grab(): backends hand it
+    /// over to be applied between frames. Returns false if there is no
+    /// exposure control.
+    virtual bool set_exposure(double& exposure_us, double& gain_db)
+    {
+        (void)exposure_us; (void)gain_db;
+        return false;
+    }
 };
 
 } // namespace cambuffer_recorder_ng
-
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Reusable in-memory JPEG compressor (libjpeg / libjpeg-turbo).
+ *
+ * Uses the fast integer DCT; libjpeg errors are caught and reported as a
+ * false return instead of terminating the process.
+ */
+class JpegEncoder {
+public:
+    JpegEncoder();
+    ~JpegEncoder();
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    /// components: 1 = gray, 3 = packed RGB. `out` is replaced with the JPEG stream.
+    bool encode(const uint8_t* pixels, int width, int height, int components,
+                int quality, std::vector<uint8_t>& out);
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
+
+} // namespace cambuffer_recorder_ng
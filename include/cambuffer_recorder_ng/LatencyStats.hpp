@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+/// Pipeline stages with their own latency histogram.
+enum class Stage : uint8_t {
+    GrabWait,    // blocked in camera grab
+    Copy,        // camera buffer -> pool slot
+    Debayer,     // Bayer/RGB -> encoder input (kernels, swscale)
+    Compress,    // LZ4 etc.
+    Encode,      // codec send/receive
+    Write,       // file / muxer write
+    QueueDwell,  // capture enqueue -> writer dequeue
+    Count
+};
+constexpr size_t kStageCount = static_cast<size_t>(Stage::Count);
+const char* stage_name(Stage s);
+
+/**
+ * @brief Log-linear (HDR-style) histogram of nanosecond latencies.
+ *
+ * 32 sub-buckets per power of two (~3% resolution) from 1 ns to ~18 min,
+ * exact max. Single writer, any number of concurrent readers: record() is a
+ * relaxed load/store per counter, with no locks and no read-modify-write.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 5;
+    static constexpr int kSub = 1 << kSubBits;
+    static constexpr int kMaxExp = 40;
+    static constexpr size_t kBuckets = (kMaxExp - kSubBits + 2) * kSub;
+
+    void record(uint64_t ns)
+    {
+        auto& c = counts_[index(ns)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (ns > max_.load(std::memory_order_relaxed)) max_.store(ns, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    }
+
+    static size_t index(uint64_t ns);
+    static uint64_t bucket_upper(size_t idx);   // largest value mapping to idx
+
+    uint64_t count_at(size_t i) const { return counts_[i].load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    void reset();
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+    std::atomic<uint64_t> max_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+/**
+ * @brief Process-wide per-stage latency statistics.
+ *
+ * Every recording thread gets its own shard of histograms on first use, so
+ * the hot path never shares a cache line or takes a lock; summarize() merges
+ * the shards on demand (diagnostics timer, shutdown dump). A thread's shard
+ * goes back to a free list when it exits (counts kept), so the threads of
+ * the next activation reuse them instead of adding more.
+ */
+class StageLatency {
+public:
+    struct Summary {
+        uint64_t count = 0;
+        double mean_ns = 0;
+        uint64_t p50_ns = 0, p99_ns = 0, p999_ns = 0, max_ns = 0;
+    };
+
+    static StageLatency& global();
+
+    void record(Stage s, uint64_t ns);
+    std::array<Summary, kStageCount> summarize() const;
+    void reset();
+
+    /// Summary table followed by the merged non-empty buckets, as CSV.
+    bool dump(const std::string& path) const;
+
+private:
+    struct Shard { std::array<LatencyHistogram, kStageCount> h; };
+
+    Shard& local();
+    void release(Shard* shard);
+    std::array<uint64_t, LatencyHistogram::kBuckets> merged(Stage s, uint64_t& max, uint64_t& sum) const;
+
+    std::deque<Shard> shards_;       // deque: shards never move once handed out
+    std::vector<Shard*> free_;       // shards of exited threads
+    mutable std::mutex mtx_;         // guards shards_ growth and free_
+};
+
+/// Records the lifetime of the scope into one stage.
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(Stage s) : s_(s), t0_(std::chrono::steady_clock::now()) {}
+    ~ScopedStageTimer()
+    {
+        StageLatency::global().record(s_, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0_).count()));
+    }
+private:
+    Stage s_;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+} // namespace cambuffer_recorder_ng
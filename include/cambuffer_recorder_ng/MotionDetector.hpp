@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cambuffer_recorder_ng/FrameBroker.hpp"
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Motion trigger on a decimated green plane, fed by a latest-only consumer.
+ *
+ * Every Nth frame is reduced by `factor` to a green plane, averaging the G
+ * sites of one CFA row pair per block (bayer_green_sparse: only 2 of every
+ * `factor` rows are read), and compared with a running background. The
+ * energy of a region is its mean absolute difference per watched pixel
+ * (0..255), summed with SSE2 psadbw; the background then moves 1/2^bg_shift
+ * of the way towards the frame.
+ *
+ * Regions are rectangles in normalized coordinates, each with its own
+ * threshold; an optional PGM mask (any size, 0 = ignore) is laid over all of
+ * them. A Start event fires when any region goes over its threshold, an End
+ * event once every region has stayed under for `hold_ms` of camera time.
+ * Both carry the camera timestamp of the frame that decided them.
+ */
+class MotionDetector {
+public:
+    struct Region {
+        double x = 0.0, y = 0.0, w = 1.0, h = 1.0;   // fraction of the frame
+        double threshold = 6.0;                     // mean |frame - background|
+    };
+
+    struct Options {
+        int every_n = 2;            // broker seq multiples of N; 0/1 = newest frame
+        int factor = 8;             // decimation (4 or 8 take the SSE2 path)
+        std::vector<Region> regions{Region{}};
+        std::string mask_path;      // PGM (P5), nonzero = watched; "" = everything
+        int bg_shift = 4;           // background rate 1/16 per processed frame
+        int warmup_frames = 10;     // processed frames before events may fire
+        int hold_ms = 2000;         // quiet time before End
+        ThreadPolicy policy;        // normally the Process role
+        std::string name = "motion";
+    };
+
+    struct Event {
+        bool start = false;         // false = End
+        uint64_t ts_ns = 0;         // camera clock
+        uint64_t frame_number = 0;
+        int region = -1;            // strongest region (Start) / last active (End)
+        double energy = 0.0;
+
+        std::string describe() const;
+    };
+
+    struct Stats {
+        uint64_t processed = 0;
+        uint64_t events = 0;
+        bool active = false;
+        double last_us = 0.0;       // decimate + SAD + background of the last frame
+        std::vector<double> energy; // per region, last frame
+    };
+
+    using Sink = std::function<void(const Event&)>;
+
+    MotionDetector() = default;
+    ~MotionDetector() { stop(); }
+
+    /// Parse "x y w h threshold" (normalized rectangle); false on malformed input.
+    static bool parse_region(const std::string& s, Region& out);
+
+    bool start(std::shared_ptr<FrameQueue> source, const Options& opt, Sink sink);
+    void stop();
+    Stats stats() const;
+
+    /// One frame through the detector, on the caller's thread (start() not needed,
+    /// but configure() is). Returns the event it decided, if any.
+    bool configure(const Options& opt);
+    bool process(const Frame& f, Event& ev);
+
+private:
+    void loop();
+    void setup(int gw, int gh);
+
+    std::shared_ptr<FrameQueue> source_;
+    Options opt_;
+    Sink sink_;
+
+    // Decimated plane, background (value << 7 and rounded to 8 bits) and mask (0 / 255).
+    int gw_ = 0, gh_ = 0;
+    std::vector<uint8_t> plane_, bg8_, mask_;
+    std::vector<int16_t> bg16_;
+    struct Rect { int x0, y0, x1, y1; uint32_t pixels; };
+    std::vector<Rect> rects_;
+    std::vector<uint8_t> file_mask_;
+    std::vector<uint8_t> narrow_;       // 16-bit frames, top 8 bits
+    int file_mask_w_ = 0, file_mask_h_ = 0;
+
+    uint64_t seen_ = 0;             // processed frames, for the warm-up
+    bool active_ = false;
+    uint64_t last_motion_ns_ = 0;
+    int last_region_ = -1;
+
+    Stats stats_;
+    mutable std::mutex stats_mtx_;
+
+    std::thread worker_;
+    std::atomic<bool> running_{false};
+};
+
+} // namespace cambuffer_recorder_ng
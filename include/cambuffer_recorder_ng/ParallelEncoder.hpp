@@ -0,0 +1,143 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "cambuffer_recorder_ng/FfmpegWriter.hpp"
+#include "cambuffer_recorder_ng/SegmentJoiner.hpp"
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Real-time encoder that spreads fixed-length segments over K encoders.
+ *
+ * The timeline is cut into segments of `segment_ms`; segment s goes to
+ * encoder s % K, each an independent FfmpegWriter on its own thread (and
+ * core, when `encode.cpus` lists at least K), writing <stem>_NNNN<ext>.
+ * A segment is one closed GOP from a fresh encoder, so while encoder k is
+ * still on segment s the others are already taking s+1, s+2, ...: K slow,
+ * high-quality encoders keep up with K times the frame rate of one.
+ *
+ * Finished segments are handed on strictly in order by a joiner thread:
+ *   Stitch    stream-copied into the one file named in open() as they come,
+ *             the segment files are removed
+ *   Playlist  kept, and listed with their durations in <stem>.ffconcat
+ *             (ffplay -f concat -safe 0 -i <stem>.ffconcat)
+ *
+ * write_frame() comes from one thread and blocks while the encoder it is
+ * feeding has `lane_frames` queued, which backs up into the caller's queue.
+ * Frames passed with an `owner` are queued by reference, otherwise copied.
+ */
+class ParallelEncoder {
+public:
+    enum class Join { Stitch, Playlist };
+
+    struct Options {
+        int encoders = 1;                 // K
+        int segment_ms = 1000;            // one GOP per segment
+        Join join = Join::Stitch;
+        std::string codec = "libx264";
+        std::vector<std::pair<std::string, std::string>> codec_opts{{"preset", "medium"}};
+        int encoder_threads = 1;          // codec threads inside each encoder
+        size_t lane_frames = 0;           // queued frames per encoder; 0 = one segment
+        ThreadPolicy encode;              // every encoder thread (cpus are dealt out)
+        ThreadPolicy io;                  // the joiner thread
+        std::shared_ptr<const TextOverlay> overlay;   // shared by every encoder
+        std::shared_ptr<const WhiteBalance> white_balance;   // Bayer input only, likewise
+        int input_bit_depth = 0;          // 16-bit input, as FfmpegWriter::set_input_bit_depth
+    };
+
+    static Join parse_join(const std::string& name);
+
+    ParallelEncoder() = default;
+    ~ParallelEncoder() { close(); }
+    ParallelEncoder(const ParallelEncoder&) = delete;
+    ParallelEncoder& operator=(const ParallelEncoder&) = delete;
+
+    bool open(const std::string& filename, int width, int height, int fps,
+              AVPixelFormat input_fmt, const Options& opt);
+
+    bool write_frame(const uint8_t* data, int stride, int64_t pts_ns,
+                     std::shared_ptr<const void> owner = nullptr, int64_t frame_number = -1);
+
+    /// Leave `n` frame slots empty so later frames keep their place in time.
+    void skip_frames(int n);
+
+    /// Bitrate relative to the base; applies from the next segment on.
+    void scale_bitrate(double factor);
+
+    /// Tag of the stitched file (in the playlist as a comment).
+    void set_metadata(const std::string& key, const std::string& value);
+
+    /// Encode what is queued, join the last segments, write the trailer.
+    void close();
+
+    bool is_open() const { return !lanes_.empty(); }
+    int64_t segments_joined() const;
+
+private:
+    struct Item {
+        enum Kind { Begin, Frame, End } kind = Frame;
+        int64_t segment = 0;
+        int64_t slot = 0;                 // frame slot within the segment
+        const uint8_t* data = nullptr;
+        int stride = 0;
+        int64_t pts_ns = 0;
+        int64_t frame_number = -1;
+        double bitrate = 1.0;             // Begin: scale for this segment
+        std::shared_ptr<const void> owner;
+        std::vector<uint8_t> copy;
+    };
+
+    struct Lane {
+        std::thread thread;
+        std::deque<Item> q;
+        size_t frames = 0;                // Frame items in q
+        bool stopping = false;
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    struct Done { bool ok = false; int64_t frames = 0; };   // frames = slots used
+
+    std::string segment_name(int64_t s) const;
+    void push(Item&& item);
+    void begin_segment(int64_t s);
+    void end_segment();
+    void lane_loop(Lane& lane, int k);
+    void join_loop();
+
+    Options opt_;
+    std::string filename_;
+    int width_ = 0, height_ = 0, fps_ = 0;
+    AVPixelFormat input_fmt_ = AV_PIX_FMT_RGB24;
+    int64_t seg_frames_ = 1;
+    std::vector<std::unique_ptr<Lane>> lanes_;
+
+    // Producer side (write_frame's thread).
+    int64_t slot_ = 0;                    // next frame slot on the timeline
+    int64_t cur_seg_ = -1;
+    double bitrate_ = 1.0;
+
+    // Segments finished by the encoders, consumed in order by the joiner.
+    std::thread joiner_;
+    mutable std::mutex join_mtx_;
+    std::condition_variable join_cv_;
+    std::map<int64_t, Done> done_;
+    int64_t next_join_ = 0;
+    int64_t last_seg_ = -1;               // set by close(): the joiner stops after it
+    bool closing_ = false;
+    SegmentJoiner stitch_;
+    FILE* playlist_ = nullptr;
+    std::vector<std::pair<std::string, std::string>> metadata_;
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace cambuffer_recorder_ng {
+
+// Colour filter layout, named by the top-left 2x2 block read row by row.
+enum class BayerPattern { RGGB, GRBG, GBRG, BGGR };
+
+// Mono16/Bayer16 are little-endian 16-bit containers holding the sensor's
+// 10/12/14/16-bit samples in the low bits (Frame::bit_depth says how many).
+enum class PixelFormat { Mono8, Bayer8, Rgb24, Mono16, Bayer16 };
+
+inline int bytes_per_pixel(PixelFormat f)
+{
+    switch (f) {
+        case PixelFormat::Rgb24: return 3;
+        case PixelFormat::Mono16:
+        case PixelFormat::Bayer16: return 2;
+        case PixelFormat::Mono8:
+        case PixelFormat::Bayer8: break;
+    }
+    return 1;
+}
+
+inline bool is_16bit(PixelFormat f) { return f == PixelFormat::Mono16 || f == PixelFormat::Bayer16; }
+
+/// The 8-bit layout of the same samples (Bayer16 -> Bayer8, Mono16 -> Mono8).
+inline PixelFormat to_8bit(PixelFormat f)
+{
+    if (f == PixelFormat::Bayer16) return PixelFormat::Bayer8;
+    if (f == PixelFormat::Mono16) return PixelFormat::Mono8;
+    return f;
+}
+
+/// Parses "rggb", "grbg", "gbrg" or "bggr" (case-insensitive); anything else is GBRG,
+/// which is what our XIMEA MQ022CG delivers.
+inline BayerPattern parse_bayer_pattern(const std::string& s)
+{
+    std::string l;
+    for (char c : s) l += static_cast<char>(c | 0x20);
+    if (l == "rggb") return BayerPattern::RGGB;
+    if (l == "grbg") return BayerPattern::GRBG;
+    if (l == "bggr") return BayerPattern::BGGR;
+    return BayerPattern::GBRG;
+}
+
+} // namespace cambuffer_recorder_ng
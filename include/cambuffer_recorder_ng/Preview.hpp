@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cambuffer_recorder_ng/BayerStats.hpp"
+#include "cambuffer_recorder_ng/FrameBroker.hpp"
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Low-resolution JPEG preview fed by a latest-only broker consumer.
+ *
+ * Takes every Nth frame (or simply the newest one), box-filters it down by
+ * 4x/8x and JPEG-encodes it on its own thread. CPU use is bounded: after
+ * each preview the thread stays idle until its measured CPU time is at most
+ * `cpu_budget` of wall time, letting the Latest queue overwrite frames in the
+ * meantime, so the recording path never sees backpressure.
+ */
+class Preview {
+public:
+    struct Options {
+        int factor = 8;             // 4 or 8 (any even factor works, slower)
+        bool color = true;          // RGB from the CFA; false = gray
+        int every_n = 0;            // 0/1 = newest frame, else broker seq multiples of N
+        double max_fps = 10.0;
+        int quality = 70;
+        double cpu_budget = 0.05;   // fraction of one core
+        std::shared_ptr<const WhiteBalance> white_balance;   // colour thumbnails, nullptr = raw
+        ThreadPolicy policy;        // normally the Preview role (SCHED_IDLE)
+        std::string name = "preview";
+    };
+
+    struct Stats {
+        uint64_t published = 0;
+        uint64_t throttled = 0;     // frames skipped for the fps cap or CPU budget
+        double cpu_fraction = 0.0;  // of one core, over the last second
+        double last_ms = 0.0;       // thumbnail + JPEG time of the last preview
+        int width = 0, height = 0;
+    };
+
+    /// (jpeg, source frame, thumbnail width, height, components)
+    using Sink = std::function<void(const std::vector<uint8_t>&, const Frame&, int, int, int)>;
+
+    Preview() = default;
+    ~Preview() { stop(); }
+
+    bool start(std::shared_ptr<FrameQueue> source, const Options& opt, Sink sink);
+    void stop();
+    Stats stats() const;
+
+private:
+    void loop();
+    int make_thumbnail(const Frame& f, int& w, int& h);
+
+    std::shared_ptr<FrameQueue> source_;
+    Options opt_;
+    Sink sink_;
+    std::vector<uint8_t> thumb_;
+    std::vector<uint8_t> jpeg_;
+    std::vector<uint8_t> narrow_;       // 16-bit frames, top 8 bits
+
+    Stats stats_;
+    mutable std::mutex stats_mtx_;
+
+    std::thread worker_;
+    std::atomic<bool> running_{false};
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace cambuffer_recorder_ng {
+
+// Bit packing of 10/12-bit samples held in 16-bit little-endian containers,
+// in the MIPI CSI-2 layouts most sensors and tools already speak:
+//   RAW10  4 pixels in 5 bytes: bits 9..2 of each pixel, then one byte with
+//          the four 2-bit remainders (pixel 0 in bits 1..0)
+//   RAW12  2 pixels in 3 bytes: bits 11..4 of each pixel, then one byte with
+//          the two 4-bit remainders (pixel 0 in bits 3..0)
+// The pixel stream is packed as a whole (no per-row padding); a trailing
+// partial group is zero-filled. Samples above the bit depth saturate.
+//
+// AVX2 (picked at run time, the build does not need -mavx2) does 16 pixels
+// per step: one shuffle per 128-bit lane builds or splits 10 / 12 bytes, and
+// the lanes are stored or loaded with overlapping unaligned accesses. Scalar
+// elsewhere and for the tail.
+
+inline size_t raw10_bytes(size_t pixels) { return (pixels + 3) / 4 * 5; }
+inline size_t raw12_bytes(size_t pixels) { return (pixels + 1) / 2 * 3; }
+
+void pack_raw10(const uint16_t* src, size_t pixels, uint8_t* dst);
+void unpack_raw10(const uint8_t* src, size_t pixels, uint16_t* dst);
+void pack_raw12(const uint16_t* src, size_t pixels, uint8_t* dst);
+void unpack_raw12(const uint8_t* src, size_t pixels, uint16_t* dst);
+
+/// True when the packers run the AVX2 path on this CPU.
+bool raw_pack_avx2();
+
+/// `bits`-deep 16-bit samples to 8 bits (the top 8 of `bits`, saturated),
+/// for stages that only read RAW8. Strides in bytes. SSE2.
+void narrow_to_8bit(const uint16_t* src, int w, int h, int src_stride, int bits,
+                    uint8_t* dst, int dst_stride);
+
+} // namespace cambuffer_recorder_ng
@@ -1,35 +1,190 @@
 #pragma once
 #include <thread>
 #include <atomic>
-#include <functional>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
+#include "cambuffer_recorder_ng/BufferPool.hpp"
+#include "cambuffer_recorder_ng/DegradationPolicy.hpp"
 #include "cambuffer_recorder_ng/FfmpegWriter.hpp"
+#include "cambuffer_recorder_ng/FrameBroker.hpp"
+#include "cambuffer_recorder_ng/MotionDetector.hpp"
+#include "cambuffer_recorder_ng/ParallelEncoder.hpp"
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
+#include "cambuffer_recorder_ng/StripedXrawWriter.hpp"
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+#include "cambuffer_recorder_ng/XrawWriter.hpp"
 
 namespace cambuffer_recorder_ng {
 
+/**
+ * @brief Encodes frames from a FrameBroker consumer queue on a writer thread.
+ *
+ * The recorder registers as a lossless (DropPolicy::Block) consumer, so a
+ * slow encode backs up into the broker's pool rather than losing frames.
+ * The writer thread takes its scheduling/affinity from the Encode role.
+ *
+ * Output is either H.264 MP4 (FfmpegWriter) or raw XRAW (XrawWriter).
+ * 10/12-bit frames (Mono16/Bayer16) are stored bit-packed in XRAW (RAW10 /
+ * RAW12, 62.5% / 75% of a 16-bit container) and other depths as 16-bit
+ * words; MP4 debayers them from 16 bits. With
+ * degradation enabled, a DegradationPolicy watches queue fill and per-frame
+ * load and steps through cheaper modes while the writer falls behind:
+ *   Compress  XRAW: LZ4 frames; MP4: bitrate scaled by `bitrate_factor`
+ *   HalfRes   XRAW only: CFA-preserving half-resolution frames
+ *   Decimate  keep every `decimate`-th frame
+ *   Drop      also skip every `drop_every`-th frame still kept (MP4 keeps
+ *             the timeline with skip_frames())
+ * Every level change is logged: as an XEVT record in XRAW; for MP4 in the
+ * `degradation_log` metadata tag and, as it happens, in `<stem>.degrade.log`
+ * (flushed per line, so it survives a crash and fragmented output).
+ *
+ * XRAW can also be striped over several disks (StripedXrawWriter), in which
+ * case frames go to the lane threads by reference to their broker slot.
+ * Likewise MP4 can be encoded by several encoders in parallel, one segment
+ * each (ParallelEncoder), with frames queued by reference.
+ *
+ * With a motion gate only active periods are kept: frames wait in a pre-roll
+ * of `pre_ms` (copied into the recorder's own pool, so the broker keeps
+ * capturing however long the wait) until a
+ * MotionDetector Start event covers them, and recording goes on until
+ * `post_ms` after the End. The events are logged like level changes
+ * (`motion_log` in MP4).
+ */
 class Recorder {
 public:
+    enum class Output { Mp4, Xraw };
+
+    struct Degradation {
+        bool enable = false;
+        DegradationPolicy::Options policy;
+        int decimate = 2;
+        int drop_every = 2;
+        double bitrate_factor = 0.5;
+    };
+
+    struct MotionGate {
+        bool enable = false;
+        int pre_ms = 2000;           // kept from before the Start event
+        int post_ms = 3000;          // kept after the End event
+    };
+
     Recorder() = default;
     ~Recorder() { stop(); }
 
-    // Updated grab callback: (data, size, ts, w, h, stride)
-    bool start(std::function<bool(uint8_t*&, size_t&, uint64_t&, int&, int&, int&)> grab_fn,
-               const std::string& filename,
+    bool start(std::shared_ptr<FrameQueue> source, const std::string& filename,
                int width, int height, int fps);
 
+    /// Stop the writer; if the broker was stopped first, the queued tail is written out.
     void stop();
 
+    /// Layout of the incoming frames (default RAW8 GBRG) and, for Mono16 /
+    /// Bayer16, their valid bits; set before start().
+    void set_input_format(PixelFormat fmt, BayerPattern pattern = BayerPattern::GBRG, int bit_depth = 8)
+    { format_ = fmt; pattern_ = pattern; bit_depth_ = bit_depth; }
+
+    /// Thread policy for the writer thread; set before start().
+    void set_thread_policy(const ThreadPolicy& encode) { encode_policy_ = encode; }
+
+    /// Container for start(); for Xraw the filename minus its extension is the prefix.
+    void set_output(Output out) { output_ = out; }
+
+    /// MP4/MKV fragment length (crash-safe, instant close); 0 = moov at close. Before start().
+    void set_fragment_ms(int ms) { writer_.set_fragment_ms(ms); }
+
+    /// Roll MP4/MKV output into <stem>_NNNN<ext> segments without a gap. Before start().
+    void set_segment(uint64_t max_bytes, int max_ms) { writer_.set_segment(max_bytes, max_ms); }
+
+    /// Encode MP4/MKV output with this many parallel encoders (more than one
+    /// replaces the single FfmpegWriter; fragment/segment settings then do not
+    /// apply). The writer thread's policy is dealt out to them. Before start().
+    void set_parallel(const ParallelEncoder::Options& opt) { parallel_opt_ = opt; }
+
+    /// Frame number / time stamp burned into MP4/MKV frames (nullptr = none).
+    /// XRAW stays untouched. Before start().
+    void set_overlay(std::shared_ptr<const TextOverlay> overlay)
+    { writer_.set_overlay(overlay); parallel_opt_.overlay = std::move(overlay); }
+
+    /// White balance applied to Bayer input before MP4/MKV debayering, live
+    /// (nullptr = none). XRAW stays raw. Before start().
+    void set_white_balance(std::shared_ptr<const WhiteBalance> wb)
+    { writer_.set_white_balance(wb); parallel_opt_.white_balance = std::move(wb); }
+
+    /// Stripe XRAW output over these directories (one I/O thread each); set before
+    /// start(). With no directories the single XrawWriter is used.
+    void set_xraw_stripes(const StripedXrawWriter::Options& opt) { stripes_ = opt; }
+
+    /// Degradation ladder; set before start(). Steps the output cannot do are dropped.
+    void set_degradation(const Degradation& d) { degrade_ = d; }
+
+    /// Record only around motion events; set before start().
+    void set_motion_gate(const MotionGate& g) { gate_ = g; }
+
+    /// Motion event from any thread (normally the detector's); applied by the writer.
+    void on_motion(const MotionDetector::Event& e);
+
+    uint64_t frames_written() const { return frames_written_; }
+    uint64_t frames_skipped() const { return frames_skipped_; }
+    uint64_t frames_gated() const { return frames_gated_; }   // left out by the motion gate
+    int degradation_level() const { return level_; }
+    std::string degradation_state() const;
+    size_t queue_depth() const;
+    std::vector<StripedXrawWriter::LaneStats> xraw_lanes() const { return striped_.lane_stats(); }
+
 private:
-    void loop();
+    void write_loop();
+    bool write_one(const FramePtr& f);
+    bool write_xraw(const FramePtr& f);
+    bool write_mp4(const FramePtr& f);
+    void on_level_change(uint64_t ts_ns);
+    void close_event_file();
+    void write_gated(FramePtr f);
+    void take_motion_events();
+    void drop_gated();
+    void count(bool written);
+    std::string thread_tag() const;
 
     std::thread worker_;
     std::atomic<bool> running_{false};
 
-    std::function<bool(uint8_t*&, size_t&, uint64_t&, int&, int&, int&)> grab_fn_;
+    std::shared_ptr<FrameQueue> source_;
     FfmpegWriter writer_;
+    ParallelEncoder parallel_;
+    ParallelEncoder::Options parallel_opt_{};
+    XrawWriter xraw_;
+    StripedXrawWriter striped_;
+    StripedXrawWriter::Options stripes_;
+    Output output_ = Output::Mp4;
+    std::atomic<uint64_t> frames_written_{0};
+    std::atomic<uint64_t> frames_skipped_{0};
+
+    Degradation degrade_;
+    DegradationPolicy policy_;           // writer thread only
+    std::atomic<int> level_{0};
+    std::string event_log_;              // MP4: level changes, one per line
+    FILE* event_file_ = nullptr;         // MP4: the same lines in <stem>.degrade.log
+    std::vector<uint8_t> half_buf_, lz4_buf_, pack_buf_;
+    uint32_t xraw_format_ = 5;           // xraw::FMT_* of full-depth frames
+
+    MotionGate gate_;
+    std::mutex motion_mtx_;
+    std::vector<MotionDetector::Event> motion_pending_;   // from on_motion()
+    std::deque<std::pair<uint64_t, uint64_t>> windows_;   // [from, until] ts_ns to keep; writer thread
+    std::deque<FramePtr> pre_roll_;      // copies in pre_pool_, oldest first
+    std::shared_ptr<BufferPool> pre_pool_;   // sized for pre_ms; never holds broker slots
+    std::string motion_log_;             // MP4: motion events, one per line
+    std::atomic<uint64_t> frames_gated_{0};
+
     std::string filename_;
     int width_ = 0, height_ = 0, fps_ = 0;
+    ThreadPolicy encode_policy_;
+    PixelFormat format_ = PixelFormat::Bayer8;
+    BayerPattern pattern_ = BayerPattern::GBRG;
+    int bit_depth_ = 8;
 };
 
 } // namespace cambuffer_recorder_ng
-
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Stream-copies video files encoded with identical settings into one.
+ *
+ * Parts are appended one at a time, each shifted to its start on the output
+ * timeline, so the output can be built while later parts are still being
+ * encoded. Nothing is re-encoded: every part must start with a keyframe and
+ * reference nothing before it (a separate encoder per part guarantees both),
+ * and the first part's codec parameters (SPS/PPS) stand for all of them.
+ */
+class SegmentJoiner {
+public:
+    SegmentJoiner() = default;
+    ~SegmentJoiner() { close(); }
+    SegmentJoiner(const SegmentJoiner&) = delete;
+    SegmentJoiner& operator=(const SegmentJoiner&) = delete;
+
+    /// Nothing is written until the first append().
+    bool open(const std::string& output, int fps);
+
+    /// Append all of `part`'s first stream, starting at `start_frame` (1/fps ticks).
+    bool append(const std::string& part, int64_t start_frame);
+
+    /// Container tag; MP4 writes it with the trailer, Matroska with the header,
+    /// so set it before the first append() there.
+    void set_metadata(const std::string& key, const std::string& value);
+
+    /// Write the trailer; false if any append failed or nothing was appended.
+    bool close();
+
+    bool is_open() const { return out_ != nullptr; }
+
+private:
+    bool write_header(const AVStream* ist);
+
+    AVFormatContext* out_ = nullptr;
+    AVStream* ost_ = nullptr;
+    AVPacket* pkt_ = nullptr;
+    std::string output_;
+    int fps_ = 0;
+    bool ok_ = true;
+};
+
+} // namespace cambuffer_recorder_ng
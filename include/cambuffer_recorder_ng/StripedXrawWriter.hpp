@@ -0,0 +1,141 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+#include "cambuffer_recorder_ng/XrawWriter.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Rolling XRAW writer striped over several directories (one per disk).
+ *
+ * Each directory is a lane with its own XrawWriter and I/O thread, writing
+ * <dir>/<name>_s<k>_0000.xraw, ... Records are handed to a lane either
+ * round-robin or to the lane whose queued bytes drain soonest at its measured
+ * write rate, so a slower disk simply gets fewer frames. A text manifest,
+ * <dirs[0]>/<name>.xrawm, lists every record's lane in submission order;
+ * XrawReader::open() on the manifest reassembles the original sequence.
+ * A line is written once its record is on disk, so the manifest never names
+ * a record its lane does not hold.
+ *
+ * When a lane fails, the record it was writing and everything queued behind
+ * it move to a healthy lane on the next write_* call (or at close()); those
+ * are listed where they were re-submitted, a few records late.
+ *
+ * Manifest layout:
+ *   XRAWSTRIPE 1
+ *   lane <k> <prefix>        one per lane
+ *   f <lane> <frame_index>   a frame, in submission order
+ *   e <lane>                 an event record
+ *
+ * The write_* calls come from one thread and block while the chosen lane's
+ * queue is full, so a slow array backs up into the caller as before.
+ */
+class StripedXrawWriter {
+public:
+    enum class Balance { RoundRobin, Throughput };
+
+    struct Options {
+        std::vector<std::string> dirs;       // one lane per directory
+        Balance balance = Balance::Throughput;
+        uint64_t roll_bytes = 2ULL * 1024 * 1024 * 1024;
+        size_t lane_queue = 8;               // records in flight per lane
+        uint32_t data_format = 5;            // file headers (xraw::FMT_*), as XrawWriter::open
+        ThreadPolicy io;                     // for every lane thread
+    };
+
+    struct LaneStats {
+        std::string prefix;
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        double mib_per_s = 0;                // measured write rate (EWMA)
+        size_t queued = 0;
+        bool failed = false;
+    };
+
+    static Balance parse_balance(const std::string& name);
+
+    StripedXrawWriter() = default;
+    ~StripedXrawWriter() { close(); }
+    StripedXrawWriter(const StripedXrawWriter&) = delete;
+    StripedXrawWriter& operator=(const StripedXrawWriter&) = delete;
+
+    bool open(const std::string& name, int width, int height, const Options& opt);
+
+    /// `owner` keeps `data` alive until the lane has written it; without one the rows are copied.
+    bool write_frame(uint64_t frame_index, uint64_t ts_ns, const uint8_t* data, int stride,
+                     int width, int height, uint32_t flags,
+                     std::shared_ptr<const void> owner = nullptr);
+
+    /// Already-encoded payload; always copied.
+    bool write_encoded(uint64_t frame_index, uint64_t ts_ns, const uint8_t* payload, uint32_t bytes,
+                       int width, int height, uint32_t data_format, uint32_t flags);
+
+    bool write_event(uint64_t ts_ns, const std::string& text);
+
+    /// Drain every lane, then close the files and the manifest.
+    void close();
+
+    bool is_open() const { return manifest_ != nullptr; }
+    const std::string& manifest_path() const { return manifest_path_; }
+    std::vector<LaneStats> lane_stats() const;
+
+private:
+    struct Record {
+        enum Kind { Frame, Encoded, Event } kind = Frame;
+        uint64_t frame_index = 0, ts_ns = 0;
+        uint64_t seq = 0;                    // manifest position
+        const uint8_t* data = nullptr;
+        uint32_t bytes = 0;
+        int stride = 0, width = 0, height = 0;
+        uint32_t data_format = 0, flags = 0;
+        std::shared_ptr<const void> owner;
+        std::vector<uint8_t> copy;
+        std::string text;
+    };
+
+    struct Lane {
+        std::string prefix;
+        XrawWriter writer;
+        std::thread thread;
+        std::deque<Record> q;
+        uint64_t queued_bytes = 0;
+        double ns_per_byte = 0;              // 0 until the first write is measured
+        uint64_t frames = 0, bytes = 0;
+        bool failed = false;
+        bool stopping = false;
+        mutable std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    int pick_lane(uint64_t bytes);
+    bool submit(int lane, Record& r);        // consumes `r` only on success
+    bool dispatch(Record& r);                // submit to a healthy lane, re-picking on failure
+    void resubmit_orphans();
+    static bool write_record(Lane& lane, const Record& r);
+    void settle(uint64_t seq, const std::string& line);
+    void lane_loop(Lane& lane, int k);
+
+    Options opt_;
+    std::string name_;
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    size_t next_rr_ = 0;
+    FILE* manifest_ = nullptr;
+    std::string manifest_path_;
+
+    uint64_t next_seq_ = 0;                  // caller thread only
+    std::mutex manifest_mtx_;                // guards everything below
+    uint64_t next_line_ = 0;
+    std::map<uint64_t, std::string> done_;   // written (or abandoned: "") records not yet listed
+    std::vector<Record> orphans_;            // from failed lanes, awaiting another lane
+};
+
+} // namespace cambuffer_recorder_ng
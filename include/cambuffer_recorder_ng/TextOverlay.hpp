@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Frame number / time stamp burned into an 8-bit plane from a glyph atlas.
+ *
+ * The glyphs (digits, " :.-+/" and "FTms") are rasterized once, from a 5x7
+ * bitmap font scaled by `scale`, into an atlas of per-pixel alpha and value
+ * that already combines a soft-edged light glyph with a dark outline. Drawing
+ * a string copies atlas rows side by side into a strip and alpha-blends each
+ * strip row into the plane (SSE2 where available): a few microseconds per
+ * frame instead of rasterizing Hershey outlines every time.
+ *
+ * Meant for the encoder's Y (or gray) plane; given the chroma planes as well,
+ * U and V are pulled to neutral under the glyphs so the text is not tinted by
+ * the scene behind it. With `bayer` the glyphs are built
+ * from 2x2 blocks and placed on even coordinates, so every CFA cell gets the
+ * same value and the text debayers to neutral gray instead of colour fringes.
+ *
+ * All methods are const and safe to call from several encoder threads.
+ */
+class TextOverlay {
+public:
+    struct Options {
+        int scale = 2;              // screen pixels per font pixel
+        bool bayer = false;
+        uint8_t text = 235;         // video white
+        uint8_t outline = 16;       // video black
+        int margin = 10;            // from the frame edges, for stamp()
+    };
+
+    /// Chroma planes of an 8-bit planar YUV frame; shift_x/_y are log2 of the
+    /// subsampling (1, 1 for 4:2:0).
+    struct Chroma {
+        uint8_t* u = nullptr;
+        uint8_t* v = nullptr;
+        int u_stride = 0, v_stride = 0;
+        int shift_x = 1, shift_y = 1;
+    };
+
+    TextOverlay() : TextOverlay(Options{}) {}
+    explicit TextOverlay(const Options& opt);
+
+    /// Glyphs outside the atlas are drawn as spaces.
+    static bool has_glyph(char c);
+
+    int text_width(const std::string& text) const { return static_cast<int>(text.size()) * cell_w_; }
+    int text_height() const { return cell_h_; }
+
+    /// Blend `text` with its top-left corner at (x, y), clipped to the w x h plane.
+    void draw(uint8_t* plane, int stride, int w, int h, int x, int y, const std::string& text,
+              const Chroma* chroma = nullptr) const;
+
+    /// "F<frame>" top-left and the wall-clock time of `ts_ns` top-right (HH:MM:SS.mmm).
+    /// `ts_ns` may be on any clock: the first call ties it to the system clock.
+    void stamp(uint8_t* plane, int stride, int w, int h, uint64_t frame, uint64_t ts_ns,
+               const Chroma* chroma = nullptr) const;
+
+private:
+    void fill_strip(const std::string& text, int row, int c0, int c1, uint8_t* a, uint8_t* v) const;
+    void neutralize(const Chroma& c, const std::string& text, int x, int y,
+                    int x0, int x1, int y0, int y1) const;
+
+    Options opt_;
+    int cell_w_ = 0, cell_h_ = 0;
+    int glyph_of_[256];
+    int atlas_w_ = 0;
+    std::vector<uint8_t> alpha_, value_;      // atlas_w_ x cell_h_
+    mutable std::atomic<int64_t> clock_offset_ns_;
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+/// Pipeline thread roles, each with its own scheduling policy.
+enum class ThreadRole { Capture, Process, Encode, Io, Preview };
+const char* role_name(ThreadRole role);
+
+/**
+ * @brief Scheduling, affinity and stack settings for one thread role.
+ *
+ * sched is "other", "fifo", "rr", "batch" or "idle"; priority is the RT
+ * priority (1..99) for fifo/rr and ignored otherwise. An empty cpus list leaves affinity alone.
+ * stack_kb of stack is touched at thread start so page faults (and, after
+ * mlockall, the locking) happen before the first frame rather than during it;
+ * it is capped at what the thread's stack has left.
+ * io_class ("idle", "be" or "rt", with io_level 0..7 for be/rt) sets the
+ * thread's I/O priority; empty leaves it alone.
+ */
+struct ThreadPolicy {
+    std::string sched = "other";
+    int priority = 0;
+    std::vector<int> cpus;
+    size_t stack_kb = 0;
+    std::string io_class;
+    int io_level = 4;
+};
+
+/// Outcome of one apply_thread_policy()/lock_process_memory() call.
+struct ThreadPolicyStatus {
+    std::string thread;
+    std::string role;
+    bool ok = true;
+    std::string detail;
+};
+
+/**
+ * @brief Apply a policy to the calling thread and name it (15 chars max).
+ *
+ * Each step is attempted even if an earlier one fails; the result (with the
+ * failing steps in `detail`) is appended to the process-wide report.
+ */
+bool apply_thread_policy(ThreadRole role, const ThreadPolicy& policy, const std::string& thread_name,
+                         std::string* detail = nullptr);
+
+/// mlockall(MCL_CURRENT | MCL_FUTURE); result goes to the report as well.
+bool lock_process_memory(std::string* detail = nullptr);
+
+std::vector<ThreadPolicyStatus> thread_policy_report();
+void clear_thread_policy_report();
+
+} // namespace cambuffer_recorder_ng
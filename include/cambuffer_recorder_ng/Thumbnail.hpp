@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
+
+namespace cambuffer_recorder_ng {
+
+// Box-filtered Bayer thumbnails for the live preview. Each output pixel
+// averages a factor x factor block (factor 4 or 8 take the SSE2 path; any
+// even factor works), so every CFA colour contributes equally and there is
+// no aliasing from point sampling. Trailing partial blocks are ignored.
+
+/// Gray thumbnail, out_w = w / factor, out_h = h / factor.
+void bayer_thumbnail_gray(const uint8_t* src, int w, int h, int stride, int factor,
+                          uint8_t* dst, int& out_w, int& out_h);
+
+/// Packed RGB24 thumbnail (R, G, B per block means), same size as the gray one.
+void bayer_thumbnail_rgb(const uint8_t* src, int w, int h, int stride, int factor,
+                         BayerPattern pattern, uint8_t* dst, int& out_w, int& out_h);
+
+/// Green plane of the same size from only the first CFA row pair of every
+/// block: each output is the mean of the `factor` G sites in it. A quarter of
+/// the reads of a full box at factor 8, for detectors that do not mind
+/// vertical aliasing.
+void bayer_green_sparse(const uint8_t* src, int w, int h, int stride, int factor,
+                        BayerPattern pattern, uint8_t* dst, int& out_w, int& out_h);
+
+} // namespace cambuffer_recorder_ng
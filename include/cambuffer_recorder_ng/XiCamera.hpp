@@ -3,12 +3,19 @@
 #include <m3api/xiApi.h>
 #include <cstdint>
 #include <cstddef>
+#include <mutex>
+#include <atomic>
 
 namespace cambuffer_recorder_ng {
 
 class XiCamera : public ICamera {
 public:
-    XiCamera() = default;
+    /// With hw_trigger each rising edge on GPI1 starts one exposure, so all
+    /// cameras wired to the same trigger line share frame numbers. A bit depth
+    /// above 8 switches the sensor to its 10/12-bit ADC mode and delivers
+    /// XI_RAW16 (Bayer16); open() rounds it to what the camera supports.
+    explicit XiCamera(bool hw_trigger = false, int bit_depth = 8)
+        : hw_trigger_(hw_trigger), bits_requested_(bit_depth), bit_depth_(bit_depth) {}
     ~XiCamera() override = default;
 
     void open(int device_index = 0) override;
@@ -18,12 +25,55 @@ public:
     bool grab(uint8_t*& data, size_t& size, uint64_t& ts,
               int& width, int& height, int& stride, int timeout_ms = 100) override;
 
+    /// Rounds the ROI to the sensor's min/max/increment constraints. Before
+    /// start() it is applied immediately. While streaming only the window
+    /// moves, applied by grab() between frames; a different size is refused,
+    /// since the consumers' buffers were sized at start().
+    bool set_roi(int& width, int& height, int& offset_x, int& offset_y) override;
+    /// Clamped to the sensor's exposure and gain ranges. Before open() the
+    /// values are kept for it (default 10000 us, 0 dB); while streaming the
+    /// grab thread writes them before its next xiGetImage().
+    bool set_exposure(double& exposure_us, double& gain_db) override;
+    /// XI_PRM_DOWNSAMPLING / _TYPE (2 = 2x2, 4 = 4x4, ... as the model allows).
+    /// Re-reads the sensor limits, since every ROI constraint changes with it.
+    bool set_downsampling(int factor, Downsampling mode, int& width, int& height) override;
+    uint64_t frame_number() const override { return image_.nframe; }
+    PixelFormat pixel_format() const override
+    { return bit_depth_ > 8 ? PixelFormat::Bayer16 : PixelFormat::Bayer8; }
+    int bit_depth() const override { return bit_depth_; }
+
 private:
+    struct Range { int min = 0, max = 0, inc = 1; };
+    struct Roi { int width = 0, height = 0, offset_x = 0, offset_y = 0; };
+
+    Range query_range(const char* prm) const;
+    void query_sensor();
+    Roi clamp_roi(Roi r) const;
+    void apply_roi(const Roi& r);
+    void apply_pending_roi();
+    void apply_exposure(int exposure_us, float gain_db);
+    void apply_bit_depth();
+
     HANDLE handle_{nullptr};
     XI_IMG image_{};
-    int width_{0}, height_{0};
-    bool running_{false};
+    int width_{0}, height_{0};      // only change while stopped
+    std::atomic<bool> running_{false};   // read by set_exposure()/set_roi() from other threads
+    bool hw_trigger_{false};
+    int bits_requested_{8};
+    int bit_depth_{8};              // what the camera delivers once open
+
+    Range sensor_w_, sensor_h_, off_x_, off_y_;
+    Roi roi_;                       // ROI currently programmed into the sensor
+    Roi pending_roi_;               // requested while streaming, guarded by roi_mtx_
+    std::atomic<bool> roi_pending_{false};
+    std::mutex roi_mtx_;
+
+    Range exposure_range_;
+    float gain_min_ = 0.0f, gain_max_ = 0.0f;
+    int exposure_us_ = 10000;       // programmed, or for open()
+    float gain_db_ = 0.0f;
+    std::atomic<bool> exposure_pending_{false};
+    std::mutex exposure_mtx_;       // guards the two values above while streaming
 };
 
 } // namespace cambuffer_recorder_ng
-
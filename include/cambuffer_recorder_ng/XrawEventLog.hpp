@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+namespace cambuffer_recorder_ng {
+
+class XrawReader;
+
+/**
+ * @brief Sidecar that carries a recording's event records past transcoding.
+ *
+ * MP4/MKV output has no place for XEVT records (degradation steps, motion
+ * start/end), so XrawTranscoder::run() writes them next to it as
+ * <output stem>.events.log, one per line in recording order:
+ *   <ts_ns> <frame_index> <text>
+ * <frame_index> being the recorded index of the frame the event precedes
+ * (one past the last frame for trailing events). Newlines in the text become
+ * spaces. xraw_compressd checks it with matches() before deleting originals.
+ */
+class XrawEventLog {
+public:
+    /// out.mkv -> out.events.log
+    static std::string path_for(const std::string& output);
+
+    /// Writes `reader`'s events to `path`. With none, writes nothing and
+    /// removes a stale sidecar. False (and no file) on an I/O error.
+    static bool write(const XrawReader& reader, const std::string& path);
+
+    /// True if `path` lists exactly `reader`'s events; with none, if there is
+    /// no sidecar or an empty one.
+    static bool matches(const XrawReader& reader, const std::string& path, std::string* why = nullptr);
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+
+namespace cambuffer_recorder_ng {
+namespace xraw {
+
+// On-disk layout written by xi_raw_rolling (rolling ~2 GiB files, packed rows).
+//
+// File header (at start of each file), then per frame a record header
+// followed by `payload_bytes` of packed pixels (no row padding).
+//
+// xi_xraw_ringbuffer(_lz4) write an older, unpacked variant with a 32-byte
+// file header (magic, ver, hdr_sz, start_ns, w, h, stride) and a 32-byte
+// frame header (magic, ver, hdr_sz, frame_index, ts_ns, bytes); version 2 of
+// that variant is LZ4-framed. Readers tell them apart by header_size.
+//
+// Rolling files may also carry event records ('XEVT' header + UTF-8 text,
+// e.g. degradation switches) between frames; readers skip or collect them.
+// Frame dimensions are per record: a half-res frame says so in its header.
+//
+// Deeper-than-8-bit recordings store 10 and 12-bit samples bit-packed
+// (MIPI CSI-2 RAW10 / RAW12, see RawPack.hpp) and anything else as 16-bit
+// little-endian containers with the bit depth in the frame flags.
+
+static constexpr uint32_t MAGIC_FILE  = 0x58524157; // 'XRAW'
+static constexpr uint32_t MAGIC_FRAME = 0x5842494E; // 'XBIN'
+static constexpr uint16_t VER_FILE    = 1;
+static constexpr uint16_t VER_FRAME   = 1;
+static constexpr uint32_t MAGIC_EVENT = 0x58455654; // 'XEVT'
+static constexpr uint16_t VER_EVENT   = 1;
+static constexpr uint32_t FMT_RAW8    = 5;          // XI_RAW8
+static constexpr uint32_t FMT_RAW8_LZ4 = 0x10005;   // RAW8 as one LZ4 block (size from w*h)
+static constexpr uint32_t FMT_RAW16   = 6;          // XI_RAW16: 2 bytes per pixel, LSB-aligned
+static constexpr uint32_t FMT_RAW10_PACKED = 0x20006;  // 4 pixels in 5 bytes
+static constexpr uint32_t FMT_RAW12_PACKED = 0x30006;  // 2 pixels in 3 bytes
+
+// FrameHeader::flags
+static constexpr uint32_t FLAG_HALF_RES   = 1u << 0;  // CFA-preserving 2x2 binned
+static constexpr uint32_t FLAG_DECIMATED  = 1u << 1;  // written while temporally decimating
+static constexpr uint32_t FLAG_LEVEL_SHIFT = 8;       // bits 8..15: degradation level
+static constexpr uint32_t FLAG_DEPTH_SHIFT = 16;      // bits 16..20: FMT_RAW16 valid bits (0 = 16)
+
+/// How a recording of `bits`-deep samples is stored.
+inline uint32_t format_for_depth(int bits)
+{
+    if (bits <= 8) return FMT_RAW8;
+    if (bits == 10) return FMT_RAW10_PACKED;
+    if (bits == 12) return FMT_RAW12_PACKED;
+    return FMT_RAW16;
+}
+
+/// Valid bits per sample of a frame record.
+inline int format_bit_depth(uint32_t data_format, uint32_t flags)
+{
+    switch (data_format) {
+        case FMT_RAW10_PACKED: return 10;
+        case FMT_RAW12_PACKED: return 12;
+        case FMT_RAW16: {
+            const int bits = static_cast<int>(flags >> FLAG_DEPTH_SHIFT & 31);
+            return bits ? bits : 16;
+        }
+        default: return 8;
+    }
+}
+
+#pragma pack(push,1)
+struct FileHeader {
+    uint32_t magic;       // 'X','R','A','W' = 0x58524157
+    uint16_t version;     // 1
+    uint16_t header_size; // sizeof(FileHeader)
+    uint32_t file_index;  // rolling file index
+    uint64_t start_mono_ns;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride_bytes;  // width + padding_x
+    uint32_t data_format;   // XI_RAW8 = 5, or the FMT_* all frames are stored in
+};
+
+struct FrameHeader {
+    uint32_t magic;        // 'X','B','I','N' = 0x5842494E
+    uint16_t version;      // 1
+    uint16_t header_size;  // sizeof(FrameHeader)
+    uint64_t frame_index;
+    uint64_t ts_mono_ns;   // steady_clock time when received
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride_bytes;   // source stride (width + padding_x)
+    uint32_t payload_bytes;  // width * height (RAW8)
+    uint32_t data_format;    // XI_RAW8 = 5, FMT_RAW8_LZ4, FMT_RAW16, FMT_RAW1x_PACKED
+    uint32_t flags;          // FLAG_*; 0 in older files
+};
+
+struct EventHeader {
+    uint32_t magic;          // 'X','E','V','T' = 0x58455654
+    uint16_t version;        // 1
+    uint16_t header_size;    // sizeof(EventHeader)
+    uint64_t ts_mono_ns;
+    uint32_t payload_bytes;  // text length, no terminator
+    uint32_t reserved;
+};
+
+// Ring-buffer tool variant (natural alignment, 32 bytes each)
+struct LegacyFileHeader {
+    uint32_t magic; uint16_t ver; uint16_t hdr_sz;
+    uint64_t start_ns; uint32_t w, h, stride;
+    uint32_t pad1;
+};
+struct LegacyFrameHeader {
+    uint32_t magic; uint16_t ver; uint16_t hdr_sz;
+    uint64_t frame_index, ts_ns; uint32_t bytes;
+    uint32_t pad0;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FileHeader) == 36, "XRAW file header layout");
+static_assert(sizeof(FrameHeader) == 48, "XRAW frame header layout");
+static_assert(sizeof(EventHeader) == 24, "XRAW event header layout");
+static_assert(sizeof(LegacyFileHeader) == 32, "legacy XRAW file header layout");
+static_assert(sizeof(LegacyFrameHeader) == 32, "legacy XRAW frame header layout");
+
+} // namespace xraw
+} // namespace cambuffer_recorder_ng
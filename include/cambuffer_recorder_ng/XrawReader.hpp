@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Memory-mapped, indexed reader for XRAW rolls.
+ *
+ * open() maps every file of a recording read-only and walks the record
+ * headers once to build a frame index; frame payloads are then served as
+ * pointers straight into the mapping. Reads both the rolling format
+ * (xi_raw_rolling) and the ring-buffer tool variant (see XrawFormat.hpp).
+ * A StripedXrawWriter manifest (*.xrawm) opens every lane's rolls and
+ * serves the frames back in their original interleaved order.
+ */
+class XrawReader {
+public:
+    struct Frame {
+        const uint8_t* data = nullptr;
+        uint32_t bytes = 0;         // payload bytes on disk
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint64_t frame_index = 0;   // as recorded
+        uint64_t ts_ns = 0;         // as recorded (monotonic)
+        uint32_t file = 0;          // index into files()
+        bool lz4 = false;           // LZ4 payload (ring-buffer v2 frame, or FMT_RAW8_LZ4 block)
+        uint32_t flags = 0;         // xraw::FLAG_* (rolling format)
+        uint32_t data_format = 5;   // xraw::FMT_* (rolling format)
+        int bit_depth = 8;          // above 8, decode() gives 16-bit little-endian samples
+        bool packed = false;        // RAW10/RAW12 bit-packed payload
+    };
+
+    /// Event record found between frames (e.g. a degradation switch).
+    struct Event {
+        uint64_t ts_ns = 0;
+        size_t before_frame = 0;    // index of the next frame after the event
+        uint32_t file = 0;          // index into files()
+        std::string text;
+    };
+
+    XrawReader() = default;
+    ~XrawReader() { close(); }
+    XrawReader(const XrawReader&) = delete;
+    XrawReader& operator=(const XrawReader&) = delete;
+
+    /// A directory gives all *.xraw in it; "<prefix>_NNNN.xraw" gives that roll
+    /// and every consecutive one after it; anything else is taken as-is.
+    static std::vector<std::string> expand(const std::string& path);
+
+    /// A manifest (*.xrawm) or anything expand() accepts.
+    bool open(const std::string& path);
+    bool open(const std::vector<std::string>& files);
+    void close();
+
+    size_t size() const { return index_.size(); }
+    const Frame& frame(size_t i) const { return index_[i]; }
+    const std::vector<Frame>& frames() const { return index_; }
+    const std::vector<std::string>& files() const { return files_; }
+    const std::vector<Event>& events() const { return events_; }
+
+    /// Unpacked width*height samples of frame i (bytes, or 16-bit words once
+    /// bit_depth > 8): a copy for raw payloads, unpacked for RAW10/RAW12, inflated
+    /// for LZ4 ones (false without LZ4 support or on a corrupt block).
+    bool decode(size_t i, std::vector<uint8_t>& out) const;
+
+    /// Ask the kernel to start reading frames [first, first+count) now.
+    void prefetch(size_t first, size_t count) const;
+    /// Let the kernel drop pages of frames that have been consumed.
+    void release(size_t first, size_t count) const;
+
+private:
+    struct Mapping { const uint8_t* base = nullptr; size_t len = 0; };
+
+    bool open_manifest(const std::string& path);
+    bool index_file(uint32_t file_no, const Mapping& m);
+    void advise(size_t first, size_t count, int advice) const;
+
+    std::vector<std::string> files_;
+    std::vector<Mapping> maps_;
+    std::vector<Frame> index_;
+    std::vector<Event> events_;
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cambuffer_recorder_ng/ICamera.hpp"
+#include "cambuffer_recorder_ng/XrawReader.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Camera backend that plays recorded XRAW rolls back through the pipeline.
+ *
+ * Frames are served zero-copy from the XrawReader mapping, either paced by
+ * their recorded timestamps (optionally scaled by `speed`) or as fast as the
+ * consumer pulls them. A window of upcoming frames is kept in flight with
+ * madvise(WILLNEED) and consumed frames are released, so replay never waits
+ * on the disk and never balloons resident memory. With `loop`, playback wraps
+ * around while frame numbers and timestamps keep increasing.
+ */
+class XrawReplayCamera : public ICamera {
+public:
+    struct Options {
+        std::string path;           // roll, first roll of a series, or directory
+        bool realtime = true;       // pace by recorded timestamps
+        double speed = 1.0;         // realtime playback rate multiplier
+        bool loop = true;
+        size_t prefetch_frames = 32;
+        BayerPattern pattern = BayerPattern::GBRG;
+    };
+
+    explicit XrawReplayCamera(const Options& opt) : opt_(opt) {}
+
+    void open(int device_index = 0) override;
+    void start() override;
+    void stop() override { running_ = false; }
+    void close() override { reader_.close(); }
+
+    bool grab(uint8_t*& data, size_t& size, uint64_t& ts,
+              int& width, int& height, int& stride, int timeout_ms = 100) override;
+
+    /// The recording's geometry is fixed; reports it with zero offsets.
+    bool set_roi(int& width, int& height, int& offset_x, int& offset_y) override;
+
+    uint64_t frame_number() const override { return frame_number_; }
+    /// Bayer8, or Bayer16 for a 10/12/16-bit recording (packed ones are unpacked).
+    PixelFormat pixel_format() const override
+    { return bit_depth() > 8 ? PixelFormat::Bayer16 : PixelFormat::Bayer8; }
+    BayerPattern bayer_pattern() const override { return opt_.pattern; }
+    int bit_depth() const override { return reader_.size() ? reader_.frame(0).bit_depth : 8; }
+
+    uint64_t loops() const { return loops_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Options opt_;
+    XrawReader reader_;
+    bool running_{false};
+
+    size_t next_ = 0;               // index of the next frame to serve
+    size_t prefetched_ = 0;         // frames [next_, prefetched_) already advised
+    size_t released_ = 0;           // frames [0, released_) already dropped
+    uint64_t loops_ = 0;
+    uint64_t ts_span_ns_ = 0;       // recording length incl. one frame period
+    uint64_t index_span_ = 0;       // frame_index range incl. one
+    uint64_t frame_number_ = 0;
+    Clock::time_point t0_{};        // wall time the current loop started
+    std::vector<uint8_t> unpacked_; // last LZ4 or bit-packed frame, decoded
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cambuffer_recorder_ng/PixelFormat.hpp"
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Offline XRAW -> H.264 MP4 / FFV1 MKV converter using every core.
+ *
+ * The indexed timeline is cut into chunks of `chunk_frames`. Each chunk is
+ * debayered and encoded by its own single-threaded FfmpegWriter on its own
+ * worker, so it starts on a keyframe and references nothing outside itself.
+ * The finished parts are then stream-copied, in order and with their
+ * timestamps offset, into the one output file: no re-encode at the seams.
+ * Event records (XEVT) go to the XrawEventLog sidecar next to the output.
+ *
+ * Gaps in the recorded frame index (drops, decimation) are kept as gaps in
+ * the output timeline. Frames whose size differs from the first (half-res
+ * stretches) cannot share the stream and are skipped; LZ4 frames are inflated
+ * when built with liblz4, RAW10/RAW12 ones unpacked.
+ *
+ * codec "ffv1" keeps the raw Bayer mosaic bit-exact as gray8, or gray16le
+ * for 10/12/16-bit recordings (tagged with the pattern); anything else is
+ * debayered to YUV420P.
+ */
+class XrawTranscoder {
+public:
+    struct Options {
+        std::string codec = "libx264";
+        std::vector<std::pair<std::string, std::string>> codec_opts{{"preset", "medium"}, {"crf", "20"}};
+        int threads = 0;             // workers; 0 = all cores
+        int chunk_frames = 0;        // frames per independent part; 0 = 10 s at the frame rate
+        int fps = 0;                 // 0 = from the recorded timestamps
+        BayerPattern pattern = BayerPattern::GBRG;
+        bool keep_parts = false;     // leave <output>.partNNNN.<ext> behind
+        ThreadPolicy policy;         // applied to every worker
+        /// Called by the workers between frames: may block (pause), false aborts.
+        std::function<bool()> gate;
+        /// Called about once per second from run()'s thread.
+        std::function<void(uint64_t done, uint64_t total)> progress;
+    };
+
+    struct Result {
+        uint64_t frames = 0;         // encoded
+        uint64_t skipped = 0;        // size mismatch or undecodable
+        size_t parts = 0;
+        size_t events = 0;           // in the <output stem>.events.log sidecar
+        int fps = 0;
+        double seconds = 0;
+    };
+
+    /// Blocks until done; false on error or when `gate` aborted (no output is left then).
+    static bool run(const std::string& input, const std::string& output,
+                    const Options& opt, Result* result = nullptr);
+
+    /// Decode `output` to the end and check it against `input`: as many frames
+    /// as run() encodes and, for ffv1, every one bit-exact. Honours `opt.gate`.
+    static bool verify(const std::string& input, const std::string& output,
+                       const Options& opt, std::string* why = nullptr);
+
+    /// Lossless container-level join of parts encoded with identical settings.
+    /// `start_frames[i]` is where part i begins on the output timeline.
+    static bool concat(const std::vector<std::string>& parts, const std::vector<int64_t>& start_frames,
+                       int fps, const std::string& output,
+                       const std::vector<std::pair<std::string, std::string>>& metadata = {});
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+/**
+ * @brief Rolling XRAW writer (the xi_raw_rolling format, see XrawFormat.hpp).
+ *
+ * Writes <prefix>_0000.xraw, <prefix>_0001.xraw, ... rolling to a new file as
+ * soon as the next record would exceed `roll_bytes`. Row padding is dropped
+ * on the way out, so payloads are always width*height bytes.
+ *
+ * Usage:
+ *   XrawWriter w;
+ *   w.open("/data/session1/xi_raw", 2048, 704);
+ *   w.write_frame(frame_no, ts_ns, data, stride);
+ *   w.close();
+ */
+class XrawWriter {
+public:
+    XrawWriter() = default;
+    ~XrawWriter() { close(); }
+    XrawWriter(const XrawWriter&) = delete;
+    XrawWriter& operator=(const XrawWriter&) = delete;
+
+    /// `data_format` goes into every file header (xraw::FMT_*, what write_encoded() stores).
+    bool open(const std::string& prefix, int width, int height,
+              uint64_t roll_bytes = 2ULL * 1024 * 1024 * 1024, uint32_t data_format = 5);
+
+    bool write_frame(uint64_t frame_index, uint64_t ts_ns, const uint8_t* data, int stride);
+
+    /// Frame whose size differs from the file's (e.g. half-res), with FLAG_* bits.
+    bool write_frame(uint64_t frame_index, uint64_t ts_ns, const uint8_t* data, int stride,
+                     int width, int height, uint32_t flags);
+
+    /// Already-encoded payload (e.g. FMT_RAW8_LZ4, FMT_RAW10_PACKED) of a width x height frame.
+    bool write_encoded(uint64_t frame_index, uint64_t ts_ns, const uint8_t* payload, uint32_t bytes,
+                       int width, int height, uint32_t data_format, uint32_t flags);
+
+    /// Free-form event record (policy switches etc.) at this point in the stream.
+    bool write_event(uint64_t ts_ns, const std::string& text);
+    void close();
+
+    bool is_open() const { return fp_ != nullptr; }
+    uint64_t bytes_written() const { return bytes_total_; }
+    uint32_t files_opened() const { return file_index_; }
+    std::string current_file() const { return current_name_; }
+
+private:
+    bool open_new_file();
+    bool reserve(uint64_t record_bytes);
+
+    std::string prefix_;
+    std::string current_name_;
+    uint64_t roll_bytes_ = 0;
+    uint32_t width_ = 0, height_ = 0;
+    uint32_t data_format_ = 5;
+    FILE* fp_ = nullptr;
+    std::vector<char> iobuf_;
+    uint32_t file_index_ = 0;
+    uint64_t bytes_in_file_ = 0;
+    uint64_t bytes_total_ = 0;
+};
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,43 @@
+#include "cambuffer_recorder_ng/ActivityLock.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace cambuffer_recorder_ng {
+
+bool ActivityLock::acquire(const std::string& path)
+{
+    release();
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0666);
+    if (fd_ < 0) {
+        perror(("ActivityLock: open " + path).c_str());
+        return false;
+    }
+    // Only ever contended by a busy() probe, which lets go immediately.
+    if (flock(fd_, LOCK_SH) != 0) {
+        perror(("ActivityLock: flock " + path).c_str());
+        release();
+        return false;
+    }
+    return true;
+}
+
+void ActivityLock::release()
+{
+    if (fd_ < 0) return;
+    ::close(fd_);   // drops the lock
+    fd_ = -1;
+}
+
+bool ActivityLock::busy(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;   // no recorder has run since boot (or /tmp was cleaned)
+    const bool held = flock(fd, LOCK_EX | LOCK_NB) != 0 && errno == EWOULDBLOCK;
+    ::close(fd);
+    return held;
+}
+
+} // namespace cambuffer_recorder_ng
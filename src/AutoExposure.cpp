@@ -0,0 +1,187 @@
+#include "cambuffer_recorder_ng/AutoExposure.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+double db_to_linear(double db) { return std::pow(10.0, db / 20.0); }
+
+} // namespace
+
+bool AutoExposure::configure(const Options& opt)
+{
+    opt_ = opt;
+    opt_.sample_cells = std::max(64, opt_.sample_cells);
+    opt_.target = std::clamp(opt_.target, 0.02, 0.95);
+    opt_.tolerance = std::clamp(opt_.tolerance, 0.0, 0.5);
+    opt_.damping = std::clamp(opt_.damping, 0.05, 1.0);
+    opt_.min_exposure_us = std::max(1.0, opt_.min_exposure_us);
+    opt_.max_gain_db = std::max(0.0, opt_.max_gain_db);
+    opt_.awb_rate = std::clamp(opt_.awb_rate, 0.0, 1.0);
+    if (opt_.awb_min > opt_.awb_max) std::swap(opt_.awb_min, opt_.awb_max);
+    if (opt_.max_exposure_us > 0 && opt_.max_exposure_us < opt_.min_exposure_us) {
+        std::cerr << "AutoExposure: max exposure " << opt_.max_exposure_us << " us is below the minimum "
+                  << opt_.min_exposure_us << " us\n";
+        return false;
+    }
+
+    exposure_us_ = opt_.exposure_us;
+    gain_db_ = opt_.gain_db;
+    wb_r_ = std::clamp(opt_.wb_r, opt_.awb_min, opt_.awb_max);
+    wb_b_ = std::clamp(opt_.wb_b, opt_.awb_min, opt_.awb_max);
+    settle_until_ = 0;
+    warned_format_ = false;
+    std::lock_guard<std::mutex> lock(state_mtx_);
+    state_ = State{};
+    state_.exposure_us = exposure_us_;
+    state_.gain_db = gain_db_;
+    state_.wb_r = wb_r_;
+    state_.wb_b = wb_b_;
+    state_.camera_control = opt_.exposure;
+    return true;
+}
+
+double AutoExposure::exposure_cap_us() const
+{
+    double cap = opt_.max_exposure_us;
+    if (cap <= 0) cap = opt_.fps > 0 ? std::clamp(opt_.frame_fill, 0.1, 1.0) * 1e6 / opt_.fps : 1e6;
+    return std::max(cap, opt_.min_exposure_us);
+}
+
+bool AutoExposure::process(const Frame& f, double& exposure_us, double& gain_db)
+{
+    if (f.format == PixelFormat::Rgb24) {
+        if (!warned_format_) std::cerr << "AutoExposure: RGB input is not supported, frames ignored\n";
+        warned_format_ = true;
+        return false;
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    if (is_16bit(f.format))
+        bayer_stats_sparse(reinterpret_cast<const uint16_t*>(f.data), f.width, f.height, f.stride, f.bit_depth,
+                           f.pattern, opt_.sample_cells, stats_);
+    else
+        bayer_stats_sparse(f.data, f.width, f.height, f.stride, f.pattern, opt_.sample_cells, stats_);
+    const double mean = stats_.mean(BayerStats::G) / 255.0;
+    const double clipped = stats_.clipped(BayerStats::G);
+
+    // Gray world over the unclipped samples; a mono sensor has no colour to balance.
+    if (opt_.awb && to_8bit(f.format) == PixelFormat::Bayer8) {
+        const double r = stats_.mean_unclipped(BayerStats::R);
+        const double g = stats_.mean_unclipped(BayerStats::G);
+        const double b = stats_.mean_unclipped(BayerStats::B);
+        if (r >= 4.0 && g >= 8.0 && b >= 4.0) {
+            wb_r_ += opt_.awb_rate * (std::clamp(g / r, opt_.awb_min, opt_.awb_max) - wb_r_);
+            wb_b_ += opt_.awb_rate * (std::clamp(g / b, opt_.awb_min, opt_.awb_max) - wb_b_);
+            if (wb_) wb_->set(wb_r_, wb_b_);
+        }
+    }
+
+    bool changed = false;
+    if (opt_.exposure && f.seq >= settle_until_) {
+        double ratio = opt_.target / std::max(mean, 1.0 / 255.0);
+        // Highlights win over the mean: cut while too much clips, and do not
+        // brighten again until the clipped share is back under half the limit.
+        if (clipped > opt_.max_clipped) ratio = std::min(ratio, 0.85);
+        else if (clipped > opt_.max_clipped / 2) ratio = std::min(ratio, 1.0);
+
+        if (std::abs(std::log(ratio)) > std::log1p(opt_.tolerance)) {
+            const double step = std::clamp(std::exp(opt_.damping * std::log(ratio)), 0.25, 4.0);
+            const double total = exposure_us_ * db_to_linear(gain_db_) * step;
+            // Time first, up to the cap that keeps the frame rate; gain for the rest.
+            const double e = std::clamp(total, opt_.min_exposure_us, exposure_cap_us());
+            const double g = std::clamp(20.0 * std::log10(total / e), 0.0, opt_.max_gain_db);
+            if (std::abs(e - exposure_us_) >= 1.0 || std::abs(g - gain_db_) >= 0.05) {
+                exposure_us_ = e;
+                gain_db_ = g;
+                settle_until_ = f.seq + static_cast<uint64_t>(std::max(0, opt_.settle_frames)) + 1;
+                changed = true;
+            }
+        }
+    }
+    exposure_us = exposure_us_;
+    gain_db = gain_db_;
+
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    std::lock_guard<std::mutex> lock(state_mtx_);
+    state_.processed++;
+    if (changed) state_.changes++;
+    state_.exposure_us = exposure_us_;
+    state_.gain_db = gain_db_;
+    state_.mean = mean;
+    state_.clipped = clipped;
+    state_.wb_r = wb_r_;
+    state_.wb_b = wb_b_;
+    state_.last_us = us;
+    return changed;
+}
+
+bool AutoExposure::start(std::shared_ptr<FrameQueue> source, const Options& opt,
+                         std::shared_ptr<ICamera> camera, std::shared_ptr<WhiteBalance> wb)
+{
+    if (running_ || !source) return false;
+    Options o = opt;
+    if (!camera) o.exposure = false;
+    if (!configure(o)) return false;
+    source_ = std::move(source);
+    camera_ = std::move(camera);
+    wb_ = std::move(wb);
+    running_ = true;
+    worker_ = std::thread(&AutoExposure::loop, this);
+    return true;
+}
+
+void AutoExposure::stop()
+{
+    running_ = false;
+    if (worker_.joinable()) worker_.join();
+}
+
+AutoExposure::State AutoExposure::state() const
+{
+    std::lock_guard<std::mutex> lock(state_mtx_);
+    return state_;
+}
+
+void AutoExposure::loop()
+{
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Process, opt_.policy, opt_.name, &why))
+        std::cerr << "AutoExposure: thread policy: " << why << "\n";
+
+    uint64_t next_seq = 0;
+    while (running_) {
+        FramePtr f;
+        if (!source_->pop(f, 100)) {
+            if (source_->closed()) break;
+            continue;
+        }
+        if (opt_.every_n > 1) {
+            if (f->seq < next_seq) continue;
+            next_seq = f->seq - f->seq % opt_.every_n + opt_.every_n;
+        }
+        double e = 0.0, g = 0.0;
+        const bool changed = process(*f, e, g);
+        f.reset();
+        if (!changed || !camera_) continue;
+
+        // The camera rounds to what it can do; the controller continues from that.
+        if (camera_->set_exposure(e, g)) {
+            exposure_us_ = e;
+            gain_db_ = g;
+            std::lock_guard<std::mutex> lock(state_mtx_);
+            state_.exposure_us = e;
+            state_.gain_db = g;
+        } else {
+            std::cerr << "AutoExposure: camera has no exposure control, white balance only\n";
+            opt_.exposure = false;
+            std::lock_guard<std::mutex> lock(state_mtx_);
+            state_.camera_control = false;
+        }
+    }
+}
+
+} // namespace cambuffer_recorder_ng
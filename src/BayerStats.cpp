@@ -0,0 +1,225 @@
+#include "cambuffer_recorder_ng/BayerStats.hpp"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+constexpr int kBins = BayerStats::kBins;
+
+// Channel (R, G, B) of site 2 * row parity + col parity.
+struct SiteChannels { int c[4]; };
+
+SiteChannels site_channels(BayerPattern p)
+{
+    switch (p) {
+        case BayerPattern::RGGB: return {{BayerStats::R, BayerStats::G, BayerStats::G, BayerStats::B}};
+        case BayerPattern::GRBG: return {{BayerStats::G, BayerStats::R, BayerStats::B, BayerStats::G}};
+        case BayerPattern::BGGR: return {{BayerStats::B, BayerStats::G, BayerStats::G, BayerStats::R}};
+        case BayerPattern::GBRG: break;
+    }
+    return {{BayerStats::G, BayerStats::B, BayerStats::R, BayerStats::G}};
+}
+
+// One run of 16 pixels: even columns to table `he`, odd ones to `ho`.
+void count_run(const uint8_t* p, uint32_t* he, uint32_t* ho, uint64_t& se, uint64_t& so)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    alignas(16) uint8_t b[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(b), _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi8(0x3f)));
+    const __m128i even = _mm_sad_epu8(_mm_and_si128(v, _mm_set1_epi16(0x00ff)), zero);
+    const __m128i odd = _mm_sad_epu8(_mm_srli_epi16(v, 8), zero);
+    se += static_cast<uint64_t>(_mm_cvtsi128_si32(even)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(even, 8)));
+    so += static_cast<uint64_t>(_mm_cvtsi128_si32(odd)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(odd, 8)));
+    for (int i = 0; i < 16; i += 2) {
+        he[b[i]]++;
+        ho[b[i + 1]]++;
+    }
+#else
+    for (int i = 0; i < 16; i += 2) {
+        he[p[i] >> 2]++;
+        ho[p[i + 1] >> 2]++;
+        se += p[i];
+        so += p[i + 1];
+    }
+#endif
+}
+
+// 16-bit samples of `bits` valid bits, scaled to the RAW8 bins and sums.
+void count_run(const uint16_t* p, int bits, uint32_t* he, uint32_t* ho, uint64_t& se, uint64_t& so)
+{
+    const int s8 = bits - 8;
+    const uint16_t maxv = static_cast<uint16_t>((1u << bits) - 1);
+    for (int i = 0; i < 16; i += 2) {
+        const int e = std::min(p[i], maxv) >> s8, o = std::min(p[i + 1], maxv) >> s8;
+        he[e >> 2]++;
+        ho[o >> 2]++;
+        se += e;
+        so += o;
+    }
+}
+
+// The sampling grid of bayer_stats_sparse; `run(row, x, he, ho, se, so)` reads
+// the 16 pixels at column x of a row.
+template <typename Run>
+void sample_sparse(int w, int h, BayerPattern pattern, int cells, BayerStats& out, Run run)
+{
+    out = BayerStats{};
+    const int pairs = h / 2, runs = w / 16;
+    if (pairs <= 0 || runs <= 0) return;
+
+    // A run is 16 pixels wide and a cell row pair 2 high, so a pair step of
+    // 8x the run step keeps the sample grid square.
+    int rs = 1, cs = 1;
+    const double ratio = static_cast<double>(pairs) * runs * 8.0 / std::max(1, cells);
+    if (ratio > 1.0) {
+        cs = std::clamp(static_cast<int>(std::lround(std::sqrt(ratio / 8.0))), 1, runs);
+        rs = std::clamp(static_cast<int>(std::ceil(ratio / cs)), 1, pairs);
+    }
+
+    uint32_t site[4][kBins] = {};
+    uint64_t sums[4] = {};
+    uint32_t n = 0;   // samples per site
+    for (int p = rs / 2; p < pairs; p += rs) {
+        for (int c = cs / 2; c < runs; c += cs) {
+            run(2 * p, 16 * c, site[0], site[1], sums[0], sums[1]);
+            run(2 * p + 1, 16 * c, site[2], site[3], sums[2], sums[3]);
+            n += 8;
+        }
+    }
+
+    const SiteChannels sc = site_channels(pattern);
+    for (int s = 0; s < 4; ++s) {
+        const int c = sc.c[s];
+        for (int k = 0; k < kBins; ++k) out.hist[c][k] += site[s][k];
+        out.sum[c] += sums[s];
+        out.count[c] += n;
+    }
+}
+
+} // namespace
+
+double BayerStats::percentile(int c, double p) const
+{
+    if (!count[c]) return 0.0;
+    const double want = std::clamp(p, 0.0, 1.0) * count[c];
+    double seen = 0.0;
+    for (int k = 0; k < kBins; ++k) {
+        seen += hist[c][k];
+        if (seen >= want) return (k + 1) * 4.0 - 1.0;
+    }
+    return 255.0;
+}
+
+double BayerStats::mean_unclipped(int c) const
+{
+    uint64_t n = 0;
+    double s = 0.0;
+    for (int k = 0; k < kBins - 1; ++k) {
+        n += hist[c][k];
+        s += hist[c][k] * (k * 4.0 + 1.5);
+    }
+    return n ? s / static_cast<double>(n) : 0.0;
+}
+
+void bayer_stats_sparse(const uint8_t* src, int w, int h, int stride, BayerPattern pattern,
+                        int cells, BayerStats& out)
+{
+    sample_sparse(w, h, pattern, cells, out,
+                  [&](int y, int x, uint32_t* he, uint32_t* ho, uint64_t& se, uint64_t& so) {
+                      count_run(src + static_cast<size_t>(y) * stride + x, he, ho, se, so);
+                  });
+}
+
+void bayer_stats_sparse(const uint16_t* src, int w, int h, int stride, int bits, BayerPattern pattern,
+                        int cells, BayerStats& out)
+{
+    bits = std::clamp(bits, 8, 16);
+    const auto* base = reinterpret_cast<const uint8_t*>(src);
+    sample_sparse(w, h, pattern, cells, out,
+                  [&](int y, int x, uint32_t* he, uint32_t* ho, uint64_t& se, uint64_t& so) {
+                      const auto* row = reinterpret_cast<const uint16_t*>(base + static_cast<size_t>(y) * stride);
+                      count_run(row + x, bits, he, ho, se, so);
+                  });
+}
+
+void WhiteBalance::set(double r, double b)
+{
+    auto q8 = [](double g) { return static_cast<uint32_t>(std::clamp(std::lround(g * 256.0), 0l, 32767l)); };
+    packed_.store(q8(r) | q8(b) << 16, std::memory_order_relaxed);
+}
+
+void bayer_white_balance(const uint8_t* src, int w, int h, int src_stride, BayerPattern pattern,
+                         int r_q8, int b_q8, uint8_t* dst, int dst_stride)
+{
+    const SiteChannels sc = site_channels(pattern);
+    const int gain[3] = {std::clamp(r_q8, 0, 32767), 256, std::clamp(b_q8, 0, 32767)};
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* s = src + static_cast<size_t>(y) * src_stride;
+        uint8_t* d = dst + static_cast<size_t>(y) * dst_stride;
+        const int g0 = gain[sc.c[2 * (y & 1)]], g1 = gain[sc.c[2 * (y & 1) + 1]];
+        int x = 0;
+#if defined(__SSE2__)
+        // (v << 8) * g: the high half is v * g / 256, bit 15 of the low half its rounding bit.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i gv = _mm_set1_epi32(g0 | g1 << 16);
+        auto scale = [&](__m128i a) {
+            return _mm_add_epi16(_mm_mulhi_epu16(a, gv), _mm_srli_epi16(_mm_mullo_epi16(a, gv), 15));
+        };
+        for (; x + 16 <= w; x += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+            const __m128i lo = scale(_mm_unpacklo_epi8(zero, v));
+            const __m128i hi = scale(_mm_unpackhi_epi8(zero, v));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; x < w; ++x)
+            d[x] = static_cast<uint8_t>(std::min(255, (s[x] * (x & 1 ? g1 : g0) + 128) >> 8));
+    }
+}
+
+void bayer_white_balance(const uint16_t* src, int w, int h, int src_stride, BayerPattern pattern,
+                         int r_q8, int b_q8, int bits, uint16_t* dst, int dst_stride)
+{
+    const SiteChannels sc = site_channels(pattern);
+    const int gain[3] = {std::clamp(r_q8, 0, 32767), 256, std::clamp(b_q8, 0, 32767)};
+    bits = std::clamp(bits, 8, 16);
+    const int up = 16 - bits;
+    const uint16_t maxv = static_cast<uint16_t>((1u << bits) - 1);
+    for (int y = 0; y < h; ++y) {
+        const auto* s = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(src) +
+                                                          static_cast<size_t>(y) * src_stride);
+        auto* d = reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(dst) + static_cast<size_t>(y) * dst_stride);
+        const int g0 = gain[sc.c[2 * (y & 1)]], g1 = gain[sc.c[2 * (y & 1) + 1]];
+        int x = 0;
+#if defined(__SSE2__)
+        // (v << up) * g as a 32-bit product in two halves: bits 8..23 are the
+        // result, bit 7 its rounding bit, anything above bit 23 saturates.
+        const __m128i gv = _mm_set1_epi32(g0 | g1 << 16);
+        const __m128i mv = _mm_set1_epi16(static_cast<int16_t>(maxv));
+        const __m128i sh = _mm_cvtsi32_si128(up);
+        const __m128i lim = _mm_set1_epi16(255);
+        for (; x + 8 <= w; x += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+            v = _mm_sll_epi16(_mm_sub_epi16(v, _mm_subs_epu16(v, mv)), sh);   // min(v, max) << up
+            const __m128i lo = _mm_mullo_epi16(v, gv), hi = _mm_mulhi_epu16(v, gv);
+            __m128i r = _mm_or_si128(_mm_slli_epi16(hi, 8), _mm_srli_epi16(lo, 8));
+            r = _mm_adds_epu16(r, _mm_srli_epi16(_mm_slli_epi16(lo, 8), 15));
+            r = _mm_or_si128(r, _mm_cmpgt_epi16(hi, lim));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x), r);
+        }
+#endif
+        for (; x < w; ++x) {
+            const uint32_t v = static_cast<uint32_t>(std::min(s[x], maxv)) << up;
+            d[x] = static_cast<uint16_t>(std::min<uint32_t>(65535, (v * (x & 1 ? g1 : g0) + 128) >> 8));
+        }
+    }
+}
+
+} // namespace cambuffer_recorder_ng
@@ -1,4 +1,5 @@
 #include "cambuffer_recorder_ng/BufferPool.hpp"
+#include <chrono>
 
 namespace cambuffer_recorder_ng {
 
@@ -23,6 +24,16 @@ uint8_t* BufferPool::acquire()
     return p;
 }
 
+uint8_t* BufferPool::acquire_for(int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]{ return !free_.empty(); }))
+        return nullptr;
+    uint8_t* p = free_.front();
+    free_.pop();
+    return p;
+}
+
 void BufferPool::release(uint8_t* buf)
 {
     {
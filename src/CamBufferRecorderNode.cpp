@@ -4,22 +4,219 @@
 #include "cambuffer_recorder_ng/XiCamera.hpp"       // legacy XIMEA SDK
 #include "cambuffer_recorder_ng/GenTLCamera.hpp"      // new generic GenTL backend
 #include "cambuffer_recorder_ng/FakeCamera.hpp"       // for testing without hardware
+#include "cambuffer_recorder_ng/XrawReplayCamera.hpp" // recorded XRAW rolls
 #include "cambuffer_recorder_ng/Recorder.hpp"
+#include "cambuffer_recorder_ng/FrameTrace.hpp"
+#include <rclcpp_components/register_node_macro.hpp>
+#include <sensor_msgs/image_encodings.hpp>
 
 namespace cambuffer_recorder_ng
 {
 
-CamBufferRecorderNode::CamBufferRecorderNode()
-    : rclcpp_lifecycle::LifecycleNode("cambuffer_recorder_ng")
+CamBufferRecorderNode::CamBufferRecorderNode(const rclcpp::NodeOptions& options)
+    : rclcpp_lifecycle::LifecycleNode("cambuffer_recorder_ng", options)
 {
     declare_parameter<int>("width", 320);
     declare_parameter<int>("height", 240);
+    declare_parameter<int>("offset_x", 0);
+    declare_parameter<int>("offset_y", 0);
     declare_parameter<int>("fps", 30);
     declare_parameter<std::string>("output_path", "/home/spencelab/fakecam_test.mp4");
 
     // GenTL path — defaults to XIMEA, but can be overridden at launch
     declare_parameter<std::string>("cti_path", "/opt/XIMEA/lib/ximea.gentl2.cti");
     declare_parameter<int>("device_index", 0);
+    declare_parameter<int>("bit_depth", 8);     // 10/12: sensor high-bit-depth mode (xiapi, fake)
+    declare_parameter<int>("downsample", 1);    // 2: half resolution, on the sensor if it can, else on the host
+    declare_parameter<std::string>("downsample_mode", "binning");   // or skipping
+
+    // Multi-camera: several devices on one hardware trigger, one channel each
+    declare_parameter<std::vector<int64_t>>("device_indices", std::vector<int64_t>{});
+    declare_parameter<std::vector<int64_t>>("capture_cpus", std::vector<int64_t>{});
+    declare_parameter<bool>("hw_trigger", false);
+    declare_parameter<int>("sync_max_skew_us", 2000);
+    declare_parameter<int>("pool_frames", 32);   // frame slots per camera shared by all consumers
+    declare_parameter<int>("pool_max_mb", 8192); // per-camera cap on pool_frames x frame size, 0 = none
+    declare_parameter<std::string>("output_format", "mp4");   // mp4 or xraw
+    declare_parameter<int>("fragment_ms", 0);   // >0: fragmented MP4 / MKV clusters of this length
+    declare_parameter<int>("segment_mb", 0);    // roll MP4/MKV segments by size (MiB), 0 = off
+    declare_parameter<int>("segment_s", 0);     // ... or by duration (s), 0 = off
+    declare_parameter<int>("parallel_encoders", 1);          // >1: encoders taking turns per segment
+    declare_parameter<int>("parallel_segment_ms", 1000);     // one closed GOP each
+    declare_parameter<std::string>("parallel_join", "stitch");   // or playlist
+    declare_parameter<std::string>("parallel_preset", "medium");
+    declare_parameter<int>("parallel_codec_threads", 1);     // threads inside each encoder
+    declare_parameter<bool>("overlay_enable", false);        // frame number + time into MP4/MKV frames
+    declare_parameter<int>("overlay_scale", 2);              // pixels per font pixel
+    declare_parameter<std::vector<std::string>>("xraw_dirs", std::vector<std::string>{});  // stripe over disks
+    declare_parameter<std::string>("xraw_balance", "throughput");   // or round_robin
+    declare_parameter<int>("xraw_lane_queue", 8);                  // frames in flight per disk
+    declare_parameter<std::string>("activity_lock", "/tmp/cambuffer_recorder_ng.active");   // "" = off
+
+    // Graceful degradation when the writer falls behind (see Recorder)
+    declare_parameter<bool>("degrade_enable", false);
+    declare_parameter<std::vector<std::string>>("degrade_steps",
+        std::vector<std::string>{"compress", "half_res", "decimate", "drop"});
+    declare_parameter<double>("degrade_high_water", 0.6);   // recorder queue fill
+    declare_parameter<double>("degrade_low_water", 0.2);
+    declare_parameter<int>("degrade_escalate_ms", 250);
+    declare_parameter<int>("degrade_recover_ms", 2000);
+    declare_parameter<int>("degrade_decimate", 2);           // keep every Nth frame
+    declare_parameter<int>("degrade_drop_every", 2);         // "drop" step: also skip every Nth kept frame
+    declare_parameter<double>("degrade_bitrate_factor", 0.5); // mp4 "compress" step
+
+    // FakeCamera: pre-rendered frames paced at `fps`, with optional fault injection
+    declare_parameter<std::string>("fake_format", "gbrg");   // rggb/grbg/gbrg/bggr, rgb or mono
+    declare_parameter<int>("fake_frames", 16);
+    declare_parameter<double>("fake_drop_prob", 0.0);
+    declare_parameter<int>("fake_jitter_us", 0);
+    declare_parameter<int>("fake_stall_every", 0);
+    declare_parameter<int>("fake_stall_ms", 0);
+    declare_parameter<bool>("fake_downsampling", false);   // behave like a sensor that can downsample
+
+    // Replay backend: feed recorded XRAW rolls back through the pipeline
+    declare_parameter<std::string>("replay_path", "");
+    declare_parameter<bool>("replay_realtime", true);
+    declare_parameter<double>("replay_speed", 1.0);
+    declare_parameter<bool>("replay_loop", true);
+
+    // Raw image topic: every Nth frame as sensor_msgs/Image (0 = off)
+    declare_parameter<int>("publish_every_n", 0);
+    declare_parameter<std::string>("frame_id", "camera");
+
+    // Live preview: box-filtered thumbnail as JPEG on a SCHED_IDLE thread with a CPU budget
+    declare_parameter<bool>("preview_enable", false);
+    declare_parameter<int>("preview_factor", 8);          // 4 or 8
+    declare_parameter<bool>("preview_color", true);
+    declare_parameter<int>("preview_every_n", 0);         // 0 = newest frame
+    declare_parameter<double>("preview_max_fps", 10.0);
+    declare_parameter<int>("preview_quality", 70);
+    declare_parameter<double>("preview_cpu_budget", 0.05); // fraction of one core
+
+    // Motion trigger on a decimated green plane; events on motion/events and,
+    // with motion_gate, recording limited to the active periods
+    declare_parameter<bool>("motion_enable", false);
+    declare_parameter<int>("motion_every_n", 2);
+    declare_parameter<int>("motion_factor", 8);            // 4 or 8
+    declare_parameter<double>("motion_threshold", 6.0);     // whole frame, when no regions are given
+    declare_parameter<std::vector<std::string>>("motion_regions", std::vector<std::string>{});  // "x y w h threshold"
+    declare_parameter<std::string>("motion_mask", "");     // PGM, 0 = ignore
+    declare_parameter<int>("motion_bg_shift", 4);          // background rate 1/2^n per processed frame
+    declare_parameter<int>("motion_hold_ms", 2000);
+    declare_parameter<bool>("motion_gate", false);
+    declare_parameter<int>("motion_pre_ms", 2000);
+    declare_parameter<int>("motion_post_ms", 3000);
+
+    // Exposure programmed at configure (and live while ae_enable is off); with
+    // ae_enable a controller steers it from sparse Bayer histograms, keeping
+    // the exposure inside the frame period at `fps`
+    declare_parameter<double>("exposure_us", 10000.0);
+    declare_parameter<double>("gain_db", 0.0);
+    declare_parameter<bool>("ae_enable", false);
+    declare_parameter<int>("ae_every_n", 2);
+    declare_parameter<double>("ae_target", 0.4);            // green mean, fraction of full scale
+    declare_parameter<double>("ae_max_clipped", 0.02);      // green fraction allowed at saturation
+    declare_parameter<double>("ae_min_exposure_us", 20.0);
+    declare_parameter<double>("ae_max_exposure_us", 0.0);   // 0 = 90% of the frame period
+    declare_parameter<double>("ae_max_gain_db", 12.0);
+    // White balance of Bayer input before MP4/MKV debayering and in colour
+    // previews: fixed wb_red / wb_blue, or gray world with awb_enable
+    declare_parameter<bool>("awb_enable", false);
+    declare_parameter<double>("wb_red", 1.0);    // the MQ022CG wants about 1.28 ...
+    declare_parameter<double>("wb_blue", 1.0);   // ... and 1.43 under our lights
+
+    // Latency histograms: /diagnostics rate (0 = off) and CSV dump on deactivate
+    // (empty = <output_path>.latency.csv, "none" = no dump)
+    declare_parameter<double>("diagnostics_rate_hz", 1.0);
+    declare_parameter<std::string>("latency_dump_path", "");
+
+    // Per-frame stage trace (Chrome/Perfetto JSON), written on deactivate
+    // (empty path = <output_path>.trace.json)
+    declare_parameter<bool>("trace_enable", false);
+    declare_parameter<int>("trace_ring_events", 1 << 16);   // per thread, newest kept
+    declare_parameter<std::string>("trace_path", "");
+
+    // Thread policies per role: thread.<capture|process|encode|io|preview>.{sched,priority,cpus,stack_kb}
+    // sched is other/fifo/rr/batch/idle; capture_cpus (per channel) overrides thread.capture.cpus.
+    for (const char* role : {"capture", "process", "encode", "io", "preview"}) {
+        const std::string p = std::string("thread.") + role + ".";
+        declare_parameter<std::string>(p + "sched", std::string(role) == "preview" ? "idle" : "other");
+        declare_parameter<int>(p + "priority", 0);
+        declare_parameter<std::vector<int64_t>>(p + "cpus", std::vector<int64_t>{});
+        declare_parameter<int>(p + "stack_kb", 0);
+        declare_parameter<std::string>(p + "io_class", "");   // idle, be, rt; "" = unchanged
+        declare_parameter<int>(p + "io_level", 4);
+    }
+    declare_parameter<bool>("thread.mlockall", false);
+
+    param_cb_ = add_on_set_parameters_callback(
+        [this](const std::vector<rclcpp::Parameter>& params) { return on_parameters(params); });
+}
+
+std::shared_ptr<ICamera> CamBufferRecorderNode::make_camera(const std::string& backend, size_t index) const
+{
+    if (backend == "xiapi")
+        return std::make_shared<XiCamera>(get_parameter("hw_trigger").as_bool(),
+                                          static_cast<int>(get_parameter("bit_depth").as_int()));
+    if (backend == "gentl")
+        return std::make_shared<GenTLCamera>();
+    if (backend == "replay") {
+        XrawReplayCamera::Options opt;
+        opt.path = get_parameter("replay_path").as_string();
+        opt.realtime = get_parameter("replay_realtime").as_bool();
+        opt.speed = get_parameter("replay_speed").as_double();
+        opt.loop = get_parameter("replay_loop").as_bool();
+        (void)index;
+        return std::make_shared<XrawReplayCamera>(opt);
+    }
+
+    FakeCamera::Options opt;
+    opt.width = width_;
+    opt.height = height_;
+    opt.fps = fps_;
+    const std::string fmt = get_parameter("fake_format").as_string();
+    if (fmt == "rgb")       opt.format = PixelFormat::Rgb24;
+    else if (fmt == "mono") opt.format = PixelFormat::Mono8;
+    else                    opt.pattern = parse_bayer_pattern(fmt);
+    const int bits = static_cast<int>(get_parameter("bit_depth").as_int());
+    if (bits > 8 && opt.format != PixelFormat::Rgb24) {
+        opt.format = opt.format == PixelFormat::Mono8 ? PixelFormat::Mono16 : PixelFormat::Bayer16;
+        opt.bit_depth = bits;
+    }
+    opt.frames = get_parameter("fake_frames").as_int();
+    opt.drop_prob = get_parameter("fake_drop_prob").as_double();
+    opt.jitter_us = get_parameter("fake_jitter_us").as_int();
+    opt.stall_every = get_parameter("fake_stall_every").as_int();
+    opt.stall_ms = get_parameter("fake_stall_ms").as_int();
+    opt.downsampling = get_parameter("fake_downsampling").as_bool();
+    opt.seed = 1 + static_cast<uint32_t>(index);   // distinct but reproducible per channel
+    return std::make_shared<FakeCamera>(opt);
+}
+
+ThreadPolicy CamBufferRecorderNode::role_policy(ThreadRole role) const
+{
+    const std::string p = std::string("thread.") + role_name(role) + ".";
+    ThreadPolicy tp;
+    tp.sched = get_parameter(p + "sched").as_string();
+    tp.priority = static_cast<int>(get_parameter(p + "priority").as_int());
+    for (auto cpu : get_parameter(p + "cpus").as_integer_array())
+        tp.cpus.push_back(static_cast<int>(cpu));
+    tp.stack_kb = static_cast<size_t>(std::max<int64_t>(0, get_parameter(p + "stack_kb").as_int()));
+    tp.io_class = get_parameter(p + "io_class").as_string();
+    tp.io_level = static_cast<int>(get_parameter(p + "io_level").as_int());
+    return tp;
+}
+
+std::string CamBufferRecorderNode::channel_path(const std::string& base, size_t i) const
+{
+    if (channels_.size() < 2) return base;
+    // out.mp4 -> out_cam0.mp4, out_cam1.mp4, ...
+    const auto dot = base.find_last_of('.');
+    const auto slash = base.find_last_of('/');
+    const std::string tag = "_cam" + std::to_string(i);
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return base + tag;
+    return base.substr(0, dot) + tag + base.substr(dot);
 }
 
 rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
@@ -27,6 +224,8 @@ CamBufferRecorderNode::on_configure(const rclcpp_lifecycle::State &)
 {
     width_  = get_parameter("width").as_int();
     height_ = get_parameter("height").as_int();
+    offset_x_ = get_parameter("offset_x").as_int();
+    offset_y_ = get_parameter("offset_y").as_int();
     fps_    = get_parameter("fps").as_int();
     std::string cti_path = get_parameter("cti_path").as_string();
     std::string backend;
@@ -34,20 +233,90 @@ CamBufferRecorderNode::on_configure(const rclcpp_lifecycle::State &)
     int device_index;
     get_parameter_or("device_index", device_index, 0);
 
+    const int downsample = static_cast<int>(std::max<int64_t>(1, get_parameter("downsample").as_int()));
+    const Downsampling downsample_mode = get_parameter("downsample_mode").as_string() == "skipping"
+        ? Downsampling::Skipping : Downsampling::Binning;
+
+    auto devices = get_parameter("device_indices").as_integer_array();
+    auto cpus = get_parameter("capture_cpus").as_integer_array();
+    if (devices.empty()) devices.push_back(device_index);
+
+    channels_.clear();
+    for (size_t i = 0; i < devices.size(); ++i) {
+        Channel ch;
+        ch.device_index = static_cast<int>(devices[i]);
+        ch.capture_cpu = i < cpus.size() ? static_cast<int>(cpus[i]) : -1;
+        channels_.push_back(ch);
+    }
+
     try {
-        if (backend == "xiapi") {
-            camera_ = std::make_shared<XiCamera>();
-        } else if (backend == "gentl") {
-            camera_ = std::make_shared<GenTLCamera>();
-        } else {
-            camera_ = std::make_shared<FakeCamera>(width_, height_, fps_);
+        for (size_t i = 0; i < channels_.size(); ++i) {
+            auto& ch = channels_[i];
+            ch.camera = make_camera(backend, i);
+            ch.camera->open(ch.device_index);
+            ch.width = width_;
+            ch.height = height_;
+
+            // Downsampling on the sensor saves the link and the host; the broker is the fallback.
+            ch.downsample_mode = downsample_mode;
+            if (downsample > 1) {
+                const char* mode = downsample_mode == Downsampling::Skipping ? "skipping" : "binning";
+                if (ch.camera->set_downsampling(downsample, downsample_mode, ch.width, ch.height)) {
+                    ch.sensor_downsample = downsample;
+                    RCLCPP_INFO(get_logger(), "Device %d %dx%d %s on the sensor",
+                                ch.device_index, downsample, downsample, mode);
+                } else if (downsample == 2) {
+                    ch.host_downsample = downsample;
+                    RCLCPP_INFO(get_logger(), "Device %d cannot downsample, 2x2 %s on the host",
+                                ch.device_index, mode);
+                } else {
+                    throw std::runtime_error("downsample " + std::to_string(downsample) +
+                                             " needs the camera; the host fallback only does 2");
+                }
+            }
+
+            // Every channel records the same ROI so sets line up pixel for pixel.
+            // The parameters are in full-sensor pixels, the camera's ROI in its own.
+            const int s = ch.sensor_downsample;
+            int w = width_ / s, h = height_ / s, ox = offset_x_ / s, oy = offset_y_ / s;
+            if (ch.camera->set_roi(w, h, ox, oy)) {
+                RCLCPP_INFO(get_logger(), "Device %d ROI %dx%d at (%d,%d)",
+                            ch.device_index, w, h, ox, oy);
+                ch.width = w;
+                ch.height = h;
+            }
+            if (&ch == &channels_.front()) {
+                width_ = w * s; height_ = h * s; offset_x_ = ox * s; offset_y_ = oy * s;
+            }
+
+            double e = get_parameter("exposure_us").as_double(), g = get_parameter("gain_db").as_double();
+            ch.exposure_control = ch.camera->set_exposure(e, g);
+            ch.exposure_us = e;
+            ch.gain_db = g;
+            if (ch.exposure_control)
+                RCLCPP_INFO(get_logger(), "Device %d exposure %.0f us, gain %.1f dB", ch.device_index, e, g);
         }
 
-        camera_->open(device_index);
-        RCLCPP_INFO(get_logger(), "Configured %s backend", backend.c_str());
+        sync_.reset(channels_.size(), get_parameter("sync_max_skew_us").as_int() * 1000LL);
+        if (!diag_pub_)
+            diag_pub_ = create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", 10);
+        for (size_t i = 0; i < channels_.size(); ++i) {
+            const std::string ns = channels_.size() > 1 ? "cam" + std::to_string(i) + "/" : "";
+            channels_[i].image_pub = create_publisher<sensor_msgs::msg::Image>(
+                ns + "image_raw", rclcpp::SensorDataQoS());
+            channels_[i].preview_pub = create_publisher<sensor_msgs::msg::CompressedImage>(
+                ns + "preview/image_raw/compressed", rclcpp::SensorDataQoS());
+            channels_[i].motion_pub = create_publisher<diagnostic_msgs::msg::DiagnosticArray>(
+                ns + "motion/events", rclcpp::QoS(10).reliable());
+        }
+        RCLCPP_INFO(get_logger(), "Configured %s backend (%zu camera%s)", backend.c_str(),
+                    channels_.size(), channels_.size() > 1 ? "s" : "");
         return CallbackReturn::SUCCESS;
     } catch (const std::exception& e) {
         RCLCPP_ERROR(get_logger(), "Camera open failed: %s", e.what());
+        for (auto& ch : channels_)
+            if (ch.camera) ch.camera->close();
+        channels_.clear();
         return CallbackReturn::FAILURE;
     }
 
@@ -65,77 +334,799 @@ CamBufferRecorderNode::on_configure(const rclcpp_lifecycle::State &)
 rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
 CamBufferRecorderNode::on_activate(const rclcpp_lifecycle::State &)
 {
-    if (!camera_) {
+    if (channels_.empty()) {
         RCLCPP_ERROR(get_logger(), "Camera not configured.");
         return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
     }
 
-    recorder_ = std::make_shared<Recorder>();
     std::string output_path = get_parameter("output_path").as_string();
 
     std::string backend;
     get_parameter_or("backend", backend, std::string("xiapi"));
-   
-    camera_->start();
-        
-    recorder_->start(
-        [this](uint8_t*& d, size_t& sz, uint64_t& t, int& w, int& h, int& s) {
-            return camera_->grab(d, sz, t, w, h, s, 100);
-        },
-        output_path, width_, height_, fps_);
+
+    sync_.reset(channels_.size(), get_parameter("sync_max_skew_us").as_int() * 1000LL);
+    StageLatency::global().reset();   // one set of histograms per recording
+    clear_thread_policy_report();
+    const std::string activity_lock = get_parameter("activity_lock").as_string();
+    if (!activity_lock.empty() && !activity_.acquire(activity_lock))
+        RCLCPP_WARN(get_logger(), "Could not take activity lock %s; background jobs will not pause",
+                    activity_lock.c_str());
+
+    std::string why;
+    if (get_parameter("thread.mlockall").as_bool() && !lock_process_memory(&why))
+        RCLCPP_WARN(get_logger(), "mlockall failed: %s", why.c_str());
+    const ThreadPolicy capture_policy = role_policy(ThreadRole::Capture);
+    const ThreadPolicy encode_policy = role_policy(ThreadRole::Encode);
+    FrameTracer::global().clear();
+    if (get_parameter("trace_enable").as_bool())
+        FrameTracer::global().enable(static_cast<size_t>(get_parameter("trace_ring_events").as_int()));
+
+    size_t pool_frames = static_cast<size_t>(std::max<int64_t>(2, get_parameter("pool_frames").as_int()));
+    const int publish_every_n = static_cast<int>(get_parameter("publish_every_n").as_int());
+    const bool preview_enable = get_parameter("preview_enable").as_bool();
+    const bool motion_enable = get_parameter("motion_enable").as_bool();
+    const bool ae_enable = get_parameter("ae_enable").as_bool() || get_parameter("awb_enable").as_bool();
+
+    const std::string output_format = get_parameter("output_format").as_string();
+    if (output_format != "mp4" && output_format != "xraw") {
+        RCLCPP_ERROR(get_logger(), "Unknown output_format '%s' (mp4 or xraw)", output_format.c_str());
+        activity_.release();
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+    }
+    Recorder::Degradation degrade;
+    degrade.enable = get_parameter("degrade_enable").as_bool();
+    degrade.policy.steps.clear();
+    for (const auto& name : get_parameter("degrade_steps").as_string_array()) {
+        DegradationPolicy::Step step;
+        if (DegradationPolicy::parse_step(name, step)) degrade.policy.steps.push_back(step);
+        else RCLCPP_WARN(get_logger(), "Ignoring unknown degrade step '%s'", name.c_str());
+    }
+    degrade.policy.high_water = get_parameter("degrade_high_water").as_double();
+    degrade.policy.low_water = get_parameter("degrade_low_water").as_double();
+    degrade.policy.escalate_ns = static_cast<uint64_t>(get_parameter("degrade_escalate_ms").as_int()) * 1000000ull;
+    degrade.policy.recover_ns = static_cast<uint64_t>(get_parameter("degrade_recover_ms").as_int()) * 1000000ull;
+    degrade.decimate = static_cast<int>(get_parameter("degrade_decimate").as_int());
+    degrade.drop_every = static_cast<int>(get_parameter("degrade_drop_every").as_int());
+    degrade.bitrate_factor = get_parameter("degrade_bitrate_factor").as_double();
+
+    StripedXrawWriter::Options stripes;
+    stripes.dirs = get_parameter("xraw_dirs").as_string_array();
+    stripes.balance = StripedXrawWriter::parse_balance(get_parameter("xraw_balance").as_string());
+    stripes.lane_queue = static_cast<size_t>(std::max<int64_t>(1, get_parameter("xraw_lane_queue").as_int()));
+    stripes.io = role_policy(ThreadRole::Io);
+    if (output_format == "xraw" && stripes.dirs.size() * stripes.lane_queue >= pool_frames)
+        RCLCPP_WARN(get_logger(), "pool_frames (%zu) should exceed xraw_dirs x xraw_lane_queue (%zu)",
+                    pool_frames, stripes.dirs.size() * stripes.lane_queue);
+
+    // The broker allocates pool_frames slots of its published frame size, per camera.
+    size_t slot_bytes = 0;
+    for (const auto& ch : channels_) {
+        int w = ch.width, h = ch.height;
+        FrameBroker::downsampled_size(ch.camera->pixel_format(), ch.host_downsample, w, h);
+        slot_bytes = std::max(slot_bytes, static_cast<size_t>(w) * static_cast<size_t>(h) *
+                                              static_cast<size_t>(bytes_per_pixel(ch.camera->pixel_format())));
+    }
+
+    ParallelEncoder::Options parallel;
+    parallel.encoders = static_cast<int>(std::max<int64_t>(1, get_parameter("parallel_encoders").as_int()));
+    parallel.segment_ms = static_cast<int>(get_parameter("parallel_segment_ms").as_int());
+    parallel.join = ParallelEncoder::parse_join(get_parameter("parallel_join").as_string());
+    parallel.codec_opts = {{"preset", get_parameter("parallel_preset").as_string()}};
+    parallel.encoder_threads = static_cast<int>(get_parameter("parallel_codec_threads").as_int());
+    parallel.io = role_policy(ThreadRole::Io);
+    if (output_format == "mp4" && parallel.encoders > 1) {
+        // Every encoder holds up to one segment of broker slots; with fewer, encoder
+        // k+1 only gets frames once encoder k lets go, and nothing runs in parallel.
+        const size_t in_flight = static_cast<size_t>(parallel.encoders) *
+            static_cast<size_t>(std::max<int64_t>(1, fps_ * parallel.segment_ms / 1000));
+        if (pool_frames < in_flight + 8) {
+            RCLCPP_WARN(get_logger(), "pool_frames raised from %zu to %zu (parallel_encoders x segment frames + 8), "
+                        "%.0f MiB per camera", pool_frames, in_flight + 8,
+                        static_cast<double>((in_flight + 8) * slot_bytes) / (1024.0 * 1024.0));
+            pool_frames = in_flight + 8;
+        }
+        if (get_parameter("fragment_ms").as_int() > 0 || get_parameter("segment_mb").as_int() > 0 ||
+            get_parameter("segment_s").as_int() > 0)
+            RCLCPP_WARN(get_logger(), "fragment_ms/segment_* do not apply with parallel_encoders > 1");
+    }
+
+    const int64_t pool_max_mb = get_parameter("pool_max_mb").as_int();
+    if (pool_max_mb > 0 && pool_frames * slot_bytes > static_cast<size_t>(pool_max_mb) << 20) {
+        RCLCPP_ERROR(get_logger(), "Frame pool of %zu x %zu bytes (%.0f MiB per camera) exceeds pool_max_mb %ld; "
+                     "lower pool_frames, parallel_encoders or parallel_segment_ms, or raise pool_max_mb",
+                     pool_frames, slot_bytes, static_cast<double>(pool_frames * slot_bytes) / (1024.0 * 1024.0),
+                     static_cast<long>(pool_max_mb));
+        activity_.release();
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+    }
+
+    // One atlas for all channels: stamping is const and the clock anchor is shared.
+    std::shared_ptr<const TextOverlay> overlay;
+    if (get_parameter("overlay_enable").as_bool()) {
+        TextOverlay::Options o;
+        o.scale = static_cast<int>(std::max<int64_t>(1, get_parameter("overlay_scale").as_int()));
+        overlay = std::make_shared<TextOverlay>(o);
+    }
+
+    const MotionDetector::Options motion = motion_options();
+    if (motion_enable && !MotionDetector().configure(motion)) {   // e.g. an unreadable mask
+        RCLCPP_ERROR(get_logger(), "Invalid motion detector settings");
+        activity_.release();
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+    }
+    Recorder::MotionGate gate;
+    gate.enable = motion_enable && get_parameter("motion_gate").as_bool();
+    gate.pre_ms = static_cast<int>(get_parameter("motion_pre_ms").as_int());
+    gate.post_ms = static_cast<int>(get_parameter("motion_post_ms").as_int());
+
+    clock_offset_ns_.clear();
+    for (size_t i = 0; i < channels_.size(); ++i) clock_offset_ns_.emplace_back(INT64_MIN);   // taken at first frame
+
+    for (size_t i = 0; i < channels_.size(); ++i) {
+        auto& ch = channels_[i];
+
+        // The broker is the camera's only reader; everything else is a consumer.
+        ch.broker = std::make_shared<FrameBroker>();
+        ch.broker->set_on_frame([this, i](const Frame& f) { sync_.observe(i, f.frame_number, f.ts_ns); });
+        auto rec_queue = ch.broker->add_consumer("recorder", DropPolicy::Block, pool_frames);
+        ch.stats = ch.broker->add_consumer("stats", DropPolicy::Latest, 1);
+        if (publish_every_n > 0)
+            ch.image_queue = ch.broker->add_consumer("image", DropPolicy::Latest, 2);
+        if (preview_enable)
+            ch.preview_queue = ch.broker->add_consumer("preview", DropPolicy::Latest, 1);
+        if (motion_enable)
+            ch.motion_queue = ch.broker->add_consumer("motion", DropPolicy::Latest, 1);
+        if (ae_enable)
+            ch.ae_queue = ch.broker->add_consumer("ae", DropPolicy::Latest, 1);
+        ch.wb = std::make_shared<WhiteBalance>();
+        ch.wb->set(get_parameter("wb_red").as_double(), get_parameter("wb_blue").as_double());
+
+        ch.recorder = std::make_shared<Recorder>();
+        ch.recorder->set_input_format(ch.camera->pixel_format(), ch.camera->bayer_pattern(),
+                                      ch.camera->bit_depth());
+        ch.recorder->set_thread_policy(encode_policy);
+        ch.recorder->set_output(output_format == "xraw" ? Recorder::Output::Xraw : Recorder::Output::Mp4);
+        ch.recorder->set_degradation(degrade);
+        ch.recorder->set_xraw_stripes(stripes);
+        ch.recorder->set_parallel(parallel);
+        ch.recorder->set_overlay(overlay);
+        ch.recorder->set_white_balance(ch.wb);
+        ch.recorder->set_motion_gate(gate);
+        ch.recorder->set_fragment_ms(static_cast<int>(get_parameter("fragment_ms").as_int()));
+        ch.recorder->set_segment(
+            static_cast<uint64_t>(std::max<int64_t>(0, get_parameter("segment_mb").as_int())) << 20,
+            static_cast<int>(get_parameter("segment_s").as_int() * 1000));
+        int out_w = ch.width, out_h = ch.height;
+        FrameBroker::downsampled_size(ch.camera->pixel_format(), ch.host_downsample, out_w, out_h);
+        if (!ch.recorder->start(rec_queue, channel_path(output_path, i), out_w, out_h, fps_)) {
+            RCLCPP_ERROR(get_logger(), "Recorder for device %d failed to start", ch.device_index);
+            stop_channels();   // the channels before this one are already running
+            activity_.release();
+            return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+        }
+
+        FrameBroker::Options bo;
+        bo.pool_frames = pool_frames;
+        bo.capture_policy = capture_policy;
+        if (ch.capture_cpu >= 0) bo.capture_policy.cpus = {ch.capture_cpu};
+        bo.name = "cam" + std::to_string(i);
+        bo.downsample = ch.host_downsample;
+        bo.downsample_mode = ch.downsample_mode;
+        ch.camera->start();
+        if (!ch.broker->start(ch.camera, ch.width, ch.height, bo)) {
+            RCLCPP_ERROR(get_logger(), "Capture for device %d failed to start", ch.device_index);
+            stop_channels();
+            activity_.release();
+            return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+        }
+
+        RCLCPP_INFO(get_logger(), "Camera %d active and recording to %s (capture cpu %d)",
+                    ch.device_index, channel_path(output_path, i).c_str(), ch.capture_cpu);
+
+        if (ch.image_queue) {
+            ch.image_pub->on_activate();
+            image_threads_.emplace_back(&CamBufferRecorderNode::publish_loop, this, i, publish_every_n);
+        }
+        if (ch.preview_queue) start_preview(i);
+        if (ch.motion_queue) start_motion(i, motion);
+        if (ch.ae_queue) start_ae(i);
+    }
 
     running_ = true;
     worker_ = std::thread(&CamBufferRecorderNode::run_loop, this);
 
-    RCLCPP_INFO(get_logger(), "Camera active and recording to %s", output_path.c_str());
+    const double diag_hz = get_parameter("diagnostics_rate_hz").as_double();
+    if (diag_pub_ && diag_hz > 0.0) {
+        diag_pub_->on_activate();
+        diag_timer_ = create_wall_timer(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / diag_hz)),
+            [this]() { publish_diagnostics(); });
+    }
+
     return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
+// Everything on_activate() may have started, for any subset of the channels.
+void CamBufferRecorderNode::stop_channels()
+{
+    for (auto& ch : channels_) {
+        if (ch.broker)   ch.broker->stop();     // closes the queues; recorders drain the tail
+        if (ch.recorder) ch.recorder->stop();
+        if (ch.camera)   ch.camera->stop();
+    }
+    for (auto& t : image_threads_)
+        if (t.joinable()) t.join();
+    image_threads_.clear();
+    for (auto& ch : channels_) {
+        if (ch.preview) ch.preview->stop();
+        if (ch.motion) ch.motion->stop();
+        if (ch.ae) {
+            // The camera keeps what the controller left; the next activation starts there.
+            ch.ae->stop();
+            const auto st = ch.ae->state();
+            ch.exposure_us = st.exposure_us;
+            ch.gain_db = st.gain_db;
+        }
+        if (ch.image_pub && ch.image_pub->is_activated()) ch.image_pub->on_deactivate();
+        if (ch.preview_pub && ch.preview_pub->is_activated()) ch.preview_pub->on_deactivate();
+        if (ch.motion_pub && ch.motion_pub->is_activated()) ch.motion_pub->on_deactivate();
+        ch.image_queue.reset();
+        ch.preview_queue.reset();
+        ch.motion_queue.reset();
+        ch.ae_queue.reset();
+    }
+}
+
 rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
 CamBufferRecorderNode::on_deactivate(const rclcpp_lifecycle::State &)
 {
     running_ = false;
     if (worker_.joinable()) worker_.join();
+    if (diag_timer_) { diag_timer_->cancel(); diag_timer_.reset(); }
+
+    stop_channels();
+    if (channels_.size() > 1) log_sync_stats();
 
-    if (recorder_) recorder_->stop();
-    if (camera_)  camera_->stop();
+    if (diag_pub_ && diag_pub_->is_activated()) {
+        publish_diagnostics();   // final numbers, including the flush
+        diag_pub_->on_deactivate();
+    }
+    dump_latency(get_parameter("output_path").as_string());
+    dump_trace(get_parameter("output_path").as_string());
+    activity_.release();   // everything is on disk: background jobs may resume
 
     RCLCPP_INFO(get_logger(), "Camera deactivated and recording stopped.");
     return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
+rcl_interfaces::msg::SetParametersResult
+CamBufferRecorderNode::on_parameters(const std::vector<rclcpp::Parameter>& params)
+{
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+
+    int w = width_, h = height_, ox = offset_x_, oy = offset_y_;
+    bool roi_changed = false;
+    double exposure_us = get_parameter("exposure_us").as_double(), gain_db = get_parameter("gain_db").as_double();
+    bool exposure_changed = false;
+    for (const auto& p : params) {
+        const auto& name = p.get_name();
+        if (name == "exposure_us" || name == "gain_db") {
+            if (running_ && get_parameter("ae_enable").as_bool()) {
+                result.successful = false;
+                result.reason = "exposure is under ae_enable control";
+                return result;
+            }
+            (name == "exposure_us" ? exposure_us : gain_db) = p.as_double();
+            exposure_changed = true;
+            continue;
+        }
+        if (name == "width" || name == "height") {
+            // The writer is sized at activation; only the window position may move while recording.
+            if (running_) {
+                result.successful = false;
+                result.reason = "ROI size cannot change while active";
+                return result;
+            }
+            (name == "width" ? w : h) = static_cast<int>(p.as_int());   // full-sensor pixels
+            roi_changed = true;
+        } else if (name == "offset_x" || name == "offset_y") {
+            (name == "offset_x" ? ox : oy) = static_cast<int>(p.as_int());
+            roi_changed = true;
+        }
+    }
+
+    for (auto& ch : channels_) {
+        if (!exposure_changed || !ch.exposure_control) continue;
+        double e = exposure_us, g = gain_db;
+        if (ch.camera->set_exposure(e, g)) {
+            ch.exposure_us = e;
+            ch.gain_db = g;
+            RCLCPP_INFO(get_logger(), "Device %d exposure -> %.0f us, gain %.1f dB", ch.device_index, e, g);
+        }
+    }
+
+    if (roi_changed && !channels_.empty()) {
+        bool applied = false;
+        const int req_w = w, req_h = h, req_ox = ox, req_oy = oy;
+        for (auto& ch : channels_) {
+            const int s = ch.sensor_downsample;
+            int cw = req_w / s, chh = req_h / s, cox = req_ox / s, coy = req_oy / s;
+            // Active: each channel keeps the size its broker and writers were built
+            // for, which may round differently from the first channel's.
+            if (running_) { cw = ch.width; chh = ch.height; }
+            if (!ch.camera->set_roi(cw, chh, cox, coy)) continue;
+            ch.width = cw;
+            ch.height = chh;
+            if (&ch == &channels_.front()) {
+                w = cw * s; h = chh * s; ox = cox * s; oy = coy * s;
+                applied = true;
+            }
+        }
+        if (applied) {
+            width_ = w; height_ = h; offset_x_ = ox; offset_y_ = oy;
+            RCLCPP_INFO(get_logger(), "ROI -> %dx%d at (%d,%d)", w, h, ox, oy);
+        }
+    }
+    return result;
+}
+
+void CamBufferRecorderNode::log_sync_stats()
+{
+    const auto st = sync_.stats();
+    RCLCPP_INFO(get_logger(), "Sync: %lu matched sets, %lu incomplete, %lu over skew limit, %lu resyncs",
+                (unsigned long)st.matched_sets, (unsigned long)st.incomplete_sets,
+                (unsigned long)st.skew_violations, (unsigned long)st.resyncs);
+    for (size_t i = 0; i < st.cameras.size(); ++i) {
+        RCLCPP_INFO(get_logger(), "  cam%zu (dev %d): %lu frames, %lu dropped, %lu unaligned, skew %.3f ms, queue %zu",
+                    i, channels_[i].device_index,
+                    (unsigned long)st.cameras[i].frames, (unsigned long)st.cameras[i].dropped,
+                    (unsigned long)st.cameras[i].unaligned,
+                    st.cameras[i].last_skew_ns / 1e6,
+                    channels_[i].recorder ? channels_[i].recorder->queue_depth() : 0);
+    }
+}
+
+void CamBufferRecorderNode::publish_diagnostics()
+{
+    const auto summary = StageLatency::global().summarize();
+    // A stage whose p99 exceeds one frame period cannot keep up on its own.
+    const double budget_us = fps_ > 0 ? 1e6 / fps_ : 0.0;
+
+    diagnostic_msgs::msg::DiagnosticArray msg;
+    msg.header.stamp = now();
+    for (size_t s = 0; s < kStageCount; ++s) {
+        const auto& r = summary[s];
+        if (!r.count) continue;
+
+        diagnostic_msgs::msg::DiagnosticStatus st;
+        st.name = std::string(get_name()) + ": latency " + stage_name(static_cast<Stage>(s));
+        st.hardware_id = "cambuffer_recorder_ng";
+        const bool over = budget_us > 0 && r.p99_ns / 1e3 > budget_us
+                          && static_cast<Stage>(s) != Stage::GrabWait;
+        st.level = over ? diagnostic_msgs::msg::DiagnosticStatus::WARN
+                        : diagnostic_msgs::msg::DiagnosticStatus::OK;
+        st.message = over ? "p99 over frame budget" : "OK";
+
+        auto kv = [&st](const std::string& k, const std::string& v) {
+            diagnostic_msgs::msg::KeyValue e;
+            e.key = k;
+            e.value = v;
+            st.values.push_back(e);
+        };
+        auto us = [](double ns) { return std::to_string(ns / 1e3); };
+        kv("count", std::to_string(r.count));
+        kv("mean_us", us(r.mean_ns));
+        kv("p50_us", us(r.p50_ns));
+        kv("p99_us", us(r.p99_ns));
+        kv("p99.9_us", us(r.p999_ns));
+        kv("max_us", us(r.max_ns));
+        msg.status.push_back(std::move(st));
+    }
+    for (size_t i = 0; i < channels_.size(); ++i) {
+        if (!channels_[i].preview) continue;
+        const auto ps = channels_[i].preview->stats();
+        const double budget = get_parameter("preview_cpu_budget").as_double();
+
+        diagnostic_msgs::msg::DiagnosticStatus st;
+        st.name = std::string(get_name()) + ": preview cam" + std::to_string(i);
+        st.hardware_id = "cambuffer_recorder_ng";
+        // The budget is enforced per preview, so a sustained overshoot means a stuck clock or a bug.
+        const bool over = ps.cpu_fraction > 1.5 * budget;
+        st.level = over ? diagnostic_msgs::msg::DiagnosticStatus::WARN
+                        : diagnostic_msgs::msg::DiagnosticStatus::OK;
+        st.message = over ? "over CPU budget" : "OK";
+        auto kv = [&st](const std::string& k, const std::string& v) {
+            diagnostic_msgs::msg::KeyValue e;
+            e.key = k;
+            e.value = v;
+            st.values.push_back(e);
+        };
+        kv("published", std::to_string(ps.published));
+        kv("throttled", std::to_string(ps.throttled));
+        kv("cpu_fraction", std::to_string(ps.cpu_fraction));
+        kv("cpu_budget", std::to_string(budget));
+        kv("last_ms", std::to_string(ps.last_ms));
+        kv("size", std::to_string(ps.width) + "x" + std::to_string(ps.height));
+        msg.status.push_back(std::move(st));
+    }
+    for (size_t i = 0; i < channels_.size(); ++i) {
+        if (!channels_[i].motion) continue;
+        const auto ms = channels_[i].motion->stats();
+
+        diagnostic_msgs::msg::DiagnosticStatus st;
+        st.name = std::string(get_name()) + ": motion cam" + std::to_string(i);
+        st.hardware_id = "cambuffer_recorder_ng";
+        st.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+        st.message = ms.active ? "motion" : "quiet";
+        auto kv = [&st](const std::string& k, const std::string& v) {
+            diagnostic_msgs::msg::KeyValue e;
+            e.key = k;
+            e.value = v;
+            st.values.push_back(e);
+        };
+        kv("processed", std::to_string(ms.processed));
+        kv("events", std::to_string(ms.events));
+        kv("last_us", std::to_string(ms.last_us));
+        for (size_t r = 0; r < ms.energy.size(); ++r)
+            kv("energy_" + std::to_string(r), std::to_string(ms.energy[r]));
+        if (channels_[i].recorder)
+            kv("frames_gated", std::to_string(channels_[i].recorder->frames_gated()));
+        msg.status.push_back(std::move(st));
+    }
+
+    for (size_t i = 0; i < channels_.size(); ++i) {
+        if (!channels_[i].ae) continue;
+        const auto as = channels_[i].ae->state();
+        const double target = get_parameter("ae_target").as_double();
+
+        diagnostic_msgs::msg::DiagnosticStatus st;
+        st.name = std::string(get_name()) + ": exposure cam" + std::to_string(i);
+        st.hardware_id = "cambuffer_recorder_ng";
+        // Dark at full exposure and gain: the scene needs light or a lower fps.
+        const bool limited = as.camera_control && as.mean < 0.8 * target &&
+                             as.gain_db >= get_parameter("ae_max_gain_db").as_double() - 0.05;
+        st.level = limited ? diagnostic_msgs::msg::DiagnosticStatus::WARN
+                           : diagnostic_msgs::msg::DiagnosticStatus::OK;
+        st.message = limited ? "underexposed at the exposure and gain limits" : "OK";
+        auto kv = [&st](const std::string& k, const std::string& v) {
+            diagnostic_msgs::msg::KeyValue e;
+            e.key = k;
+            e.value = v;
+            st.values.push_back(e);
+        };
+        kv("processed", std::to_string(as.processed));
+        kv("changes", std::to_string(as.changes));
+        kv("exposure_us", std::to_string(as.exposure_us));
+        kv("gain_db", std::to_string(as.gain_db));
+        kv("mean", std::to_string(as.mean));
+        kv("clipped", std::to_string(as.clipped));
+        kv("wb_red", std::to_string(as.wb_r));
+        kv("wb_blue", std::to_string(as.wb_b));
+        kv("last_us", std::to_string(as.last_us));
+        kv("camera_control", as.camera_control ? "true" : "false");
+        msg.status.push_back(std::move(st));
+    }
+
+    for (size_t i = 0; i < channels_.size(); ++i) {
+        const auto& rec = channels_[i].recorder;
+        if (!rec) continue;
+        const auto lanes = rec->xraw_lanes();
+        if (!get_parameter("degrade_enable").as_bool() && lanes.empty()) continue;
+
+        diagnostic_msgs::msg::DiagnosticStatus st;
+        st.name = std::string(get_name()) + ": recorder cam" + std::to_string(i);
+        st.hardware_id = "cambuffer_recorder_ng";
+        const int level = rec->degradation_level();
+        st.level = level > 0 ? diagnostic_msgs::msg::DiagnosticStatus::WARN
+                             : diagnostic_msgs::msg::DiagnosticStatus::OK;
+        st.message = level > 0 ? "degraded: " + rec->degradation_state() : "OK";
+        auto kv = [&st](const std::string& k, const std::string& v) {
+            diagnostic_msgs::msg::KeyValue e;
+            e.key = k;
+            e.value = v;
+            st.values.push_back(e);
+        };
+        kv("level", std::to_string(level));
+        kv("frames_written", std::to_string(rec->frames_written()));
+        kv("frames_skipped", std::to_string(rec->frames_skipped()));
+        kv("queue_depth", std::to_string(rec->queue_depth()));
+        for (size_t k = 0; k < lanes.size(); ++k) {
+            const std::string lane = "lane" + std::to_string(k) + "_";
+            kv(lane + "path", lanes[k].prefix);
+            kv(lane + "frames", std::to_string(lanes[k].frames));
+            kv(lane + "mib_per_s", std::to_string(lanes[k].mib_per_s));
+            kv(lane + "queued", std::to_string(lanes[k].queued));
+            if (lanes[k].failed) {
+                st.level = diagnostic_msgs::msg::DiagnosticStatus::ERROR;
+                st.message = "xraw lane " + std::to_string(k) + " failed";
+            }
+        }
+        msg.status.push_back(std::move(st));
+    }
+
+    // Thread policy outcomes: a thread silently running at default priority is
+    // exactly what the capture jitter looks like, so failures are errors.
+    for (const auto& tp : thread_policy_report()) {
+        diagnostic_msgs::msg::DiagnosticStatus st;
+        st.name = std::string(get_name()) + ": thread " + tp.thread;
+        st.hardware_id = "cambuffer_recorder_ng";
+        st.level = tp.ok ? diagnostic_msgs::msg::DiagnosticStatus::OK
+                         : diagnostic_msgs::msg::DiagnosticStatus::ERROR;
+        st.message = tp.detail;
+        diagnostic_msgs::msg::KeyValue e;
+        e.key = "role";
+        e.value = tp.role;
+        st.values.push_back(e);
+        msg.status.push_back(std::move(st));
+    }
+
+    if (!msg.status.empty()) diag_pub_->publish(msg);
+}
+
+void CamBufferRecorderNode::dump_latency(const std::string& output_path)
+{
+    std::string path = get_parameter("latency_dump_path").as_string();
+    if (path == "none") return;
+    if (path.empty()) path = output_path + ".latency.csv";
+    if (StageLatency::global().dump(path))
+        RCLCPP_INFO(get_logger(), "Latency histograms written to %s", path.c_str());
+}
+
+void CamBufferRecorderNode::dump_trace(const std::string& output_path)
+{
+    auto& tracer = FrameTracer::global();
+    if (!tracer.enabled()) return;
+    tracer.disable();
+
+    std::string path = get_parameter("trace_path").as_string();
+    if (path.empty()) path = output_path + ".trace.json";
+    if (tracer.write_json(path))
+        RCLCPP_INFO(get_logger(), "Frame trace written to %s", path.c_str());
+}
+
+static std::string image_encoding(const Frame& f)
+{
+    namespace enc = sensor_msgs::image_encodings;
+    switch (f.format) {
+        case PixelFormat::Rgb24: return enc::RGB8;
+        case PixelFormat::Mono8: return enc::MONO8;
+        case PixelFormat::Mono16: return enc::MONO16;
+        case PixelFormat::Bayer16:
+            switch (f.pattern) {
+                case BayerPattern::RGGB: return enc::BAYER_RGGB16;
+                case BayerPattern::GRBG: return enc::BAYER_GRBG16;
+                case BayerPattern::BGGR: return enc::BAYER_BGGR16;
+                case BayerPattern::GBRG: break;
+            }
+            return enc::BAYER_GBRG16;
+        case PixelFormat::Bayer8: break;
+    }
+    switch (f.pattern) {
+        case BayerPattern::RGGB: return enc::BAYER_RGGB8;
+        case BayerPattern::GRBG: return enc::BAYER_GRBG8;
+        case BayerPattern::BGGR: return enc::BAYER_BGGR8;
+        case BayerPattern::GBRG: break;
+    }
+    return enc::BAYER_GBRG8;
+}
+
+static void fill_image(sensor_msgs::msg::Image& msg, const Frame& f,
+                       const rclcpp::Time& stamp, const std::string& frame_id)
+{
+    msg.header.stamp = stamp;
+    msg.header.frame_id = frame_id;
+    msg.width = static_cast<uint32_t>(f.width);
+    msg.height = static_cast<uint32_t>(f.height);
+    msg.encoding = image_encoding(f);
+    msg.is_bigendian = false;
+    msg.step = static_cast<uint32_t>(f.stride);
+    msg.data.assign(f.data, f.data + f.bytes);   // sized and filled in one pass, no zeroing
+}
+
+// The camera timestamp on the ROS clock. The offset is taken once, from the
+// first frame stamped on the channel, so stamps keep the camera's spacing
+// instead of the publisher's scheduling jitter.
+rclcpp::Time CamBufferRecorderNode::stamp_of(size_t channel, const Frame& f)
+{
+    if (f.ts_ns == 0 || channel >= clock_offset_ns_.size()) return now();   // no camera clock
+    auto& offset = clock_offset_ns_[channel];
+    int64_t o = offset.load(std::memory_order_relaxed);
+    if (o == INT64_MIN) {
+        const int64_t want = now().nanoseconds() - static_cast<int64_t>(f.ts_ns);
+        if (offset.compare_exchange_strong(o, want)) o = want;   // else o is the other thread's
+    }
+    return rclcpp::Time(static_cast<int64_t>(f.ts_ns) + o, get_clock()->get_clock_type());
+}
+
+void CamBufferRecorderNode::publish_loop(size_t channel, int every_n)
+{
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Process, role_policy(ThreadRole::Process),
+                             "pub cam" + std::to_string(channel), &why))
+        RCLCPP_WARN(get_logger(), "Thread policy (image publisher): %s", why.c_str());
+
+    auto queue = channels_[channel].image_queue;
+    auto pub = channels_[channel].image_pub;
+    const std::string frame_id = get_parameter("frame_id").as_string();
+    uint64_t next_seq = 0;
+
+    while (true) {
+        FramePtr f;
+        if (!queue->pop(f, 100)) {
+            if (queue->closed()) break;
+            continue;
+        }
+        // Decimate on the broker's sequence so a dropped queue entry doesn't shift the cadence.
+        if (f->seq < next_seq) continue;
+        next_seq = f->seq - f->seq % every_n + every_n;
+
+        // One copy from the broker slot into the outgoing message (the slot is shared
+        // with the recorder, so it cannot be handed over); intra-process subscribers
+        // then take ownership of the message without serialization.
+        if (pub->can_loan_messages()) {
+            auto loaned = pub->borrow_loaned_message();
+            fill_image(loaned.get(), *f, stamp_of(channel, *f), frame_id);
+            pub->publish(std::move(loaned));
+        } else {
+            auto msg = std::make_unique<sensor_msgs::msg::Image>();
+            fill_image(*msg, *f, stamp_of(channel, *f), frame_id);
+            pub->publish(std::move(msg));
+        }
+    }
+}
+
+void CamBufferRecorderNode::start_preview(size_t channel)
+{
+    auto& ch = channels_[channel];
+    Preview::Options po;
+    po.factor = static_cast<int>(get_parameter("preview_factor").as_int());
+    po.color = get_parameter("preview_color").as_bool();
+    po.every_n = static_cast<int>(get_parameter("preview_every_n").as_int());
+    po.max_fps = get_parameter("preview_max_fps").as_double();
+    po.quality = static_cast<int>(get_parameter("preview_quality").as_int());
+    po.cpu_budget = get_parameter("preview_cpu_budget").as_double();
+    po.white_balance = ch.wb;
+    po.policy = role_policy(ThreadRole::Preview);
+    po.name = "prev cam" + std::to_string(channel);
+
+    auto pub = ch.preview_pub;
+    const std::string frame_id = get_parameter("frame_id").as_string();
+    pub->on_activate();
+    ch.preview = std::make_shared<Preview>();
+    ch.preview->start(ch.preview_queue, po,
+        [this, pub, frame_id, channel](const std::vector<uint8_t>& jpeg, const Frame& f, int, int, int comps) {
+            auto msg = std::make_unique<sensor_msgs::msg::CompressedImage>();
+            msg->header.stamp = stamp_of(channel, f);
+            msg->header.frame_id = frame_id;
+            // image_transport's compressed format string
+            msg->format = comps == 1 ? "mono8; jpeg compressed mono8" : "rgb8; jpeg compressed rgb8";
+            msg->data = jpeg;
+            pub->publish(std::move(msg));
+        });
+}
+
+MotionDetector::Options CamBufferRecorderNode::motion_options() const
+{
+    MotionDetector::Options mo;
+    mo.every_n = static_cast<int>(get_parameter("motion_every_n").as_int());
+    mo.factor = static_cast<int>(get_parameter("motion_factor").as_int());
+    mo.regions.clear();
+    for (const auto& text : get_parameter("motion_regions").as_string_array()) {
+        MotionDetector::Region r;
+        if (MotionDetector::parse_region(text, r)) mo.regions.push_back(r);
+        else RCLCPP_WARN(get_logger(), "Ignoring motion region '%s' (x y w h threshold)", text.c_str());
+    }
+    if (mo.regions.empty()) {
+        MotionDetector::Region all;
+        all.threshold = get_parameter("motion_threshold").as_double();
+        mo.regions.push_back(all);
+    }
+    mo.mask_path = get_parameter("motion_mask").as_string();
+    mo.bg_shift = static_cast<int>(get_parameter("motion_bg_shift").as_int());
+    mo.hold_ms = static_cast<int>(get_parameter("motion_hold_ms").as_int());
+    mo.policy = role_policy(ThreadRole::Process);
+    return mo;
+}
+
+void CamBufferRecorderNode::start_motion(size_t channel, MotionDetector::Options mo)
+{
+    auto& ch = channels_[channel];
+    mo.name = "motion cam" + std::to_string(channel);
+
+    auto pub = ch.motion_pub;
+    auto recorder = ch.recorder;
+    const std::string name = std::string(get_name()) + ": motion cam" + std::to_string(channel);
+    pub->on_activate();
+    ch.motion = std::make_shared<MotionDetector>();
+    ch.motion->start(ch.motion_queue, mo,
+        [this, pub, recorder, name](const MotionDetector::Event& e) {
+            if (recorder) recorder->on_motion(e);
+
+            diagnostic_msgs::msg::DiagnosticArray msg;
+            msg.header.stamp = now();
+            diagnostic_msgs::msg::DiagnosticStatus st;
+            st.name = name;
+            st.hardware_id = "cambuffer_recorder_ng";
+            st.level = e.start ? diagnostic_msgs::msg::DiagnosticStatus::WARN
+                               : diagnostic_msgs::msg::DiagnosticStatus::OK;
+            st.message = e.start ? "start" : "end";
+            auto kv = [&st](const std::string& k, const std::string& v) {
+                diagnostic_msgs::msg::KeyValue item;
+                item.key = k;
+                item.value = v;
+                st.values.push_back(item);
+            };
+            kv("ts_ns", std::to_string(e.ts_ns));   // camera clock, as in the recording
+            kv("frame_number", std::to_string(e.frame_number));
+            kv("region", std::to_string(e.region));
+            kv("energy", std::to_string(e.energy));
+            msg.status.push_back(std::move(st));
+            pub->publish(msg);
+        });
+}
+
+void CamBufferRecorderNode::start_ae(size_t channel)
+{
+    auto& ch = channels_[channel];
+    AutoExposure::Options ao;
+    ao.every_n = static_cast<int>(get_parameter("ae_every_n").as_int());
+    ao.target = get_parameter("ae_target").as_double();
+    ao.max_clipped = get_parameter("ae_max_clipped").as_double();
+    ao.min_exposure_us = get_parameter("ae_min_exposure_us").as_double();
+    ao.max_exposure_us = get_parameter("ae_max_exposure_us").as_double();
+    ao.max_gain_db = get_parameter("ae_max_gain_db").as_double();
+    ao.fps = fps_;
+    ao.exposure_us = ch.exposure_us;
+    ao.gain_db = ch.gain_db;
+    ao.exposure = get_parameter("ae_enable").as_bool() && ch.exposure_control;
+    ao.awb = get_parameter("awb_enable").as_bool() && to_8bit(ch.camera->pixel_format()) == PixelFormat::Bayer8;
+    ao.wb_r = get_parameter("wb_red").as_double();
+    ao.wb_b = get_parameter("wb_blue").as_double();
+    ao.policy = role_policy(ThreadRole::Process);
+    ao.name = "ae cam" + std::to_string(channel);
+    if (get_parameter("ae_enable").as_bool() && !ch.exposure_control)
+        RCLCPP_WARN(get_logger(), "Device %d has no exposure control; ae_enable does nothing there",
+                    ch.device_index);
+
+    ch.ae = std::make_shared<AutoExposure>();
+    if (!ch.ae->start(ch.ae_queue, ao, ao.exposure ? ch.camera : nullptr, ch.wb)) {
+        RCLCPP_WARN(get_logger(), "Auto exposure for device %d did not start", ch.device_index);
+        ch.ae.reset();
+    }
+}
+
 void CamBufferRecorderNode::run_loop()
 {
-    uint8_t* data;
-    size_t size;
-    int w, h, stride;
-    uint64_t ts;
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Process, role_policy(ThreadRole::Process), "node loop", &why))
+        RCLCPP_WARN(get_logger(), "Thread policy (process): %s", why.c_str());
 
-    size_t frame_count = 0;
+    // The brokers own every grab; this loop only watches a latest-only stats queue.
+    auto stats = channels_.front().stats;
+    auto broker = channels_.front().broker;
+    uint64_t last_count = broker->frames_captured();
     auto last_heartbeat = std::chrono::steady_clock::now();
 
     while (running_ && rclcpp::ok()) {
-        if (camera_->grab(data, size, ts, w, h, stride, 100)) {
-            frame_count++;
-
-            // Write frame to recorder if active
-            // (you can skip this if already handled inside Recorder)
-            // recorder_->push_frame(data, size, w, h, ts);
-
-            // Log one frame timestamp every 2s (already there)
+        FramePtr f;
+        if (stats->pop(f, 100)) {
             RCLCPP_INFO_THROTTLE(get_logger(), *get_clock(), 2000,
                                  "Frame ts: %lu (%dx%d, %zu bytes)",
-                                 ts, w, h, size);
+                                 (unsigned long)f->ts_ns, f->width, f->height, f->bytes);
         }
+        f.reset();   // don't pin a pool slot while idle
 
         // --- Heartbeat: print FPS every second ---
         auto now = std::chrono::steady_clock::now();
         double elapsed = std::chrono::duration<double>(now - last_heartbeat).count();
         if (elapsed >= 1.0) {
-            double fps_est = frame_count / elapsed;
+            const uint64_t count = broker->frames_captured();
+            const double frame_count = static_cast<double>(count - last_count);
             RCLCPP_INFO(get_logger(), "Heartbeat: %.2f fps (%.0f frames in %.2fs)",
-                        fps_est, (double)frame_count, elapsed);
-            frame_count = 0;
+                        frame_count / elapsed, frame_count, elapsed);
+            if (channels_.size() > 1) log_sync_stats();
+            last_count = count;
             last_heartbeat = now;
         }
     }
@@ -144,3 +1135,4 @@ void CamBufferRecorderNode::run_loop()
 
 }  // namespace cambuffer_recorder_ng
 
+RCLCPP_COMPONENTS_REGISTER_NODE(cambuffer_recorder_ng::CamBufferRecorderNode)
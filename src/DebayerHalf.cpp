@@ -0,0 +1,100 @@
+#include "cambuffer_recorder_ng/DebayerHalf.hpp"
+#include "cambuffer_recorder_ng/Decimate.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+// Byte offsets of R, the two Gs and B inside a 2x2 cell (row1 adds `stride`).
+struct CellOffsets { int r, g1, g2, b; };
+
+CellOffsets cell_offsets(BayerPattern p, int stride)
+{
+    switch (p) {
+        case BayerPattern::RGGB: return {0, 1, stride, stride + 1};
+        case BayerPattern::GRBG: return {1, 0, stride + 1, stride};
+        case BayerPattern::BGGR: return {stride + 1, 1, stride, 0};
+        case BayerPattern::GBRG: break;
+    }
+    return {stride, 0, stride + 1, 1};   // GBRG: row0 G B / row1 R G
+}
+
+} // namespace
+
+void debayer_half_bgr(const uint8_t* src, int w, int h, int stride,
+                      uint8_t* dst, BayerPattern pattern)
+{
+    const int ow = w / 2, oh = h / 2;
+    const CellOffsets o = cell_offsets(pattern, stride);
+
+    for (int y = 0; y < oh; ++y) {
+        const uint8_t* cell = src + static_cast<size_t>(2 * y) * stride;
+        uint8_t* out = dst + static_cast<size_t>(y) * ow * 3;
+        for (int x = 0; x < ow; ++x, cell += 2, out += 3) {
+            out[0] = cell[o.b];
+            out[1] = static_cast<uint8_t>((cell[o.g1] + cell[o.g2]) >> 1);
+            out[2] = cell[o.r];
+        }
+    }
+}
+
+void debayer_half_gray(const uint8_t* src, int w, int h, int stride, uint8_t* dst)
+{
+    const int ow = w / 2, oh = h / 2;
+    for (int y = 0; y < oh; ++y) {
+        const uint8_t* row0 = src + static_cast<size_t>(2 * y) * stride;
+        const uint8_t* row1 = row0 + stride;
+        uint8_t* out = dst + static_cast<size_t>(y) * ow;
+        for (int x = 0; x < ow; ++x) {
+            const int sum = row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1];
+            out[x] = static_cast<uint8_t>(sum >> 2);
+        }
+    }
+}
+
+void bayer_half_preserve_cfa(const uint8_t* in, int in_w, int in_h, int stride,
+                             uint8_t* out, int& out_w, int& out_h,
+                             BayerPattern /*pattern*/)
+{
+    // Gain 1: the rounded mean of the four same-colour sites.
+    bayer_decimate_2x2_gain(in, in_w, in_h, stride, 1.0, out, out_w, out_h);
+}
+
+void bayer_half_preserve_cfa(const uint8_t* in, int in_w, int in_h, int stride,
+                             uint16_t* out, int& out_w, int& out_h,
+                             BayerPattern /*pattern*/)
+{
+    out_w = (in_w / 4) * 2;
+    out_h = (in_h / 4) * 2;
+    // Output row 2b + p comes from input rows 4b + p and 4b + p + 2; site x from
+    // columns 4 * (x / 2) + (x & 1) and two further on.
+    for (int y = 0; y < out_h; ++y) {
+        const uint8_t* r0 = in + static_cast<size_t>(4 * (y / 2) + (y & 1)) * stride;
+        const uint8_t* r1 = r0 + 2 * static_cast<size_t>(stride);
+        uint16_t* o = out + static_cast<size_t>(y) * out_w;
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+        auto four = [&](__m128i v) {   // (v0 v1 v2 v3) -> (v0 + v2, v1 + v3) per 64 bits
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+            return _mm_madd_epi16(v, ones);
+        };
+        for (; x + 8 <= out_w; x += 8) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + 2 * x));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 2 * x));
+            const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + x), _mm_packs_epi32(four(lo), four(hi)));
+        }
+#endif
+        for (; x < out_w; ++x) {
+            const int i = 4 * (x / 2) + (x & 1);
+            o[x] = static_cast<uint16_t>(r0[i] + r0[i + 2] + r1[i] + r1[i + 2]);
+        }
+    }
+}
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,204 @@
+#include "cambuffer_recorder_ng/Decimate.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+// out = (sum4 * G + 512) >> 10 with G = gain * 256: gain / 4 with rounding.
+constexpr int kShift = 10;
+constexpr int kRound = 1 << (kShift - 1);
+
+int fixed_gain(double gain)
+{
+    return static_cast<int>(std::clamp(std::lround(gain * 256.0), 0l, 32767l));
+}
+
+// n outputs from two rows. Output j sums the samples at i and i + U of both
+// rows, where i = 2U * (j / U) + j % U: U = 1 gray, 2 one Bayer row, 3 RGB.
+void decimate_rows(const uint8_t* r0, const uint8_t* r1, int n, int U, int G, uint8_t* dst)
+{
+    int j = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i gv = _mm_set1_epi16(static_cast<int16_t>(G));
+    const __m128i rv = _mm_set1_epi32(kRound);
+    // Vertical 16-bit sums of 8 bytes, then madd adds neighbouring lanes times G.
+    auto vsum = [&](const uint8_t* p0, const uint8_t* p1, bool hi) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+        return hi ? _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero))
+                  : _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    };
+    auto scale = [&](__m128i pairs) {   // 4 x 32-bit (a + b) * G -> rounded, shifted
+        return _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, gv), rv), kShift);
+    };
+
+    if (U == 1 || U == 2) {
+        // 32 input bytes -> 16 outputs. For Bayer, (v0 v1 v2 v3) becomes
+        // (v0 v2 v1 v3) so each same-colour pair is adjacent for madd.
+        auto eight = [&](const uint8_t* p0, const uint8_t* p1) {
+            __m128i lo = vsum(p0, p1, false), hi = vsum(p0, p1, true);
+            if (U == 2) {
+                lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+                hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+            }
+            return _mm_packs_epi32(scale(lo), scale(hi));
+        };
+        for (; j + 16 <= n; j += 16) {
+            const __m128i a = eight(r0 + 2 * j, r1 + 2 * j);
+            const __m128i b = eight(r0 + 2 * j + 16, r1 + 2 * j + 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + j), _mm_packus_epi16(a, b));
+        }
+    } else if (U == 3) {
+        // Sums at offset 0 and 3 line up each pixel with its right neighbour;
+        // of the 16 results, bytes 0-2, 6-8 and 12-14 are three output pixels.
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i gr = _mm_unpacklo_epi16(gv, _mm_set1_epi16(kRound));   // (G, R) pairs
+        auto times_gain = [&](__m128i h) {
+            const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(h, ones), gr);
+            const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(h, ones), gr);
+            return _mm_packs_epi32(_mm_srai_epi32(lo, kShift), _mm_srai_epi32(hi, kShift));
+        };
+        const __m128i m0 = _mm_setr_epi8(-1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i m1 = _mm_slli_si128(m0, 3), m2 = _mm_slli_si128(m0, 6);
+        for (; j + 12 <= n; j += 9) {
+            const uint8_t* p0 = r0 + 2 * j;
+            const uint8_t* p1 = r1 + 2 * j;
+            const __m128i lo = times_gain(_mm_add_epi16(vsum(p0, p1, false), vsum(p0 + 3, p1 + 3, false)));
+            const __m128i hi = times_gain(_mm_add_epi16(vsum(p0, p1, true), vsum(p0 + 3, p1 + 3, true)));
+            const __m128i h8 = _mm_packus_epi16(lo, hi);
+            const __m128i o = _mm_or_si128(_mm_and_si128(h8, m0),
+                              _mm_or_si128(_mm_and_si128(_mm_srli_si128(h8, 3), m1),
+                                           _mm_and_si128(_mm_srli_si128(h8, 6), m2)));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + j), o);
+            dst[j + 8] = static_cast<uint8_t>(_mm_extract_epi16(o, 4));
+        }
+    }
+#endif
+    for (; j < n; ++j) {
+        const int i = 2 * U * (j / U) + j % U;
+        const int sum = r0[i] + r0[i + U] + r1[i] + r1[i + U];
+        dst[j] = static_cast<uint8_t>(std::min(255, (sum * G + kRound) >> kShift));
+    }
+}
+
+// Every other unit of U bytes: 16 output bytes per 32 input. U = 1 keeps the
+// low byte of each 16-bit lane, U = 2 the low half of each 32-bit lane
+// (sign-extended so packs is exact), U = 4 the even 32-bit lanes.
+void skip_row(const uint8_t* s, int units, int U, uint8_t* d)
+{
+    int k = 0;
+#if defined(__SSE2__)
+    if (U == 1 || U == 2 || U == 4) {
+        const int per = 16 / U;
+        const __m128i m8 = _mm_set1_epi16(0x00ff);
+        for (; k + per <= units; k += per) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * k * U));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * k * U + 16));
+            __m128i o;
+            if (U == 1)
+                o = _mm_packus_epi16(_mm_and_si128(a, m8), _mm_and_si128(b, m8));
+            else if (U == 2)
+                o = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                                    _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+            else
+                o = _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)),
+                                       _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + k * U), o);
+        }
+    }
+#endif
+    for (; k < units; ++k) std::memcpy(d + k * U, s + 2 * k * U, U);
+}
+
+// n 16-bit outputs from two rows, output j from sites i and i + P of both,
+// i = 2P * (j / P) + j % P. madd has no unsigned form, so samples are biased
+// by -32768: the four biases cancel against the final >> 2 and re-bias.
+void bin16_rows(const uint16_t* r0, const uint16_t* r1, int n, int P, uint16_t* dst)
+{
+    int j = 0;
+#if defined(__SSE2__)
+    const __m128i bias = _mm_set1_epi16(-32768);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi32(2);
+    auto four = [&](const uint16_t* p0, const uint16_t* p1) {
+        __m128i a = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p0)), bias);
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1)), bias);
+        if (P == 2) {   // (v0 v1 v2 v3) -> (v0 v2 v1 v3), as in decimate_rows
+            a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+            b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+        }
+        const __m128i sum = _mm_add_epi32(_mm_madd_epi16(a, ones), _mm_madd_epi16(b, ones));
+        return _mm_srai_epi32(_mm_add_epi32(sum, two), 2);
+    };
+    for (; j + 8 <= n; j += 8) {
+        const __m128i o = _mm_packs_epi32(four(r0 + 2 * j, r1 + 2 * j), four(r0 + 2 * j + 8, r1 + 2 * j + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + j), _mm_xor_si128(o, bias));
+    }
+#endif
+    for (; j < n; ++j) {
+        const int i = 2 * P * (j / P) + j % P;
+        dst[j] = static_cast<uint16_t>((r0[i] + r0[i + P] + r1[i] + r1[i + P] + 2) >> 2);
+    }
+}
+
+} // namespace
+
+void decimate_2x2_gain(const uint8_t* src, int w, int h, int stride, int channels,
+                       double gain, uint8_t* dst)
+{
+    const int ow = w / 2, oh = h / 2;
+    const int n = ow * channels;
+    const int G = fixed_gain(gain);
+    for (int y = 0; y < oh; ++y) {
+        const uint8_t* r0 = src + static_cast<size_t>(2 * y) * stride;
+        decimate_rows(r0, r0 + stride, n, channels, G, dst + static_cast<size_t>(y) * n);
+    }
+}
+
+void bayer_decimate_2x2_gain(const uint8_t* src, int w, int h, int stride, double gain,
+                             uint8_t* dst, int& out_w, int& out_h)
+{
+    out_w = (w / 4) * 2;
+    out_h = (h / 4) * 2;
+    const int G = fixed_gain(gain);
+    // Output row 2b + p (p = CFA row parity) comes from input rows 4b + p and 4b + p + 2.
+    for (int y = 0; y < out_h; ++y) {
+        const uint8_t* r0 = src + static_cast<size_t>(4 * (y / 2) + (y & 1)) * stride;
+        decimate_rows(r0, r0 + 2 * static_cast<size_t>(stride), out_w, 2, G,
+                      dst + static_cast<size_t>(y) * out_w);
+    }
+}
+
+void skip_2x2(const uint8_t* src, int w, int h, int stride, int bpp, int period,
+              uint8_t* dst, int dst_stride)
+{
+    const int units = w / (2 * period), oh = h / (2 * period) * period;
+    for (int y = 0; y < oh; ++y) {
+        const int sy = 2 * period * (y / period) + y % period;
+        skip_row(src + static_cast<size_t>(sy) * stride, units, bpp * period,
+                 dst + static_cast<size_t>(y) * dst_stride);
+    }
+}
+
+void bin_2x2_16(const uint16_t* src, int w, int h, int stride, int period,
+                uint16_t* dst, int dst_stride)
+{
+    const int ow = w / (2 * period) * period, oh = h / (2 * period) * period;
+    const auto* base = reinterpret_cast<const uint8_t*>(src);
+    for (int y = 0; y < oh; ++y) {
+        const int sy = 2 * period * (y / period) + y % period;
+        const auto* r0 = reinterpret_cast<const uint16_t*>(base + static_cast<size_t>(sy) * stride);
+        const auto* r1 = reinterpret_cast<const uint16_t*>(base + static_cast<size_t>(sy + period) * stride);
+        bin16_rows(r0, r1, ow, period,
+                   reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(dst) + static_cast<size_t>(y) * dst_stride));
+    }
+}
+
+} // namespace cambuffer_recorder_ng
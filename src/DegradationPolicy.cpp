@@ -0,0 +1,86 @@
+#include "cambuffer_recorder_ng/DegradationPolicy.hpp"
+#include <cstdio>
+
+namespace cambuffer_recorder_ng {
+
+const char* DegradationPolicy::step_name(Step s)
+{
+    switch (s) {
+        case Step::Compress: return "compress";
+        case Step::HalfRes:  return "half_res";
+        case Step::Decimate: return "decimate";
+        case Step::Drop:     return "drop";
+    }
+    return "?";
+}
+
+bool DegradationPolicy::parse_step(const std::string& name, Step& out)
+{
+    for (Step s : {Step::Compress, Step::HalfRes, Step::Decimate, Step::Drop})
+        if (name == step_name(s)) { out = s; return true; }
+    return false;
+}
+
+std::string DegradationPolicy::Change::describe() const
+{
+    char buf[160];
+    snprintf(buf, sizeof(buf), "degrade %d->%d (%s -> %s) at %llu ns: queue %.0f%%, load %.2f",
+             from, to, from_name.c_str(), to_name.c_str(),
+             (unsigned long long)ts_ns, fill * 100.0, load);
+    return buf;
+}
+
+void DegradationPolicy::reset(const Options& opt)
+{
+    opt_ = opt;
+    level_ = 0;
+    behind_since_ = healthy_since_ = 0;
+    change_ = Change{};
+}
+
+std::string DegradationPolicy::level_name(int level) const
+{
+    return level == 0 ? "normal" : step_name(opt_.steps[static_cast<size_t>(level - 1)]);
+}
+
+bool DegradationPolicy::active(Step s) const
+{
+    for (int i = 0; i < level_; ++i)
+        if (opt_.steps[static_cast<size_t>(i)] == s) return true;
+    return false;
+}
+
+bool DegradationPolicy::update(uint64_t now_ns, double fill, double load)
+{
+    const bool behind = fill >= opt_.high_water || load >= opt_.overload_ratio;
+    const bool healthy = fill <= opt_.low_water && load <= opt_.recover_ratio;
+    const int max_level = static_cast<int>(opt_.steps.size());
+
+    int next = level_;
+    if (behind) {
+        healthy_since_ = 0;
+        if (!behind_since_) behind_since_ = now_ns;
+        if (now_ns - behind_since_ >= opt_.escalate_ns && level_ < max_level) next = level_ + 1;
+    } else if (healthy) {
+        behind_since_ = 0;
+        if (!healthy_since_) healthy_since_ = now_ns;
+        if (now_ns - healthy_since_ >= opt_.recover_ns && level_ > 0) next = level_ - 1;
+    } else {
+        behind_since_ = healthy_since_ = 0;   // dead band
+    }
+    if (next == level_) return false;
+
+    change_.from = level_;
+    change_.to = next;
+    change_.from_name = level_name(level_);
+    change_.to_name = level_name(next);
+    change_.ts_ns = now_ns;
+    change_.fill = fill;
+    change_.load = load;
+    level_ = next;
+    // Each further step needs its own full window.
+    behind_since_ = healthy_since_ = 0;
+    return true;
+}
+
+} // namespace cambuffer_recorder_ng
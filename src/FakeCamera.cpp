@@ -0,0 +1,174 @@
+#include "cambuffer_recorder_ng/FakeCamera.hpp"
+#include <algorithm>
+#include <thread>
+
+namespace cambuffer_recorder_ng {
+
+void FakeCamera::open(int)
+{
+    opt_.width  = std::max(opt_.width & ~1, 2);
+    opt_.height = std::max(opt_.height & ~1, 2);
+    opt_.frames = std::max(opt_.frames, 1);
+    if (opt_.fps <= 0) opt_.fps = 30.0;
+    opt_.drop_prob = std::clamp(opt_.drop_prob, 0.0, 0.99);   // 1 would never deliver
+    opt_.bit_depth = std::clamp(opt_.bit_depth, 9, 16);
+    full_w_ = opt_.width;
+    full_h_ = opt_.height;
+
+    period_ = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / opt_.fps));
+    render();
+}
+
+bool FakeCamera::set_downsampling(int factor, Downsampling mode, int& width, int& height)
+{
+    (void)mode;   // the gradient looks the same either way
+    if (!opt_.downsampling || running_ || factor < 1) return false;
+    if (frames_.empty()) open();
+    opt_.width  = std::max((full_w_ / factor) & ~1, 2);
+    opt_.height = std::max((full_h_ / factor) & ~1, 2);
+    render();
+    width = opt_.width;
+    height = opt_.height;
+    return true;
+}
+
+void FakeCamera::render()
+{
+    const int w = opt_.width, h = opt_.height;
+    const int bpp = bytes_per_pixel(opt_.format);
+    frame_bytes_ = static_cast<size_t>(w) * h * bpp;
+    frames_.assign(opt_.frames, std::vector<uint8_t>(frame_bytes_));
+
+    // CFA colour of each site in a 2x2 block: 0 = R, 1 = G, 2 = B
+    int cfa[2][2];
+    switch (opt_.pattern) {
+        case BayerPattern::RGGB: cfa[0][0]=0; cfa[0][1]=1; cfa[1][0]=1; cfa[1][1]=2; break;
+        case BayerPattern::GRBG: cfa[0][0]=1; cfa[0][1]=0; cfa[1][0]=2; cfa[1][1]=1; break;
+        case BayerPattern::GBRG: cfa[0][0]=1; cfa[0][1]=2; cfa[1][0]=0; cfa[1][1]=1; break;
+        case BayerPattern::BGGR: cfa[0][0]=2; cfa[0][1]=1; cfa[1][0]=1; cfa[1][1]=0; break;
+    }
+
+    // Deeper formats scale the 8-bit value up and fill the extra low bits
+    // with a fine dither, so packing and shifting have real bits to move.
+    const int extra = bit_depth() - 8;
+    auto deep = [extra](int v, int x, int y) {
+        return static_cast<uint16_t>((v & 255) << extra | ((x ^ y) & ((1 << extra) - 1)));
+    };
+
+    // Moving colour gradient: R follows x, G follows y, B the diagonal.
+    for (int f = 0; f < opt_.frames; ++f) {
+        uint8_t* dst = frames_[f].data();
+        auto* dst16 = reinterpret_cast<uint16_t*>(dst);
+        const int k = f * 256 / opt_.frames;
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const uint8_t rgb[3] = {
+                    static_cast<uint8_t>(x + k),
+                    static_cast<uint8_t>(y + k),
+                    static_cast<uint8_t>(((x + y) >> 1) + k) };
+                const size_t i = static_cast<size_t>(y) * w + x;
+                switch (opt_.format) {
+                    case PixelFormat::Rgb24:
+                        dst[3*i+0] = rgb[0]; dst[3*i+1] = rgb[1]; dst[3*i+2] = rgb[2];
+                        break;
+                    case PixelFormat::Bayer8:
+                        dst[i] = rgb[cfa[y & 1][x & 1]];
+                        break;
+                    case PixelFormat::Mono8:
+                        dst[i] = static_cast<uint8_t>((rgb[0] + 2 * rgb[1] + rgb[2]) >> 2);
+                        break;
+                    case PixelFormat::Bayer16:
+                        dst16[i] = deep(rgb[cfa[y & 1][x & 1]], x, y);
+                        break;
+                    case PixelFormat::Mono16:
+                        dst16[i] = deep((rgb[0] + 2 * rgb[1] + rgb[2]) >> 2, x, y);
+                        break;
+                }
+            }
+        }
+    }
+}
+
+void FakeCamera::start()
+{
+    if (frames_.empty()) open();
+    rng_.seed(opt_.seed);
+    counter_ = 0;
+    last_stall_ = 0;
+    injected_drops_ = 0;
+    next_ = Clock::now() + period_;
+    running_ = true;
+}
+
+// sleep_until alone overshoots by tens of microseconds; sleep most of the way, spin the rest.
+void FakeCamera::wait_until(Clock::time_point t)
+{
+    constexpr auto spin = std::chrono::microseconds(200);
+    if (t - Clock::now() > spin) std::this_thread::sleep_until(t - spin);
+    while (Clock::now() < t) {}
+}
+
+bool FakeCamera::grab(uint8_t*& data, size_t& size, uint64_t& ts,
+                      int& width, int& height, int& stride, int timeout_ms)
+{
+    if (!running_) return false;
+
+    // Stall: the sensor keeps exposing but nothing reaches the host.
+    // Once per stall_every frames: the skipped frames may land the counter on
+    // (or past) another multiple, which must not stall again.
+    if (opt_.stall_every > 0 && opt_.stall_ms > 0 && counter_ > 0 &&
+        counter_ / opt_.stall_every > last_stall_) {
+        const auto stall = std::chrono::milliseconds(opt_.stall_ms);
+        const uint64_t lost = static_cast<uint64_t>(stall / period_);
+        next_ += period_ * lost;
+        counter_ += lost;
+        injected_drops_ += lost;
+        last_stall_ = counter_ / opt_.stall_every;
+    }
+
+    // Transport drops: the counter still advances.
+    if (opt_.drop_prob > 0) {
+        std::bernoulli_distribution drop(opt_.drop_prob);
+        while (drop(rng_)) {
+            next_ += period_;
+            counter_++;
+            injected_drops_++;
+        }
+    }
+
+    // Consumer overrun: a camera with queue_frames buffers loses the oldest ones.
+    const auto now = Clock::now();
+    const auto backlog = period_ * std::max(opt_.queue_frames, 1);
+    if (now - next_ > backlog) {
+        const uint64_t lost = static_cast<uint64_t>((now - next_ - backlog) / period_) + 1;
+        next_ += period_ * lost;
+        counter_ += lost;
+        injected_drops_ += lost;
+    }
+
+    auto deliver = next_;
+    if (opt_.jitter_us > 0) {
+        std::uniform_int_distribution<int> j(-opt_.jitter_us, opt_.jitter_us);
+        deliver += std::chrono::microseconds(j(rng_));
+    }
+
+    if (deliver - now > std::chrono::milliseconds(timeout_ms)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        return false;   // like xiGetImage timing out; the frame is still coming
+    }
+    wait_until(deliver);
+
+    counter_++;
+    data = frames_[counter_ % frames_.size()].data();
+    size = frame_bytes_;
+    width = opt_.width;
+    height = opt_.height;
+    stride = opt_.width * bytes_per_pixel(opt_.format);
+    ts = std::chrono::duration_cast<std::chrono::nanoseconds>(next_.time_since_epoch()).count();
+
+    next_ += period_;
+    return true;
+}
+
+} // namespace cambuffer_recorder_ng
@@ -1,21 +1,64 @@
 #include "cambuffer_recorder_ng/FfmpegWriter.hpp"
+#include "cambuffer_recorder_ng/FrameTrace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
-#include "rclcpp/rclcpp.hpp"
 
 namespace cambuffer_recorder_ng {
 
+static bool bayer_pattern_of(AVPixelFormat fmt, BayerPattern& pattern)
+{
+    switch (fmt) {
+        case AV_PIX_FMT_BAYER_RGGB8: case AV_PIX_FMT_BAYER_RGGB16LE: pattern = BayerPattern::RGGB; return true;
+        case AV_PIX_FMT_BAYER_GRBG8: case AV_PIX_FMT_BAYER_GRBG16LE: pattern = BayerPattern::GRBG; return true;
+        case AV_PIX_FMT_BAYER_GBRG8: case AV_PIX_FMT_BAYER_GBRG16LE: pattern = BayerPattern::GBRG; return true;
+        case AV_PIX_FMT_BAYER_BGGR8: case AV_PIX_FMT_BAYER_BGGR16LE: pattern = BayerPattern::BGGR; return true;
+        default: return false;
+    }
+}
+
+static bool is_16bit(AVPixelFormat fmt)
+{
+    switch (fmt) {
+        case AV_PIX_FMT_GRAY16LE:
+        case AV_PIX_FMT_BAYER_RGGB16LE: case AV_PIX_FMT_BAYER_GRBG16LE:
+        case AV_PIX_FMT_BAYER_GBRG16LE: case AV_PIX_FMT_BAYER_BGGR16LE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint64_t now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
 bool FfmpegWriter::open(const std::string& filename,
                         int width,
                         int height,
                         int fps,
-                        const std::string& codec_name)
+                        const std::string& codec_name,
+                        AVPixelFormat input_fmt)
 {
     std::lock_guard<std::mutex> lock(mtx_);
     width_ = width; height_ = height; fps_ = fps;
+    input_fmt_ = input_fmt;
     frame_index_ = 0;
+    filename_ = filename;
+    segment_index_ = 0;
+    segment_start_pts_ = 0;
+    rotate_pending_ = false;
+    key_forced_ = false;
+    next_ctx_ = nullptr;
+    open_failures_ = 0;
+    retry_at_ = {};
 
-    avformat_alloc_output_context2(&fmt_ctx_, nullptr, nullptr, filename.c_str());
-    if (!fmt_ctx_) {
+    const std::string first = segment_name(0);
+    const AVOutputFormat* ofmt = av_guess_format(nullptr, first.c_str(), nullptr);
+    if (!ofmt) {
         std::cerr << "FFmpeg: could not allocate output context.\n";
         return false;
     }
@@ -32,70 +75,295 @@ bool FfmpegWriter::open(const std::string& filename,
     codec_ctx_->height = height_;
     codec_ctx_->time_base = {1, fps_};
     codec_ctx_->framerate = {fps_, 1};
-    codec_ctx_->pix_fmt = AV_PIX_FMT_YUV420P;
-    codec_ctx_->bit_rate = 8'000'000;  // 8 Mbps
+    codec_ctx_->pix_fmt = enc_fmt_;
+    codec_ctx_->bit_rate = base_bit_rate_;  // 8 Mbps
+    if (fragment_ms_ > 0)
+        codec_ctx_->gop_size = std::max(1, fps_ * fragment_ms_ / 1000);
 
-    if (fmt_ctx_->oformat->flags & AVFMT_GLOBALHEADER)
+    if (ofmt->flags & AVFMT_GLOBALHEADER)
         codec_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
-    if (avcodec_open2(codec_ctx_, codec, nullptr) < 0) {
+    AVDictionary* opts = nullptr;
+    for (const auto& [key, value] : codec_opts_)
+        av_dict_set(&opts, key.c_str(), value.c_str(), 0);
+    const int ret = avcodec_open2(codec_ctx_, codec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
         std::cerr << "FFmpeg: could not open codec.\n";
         return false;
     }
 
-    stream_ = avformat_new_stream(fmt_ctx_, nullptr);
-    stream_->id = fmt_ctx_->nb_streams - 1;
-    stream_->time_base = codec_ctx_->time_base;
-    avcodec_parameters_from_context(stream_->codecpar, codec_ctx_);
-
-    if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
-        if (avio_open(&fmt_ctx_->pb, filename.c_str(), AVIO_FLAG_WRITE) < 0) {
-            std::cerr << "FFmpeg: could not open output file " << filename << "\n";
-            return false;
-        }
-    }
+    // Every segment's stream is created from this one snapshot.
+    params_ = avcodec_parameters_alloc();
+    avcodec_parameters_from_context(params_, codec_ctx_);
 
-    if (avformat_write_header(fmt_ctx_, nullptr) < 0)
-    RCLCPP_WARN(rclcpp::get_logger("FfmpegWriter"), "Failed to write FFmpeg header");
+    fmt_ctx_ = open_muxer(first);
+    if (!fmt_ctx_) return false;
+    stream_ = fmt_ctx_->streams[0];
 
-    // Prepare scaling context from RGB24 to YUV420P
-    sws_ctx_ = sws_getContext(width_, height_, AV_PIX_FMT_RGB24,
-                              width_, height_, AV_PIX_FMT_YUV420P,
+    // Prepare scaling context from the input format (RGB24 or Bayer) to the encoder's (YUV420P)
+    sws_ctx_ = sws_getContext(width_, height_, input_fmt_,
+                              width_, height_, enc_fmt_,
                               SWS_BILINEAR, nullptr, nullptr, nullptr);
 
     frame_yuv_ = av_frame_alloc();
-    frame_yuv_->format = AV_PIX_FMT_YUV420P;
+    frame_yuv_->format = enc_fmt_;
     frame_yuv_->width = width_;
     frame_yuv_->height = height_;
     av_frame_get_buffer(frame_yuv_, 32);
 
     pkt_ = av_packet_alloc();
+    if (segmenting()) prepare_next();
     return true;
 }
 
-bool FfmpegWriter::write_frame(const uint8_t* rgb_data, int stride_bytes, int64_t pts_ns)
+std::string FfmpegWriter::segment_name(int index) const
+{
+    if (!segmenting()) return filename_;
+    // out.mp4 -> out_0003.mp4
+    const auto dot = filename_.find_last_of('.');
+    const auto slash = filename_.find_last_of('/');
+    const bool has_ext = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    char idx[16];
+    snprintf(idx, sizeof(idx), "_%04d", index);
+    return has_ext ? filename_.substr(0, dot) + idx + filename_.substr(dot) : filename_ + idx;
+}
+
+AVFormatContext* FfmpegWriter::open_muxer(const std::string& filename) const
+{
+    AVFormatContext* ctx = nullptr;
+    avformat_alloc_output_context2(&ctx, nullptr, nullptr, filename.c_str());
+    if (!ctx) {
+        std::cerr << "FFmpeg: could not allocate output context.\n";
+        return nullptr;
+    }
+
+    AVStream* st = avformat_new_stream(ctx, nullptr);
+    st->id = 0;
+    st->time_base = {1, fps_};
+    avcodec_parameters_copy(st->codecpar, params_);
+
+    if (!(ctx->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&ctx->pb, filename.c_str(), AVIO_FLAG_WRITE) < 0) {
+            std::cerr << "FFmpeg: could not open output file " << filename << "\n";
+            avformat_free_context(ctx);
+            return nullptr;
+        }
+    }
+
+    // Lets set_metadata() keys other than the standard MP4 ones survive.
+    AVDictionary* mux_opts = nullptr;
+    std::string movflags = "use_metadata_tags";
+    if (fragment_ms_ > 0) {
+        // empty_moov: the header is complete up front; each fragment is then
+        // self-contained and handed to the OS as soon as it is finished.
+        movflags += "+frag_keyframe+empty_moov+default_base_moof";
+        av_dict_set(&mux_opts, "frag_duration", std::to_string(fragment_ms_ * 1000LL).c_str(), 0);
+        av_dict_set(&mux_opts, "cluster_time_limit", std::to_string(fragment_ms_).c_str(), 0);  // Matroska
+        av_dict_set(&mux_opts, "flush_packets", "1", 0);
+    }
+    av_dict_set(&mux_opts, "movflags", movflags.c_str(), 0);
+    const int hdr = avformat_write_header(ctx, &mux_opts);
+    av_dict_free(&mux_opts);
+    if (hdr < 0) {
+        // e.g. a codec the container cannot carry (ffv1 in MP4): nothing usable would follow.
+        std::cerr << "FFmpeg: could not write the header of " << filename << " (error " << hdr << ")\n";
+        if (!(ctx->oformat->flags & AVFMT_NOFILE)) avio_closep(&ctx->pb);
+        avformat_free_context(ctx);
+        std::remove(filename.c_str());
+        return nullptr;
+    }
+    return ctx;
+}
+
+void FfmpegWriter::finish_muxer(AVFormatContext* ctx)
+{
+    av_write_trailer(ctx);
+    if (!(ctx->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&ctx->pb);
+    avformat_free_context(ctx);
+}
+
+void FfmpegWriter::prepare_next()
+{
+    next_name_ = segment_name(segment_index_ + 1);
+    next_ = std::async(std::launch::async, &FfmpegWriter::open_muxer, this, next_name_);
+}
+
+// Picks up the background open once it has finished, without waiting for it.
+// A failed one (disk full, permissions) is retried after a doubling back-off.
+void FfmpegWriter::poll_next()
+{
+    if (next_ctx_) return;
+    if (next_.valid()) {
+        if (next_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+        next_ctx_ = next_.get();
+        if (next_ctx_) {
+            open_failures_ = 0;
+            return;
+        }
+        const int backoff_ms = std::min(30000, 1000 << std::min(open_failures_++, 5));
+        std::cerr << "FFmpeg: could not open segment " << next_name_
+                  << ", continuing in the current one; retrying in " << backoff_ms << " ms\n";
+        retry_at_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(backoff_ms);
+        return;
+    }
+    if (std::chrono::steady_clock::now() >= retry_at_) prepare_next();
+}
+
+bool FfmpegWriter::segment_full() const
+{
+    if (segment_bytes_ && fmt_ctx_->pb &&
+        static_cast<uint64_t>(avio_tell(fmt_ctx_->pb)) >= segment_bytes_)
+        return true;
+    return segment_ms_ > 0 && fps_ > 0 &&
+           (frame_index_ - segment_start_pts_) * 1000 >= static_cast<int64_t>(segment_ms_) * fps_;
+}
+
+void FfmpegWriter::switch_segment(int64_t start_pts)
+{
+    // Only called once poll_next() has the opened file: never waits.
+    AVFormatContext* next = next_ctx_;
+    next_ctx_ = nullptr;
+    rotate_pending_ = false;
+    key_forced_ = false;
+
+    // The finished file's trailer (its whole index, for classic MP4) is written off this thread.
+    AVFormatContext* done = fmt_ctx_;
+    finishing_.push_back(std::async(std::launch::async, &FfmpegWriter::finish_muxer, done));
+
+    fmt_ctx_ = next;
+    stream_ = fmt_ctx_->streams[0];
+    segment_index_++;
+    segment_start_pts_ = start_pts;
+    prepare_next();
+
+    // Reap trailers that are already written.
+    finishing_.erase(std::remove_if(finishing_.begin(), finishing_.end(), [](std::future<void>& f) {
+        return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), finishing_.end());
+}
+
+void FfmpegWriter::write_packet(AVPacket* pkt)
+{
+    // A closed GOP starts at the key packet: everything after it in decode
+    // order displays after it too, so this is where the new file begins.
+    if (rotate_pending_ && next_ctx_ && (pkt->flags & AV_PKT_FLAG_KEY))
+        switch_segment(pkt->pts);
+
+    if (segment_start_pts_) {
+        if (pkt->pts != AV_NOPTS_VALUE) pkt->pts -= segment_start_pts_;
+        if (pkt->dts != AV_NOPTS_VALUE) pkt->dts -= segment_start_pts_;
+    }
+    av_packet_rescale_ts(pkt, codec_ctx_->time_base, stream_->time_base);
+    pkt->stream_index = stream_->index;
+    av_interleaved_write_frame(fmt_ctx_, pkt);
+}
+
+bool FfmpegWriter::write_frame(const uint8_t* rgb_data, int stride_bytes, int64_t pts_ns,
+                               int64_t frame_number)
 {
     std::lock_guard<std::mutex> lock(mtx_);
     if (!fmt_ctx_ || !codec_ctx_) return false;
 
+    auto& stats = StageLatency::global();
+    auto& trace = FrameTracer::global();
+    const bool tracing = trace.enabled();
+    const uint64_t frame = static_cast<uint64_t>(frame_index_);
+    const uint64_t t0 = now_ns();
+
     const uint8_t* src_slices[1] = { rgb_data };
     int src_stride[1] = { stride_bytes };
+    BayerPattern pattern = BayerPattern::GBRG;
+    const bool bayer = bayer_pattern_of(input_fmt_, pattern);
+    int r = 256, b = 256;
+    if (wb_ && bayer) wb_->get(r, b);
+    if (is_16bit(input_fmt_)) {
+        // One pass shifts 10/12-bit samples to full scale and applies the gains.
+        const int bits = input_bits_ > 0 ? std::min(input_bits_, 16) : 16;
+        if (bits < 16 || r != 256 || b != 256) {
+            wb_buf_.resize(static_cast<size_t>(width_) * static_cast<size_t>(height_) * 2);
+            bayer_white_balance(reinterpret_cast<const uint16_t*>(rgb_data), width_, height_, stride_bytes,
+                                pattern, r, b, bits, reinterpret_cast<uint16_t*>(wb_buf_.data()), width_ * 2);
+            src_slices[0] = wb_buf_.data();
+            src_stride[0] = width_ * 2;
+        }
+    } else if (r != 256 || b != 256) {
+        wb_buf_.resize(static_cast<size_t>(width_) * static_cast<size_t>(height_));
+        bayer_white_balance(rgb_data, width_, height_, stride_bytes, pattern, r, b, wb_buf_.data(), width_);
+        src_slices[0] = wb_buf_.data();
+        src_stride[0] = width_;
+    }
     sws_scale(sws_ctx_, src_slices, src_stride, 0, height_,
               frame_yuv_->data, frame_yuv_->linesize);
+    if (overlay_) {
+        TextOverlay::Chroma chroma;
+        if (enc_fmt_ == AV_PIX_FMT_YUV420P) {
+            chroma.u = frame_yuv_->data[1];
+            chroma.v = frame_yuv_->data[2];
+            chroma.u_stride = frame_yuv_->linesize[1];
+            chroma.v_stride = frame_yuv_->linesize[2];
+        }
+        overlay_->stamp(frame_yuv_->data[0], frame_yuv_->linesize[0], width_, height_,
+                        static_cast<uint64_t>(frame_number >= 0 ? frame_number : frame_index_),
+                        static_cast<uint64_t>(pts_ns), chroma.u ? &chroma : nullptr);
+    }
+
+    const uint64_t t1 = now_ns();
+    stats.record(Stage::Debayer, t1 - t0);
+    if (tracing) trace.add(Stage::Debayer, frame, t0, t1);
 
     frame_yuv_->pts = frame_index_++;
+    // Past the segment limit: ask for one keyframe to switch on, once the next
+    // file is actually there. Until then the current segment keeps growing.
+    frame_yuv_->pict_type = AV_PICTURE_TYPE_NONE;
+    if (segmenting()) {
+        poll_next();
+        if (!rotate_pending_ && segment_full()) rotate_pending_ = true;
+        if (rotate_pending_ && next_ctx_ && !key_forced_) {
+            key_forced_ = true;
+            frame_yuv_->pict_type = AV_PICTURE_TYPE_I;
+        }
+    }
 
     if (avcodec_send_frame(codec_ctx_, frame_yuv_) < 0) return false;
 
+    // Muxer time is split out so Encode is the codec alone.
+    uint64_t write_ns = 0;
     while (avcodec_receive_packet(codec_ctx_, pkt_) == 0) {
-        av_packet_rescale_ts(pkt_, codec_ctx_->time_base, stream_->time_base);
-        pkt_->stream_index = stream_->index;
-        av_interleaved_write_frame(fmt_ctx_, pkt_);
+        const uint64_t w0 = now_ns();
+        write_packet(pkt_);
+        const uint64_t w1 = now_ns();
+        write_ns += w1 - w0;
+        if (tracing) trace.add(Stage::Write, frame, w0, w1);
         av_packet_unref(pkt_);
     }
+    const uint64_t t2 = now_ns();
+    stats.record(Stage::Encode, t2 - t1 - write_ns);
+    if (tracing) trace.add(Stage::Encode, frame, t1, t2);   // write spans nest inside
+    if (write_ns) stats.record(Stage::Write, write_ns);
     return true;
 }
 
+void FfmpegWriter::skip_frames(int n)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    frame_index_ += n;
+}
+
+void FfmpegWriter::scale_bitrate(double factor)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!codec_ctx_) return;
+    codec_ctx_->bit_rate = static_cast<int64_t>(base_bit_rate_ * factor);
+}
+
+void FfmpegWriter::set_metadata(const std::string& key, const std::string& value)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (fmt_ctx_) av_dict_set(&fmt_ctx_->metadata, key.c_str(), value.c_str(), 0);
+}
+
 void FfmpegWriter::close()
 {
     std::lock_guard<std::mutex> lock(mtx_);
@@ -103,22 +371,26 @@ void FfmpegWriter::close()
 
     avcodec_send_frame(codec_ctx_, nullptr);
     while (avcodec_receive_packet(codec_ctx_, pkt_) == 0) {
-        av_packet_rescale_ts(pkt_, codec_ctx_->time_base, stream_->time_base);
-        pkt_->stream_index = stream_->index;
-        av_interleaved_write_frame(fmt_ctx_, pkt_);
+        write_packet(pkt_);
         av_packet_unref(pkt_);
     }
 
-    av_write_trailer(fmt_ctx_);
-
-    if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE))
-        avio_closep(&fmt_ctx_->pb);
+    finish_muxer(fmt_ctx_);
+    for (auto& f : finishing_) f.wait();
+    finishing_.clear();
+    // The segment prepared for next is still empty: drop it.
+    if (!next_ctx_ && next_.valid()) next_ctx_ = next_.get();
+    if (next_ctx_) {
+        finish_muxer(next_ctx_);
+        std::remove(next_name_.c_str());
+        next_ctx_ = nullptr;
+    }
 
     av_frame_free(&frame_yuv_);
     av_packet_free(&pkt_);
     sws_freeContext(sws_ctx_);
     avcodec_free_context(&codec_ctx_);
-    avformat_free_context(fmt_ctx_);
+    avcodec_parameters_free(&params_);
 
     fmt_ctx_ = nullptr;
     codec_ctx_ = nullptr;
@@ -0,0 +1,232 @@
+#include "cambuffer_recorder_ng/FrameBroker.hpp"
+#include "cambuffer_recorder_ng/Decimate.hpp"
+#include "cambuffer_recorder_ng/FrameTrace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace cambuffer_recorder_ng {
+
+static uint64_t now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// ---------------- FrameQueue ----------------
+void FrameQueue::push(FramePtr frame, uint64_t now)
+{
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (policy_ == DropPolicy::Block) {
+            cv_.wait(lock, [&]{ return q_.size() < capacity_ || closed_; });
+        } else if (q_.size() >= capacity_) {
+            q_.pop_front();
+            dropped_++;
+        }
+        if (closed_) { dropped_++; return; }
+        q_.push_back({std::move(frame), now});
+    }
+    cv_.notify_all();
+}
+
+uint32_t FrameQueue::next_trace_id()
+{
+    static std::atomic<uint32_t> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool FrameQueue::pop(FramePtr& out, int timeout_ms)
+{
+    Entry e;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                          [&]{ return !q_.empty() || closed_; }))
+            return false;
+        if (q_.empty()) return false;     // closed and drained
+        e = std::move(q_.front());
+        q_.pop_front();
+    }
+    cv_.notify_all();
+
+    // Dwell is only meaningful for lossless consumers; Latest queues overwrite.
+    if (policy_ == DropPolicy::Block)
+        stage_done(Stage::QueueDwell, e.frame->seq, e.enqueued_ns, now_ns(), trace_id_);
+    delivered_++;
+    out = std::move(e.frame);
+    return true;
+}
+
+size_t FrameQueue::depth() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return q_.size();
+}
+
+bool FrameQueue::closed() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return closed_;
+}
+
+void FrameQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
+
+void FrameQueue::reopen()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    closed_ = false;
+    q_.clear();
+}
+
+// ---------------- FrameBroker ----------------
+std::shared_ptr<FrameQueue> FrameBroker::add_consumer(const std::string& name, DropPolicy policy,
+                                                      size_t capacity)
+{
+    auto q = std::make_shared<FrameQueue>(name, policy, capacity);
+    std::lock_guard<std::mutex> lock(consumers_mtx_);
+    consumers_.push_back(q);
+    return q;
+}
+
+std::vector<std::shared_ptr<FrameQueue>> FrameBroker::consumers() const
+{
+    std::lock_guard<std::mutex> lock(consumers_mtx_);
+    return consumers_;
+}
+
+bool FrameBroker::downsampled_size(PixelFormat format, int factor, int& width, int& height)
+{
+    if (factor == 1) return true;
+    if (factor != 2) return false;
+    // Bayer halves in whole CFA periods, as bayer_decimate_2x2_gain does.
+    const int u = to_8bit(format) == PixelFormat::Bayer8 ? 2 : 1;
+    width = width / (2 * u) * u;
+    height = height / (2 * u) * u;
+    return true;
+}
+
+bool FrameBroker::start(std::shared_ptr<ICamera> camera, int width, int height, const Options& opt)
+{
+    if (running_ || !camera) return false;
+    format_ = camera->pixel_format();
+    in_width_ = width_ = width;
+    in_height_ = height_ = height;
+    if (!downsampled_size(format_, opt.downsample, width_, height_)) {
+        std::cerr << "FrameBroker: host downsampling by " << opt.downsample << " is not supported\n";
+        return false;
+    }
+    camera_ = std::move(camera);
+    opt_ = opt;
+    pattern_ = camera_->bayer_pattern();
+    bit_depth_ = camera_->bit_depth();
+    row_bytes_ = static_cast<size_t>(width_) * bytes_per_pixel(format_);
+
+    // A fresh pool per run: frames still held from a previous run keep the old one alive.
+    pool_ = std::make_shared<BufferPool>(row_bytes_ * height_, std::max<size_t>(opt_.pool_frames, 2));
+    captured_ = 0;
+    for (auto& q : consumers()) q->reopen();
+
+    running_ = true;
+    capture_ = std::thread(&FrameBroker::capture_loop, this);
+    return true;
+}
+
+void FrameBroker::stop()
+{
+    running_ = false;
+    // Closing first releases a capture thread blocked on a full lossless queue.
+    for (auto& q : consumers()) q->close();
+    if (capture_.joinable()) capture_.join();
+}
+
+// Host 2x2 in place of the copy. The 8-bit binning kernels write packed rows,
+// which is the slot layout whenever the camera delivers the size start() got.
+void FrameBroker::copy_downsampled(const uint8_t* data, int w, int h, int stride, uint8_t* slot) const
+{
+    const int period = to_8bit(format_) == PixelFormat::Bayer8 ? 2 : 1;
+    if (opt_.downsample_mode == Downsampling::Skipping) {
+        skip_2x2(data, w, h, stride, bytes_per_pixel(format_), period, slot, static_cast<int>(row_bytes_));
+    } else if (is_16bit(format_)) {
+        bin_2x2_16(reinterpret_cast<const uint16_t*>(data), w, h, stride, period,
+                   reinterpret_cast<uint16_t*>(slot), static_cast<int>(row_bytes_));
+    } else if (format_ == PixelFormat::Bayer8) {
+        int ow = 0, oh = 0;
+        bayer_decimate_2x2_gain(data, w, h, stride, 1.0, slot, ow, oh);
+    } else {
+        decimate_2x2_gain(data, w, h, stride, bytes_per_pixel(format_), 1.0, slot);
+    }
+}
+
+void FrameBroker::capture_loop()
+{
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Capture, opt_.capture_policy, "cap " + opt_.name, &why))
+        std::cerr << "FrameBroker: capture thread policy: " << why << "\n";
+    FrameTracer::global().name_thread("capture " + opt_.name);
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    uint64_t ts = 0;
+    int w = 0, h = 0, stride = 0;
+    uint64_t seq = 0;
+
+    while (running_) {
+        const uint64_t t0 = now_ns();
+        bool ok = false;
+        try {
+            ok = camera_->grab(data, size, ts, w, h, stride, opt_.grab_timeout_ms);
+        } catch (const std::exception& e) {
+            std::cerr << "FrameBroker: grab failed: " << e.what() << "\n";
+        }
+        if (!ok) continue;
+        stage_done(Stage::GrabWait, seq, t0, now_ns());
+
+        // Blocks while every slot is held downstream; the camera queue absorbs the rest.
+        uint8_t* slot = nullptr;
+        while (running_ && !(slot = pool_->acquire_for(opt_.grab_timeout_ms))) {}
+        if (!slot) break;
+
+        const uint64_t t1 = now_ns();
+        if (opt_.downsample > 1)
+            copy_downsampled(data, std::min(w, in_width_), std::min(h, in_height_), stride, slot);
+        else {
+            const int rows = std::min(h, height_);
+            const size_t row_bytes = std::min(static_cast<size_t>(w) * bytes_per_pixel(format_), row_bytes_);
+            for (int y = 0; y < rows; ++y)
+                std::memcpy(slot + static_cast<size_t>(y) * row_bytes_,
+                            data + static_cast<size_t>(y) * stride, row_bytes);
+        }
+        const uint64_t t2 = now_ns();
+        stage_done(Stage::Copy, seq, t1, t2);
+
+        auto pool = pool_;
+        auto* f = new Frame;
+        f->data = slot;
+        f->bytes = row_bytes_ * height_;
+        f->width = width_;
+        f->height = height_;
+        f->stride = static_cast<int>(row_bytes_);
+        f->format = format_;
+        f->pattern = pattern_;
+        f->bit_depth = bit_depth_;
+        f->ts_ns = ts;
+        f->frame_number = camera_->frame_number();
+        f->seq = seq++;
+        FramePtr frame(f, [pool, slot](const Frame* p) { pool->release(slot); delete p; });
+
+        if (on_frame_) on_frame_(*frame);
+        for (auto& q : consumers()) q->push(frame, t2);
+        captured_++;
+    }
+}
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,164 @@
+#include "cambuffer_recorder_ng/FrameSynchronizer.hpp"
+#include <algorithm>
+
+namespace cambuffer_recorder_ng {
+
+void FrameSynchronizer::reset(size_t n_cameras, int64_t max_skew_ns, size_t window)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    n_ = n_cameras;
+    max_skew_ns_ = max_skew_ns;
+    window_ = std::max<size_t>(window, 1);
+    have_base_.assign(n_, false);
+    base_.assign(n_, 0);
+    early_.assign(n_, Early{});
+    have_last_.assign(n_, false);
+    last_key_.assign(n_, 0);
+    pending_.clear();
+    key_ts_.clear();
+    newest_key_ = 0;
+    next_anchor_key_ = 0;
+    over_skew_ = 0;
+    stats_ = Stats{};
+    stats_.cameras.resize(n_);
+}
+
+// Called with mtx_ held. Finds the key offset for a camera that has none.
+bool FrameSynchronizer::align(size_t camera, uint64_t frame_number, uint64_t ts_ns)
+{
+    const bool anchored = std::find(have_base_.begin(), have_base_.end(), true) != have_base_.end();
+    uint64_t key = next_anchor_key_;
+    if (anchored) {
+        // The recent key closest in time; it has to be within max_skew.
+        auto best = key_ts_.end();
+        uint64_t best_d = UINT64_MAX;
+        for (auto it = key_ts_.begin(); it != key_ts_.end(); ++it) {
+            const uint64_t d = it->second > ts_ns ? it->second - ts_ns : ts_ns - it->second;
+            if (d < best_d) { best_d = d; best = it; }
+        }
+        if (best == key_ts_.end() || (max_skew_ns_ > 0 && best_d > static_cast<uint64_t>(max_skew_ns_))) {
+            // Its partner frame is not in yet, or this one is from before the others.
+            early_[camera] = {true, frame_number, ts_ns};
+            return false;
+        }
+        key = best->first;
+    }
+    have_base_[camera] = true;
+    early_[camera].have = false;
+    base_[camera] = static_cast<int64_t>(frame_number) - static_cast<int64_t>(key);
+    return true;
+}
+
+// Called with mtx_ held when `key` is first seen. A camera that reports ahead
+// of the others every time never finds its partner key in align(); its held
+// back frame is lined up here instead and joins the set.
+void FrameSynchronizer::adopt_early(uint64_t key, uint64_t ts_ns, Pending& p)
+{
+    for (size_t c = 0; c < n_; ++c) {
+        Early& e = early_[c];
+        if (have_base_[c] || !e.have) continue;
+        const uint64_t d = e.ts > ts_ns ? e.ts - ts_ns : ts_ns - e.ts;
+        if (max_skew_ns_ > 0 && d > static_cast<uint64_t>(max_skew_ns_)) continue;
+        e.have = false;
+        have_base_[c] = true;
+        base_[c] = static_cast<int64_t>(e.frame_number) - static_cast<int64_t>(key);
+        have_last_[c] = true;
+        last_key_[c] = key;
+        stats_.cameras[c].unaligned--;   // counted when it was held back
+        if (!p.have[c]) p.count++;
+        p.have[c] = true;
+        p.ts[c] = e.ts;
+    }
+}
+
+// Called with mtx_ held. Forgets every offset; the next frames line up afresh.
+void FrameSynchronizer::resync()
+{
+    stats_.incomplete_sets += pending_.size();
+    stats_.resyncs++;
+    next_anchor_key_ = newest_key_ + 1;
+    have_base_.assign(n_, false);
+    early_.assign(n_, Early{});
+    have_last_.assign(n_, false);
+    pending_.clear();
+    key_ts_.clear();
+    over_skew_ = 0;
+}
+
+void FrameSynchronizer::observe(size_t camera, uint64_t frame_number, uint64_t ts_ns)
+{
+    std::vector<uint64_t> complete_ts;
+    uint64_t complete_key = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (camera >= n_) return;
+
+        auto& cs = stats_.cameras[camera];
+        cs.frames++;
+
+        if (!have_base_[camera] && !align(camera, frame_number, ts_ns)) {
+            cs.unaligned++;
+            return;
+        }
+        const int64_t k = static_cast<int64_t>(frame_number) - base_[camera];
+        if (k < 0) return;   // counter reset; ignore stragglers
+        const uint64_t key = static_cast<uint64_t>(k);
+
+        if (have_last_[camera]) {
+            if (key <= last_key_[camera]) return;    // duplicate / reordered
+            cs.dropped += key - last_key_[camera] - 1;
+        }
+        have_last_[camera] = true;
+        last_key_[camera] = key;
+        newest_key_ = std::max(newest_key_, key);
+        const bool new_key = key_ts_.emplace(key, ts_ns).second;
+
+        if (n_ == 1) {
+            stats_.matched_sets++;
+            complete_key = key;
+            complete_ts.assign(1, ts_ns);
+        } else {
+            auto& p = pending_[key];
+            if (p.ts.empty()) {
+                p.ts.assign(n_, 0);
+                p.have.assign(n_, false);
+            }
+            if (!p.have[camera]) p.count++;
+            p.have[camera] = true;
+            p.ts[camera] = ts_ns;
+            if (new_key) adopt_early(key, ts_ns, p);
+
+            if (p.count == n_) {
+                const auto [lo, hi] = std::minmax_element(p.ts.begin(), p.ts.end());
+                const bool over = static_cast<int64_t>(*hi - *lo) > max_skew_ns_;
+                if (over) stats_.skew_violations++;
+                over_skew_ = over ? over_skew_ + 1 : 0;
+                for (size_t i = 0; i < n_; ++i)
+                    stats_.cameras[i].last_skew_ns = static_cast<int64_t>(p.ts[i] - *lo);
+                stats_.matched_sets++;
+                complete_key = key;
+                complete_ts = std::move(p.ts);
+                pending_.erase(key);
+                if (over_skew_ >= kResyncAfter) resync();
+            }
+        }
+
+        // Anything older than the window will never complete.
+        while (!pending_.empty() && pending_.begin()->first + window_ < newest_key_) {
+            pending_.erase(pending_.begin());
+            stats_.incomplete_sets++;
+        }
+        while (!key_ts_.empty() && key_ts_.begin()->first + window_ < newest_key_)
+            key_ts_.erase(key_ts_.begin());
+    }
+
+    if (!complete_ts.empty() && callback_) callback_(complete_key, complete_ts);
+}
+
+FrameSynchronizer::Stats FrameSynchronizer::stats() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stats_;
+}
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,118 @@
+#include "cambuffer_recorder_ng/FrameTrace.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace cambuffer_recorder_ng {
+
+// Thread names carry file paths, which may hold quotes, backslashes or control bytes.
+static std::string json_escape(const std::string& s)
+{
+    std::string out;
+    out.reserve(s.size());
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out;
+}
+
+FrameTracer& FrameTracer::global()
+{
+    static FrameTracer instance;
+    return instance;
+}
+
+void FrameTracer::enable(size_t ring_events)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ring_events_ = std::max<size_t>(ring_events, 16);
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+FrameTracer::Ring& FrameTracer::local()
+{
+    thread_local Ring* ring = nullptr;
+    thread_local uint64_t epoch = ~0ull;
+    if (ring && epoch == epoch_.load(std::memory_order_relaxed)) return *ring;
+
+    // First event of this thread (or first since clear()): register a ring.
+    std::lock_guard<std::mutex> lock(mtx_);
+    rings_.emplace_back();
+    ring = &rings_.back();
+    ring->events.resize(ring_events_);    // preallocate; add() never allocates
+    ring->tid = static_cast<int>(rings_.size());
+    epoch = epoch_.load(std::memory_order_relaxed);
+    return *ring;
+}
+
+void FrameTracer::name_thread(const std::string& name)
+{
+    if (!enabled()) return;
+    Ring& r = local();
+    std::lock_guard<std::mutex> lock(mtx_);
+    r.name = name;
+}
+
+void FrameTracer::clear()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    rings_.clear();
+    epoch_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool FrameTracer::write_json(const std::string& path) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) { perror(("FrameTracer: fopen " + path).c_str()); return false; }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    auto sep = [&]() { if (!first) fputs(",\n", fp); first = false; };
+
+    for (const Ring& r : rings_) {
+        sep();
+        fprintf(fp, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,"
+                    "\"args\":{\"name\":\"%s\"}}",
+                r.tid, r.name.empty() ? ("thread " + std::to_string(r.tid)).c_str()
+                                      : json_escape(r.name).c_str());
+
+        const uint64_t n = std::min<uint64_t>(r.head, r.events.size());
+        for (uint64_t i = r.head - n; i < r.head; ++i) {
+            const Event& e = r.events[i % r.events.size()];
+            const char* name = stage_name(e.stage);
+            sep();
+            if (e.stage == Stage::QueueDwell) {
+                // Spans two threads and overlaps other stages: async begin/end pair.
+                // Every camera counts seq from 0, so the id names the queue too.
+                fprintf(fp, "{\"ph\":\"b\",\"cat\":\"queue\",\"name\":\"%s\",\"id\":\"q%u.%llu\","
+                            "\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"frame\":%llu}},\n",
+                        name, e.track, (unsigned long long)e.frame, r.tid, e.begin_ns / 1e3,
+                        (unsigned long long)e.frame);
+                fprintf(fp, "{\"ph\":\"e\",\"cat\":\"queue\",\"name\":\"%s\",\"id\":\"q%u.%llu\","
+                            "\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                        name, e.track, (unsigned long long)e.frame, r.tid, e.end_ns / 1e3);
+            } else {
+                fprintf(fp, "{\"ph\":\"X\",\"cat\":\"stage\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,"
+                            "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+                        name, r.tid, e.begin_ns / 1e3, (e.end_ns - e.begin_ns) / 1e3,
+                        (unsigned long long)e.frame);
+            }
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
+
+} // namespace cambuffer_recorder_ng
@@ -93,6 +93,7 @@ bool GenTLCamera::grab(uint8_t*& data, size_t& size, uint64_t& ts,
     //  0x0001: BASE pointer
     //  0x0002: SIZE
     //  0x0005: TIMESTAMP (ns)
+    //  0x000B: FRAMEID
     //  0x0011: WIDTH
     //  0x0012: HEIGHT
     //  0x0013: LINE_SIZE (stride)
@@ -105,6 +106,10 @@ bool GenTLCamera::grab(uint8_t*& data, size_t& size, uint64_t& ts,
     DSGetBufferInfo(hDS_, hBuf, 0x0005, &ts_ns, &ts_sz);
     ts = ts_ns;
 
+    uint64_t fid = 0; size_t fid_sz = sizeof(fid);
+    if (DSGetBufferInfo(hDS_, hBuf, 0x000B, &fid, &fid_sz) == GC_ERR_SUCCESS)
+        frame_id_ = fid;
+
     uint64_t w64=0, h64=0, ls64=0; size_t n8=sizeof(uint64_t);
     DSGetBufferInfo(hDS_, hBuf, 0x0011, &w64, &n8);
     DSGetBufferInfo(hDS_, hBuf, 0x0012, &h64, &n8);
@@ -0,0 +1,79 @@
+#include "cambuffer_recorder_ng/JpegEncoder.hpp"
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <jpeglib.h>
+
+namespace cambuffer_recorder_ng {
+
+struct JpegEncoder::Impl {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    jmp_buf jump;
+    // jpeg_mem_dest's output lives here rather than in encode()'s locals: a
+    // local changed between setjmp and longjmp is indeterminate afterwards.
+    unsigned char* buf = nullptr;
+    unsigned long size = 0;
+};
+
+static void on_jpeg_error(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, msg);
+    std::cerr << "JpegEncoder: " << msg << "\n";
+    longjmp(*static_cast<jmp_buf*>(cinfo->client_data), 1);
+}
+
+JpegEncoder::JpegEncoder() : impl_(new Impl)
+{
+    impl_->cinfo.err = jpeg_std_error(&impl_->jerr);
+    impl_->jerr.error_exit = on_jpeg_error;
+    impl_->cinfo.client_data = &impl_->jump;
+    jpeg_create_compress(&impl_->cinfo);
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    jpeg_destroy_compress(&impl_->cinfo);
+    delete impl_;
+}
+
+bool JpegEncoder::encode(const uint8_t* pixels, int width, int height, int components,
+                         int quality, std::vector<uint8_t>& out)
+{
+    jpeg_compress_struct& c = impl_->cinfo;
+    impl_->buf = nullptr;
+    impl_->size = 0;
+
+    if (setjmp(impl_->jump)) {
+        jpeg_abort_compress(&c);
+        free(impl_->buf);
+        impl_->buf = nullptr;
+        return false;
+    }
+
+    jpeg_mem_dest(&c, &impl_->buf, &impl_->size);
+    c.image_width = static_cast<JDIMENSION>(width);
+    c.image_height = static_cast<JDIMENSION>(height);
+    c.input_components = components;
+    c.in_color_space = components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&c);
+    jpeg_set_quality(&c, quality, TRUE);
+    c.dct_method = JDCT_IFAST;
+
+    jpeg_start_compress(&c, TRUE);
+    const size_t row_bytes = static_cast<size_t>(width) * components;
+    while (c.next_scanline < c.image_height) {
+        JSAMPROW row = const_cast<JSAMPROW>(pixels + c.next_scanline * row_bytes);
+        jpeg_write_scanlines(&c, &row, 1);
+    }
+    jpeg_finish_compress(&c);
+
+    out.assign(impl_->buf, impl_->buf + impl_->size);
+    free(impl_->buf);
+    impl_->buf = nullptr;
+    return true;
+}
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,168 @@
+#include "cambuffer_recorder_ng/LatencyStats.hpp"
+#include <cstdio>
+
+namespace cambuffer_recorder_ng {
+
+const char* stage_name(Stage s)
+{
+    switch (s) {
+        case Stage::GrabWait:   return "grab_wait";
+        case Stage::Copy:       return "copy";
+        case Stage::Debayer:    return "debayer";
+        case Stage::Compress:   return "compress";
+        case Stage::Encode:     return "encode";
+        case Stage::Write:      return "write";
+        case Stage::QueueDwell: return "queue_dwell";
+        case Stage::Count:      break;
+    }
+    return "?";
+}
+
+// ---------------- LatencyHistogram ----------------
+size_t LatencyHistogram::index(uint64_t ns)
+{
+    if (ns < static_cast<uint64_t>(kSub)) return static_cast<size_t>(ns);
+    int e = 63 - __builtin_clzll(ns);
+    if (e > kMaxExp) return kBuckets - 1;
+    const int shift = e - kSubBits;
+    return static_cast<size_t>((shift + 1) * kSub + ((ns >> shift) - kSub));
+}
+
+uint64_t LatencyHistogram::bucket_upper(size_t idx)
+{
+    if (idx < static_cast<size_t>(kSub)) return idx;
+    const int shift = static_cast<int>(idx / kSub) - 1;
+    const uint64_t sub = idx % kSub + kSub;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+}
+
+// ---------------- StageLatency ----------------
+StageLatency& StageLatency::global()
+{
+    static StageLatency instance;
+    return instance;
+}
+
+StageLatency::Shard& StageLatency::local()
+{
+    // Hands the shard back when the thread exits.
+    struct Lease {
+        StageLatency* owner = nullptr;
+        Shard* shard = nullptr;
+        ~Lease() { if (owner) owner->release(shard); }
+    };
+    thread_local Lease lease;
+    if (!lease.shard) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!free_.empty()) {
+            lease.shard = free_.back();
+            free_.pop_back();
+        } else {
+            lease.shard = &shards_.emplace_back();
+        }
+        lease.owner = this;
+    }
+    return *lease.shard;
+}
+
+void StageLatency::release(Shard* shard)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    free_.push_back(shard);
+}
+
+void StageLatency::record(Stage s, uint64_t ns)
+{
+    local().h[static_cast<size_t>(s)].record(ns);
+}
+
+std::array<uint64_t, LatencyHistogram::kBuckets>
+StageLatency::merged(Stage s, uint64_t& max, uint64_t& sum) const
+{
+    std::array<uint64_t, LatencyHistogram::kBuckets> counts{};
+    max = sum = 0;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto& sh : shards_) {
+        const auto& h = sh.h[static_cast<size_t>(s)];
+        for (size_t i = 0; i < counts.size(); ++i) counts[i] += h.count_at(i);
+        max = std::max(max, h.max());
+        sum += h.sum();
+    }
+    return counts;
+}
+
+std::array<StageLatency::Summary, kStageCount> StageLatency::summarize() const
+{
+    std::array<Summary, kStageCount> out{};
+    for (size_t s = 0; s < kStageCount; ++s) {
+        uint64_t max = 0, sum = 0;
+        const auto counts = merged(static_cast<Stage>(s), max, sum);
+
+        Summary& r = out[s];
+        for (uint64_t c : counts) r.count += c;
+        if (r.count == 0) continue;
+        r.mean_ns = static_cast<double>(sum) / r.count;
+        r.max_ns = max;
+
+        // Walk the CDF once, picking off each quantile as it is crossed.
+        const uint64_t q50 = (r.count * 500 + 999) / 1000;
+        const uint64_t q99 = (r.count * 990 + 999) / 1000;
+        const uint64_t q999 = (r.count * 999 + 999) / 1000;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (!counts[i]) continue;
+            const uint64_t before = seen;
+            seen += counts[i];
+            const uint64_t v = std::min(LatencyHistogram::bucket_upper(i), max);
+            if (before < q50 && seen >= q50) r.p50_ns = v;
+            if (before < q99 && seen >= q99) r.p99_ns = v;
+            if (before < q999 && seen >= q999) { r.p999_ns = v; break; }
+        }
+    }
+    return out;
+}
+
+void StageLatency::reset()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto& sh : shards_)
+        for (auto& h : sh.h) h.reset();
+}
+
+bool StageLatency::dump(const std::string& path) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) { perror(("StageLatency: fopen " + path).c_str()); return false; }
+
+    const auto sum = summarize();
+    fprintf(fp, "stage,count,mean_us,p50_us,p99_us,p999_us,max_us\n");
+    for (size_t s = 0; s < kStageCount; ++s) {
+        const auto& r = sum[s];
+        if (!r.count) continue;
+        fprintf(fp, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f\n", stage_name(static_cast<Stage>(s)),
+                (unsigned long long)r.count, r.mean_ns / 1e3, r.p50_ns / 1e3,
+                r.p99_ns / 1e3, r.p999_ns / 1e3, r.max_ns / 1e3);
+    }
+
+    fprintf(fp, "\nstage,bucket_upper_ns,count\n");
+    for (size_t s = 0; s < kStageCount; ++s) {
+        uint64_t max = 0, total = 0;
+        const auto counts = merged(static_cast<Stage>(s), max, total);
+        for (size_t i = 0; i < counts.size(); ++i)
+            if (counts[i])
+                fprintf(fp, "%s,%llu,%llu\n", stage_name(static_cast<Stage>(s)),
+                        (unsigned long long)LatencyHistogram::bucket_upper(i),
+                        (unsigned long long)counts[i]);
+    }
+    fclose(fp);
+    return true;
+}
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,305 @@
+#include "cambuffer_recorder_ng/MotionDetector.hpp"
+#include "cambuffer_recorder_ng/RawPack.hpp"
+#include "cambuffer_recorder_ng/Thumbnail.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+constexpr int kFrac = 7;   // background fraction bits: value << 7 stays inside int16
+
+// Sum of |a - b| over the pixels where mask is 255.
+uint32_t masked_sad(const uint8_t* a, const uint8_t* b, const uint8_t* mask, int n)
+{
+    uint32_t sum = 0;
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        const __m128i vm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i));
+        const __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_and_si128(d, vm), zero));
+    }
+    sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc)) +
+          static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+    for (; i < n; ++i)
+        if (mask[i]) sum += static_cast<uint32_t>(std::abs(a[i] - b[i]));
+    return sum;
+}
+
+// bg16 += ((v << 7) - bg16) >> shift; bg8 = bg16 rounded back to 8 bits.
+void update_background(const uint8_t* v, int16_t* bg16, uint8_t* bg8, int n, int shift)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(1 << (kFrac - 1));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    auto step = [&](__m128i cur, int16_t* b) {
+        __m128i bg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        bg = _mm_add_epi16(bg, _mm_sra_epi16(_mm_sub_epi16(_mm_slli_epi16(cur, kFrac), bg), sh));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(b), bg);
+        return _mm_srli_epi16(_mm_add_epi16(bg, half), kFrac);
+    };
+    for (; i + 16 <= n; i += 16) {
+        const __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        const __m128i lo = step(_mm_unpacklo_epi8(cur, zero), bg16 + i);
+        const __m128i hi = step(_mm_unpackhi_epi8(cur, zero), bg16 + i + 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bg8 + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        bg16[i] = static_cast<int16_t>(bg16[i] + (((v[i] << kFrac) - bg16[i]) >> shift));
+        bg8[i] = static_cast<uint8_t>((bg16[i] + (1 << (kFrac - 1))) >> kFrac);
+    }
+}
+
+// Binary PGM (P5, maxval < 256); comments allowed in the header.
+bool read_pgm(const std::string& path, std::vector<uint8_t>& data, int& w, int& h)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    auto token = [&in]() {
+        std::string t;
+        while (in >> t && t[0] == '#') in.ignore(1 << 20, '\n');
+        return t;
+    };
+    if (token() != "P5") return false;
+    try {
+        w = std::stoi(token());
+        h = std::stoi(token());
+        if (std::stoi(token()) > 255 || w <= 0 || h <= 0) return false;
+    } catch (const std::exception&) {
+        return false;
+    }
+    in.get();   // the single whitespace before the raster
+    data.resize(static_cast<size_t>(w) * h);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size())));
+}
+
+} // namespace
+
+std::string MotionDetector::Event::describe() const
+{
+    char buf[96];
+    snprintf(buf, sizeof(buf), "motion %s region %d energy %.1f frame %llu", start ? "start" : "end",
+             region, energy, static_cast<unsigned long long>(frame_number));
+    return buf;
+}
+
+bool MotionDetector::parse_region(const std::string& s, Region& out)
+{
+    std::istringstream in(s);
+    Region r;
+    if (!(in >> r.x >> r.y >> r.w >> r.h >> r.threshold)) return false;
+    if (r.w <= 0 || r.h <= 0 || r.threshold <= 0) return false;
+    out = r;
+    return true;
+}
+
+bool MotionDetector::configure(const Options& opt)
+{
+    opt_ = opt;
+    opt_.factor = std::max(2, opt_.factor & ~1);
+    opt_.bg_shift = std::clamp(opt_.bg_shift, 0, 8);
+    if (opt_.regions.empty()) opt_.regions.push_back(Region{});
+    file_mask_.clear();
+    file_mask_w_ = file_mask_h_ = 0;
+    if (!opt_.mask_path.empty() && !read_pgm(opt_.mask_path, file_mask_, file_mask_w_, file_mask_h_)) {
+        std::cerr << "MotionDetector: cannot read mask " << opt_.mask_path << " (binary PGM expected)\n";
+        return false;
+    }
+    gw_ = gh_ = 0;
+    seen_ = 0;
+    active_ = false;
+    last_motion_ns_ = 0;
+    last_region_ = -1;
+    std::lock_guard<std::mutex> lock(stats_mtx_);
+    stats_ = Stats{};
+    return true;
+}
+
+void MotionDetector::setup(int gw, int gh)
+{
+    gw_ = gw;
+    gh_ = gh;
+    const size_t n = static_cast<size_t>(gw) * gh;
+    bg8_.assign(n, 0);
+    bg16_.assign(n, 0);
+    mask_.assign(n, 255);
+    if (!file_mask_.empty())
+        for (int y = 0; y < gh; ++y)
+            for (int x = 0; x < gw; ++x) {
+                const int mx = x * file_mask_w_ / gw, my = y * file_mask_h_ / gh;
+                if (!file_mask_[static_cast<size_t>(my) * file_mask_w_ + mx])
+                    mask_[static_cast<size_t>(y) * gw + x] = 0;
+            }
+
+    rects_.clear();
+    for (const auto& r : opt_.regions) {
+        Rect q;
+        q.x0 = std::clamp(static_cast<int>(std::lround(r.x * gw)), 0, gw);
+        q.y0 = std::clamp(static_cast<int>(std::lround(r.y * gh)), 0, gh);
+        q.x1 = std::clamp(static_cast<int>(std::lround((r.x + r.w) * gw)), q.x0, gw);
+        q.y1 = std::clamp(static_cast<int>(std::lround((r.y + r.h) * gh)), q.y0, gh);
+        q.pixels = 0;
+        for (int y = q.y0; y < q.y1; ++y)
+            for (int x = q.x0; x < q.x1; ++x)
+                q.pixels += mask_[static_cast<size_t>(y) * gw + x] ? 1 : 0;
+        rects_.push_back(q);
+    }
+}
+
+bool MotionDetector::process(const Frame& f, Event& ev)
+{
+    if (is_16bit(f.format)) {
+        // The kernels here are RAW8: take the top 8 bits first.
+        narrow_.resize(static_cast<size_t>(f.width) * f.height);
+        narrow_to_8bit(reinterpret_cast<const uint16_t*>(f.data), f.width, f.height, f.stride, f.bit_depth,
+                       narrow_.data(), f.width);
+        Frame g = f;
+        g.data = narrow_.data();
+        g.bytes = narrow_.size();
+        g.stride = f.width;
+        g.format = to_8bit(f.format);
+        g.bit_depth = 8;
+        return process(g, ev);
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    const int k = opt_.factor;
+    int gw = f.width / k, gh = f.height / k;
+    plane_.resize(static_cast<size_t>(gw) * gh);
+    switch (f.format) {
+        case PixelFormat::Bayer8:
+        case PixelFormat::Mono8:
+        case PixelFormat::Mono16:       // narrowed above, never here
+        case PixelFormat::Bayer16:
+            // On a mono sensor the "green" sites are simply a checkerboard sample.
+            bayer_green_sparse(f.data, f.width, f.height, f.stride, k, f.pattern, plane_.data(), gw, gh);
+            break;
+        case PixelFormat::Rgb24:
+            // Only FakeCamera produces RGB; point-sample its green.
+            for (int y = 0; y < gh; ++y)
+                for (int x = 0; x < gw; ++x)
+                    plane_[static_cast<size_t>(y) * gw + x] = f.data[static_cast<size_t>(y * k) * f.stride + x * k * 3 + 1];
+            break;
+    }
+    if (gw <= 0 || gh <= 0) return false;
+
+    const size_t n = static_cast<size_t>(gw) * gh;
+    const bool first = gw != gw_ || gh != gh_;
+    if (first) setup(gw, gh);
+
+    std::vector<double> energy(rects_.size(), 0.0);
+    int strongest = -1;
+    double over = 0.0;   // energy / threshold of the strongest region
+    if (!first) {
+        for (size_t r = 0; r < rects_.size(); ++r) {
+            const Rect& q = rects_[r];
+            if (!q.pixels) continue;
+            uint64_t sum = 0;
+            for (int y = q.y0; y < q.y1; ++y) {
+                const size_t o = static_cast<size_t>(y) * gw + q.x0;
+                sum += masked_sad(&plane_[o], &bg8_[o], &mask_[o], q.x1 - q.x0);
+            }
+            energy[r] = static_cast<double>(sum) / q.pixels;
+            const double ratio = energy[r] / opt_.regions[r].threshold;
+            if (ratio > over) { over = ratio; strongest = static_cast<int>(r); }
+        }
+        update_background(plane_.data(), bg16_.data(), bg8_.data(), static_cast<int>(n), opt_.bg_shift);
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            bg16_[i] = static_cast<int16_t>(plane_[i] << kFrac);
+            bg8_[i] = plane_[i];
+        }
+    }
+    seen_++;
+
+    bool fired = false;
+    const bool moving = over > 1.0 && seen_ > static_cast<uint64_t>(std::max(1, opt_.warmup_frames));
+    if (moving) {
+        last_motion_ns_ = f.ts_ns;
+        last_region_ = strongest;
+        if (!active_) {
+            active_ = fired = true;
+            ev = Event{true, f.ts_ns, f.frame_number, strongest, energy[static_cast<size_t>(strongest)]};
+        }
+    } else if (active_ && f.ts_ns >= last_motion_ns_ + static_cast<uint64_t>(std::max(0, opt_.hold_ms)) * 1000000ull) {
+        active_ = false;
+        fired = true;
+        const double e = last_region_ >= 0 ? energy[static_cast<size_t>(last_region_)] : 0.0;
+        ev = Event{false, f.ts_ns, f.frame_number, last_region_, e};
+    }
+
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    std::lock_guard<std::mutex> lock(stats_mtx_);
+    stats_.processed++;
+    if (fired) stats_.events++;
+    stats_.active = active_;
+    stats_.last_us = us;
+    stats_.energy = std::move(energy);
+    return fired;
+}
+
+bool MotionDetector::start(std::shared_ptr<FrameQueue> source, const Options& opt, Sink sink)
+{
+    if (running_ || !source) return false;
+    if (!configure(opt)) return false;
+    source_ = std::move(source);
+    sink_ = std::move(sink);
+    running_ = true;
+    worker_ = std::thread(&MotionDetector::loop, this);
+    return true;
+}
+
+void MotionDetector::stop()
+{
+    running_ = false;
+    if (worker_.joinable()) worker_.join();
+}
+
+MotionDetector::Stats MotionDetector::stats() const
+{
+    std::lock_guard<std::mutex> lock(stats_mtx_);
+    return stats_;
+}
+
+void MotionDetector::loop()
+{
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Process, opt_.policy, opt_.name, &why))
+        std::cerr << "MotionDetector: thread policy: " << why << "\n";
+
+    uint64_t next_seq = 0;
+    while (running_) {
+        FramePtr f;
+        if (!source_->pop(f, 100)) {
+            if (source_->closed()) break;
+            continue;
+        }
+        if (opt_.every_n > 1) {
+            if (f->seq < next_seq) continue;
+            next_seq = f->seq - f->seq % opt_.every_n + opt_.every_n;
+        }
+        Event ev;
+        const bool fired = process(*f, ev);
+        f.reset();
+        if (fired && sink_) sink_(ev);
+    }
+}
+
+} // namespace cambuffer_recorder_ng
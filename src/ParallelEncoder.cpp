@@ -0,0 +1,330 @@
+#include "cambuffer_recorder_ng/ParallelEncoder.hpp"
+#include "cambuffer_recorder_ng/FrameTrace.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace cambuffer_recorder_ng {
+
+ParallelEncoder::Join ParallelEncoder::parse_join(const std::string& name)
+{
+    return name == "playlist" ? Join::Playlist : Join::Stitch;
+}
+
+std::string ParallelEncoder::segment_name(int64_t s) const
+{
+    // out.mp4 -> out_0003.mp4, as FfmpegWriter names its segments.
+    const auto dot = filename_.find_last_of('.');
+    const auto slash = filename_.find_last_of('/');
+    const bool has_ext = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    char idx[24];
+    snprintf(idx, sizeof(idx), "_%04lld", static_cast<long long>(s));
+    return has_ext ? filename_.substr(0, dot) + idx + filename_.substr(dot) : filename_ + idx;
+}
+
+bool ParallelEncoder::open(const std::string& filename, int width, int height, int fps,
+                           AVPixelFormat input_fmt, const Options& opt)
+{
+    close();
+    opt_ = opt;
+    opt_.encoders = std::max(1, opt_.encoders);
+    filename_ = filename;
+    width_ = width;
+    height_ = height;
+    fps_ = std::max(1, fps);
+    input_fmt_ = input_fmt;
+    seg_frames_ = std::max<int64_t>(1, static_cast<int64_t>(fps_) * std::max(1, opt_.segment_ms) / 1000);
+    if (opt_.lane_frames == 0) opt_.lane_frames = static_cast<size_t>(seg_frames_);
+
+    slot_ = 0;
+    cur_seg_ = -1;
+    bitrate_ = 1.0;
+    done_.clear();
+    next_join_ = 0;
+    last_seg_ = -1;
+    closing_ = false;
+    metadata_.clear();
+
+    if (opt_.join == Join::Stitch) {
+        if (!stitch_.open(filename_, fps_)) return false;
+    } else {
+        const auto dot = filename_.find_last_of('.');
+        const auto slash = filename_.find_last_of('/');
+        const bool has_ext = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        const std::string list = (has_ext ? filename_.substr(0, dot) : filename_) + ".ffconcat";
+        playlist_ = fopen(list.c_str(), "w");
+        if (!playlist_) { perror(("ParallelEncoder: fopen " + list).c_str()); return false; }
+        setvbuf(playlist_, nullptr, _IOLBF, 0);
+        fprintf(playlist_, "ffconcat version 1.0\n");
+    }
+
+    for (int k = 0; k < opt_.encoders; ++k) lanes_.push_back(std::make_unique<Lane>());
+    for (size_t k = 0; k < lanes_.size(); ++k)
+        lanes_[k]->thread = std::thread(&ParallelEncoder::lane_loop, this, std::ref(*lanes_[k]),
+                                        static_cast<int>(k));
+    joiner_ = std::thread(&ParallelEncoder::join_loop, this);
+    return true;
+}
+
+void ParallelEncoder::push(Item&& item)
+{
+    Lane& lane = *lanes_[static_cast<size_t>(item.segment % static_cast<int64_t>(lanes_.size()))];
+    std::unique_lock<std::mutex> lock(lane.mtx);
+    if (item.kind == Item::Frame) {
+        lane.cv.wait(lock, [&] { return lane.frames < opt_.lane_frames; });
+        lane.frames++;
+    }
+    lane.q.push_back(std::move(item));
+    lane.cv.notify_all();
+}
+
+void ParallelEncoder::begin_segment(int64_t s)
+{
+    cur_seg_ = s;
+    Item it;
+    it.kind = Item::Begin;
+    it.segment = s;
+    it.bitrate = bitrate_;
+    push(std::move(it));
+}
+
+void ParallelEncoder::end_segment()
+{
+    Item it;
+    it.kind = Item::End;
+    it.segment = cur_seg_;
+    push(std::move(it));
+}
+
+bool ParallelEncoder::write_frame(const uint8_t* data, int stride, int64_t pts_ns,
+                                  std::shared_ptr<const void> owner, int64_t frame_number)
+{
+    if (lanes_.empty()) return false;
+
+    // Segments the timeline skipped entirely still pass through, empty, to keep the order.
+    const int64_t s = slot_ / seg_frames_;
+    while (cur_seg_ < s) {
+        if (cur_seg_ >= 0) end_segment();
+        begin_segment(cur_seg_ + 1);
+    }
+
+    Item it;
+    it.kind = Item::Frame;
+    it.segment = s;
+    it.slot = slot_ - s * seg_frames_;
+    it.stride = stride;
+    it.pts_ns = pts_ns;
+    // The overlay should show the caller's number, not the slot within the segment.
+    it.frame_number = frame_number >= 0 ? frame_number : slot_;
+    if (owner) {
+        it.data = data;
+        it.owner = std::move(owner);
+    } else {
+        it.copy.assign(data, data + static_cast<size_t>(stride) * static_cast<size_t>(height_));
+        it.data = it.copy.data();
+    }
+    slot_++;
+    push(std::move(it));
+    return true;
+}
+
+void ParallelEncoder::skip_frames(int n)
+{
+    if (n > 0) slot_ += n;
+}
+
+void ParallelEncoder::scale_bitrate(double factor)
+{
+    bitrate_ = factor;
+}
+
+void ParallelEncoder::set_metadata(const std::string& key, const std::string& value)
+{
+    std::lock_guard<std::mutex> lock(join_mtx_);
+    metadata_.emplace_back(key, value);
+}
+
+void ParallelEncoder::lane_loop(Lane& lane, int k)
+{
+    // With enough cores listed, each encoder gets its own share of them.
+    ThreadPolicy policy = opt_.encode;
+    const size_t n = lanes_.size();
+    if (policy.cpus.size() >= n) {
+        std::vector<int> mine;
+        for (size_t i = static_cast<size_t>(k); i < policy.cpus.size(); i += n) mine.push_back(policy.cpus[i]);
+        policy.cpus = mine;
+    }
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Encode, policy, "penc " + std::to_string(k), &why))
+        std::cerr << "ParallelEncoder: encoder " << k << " thread policy: " << why << "\n";
+    FrameTracer::global().name_thread("encoder " + std::to_string(k));
+
+    std::unique_ptr<FfmpegWriter> writer;
+    int64_t segment = 0, next_slot = 0;
+    double bitrate = 1.0;
+    bool ok = true;
+
+    while (true) {
+        Item it;
+        {
+            std::unique_lock<std::mutex> lock(lane.mtx);
+            lane.cv.wait(lock, [&] { return !lane.q.empty() || lane.stopping; });
+            if (lane.q.empty()) break;
+            it = std::move(lane.q.front());
+            lane.q.pop_front();
+        }
+
+        switch (it.kind) {
+            case Item::Begin:
+                segment = it.segment;
+                bitrate = it.bitrate;
+                next_slot = 0;
+                ok = true;
+                break;
+
+            case Item::Frame:
+                if (!writer && ok) {
+                    // Opened on the first frame, so a segment that was all skipped leaves no file.
+                    writer = std::make_unique<FfmpegWriter>();
+                    writer->set_codec_option("threads", std::to_string(std::max(1, opt_.encoder_threads)));
+                    writer->set_codec_option("g", std::to_string(seg_frames_));
+                    for (const auto& [key, value] : opt_.codec_opts) writer->set_codec_option(key, value);
+                    writer->set_overlay(opt_.overlay);
+                    writer->set_white_balance(opt_.white_balance);
+                    writer->set_input_bit_depth(opt_.input_bit_depth);
+                    ok = writer->open(segment_name(segment), width_, height_, fps_, opt_.codec, input_fmt_);
+                    if (ok && bitrate != 1.0) writer->scale_bitrate(bitrate);
+                }
+                if (ok) {
+                    if (it.slot > next_slot) writer->skip_frames(static_cast<int>(it.slot - next_slot));
+                    ok = writer->write_frame(it.data, it.stride, it.pts_ns, it.frame_number);
+                }
+                next_slot = it.slot + 1;
+                it.owner.reset();   // hand the frame back before waiting again
+                {
+                    std::lock_guard<std::mutex> lock(lane.mtx);
+                    lane.frames--;
+                }
+                lane.cv.notify_all();
+                break;
+
+            case Item::End: {
+                if (writer) writer->close();
+                Done d;
+                d.ok = ok && writer;
+                d.frames = writer ? next_slot : 0;
+                writer.reset();
+                std::lock_guard<std::mutex> lock(join_mtx_);
+                done_[segment] = d;
+                join_cv_.notify_all();
+                break;
+            }
+        }
+    }
+}
+
+void ParallelEncoder::join_loop()
+{
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Io, opt_.io, "pjoin", &why))
+        std::cerr << "ParallelEncoder: joiner thread policy: " << why << "\n";
+
+    // Playlist entries are written once the next segment's start is known, so
+    // each duration also covers any empty segments after it.
+    std::string pending;
+    int64_t pending_start = 0, pending_frames = 0;
+    auto write_entry = [&](double seconds) {
+        fprintf(playlist_, "file '%s'\nduration %.6f\n",
+                pending.substr(pending.find_last_of('/') + 1).c_str(), seconds);
+    };
+    bool warned = false;
+
+    while (true) {
+        Done d;
+        int64_t s = 0;
+        {
+            std::unique_lock<std::mutex> lock(join_mtx_);
+            join_cv_.wait(lock, [&] { return done_.count(next_join_) || (closing_ && next_join_ > last_seg_); });
+            auto it = done_.find(next_join_);
+            if (it == done_.end()) break;
+            d = it->second;
+            done_.erase(it);
+            s = next_join_;
+        }
+
+        const std::string name = segment_name(s);
+        const int64_t start = s * seg_frames_;
+        if (d.frames > 0 && !d.ok) {
+            std::cerr << "ParallelEncoder: segment " << name << " failed to encode, left out\n";
+            std::remove(name.c_str());
+        } else if (d.frames > 0 && opt_.join == Join::Stitch) {
+            if (stitch_.append(name, start)) {
+                std::remove(name.c_str());
+            } else if (!warned) {
+                std::cerr << "ParallelEncoder: cannot stitch into " << filename_
+                          << ", keeping the segment files\n";
+                warned = true;
+            }
+        } else if (d.frames > 0) {
+            if (!pending.empty()) write_entry(static_cast<double>(start - pending_start) / fps_);
+            pending = name;
+            pending_start = start;
+            pending_frames = d.frames;
+        }
+
+        std::lock_guard<std::mutex> lock(join_mtx_);
+        next_join_++;
+    }
+
+    std::vector<std::pair<std::string, std::string>> metadata;
+    {
+        std::lock_guard<std::mutex> lock(join_mtx_);
+        metadata = metadata_;
+    }
+    if (opt_.join == Join::Stitch) {
+        for (const auto& [key, value] : metadata) stitch_.set_metadata(key, value);
+        stitch_.close();
+    } else {
+        if (!pending.empty()) write_entry(static_cast<double>(pending_frames) / fps_);
+        for (const auto& [key, value] : metadata) {
+            std::istringstream lines(value);   // one comment line per line of the value
+            for (std::string line; std::getline(lines, line); )
+                fprintf(playlist_, "# %s: %s\n", key.c_str(), line.c_str());
+        }
+        fclose(playlist_);
+        playlist_ = nullptr;
+    }
+}
+
+int64_t ParallelEncoder::segments_joined() const
+{
+    std::lock_guard<std::mutex> lock(join_mtx_);
+    return next_join_;
+}
+
+void ParallelEncoder::close()
+{
+    if (lanes_.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(join_mtx_);
+        last_seg_ = cur_seg_;
+        closing_ = true;
+    }
+    if (cur_seg_ >= 0) end_segment();
+    join_cv_.notify_all();
+
+    for (auto& l : lanes_) {
+        {
+            std::lock_guard<std::mutex> lock(l->mtx);
+            l->stopping = true;
+        }
+        l->cv.notify_all();
+    }
+    for (auto& l : lanes_)
+        if (l->thread.joinable()) l->thread.join();
+    if (joiner_.joinable()) joiner_.join();
+    lanes_.clear();
+}
+
+} // namespace cambuffer_recorder_ng
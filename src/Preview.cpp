@@ -0,0 +1,163 @@
+#include "cambuffer_recorder_ng/Preview.hpp"
+#include "cambuffer_recorder_ng/JpegEncoder.hpp"
+#include "cambuffer_recorder_ng/RawPack.hpp"
+#include "cambuffer_recorder_ng/Thumbnail.hpp"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+
+namespace cambuffer_recorder_ng {
+
+static uint64_t thread_cpu_ns()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+bool Preview::start(std::shared_ptr<FrameQueue> source, const Options& opt, Sink sink)
+{
+    if (running_ || !source) return false;
+    source_ = std::move(source);
+    opt_ = opt;
+    opt_.factor = std::max(2, opt_.factor & ~1);
+    opt_.cpu_budget = std::clamp(opt_.cpu_budget, 0.001, 1.0);
+    sink_ = std::move(sink);
+    {
+        std::lock_guard<std::mutex> lock(stats_mtx_);
+        stats_ = Stats{};
+    }
+    running_ = true;
+    worker_ = std::thread(&Preview::loop, this);
+    return true;
+}
+
+void Preview::stop()
+{
+    running_ = false;
+    if (worker_.joinable()) worker_.join();
+}
+
+Preview::Stats Preview::stats() const
+{
+    std::lock_guard<std::mutex> lock(stats_mtx_);
+    return stats_;
+}
+
+int Preview::make_thumbnail(const Frame& f, int& w, int& h)
+{
+    if (is_16bit(f.format)) {
+        // The kernels here are RAW8: take the top 8 bits first.
+        narrow_.resize(static_cast<size_t>(f.width) * f.height);
+        narrow_to_8bit(reinterpret_cast<const uint16_t*>(f.data), f.width, f.height, f.stride, f.bit_depth,
+                       narrow_.data(), f.width);
+        Frame g = f;
+        g.data = narrow_.data();
+        g.bytes = narrow_.size();
+        g.stride = f.width;
+        g.format = to_8bit(f.format);
+        g.bit_depth = 8;
+        return make_thumbnail(g, w, h);
+    }
+    const int k = opt_.factor;
+    thumb_.resize(static_cast<size_t>(f.width / k) * (f.height / k) * 3);
+
+    switch (f.format) {
+        case PixelFormat::Bayer8:
+            if (opt_.color) {
+                bayer_thumbnail_rgb(f.data, f.width, f.height, f.stride, k, f.pattern, thumb_.data(), w, h);
+                if (opt_.white_balance && !opt_.white_balance->unity()) {
+                    int r = 256, b = 256;
+                    opt_.white_balance->get(r, b);
+                    uint8_t* p = thumb_.data();
+                    for (size_t i = 0, n = static_cast<size_t>(w) * h; i < n; ++i, p += 3) {
+                        p[0] = static_cast<uint8_t>(std::min(255, (p[0] * r + 128) >> 8));
+                        p[2] = static_cast<uint8_t>(std::min(255, (p[2] * b + 128) >> 8));
+                    }
+                }
+                return 3;
+            }
+            [[fallthrough]];
+        case PixelFormat::Mono8:
+        case PixelFormat::Mono16:       // narrowed above, never here
+        case PixelFormat::Bayer16:
+            // The gray kernel is a plain box mean, so it suits mono sensors too.
+            bayer_thumbnail_gray(f.data, f.width, f.height, f.stride, k, thumb_.data(), w, h);
+            return 1;
+        case PixelFormat::Rgb24:
+            break;
+    }
+
+    // RGB input is only produced by FakeCamera; point-sample it.
+    w = f.width / k;
+    h = f.height / k;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            const uint8_t* p = f.data + static_cast<size_t>(y * k) * f.stride + x * k * 3;
+            std::copy(p, p + 3, thumb_.begin() + (static_cast<size_t>(y) * w + x) * 3);
+        }
+    return 3;
+}
+
+void Preview::loop()
+{
+    using clock = std::chrono::steady_clock;
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Preview, opt_.policy, opt_.name, &why))
+        std::cerr << "Preview: thread policy: " << why << "\n";
+
+    JpegEncoder jpeg;
+    const auto min_interval = std::chrono::duration<double>(opt_.max_fps > 0 ? 1.0 / opt_.max_fps : 0.0);
+    auto next_allowed = clock::now();
+    auto window_start = clock::now();
+    uint64_t window_cpu0 = thread_cpu_ns();
+    uint64_t next_seq = 0;
+
+    while (running_) {
+        FramePtr f;
+        if (!source_->pop(f, 100)) {
+            if (source_->closed()) break;
+            continue;
+        }
+        if (opt_.every_n > 1) {
+            if (f->seq < next_seq) continue;
+            next_seq = f->seq - f->seq % opt_.every_n + opt_.every_n;
+        }
+
+        const auto t0 = clock::now();
+        if (t0 < next_allowed) {
+            std::lock_guard<std::mutex> lock(stats_mtx_);
+            stats_.throttled++;
+            continue;
+        }
+
+        const uint64_t cpu0 = thread_cpu_ns();
+        int w = 0, h = 0;
+        const int comps = make_thumbnail(*f, w, h);
+        const bool ok = w > 0 && h > 0 && jpeg.encode(thumb_.data(), w, h, comps, opt_.quality, jpeg_);
+        if (ok && sink_) sink_(jpeg_, *f, w, h, comps);
+        f.reset();
+
+        // This preview's CPU time buys cpu / budget of wall time before the next.
+        const uint64_t cpu = thread_cpu_ns() - cpu0;
+        const auto earned = std::chrono::duration<double>(cpu * 1e-9 / opt_.cpu_budget);
+        next_allowed = t0 + std::chrono::duration_cast<clock::duration>(std::max(min_interval, earned));
+
+        const auto now = clock::now();
+        std::lock_guard<std::mutex> lock(stats_mtx_);
+        if (ok) stats_.published++;
+        stats_.last_ms = std::chrono::duration<double, std::milli>(now - t0).count();
+        stats_.width = w;
+        stats_.height = h;
+        const double window = std::chrono::duration<double>(now - window_start).count();
+        if (window >= 1.0) {
+            const uint64_t c = thread_cpu_ns();
+            stats_.cpu_fraction = (c - window_cpu0) * 1e-9 / window;
+            window_cpu0 = c;
+            window_start = now;
+        }
+    }
+}
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,236 @@
+#include "cambuffer_recorder_ng/RawPack.hpp"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RAW_PACK_AVX2 1
+#endif
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+// Scalar, from pixel i on (a multiple of the group size).
+void pack10_tail(const uint16_t* src, size_t i, size_t n, uint8_t* dst)
+{
+    uint8_t* d = dst + i / 4 * 5;
+    for (; i < n; i += 4, d += 5) {
+        uint16_t p[4] = {};
+        for (size_t k = 0; k < 4 && i + k < n; ++k) p[k] = std::min<uint16_t>(src[i + k], 1023);
+        d[0] = static_cast<uint8_t>(p[0] >> 2);
+        d[1] = static_cast<uint8_t>(p[1] >> 2);
+        d[2] = static_cast<uint8_t>(p[2] >> 2);
+        d[3] = static_cast<uint8_t>(p[3] >> 2);
+        d[4] = static_cast<uint8_t>((p[0] & 3) | (p[1] & 3) << 2 | (p[2] & 3) << 4 | (p[3] & 3) << 6);
+    }
+}
+
+void unpack10_tail(const uint8_t* src, size_t i, size_t n, uint16_t* dst)
+{
+    const uint8_t* s = src + i / 4 * 5;
+    for (; i < n; i += 4, s += 5)
+        for (size_t k = 0; k < 4 && i + k < n; ++k)
+            dst[i + k] = static_cast<uint16_t>(s[k] << 2 | ((s[4] >> (2 * k)) & 3));
+}
+
+void pack12_tail(const uint16_t* src, size_t i, size_t n, uint8_t* dst)
+{
+    uint8_t* d = dst + i / 2 * 3;
+    for (; i < n; i += 2, d += 3) {
+        const uint16_t p0 = std::min<uint16_t>(src[i], 4095);
+        const uint16_t p1 = i + 1 < n ? std::min<uint16_t>(src[i + 1], 4095) : 0;
+        d[0] = static_cast<uint8_t>(p0 >> 4);
+        d[1] = static_cast<uint8_t>(p1 >> 4);
+        d[2] = static_cast<uint8_t>((p0 & 15) | (p1 & 15) << 4);
+    }
+}
+
+void unpack12_tail(const uint8_t* src, size_t i, size_t n, uint16_t* dst)
+{
+    const uint8_t* s = src + i / 2 * 3;
+    for (; i < n; i += 2, s += 3) {
+        dst[i] = static_cast<uint16_t>(s[0] << 4 | (s[2] & 15));
+        if (i + 1 < n) dst[i + 1] = static_cast<uint16_t>(s[1] << 4 | s[2] >> 4);
+    }
+}
+
+#if defined(RAW_PACK_AVX2)
+bool have_avx2()
+{
+    static const bool yes = __builtin_cpu_supports("avx2");
+    return yes;
+}
+
+// The SIMD loops stop 8 pixels early: the second lane's 16-byte access runs
+// past its 10 / 12 bytes, which must still lie inside the packed buffer (and,
+// when storing, get overwritten by the next group).
+
+__attribute__((target("avx2")))
+size_t pack10_avx2(const uint16_t* src, size_t n, uint8_t* dst)
+{
+    const __m256i maxv = _mm256_set1_epi16(1023);
+    const __m256i three = _mm256_set1_epi16(3);
+    const __m256i w14 = _mm256_set1_epi32(0x00040001);
+    // Bytes 0..7 hold bits 9..2 of pixels 0..7, bytes 8 and 12 the two remainder bytes.
+    const __m256i order = _mm256_setr_epi8(0, 1, 2, 3, 8, 4, 5, 6, 7, 12, -1, -1, -1, -1, -1, -1,
+                                           0, 1, 2, 3, 8, 4, 5, 6, 7, 12, -1, -1, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 24 <= n; i += 16) {
+        const __m256i v = _mm256_min_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), maxv);
+        // Per dword r0 + 4 r1, then per qword low dword + 16 x high dword: r0 | r1 << 2 | r2 << 4 | r3 << 6.
+        const __m256i m = _mm256_madd_epi16(_mm256_and_si256(v, three), w14);
+        const __m256i r = _mm256_add_epi32(m, _mm256_slli_epi32(_mm256_srli_epi64(m, 32), 4));
+        const __m256i b = _mm256_shuffle_epi8(_mm256_packus_epi16(_mm256_srli_epi16(v, 2), r), order);
+        uint8_t* d = dst + i / 4 * 5;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm256_castsi256_si128(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 10), _mm256_extracti128_si256(b, 1));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t unpack10_avx2(const uint8_t* src, size_t n, uint16_t* dst)
+{
+    const __m256i three = _mm256_set1_epi16(3);
+    const __m256i high = _mm256_setr_epi8(0, -1, 1, -1, 2, -1, 3, -1, 5, -1, 6, -1, 7, -1, 8, -1,
+                                          0, -1, 1, -1, 2, -1, 3, -1, 5, -1, 6, -1, 7, -1, 8, -1);
+    const __m256i rest = _mm256_setr_epi8(4, -1, 4, -1, 4, -1, 4, -1, 9, -1, 9, -1, 9, -1, 9, -1,
+                                          4, -1, 4, -1, 4, -1, 4, -1, 9, -1, 9, -1, 9, -1, 9, -1);
+    // Moves pixel k's remainder to bits 7..6: x 64, 16, 4, 1.
+    const __m256i up = _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1);
+    size_t i = 0;
+    for (; i + 24 <= n; i += 16) {
+        const uint8_t* s = src + i / 4 * 5;
+        const __m256i b = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 10)), 1);
+        const __m256i h = _mm256_slli_epi16(_mm256_shuffle_epi8(b, high), 2);
+        const __m256i l = _mm256_and_si256(
+            _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(b, rest), up), 6), three);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(h, l));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t pack12_avx2(const uint16_t* src, size_t n, uint8_t* dst)
+{
+    const __m256i maxv = _mm256_set1_epi16(4095);
+    const __m256i fifteen = _mm256_set1_epi16(15);
+    const __m256i w116 = _mm256_set1_epi32(0x00100001);
+    // Bytes 0..7 hold bits 11..4 of pixels 0..7, bytes 8, 10, 12, 14 the remainder bytes.
+    const __m256i order = _mm256_setr_epi8(0, 1, 8, 2, 3, 10, 4, 5, 12, 6, 7, 14, -1, -1, -1, -1,
+                                           0, 1, 8, 2, 3, 10, 4, 5, 12, 6, 7, 14, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 24 <= n; i += 16) {
+        const __m256i v = _mm256_min_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), maxv);
+        const __m256i r = _mm256_madd_epi16(_mm256_and_si256(v, fifteen), w116);   // r0 | r1 << 4
+        const __m256i b = _mm256_shuffle_epi8(_mm256_packus_epi16(_mm256_srli_epi16(v, 4), r), order);
+        uint8_t* d = dst + i / 2 * 3;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm256_castsi256_si128(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 12), _mm256_extracti128_si256(b, 1));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t unpack12_avx2(const uint8_t* src, size_t n, uint16_t* dst)
+{
+    const __m256i fifteen = _mm256_set1_epi16(15);
+    const __m256i high = _mm256_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1,
+                                          0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m256i rest = _mm256_setr_epi8(2, -1, 2, -1, 5, -1, 5, -1, 8, -1, 8, -1, 11, -1, 11, -1,
+                                          2, -1, 2, -1, 5, -1, 5, -1, 8, -1, 8, -1, 11, -1, 11, -1);
+    // Moves even pixels' remainder to bits 7..4: x 16, 1.
+    const __m256i up = _mm256_set1_epi32(0x00010010);
+    size_t i = 0;
+    for (; i + 24 <= n; i += 16) {
+        const uint8_t* s = src + i / 2 * 3;
+        const __m256i b = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 12)), 1);
+        const __m256i h = _mm256_slli_epi16(_mm256_shuffle_epi8(b, high), 4);
+        const __m256i l = _mm256_and_si256(
+            _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(b, rest), up), 4), fifteen);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(h, l));
+    }
+    return i;
+}
+#endif
+
+} // namespace
+
+bool raw_pack_avx2()
+{
+#if defined(RAW_PACK_AVX2)
+    return have_avx2();
+#else
+    return false;
+#endif
+}
+
+void pack_raw10(const uint16_t* src, size_t pixels, uint8_t* dst)
+{
+    size_t i = 0;
+#if defined(RAW_PACK_AVX2)
+    if (have_avx2()) i = pack10_avx2(src, pixels, dst);
+#endif
+    pack10_tail(src, i, pixels, dst);
+}
+
+void unpack_raw10(const uint8_t* src, size_t pixels, uint16_t* dst)
+{
+    size_t i = 0;
+#if defined(RAW_PACK_AVX2)
+    if (have_avx2()) i = unpack10_avx2(src, pixels, dst);
+#endif
+    unpack10_tail(src, i, pixels, dst);
+}
+
+void pack_raw12(const uint16_t* src, size_t pixels, uint8_t* dst)
+{
+    size_t i = 0;
+#if defined(RAW_PACK_AVX2)
+    if (have_avx2()) i = pack12_avx2(src, pixels, dst);
+#endif
+    pack12_tail(src, i, pixels, dst);
+}
+
+void unpack_raw12(const uint8_t* src, size_t pixels, uint16_t* dst)
+{
+    size_t i = 0;
+#if defined(RAW_PACK_AVX2)
+    if (have_avx2()) i = unpack12_avx2(src, pixels, dst);
+#endif
+    unpack12_tail(src, i, pixels, dst);
+}
+
+void narrow_to_8bit(const uint16_t* src, int w, int h, int src_stride, int bits,
+                    uint8_t* dst, int dst_stride)
+{
+    bits = std::clamp(bits, 8, 16);
+    const int shift = bits - 8;
+    const uint16_t maxv = static_cast<uint16_t>((1u << bits) - 1);
+    for (int y = 0; y < h; ++y) {
+        const uint16_t* s = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(src) +
+                                                              static_cast<size_t>(y) * src_stride);
+        uint8_t* d = dst + static_cast<size_t>(y) * dst_stride;
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128i mv = _mm_set1_epi16(static_cast<int16_t>(maxv));
+        const __m128i sh = _mm_cvtsi32_si128(shift);
+        // min(v, max) as v - max(v - max, 0): SSE2 has no unsigned 16-bit min.
+        auto top = [&](__m128i v) { return _mm_srl_epi16(_mm_sub_epi16(v, _mm_subs_epu16(v, mv)), sh); };
+        for (; x + 16 <= w; x += 16) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x + 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x), _mm_packus_epi16(top(a), top(b)));
+        }
+#endif
+        for (; x < w; ++x) d[x] = static_cast<uint8_t>(std::min(s[x], maxv) >> shift);
+    }
+}
+
+} // namespace cambuffer_recorder_ng
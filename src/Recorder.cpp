@@ -1,51 +1,454 @@
 #include "cambuffer_recorder_ng/Recorder.hpp"
+#include "cambuffer_recorder_ng/DebayerHalf.hpp"
+#include "cambuffer_recorder_ng/FrameTrace.hpp"
+#include "cambuffer_recorder_ng/RawPack.hpp"
+#include "cambuffer_recorder_ng/XrawFormat.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
 
 namespace cambuffer_recorder_ng {
 
-bool Recorder::start(std::function<bool(uint8_t*&, size_t&, uint64_t&, int&, int&, int&)> grab_fn,
-                     const std::string& filename, int width, int height, int fps)
+static uint64_t now_ns()
 {
-    if (running_) return false;
-    grab_fn_ = std::move(grab_fn);
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static std::string strip_extension(const std::string& path)
+{
+    const auto dot = path.find_last_of('.');
+    const auto slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return path;
+    return path.substr(0, dot);
+}
+
+bool Recorder::start(std::shared_ptr<FrameQueue> source, const std::string& filename,
+                     int width, int height, int fps)
+{
+    if (running_ || !source) return false;
+    source_ = std::move(source);
     filename_ = filename;
     width_ = width;
     height_ = height;
     fps_ = fps;
 
-    if (!writer_.open(filename_, width_, height_, fps_, "libx264")) {
+    if (is_16bit(format_) && (bit_depth_ <= 8 || bit_depth_ > 16)) bit_depth_ = 16;
+    writer_.set_input_bit_depth(is_16bit(format_) ? bit_depth_ : 0);
+    if (output_ == Output::Xraw) {
+        if (format_ == PixelFormat::Rgb24) {
+            std::cerr << "Recorder: XRAW output needs single-channel frames\n";
+            return false;
+        }
+        xraw_format_ = xraw::format_for_depth(is_16bit(format_) ? bit_depth_ : 8);
+        if (!stripes_.dirs.empty()) {
+            const std::string base = strip_extension(filename_);
+            const auto slash = base.find_last_of('/');
+            StripedXrawWriter::Options so = stripes_;
+            so.data_format = xraw_format_;
+            if (!striped_.open(slash == std::string::npos ? base : base.substr(slash + 1),
+                               width_, height_, so)) {
+                std::cerr << "Recorder: failed to open striped XRAW writer\n";
+                return false;
+            }
+        } else if (!xraw_.open(strip_extension(filename_), width_, height_,
+                               2ULL * 1024 * 1024 * 1024, xraw_format_)) {
+            std::cerr << "Recorder: failed to open XRAW writer\n";
+            return false;
+        }
+    } else if (parallel_opt_.encoders > 1) {
+        ParallelEncoder::Options popt = parallel_opt_;
+        popt.encode = encode_policy_;
+        popt.input_bit_depth = is_16bit(format_) ? bit_depth_ : 0;
+        if (!parallel_.open(filename_, width_, height_, fps_, to_av_format(format_, pattern_), popt)) {
+            std::cerr << "Recorder: failed to open parallel encoder\n";
+            return false;
+        }
+    } else if (!writer_.open(filename_, width_, height_, fps_, "libx264", to_av_format(format_, pattern_))) {
+        // Raw Bayer goes straight to swscale, which debayers on the way to YUV.
         std::cerr << "Recorder: failed to open FFmpeg writer\n";
         return false;
     }
 
+    // Keep only the steps this output can actually take.
+    auto& steps = degrade_.policy.steps;
+    steps.erase(std::remove_if(steps.begin(), steps.end(), [this](DegradationPolicy::Step s) {
+        if (s == DegradationPolicy::Step::HalfRes)
+            return output_ == Output::Mp4 || format_ != PixelFormat::Bayer8;
+        // XRAW LZ4 is RAW8 only; deeper frames are bit-packed anyway.
+        if (s == DegradationPolicy::Step::Compress && output_ == Output::Xraw && is_16bit(format_))
+            return true;
+#ifndef HAVE_LZ4
+        if (s == DegradationPolicy::Step::Compress) return output_ == Output::Xraw;
+#endif
+        return false;
+    }), steps.end());
+    degrade_.decimate = std::max(degrade_.decimate, 2);
+    degrade_.drop_every = std::max(degrade_.drop_every, 2);
+    policy_.reset(degrade_.policy);
+    level_ = 0;
+    event_log_.clear();
+    close_event_file();
+
+    if (output_ == Output::Xraw) {
+        half_buf_.resize(static_cast<size_t>(width_ / 2) * (height_ / 2));
+        const size_t pixels = static_cast<size_t>(width_) * height_;
+        if (xraw_format_ == xraw::FMT_RAW10_PACKED) pack_buf_.resize(raw10_bytes(pixels));
+        if (xraw_format_ == xraw::FMT_RAW12_PACKED) pack_buf_.resize(raw12_bytes(pixels));
+#ifdef HAVE_LZ4
+        lz4_buf_.resize(static_cast<size_t>(LZ4_compressBound(width_ * height_)));
+#endif
+    }
+
+    frames_written_ = 0;
+    frames_skipped_ = 0;
+    frames_gated_ = 0;
+    windows_.clear();
+    pre_roll_.clear();
+    if (gate_.enable) {
+        // Two spare slots: the frame being copied in and one the writer may still hold.
+        const size_t pre = static_cast<size_t>(std::max(0, fps_) * static_cast<int64_t>(std::max(0, gate_.pre_ms)) / 1000);
+        pre_pool_ = std::make_shared<BufferPool>(static_cast<size_t>(width_) * height_ * bytes_per_pixel(format_),
+                                                 pre + 2);
+    }
+    motion_log_.clear();
+    {
+        std::lock_guard<std::mutex> lock(motion_mtx_);
+        motion_pending_.clear();
+    }
     running_ = true;
-    worker_ = std::thread(&Recorder::loop, this);
+    worker_ = std::thread(&Recorder::write_loop, this);
     return true;
 }
 
-void Recorder::loop()
+void Recorder::write_loop()
 {
-    uint8_t* data = nullptr;
-    size_t size = 0;
-    uint64_t ts = 0;
-    int w = 0, h = 0, stride = 0;
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Encode, encode_policy_, "enc " + thread_tag(), &why))
+        std::cerr << "Recorder: writer thread policy: " << why << "\n";
+    FrameTracer::global().name_thread("writer " + filename_);
 
-    while (running_) {
-        if (!grab_fn_) break;
+    // Load = smoothed writer time per frame over the frame period.
+    const double period_ns = fps_ > 0 ? 1e9 / fps_ : 0.0;
+    double load = 0.0;
+
+    while (true) {
+        // Once the broker has closed the queue, drain it; otherwise stop() stops now.
+        if (!running_ && !source_->closed()) break;
+
+        FramePtr f;
+        if (!source_->pop(f, 100)) {
+            if (!running_ || source_->closed()) break;
+            continue;
+        }
 
-        bool ok = false;
-        try {
-            ok = grab_fn_(data, size, ts, w, h, stride);
-        } catch (...) {
-            ok = false;
+        const uint64_t t0 = now_ns();
+        if (degrade_.enable && period_ns > 0) {
+            const double fill = static_cast<double>(source_->depth()) / source_->capacity();
+            if (policy_.update(t0, fill, load)) on_level_change(f->ts_ns);
         }
 
-        if (!ok) continue;
+        if (gate_.enable) write_gated(std::move(f));
+        else count(write_one(f));
 
-        writer_.write_frame(data, stride);
+        if (period_ns > 0)
+            load += 0.1 * (static_cast<double>(now_ns() - t0) / period_ns - load);
     }
 
-    writer_.close();
+    pre_roll_.clear();   // never covered by a Start
+    if (gate_.enable) take_motion_events();   // an End that came in late still gets logged
+
+    if (output_ == Output::Mp4) {
+        if (!event_log_.empty()) {
+            writer_.set_metadata("degradation_log", event_log_);
+            parallel_.set_metadata("degradation_log", event_log_);
+        }
+        if (!motion_log_.empty()) {
+            writer_.set_metadata("motion_log", motion_log_);
+            parallel_.set_metadata("motion_log", motion_log_);
+        }
+        writer_.close();
+        parallel_.close();
+        close_event_file();
+    } else {
+        xraw_.close();
+        striped_.close();
+    }
+}
+
+bool Recorder::write_one(const FramePtr& fp)
+{
+    const Frame& f = *fp;
+    using Step = DegradationPolicy::Step;
+    const bool decimating = policy_.active(Step::Decimate);
+    const uint64_t decimate = static_cast<uint64_t>(degrade_.decimate);
+    bool skip = decimating && f.seq % decimate != 0;
+    if (!skip && policy_.active(Step::Drop)) {
+        // Thins whatever decimation keeps, so each step still halves (by default) the rate.
+        const uint64_t kept = decimating ? f.seq / decimate : f.seq;
+        const uint64_t n = static_cast<uint64_t>(degrade_.drop_every);
+        skip = kept % n == n - 1;
+    }
+    if (skip) {
+        // MP4 timestamps come from the frame count, so account for the gap.
+        if (output_ == Output::Mp4) {
+            writer_.skip_frames(1);
+            parallel_.skip_frames(1);
+        }
+        return false;
+    }
+
+    return output_ == Output::Mp4 ? write_mp4(fp) : write_xraw(fp);
+}
+
+bool Recorder::write_mp4(const FramePtr& fp)
+{
+    const Frame& f = *fp;
+    const int64_t number = static_cast<int64_t>(f.frame_number ? f.frame_number : f.seq);
+    // The parallel encoders keep the broker slot until their segment gets to it.
+    if (parallel_.is_open())
+        return parallel_.write_frame(f.data, f.stride, static_cast<int64_t>(f.ts_ns), fp, number);
+    return writer_.write_frame(f.data, f.stride, static_cast<int64_t>(f.ts_ns), number);
+}
+
+bool Recorder::write_xraw(const FramePtr& fp)
+{
+    using Step = DegradationPolicy::Step;
+    const Frame& f = *fp;
+    // Striped lanes time their own writes; here that would only be the hand-off.
+    const bool striped = striped_.is_open();
+    const uint64_t index = f.frame_number ? f.frame_number : f.seq;
+    uint32_t flags = static_cast<uint32_t>(policy_.level()) << xraw::FLAG_LEVEL_SHIFT;
+    if (policy_.active(Step::Decimate)) flags |= xraw::FLAG_DECIMATED;
+
+    if (is_16bit(format_)) {
+        // 10/12-bit go out bit-packed, other depths as 16-bit words tagged with their depth.
+        const size_t pixels = static_cast<size_t>(f.width) * f.height;
+        const uint8_t* payload = pack_buf_.data();
+        size_t bytes = 0;
+        const uint64_t t0 = now_ns();
+        if (xraw_format_ == xraw::FMT_RAW10_PACKED) {
+            pack_raw10(reinterpret_cast<const uint16_t*>(f.data), pixels, pack_buf_.data());
+            bytes = raw10_bytes(pixels);
+        } else if (xraw_format_ == xraw::FMT_RAW12_PACKED) {
+            pack_raw12(reinterpret_cast<const uint16_t*>(f.data), pixels, pack_buf_.data());
+            bytes = raw12_bytes(pixels);
+        } else {
+            payload = f.data;
+            bytes = pixels * 2;
+            flags |= static_cast<uint32_t>(bit_depth_ & 15) << xraw::FLAG_DEPTH_SHIFT;
+        }
+        const uint64_t t1 = now_ns();
+        if (payload != f.data) stage_done(Stage::Compress, f.seq, t0, t1);
+        if (striped)
+            return striped_.write_encoded(index, f.ts_ns, payload, static_cast<uint32_t>(bytes),
+                                          f.width, f.height, xraw_format_, flags);
+        const bool ok = xraw_.write_encoded(index, f.ts_ns, payload, static_cast<uint32_t>(bytes),
+                                            f.width, f.height, xraw_format_, flags);
+        stage_done(Stage::Write, f.seq, t1, now_ns());
+        return ok;
+    }
+
+    const uint8_t* data = f.data;
+    int w = f.width, h = f.height, stride = f.stride;
+    if (policy_.active(Step::HalfRes)) {
+        const uint64_t t0 = now_ns();
+        bayer_half_preserve_cfa(f.data, f.width, f.height, f.stride, half_buf_.data(), w, h, pattern_);
+        stage_done(Stage::Debayer, f.seq, t0, now_ns());
+        data = half_buf_.data();
+        stride = w;
+        flags |= xraw::FLAG_HALF_RES;
+    }
+
+#ifdef HAVE_LZ4
+    // LZ4 wants a packed source; broker slots and half-res output both are.
+    if (policy_.active(Step::Compress) && stride == w) {
+        const uint64_t t0 = now_ns();
+        const int n = LZ4_compress_fast(reinterpret_cast<const char*>(data),
+                                        reinterpret_cast<char*>(lz4_buf_.data()),
+                                        w * h, static_cast<int>(lz4_buf_.size()), 1);
+        const uint64_t t1 = now_ns();
+        stage_done(Stage::Compress, f.seq, t0, t1);
+        if (n <= 0) return false;
+        if (striped)
+            return striped_.write_encoded(index, f.ts_ns, lz4_buf_.data(), static_cast<uint32_t>(n),
+                                          w, h, xraw::FMT_RAW8_LZ4, flags);
+        const bool ok = xraw_.write_encoded(index, f.ts_ns, lz4_buf_.data(), static_cast<uint32_t>(n),
+                                            w, h, xraw::FMT_RAW8_LZ4, flags);
+        stage_done(Stage::Write, f.seq, t1, now_ns());
+        return ok;
+    }
+#endif
+
+    if (striped) {
+        // Full-res frames travel by reference to their broker slot; half-res ones are copied.
+        std::shared_ptr<const void> owner;
+        if (data == f.data) owner = fp;
+        return striped_.write_frame(index, f.ts_ns, data, stride, w, h, flags, std::move(owner));
+    }
+
+    const uint64_t t0 = now_ns();
+    const bool ok = (flags == 0 && w == width_ && h == height_)
+        ? xraw_.write_frame(index, f.ts_ns, data, stride)
+        : xraw_.write_frame(index, f.ts_ns, data, stride, w, h, flags);
+    stage_done(Stage::Write, f.seq, t0, now_ns());
+    return ok;
+}
+
+void Recorder::count(bool written)
+{
+    if (written) frames_written_++;
+    else frames_skipped_++;
+}
+
+void Recorder::on_motion(const MotionDetector::Event& e)
+{
+    std::lock_guard<std::mutex> lock(motion_mtx_);
+    motion_pending_.push_back(e);
+}
+
+void Recorder::take_motion_events()
+{
+    std::vector<MotionDetector::Event> events;
+    {
+        std::lock_guard<std::mutex> lock(motion_mtx_);
+        events.swap(motion_pending_);
+    }
+    const uint64_t pre = static_cast<uint64_t>(std::max(0, gate_.pre_ms)) * 1000000ull;
+    const uint64_t post = static_cast<uint64_t>(std::max(0, gate_.post_ms)) * 1000000ull;
+    for (const auto& e : events) {
+        if (e.start) {
+            const uint64_t from = e.ts_ns > pre ? e.ts_ns - pre : 0;
+            // A Start inside the previous window's tail just keeps it open.
+            if (!windows_.empty() && from <= windows_.back().second) windows_.back().second = UINT64_MAX;
+            else windows_.emplace_back(from, UINT64_MAX);
+        } else if (!windows_.empty()) {
+            windows_.back().second = e.ts_ns + post;
+        }
+
+        const std::string line = e.describe();
+        if (output_ == Output::Xraw) {
+            if (striped_.is_open()) striped_.write_event(e.ts_ns, line);
+            else xraw_.write_event(e.ts_ns, line);
+        } else {
+            motion_log_ += std::to_string(e.ts_ns) + " " + line + "\n";
+        }
+    }
+}
+
+void Recorder::drop_gated()
+{
+    frames_gated_++;
+    // MP4 keeps its timeline, as for dropped frames.
+    if (output_ == Output::Mp4) {
+        writer_.skip_frames(1);
+        parallel_.skip_frames(1);
+    }
+}
+
+void Recorder::write_gated(FramePtr f)
+{
+    take_motion_events();
+    // Windows are disjoint and in order, and frames come in camera order.
+    while (!windows_.empty() && windows_.front().second < f->ts_ns) windows_.pop_front();
+    const bool keep = !windows_.empty() && f->ts_ns >= windows_.front().first;
+
+    if (!keep) {
+        // The detector may lag the writer: hold `pre_ms` of frames for a Start still to come.
+        // They are copied into the recorder's own pool; holding broker slots that long
+        // would stop capture, and with it the detector that could end the wait.
+        uint8_t* slot = pre_pool_->acquire_for(0);
+        while (!slot && !pre_roll_.empty()) {   // full: the oldest makes room
+            pre_roll_.pop_front();
+            drop_gated();
+            slot = pre_pool_->acquire_for(0);
+        }
+        if (!slot) {
+            drop_gated();
+            return;
+        }
+        std::memcpy(slot, f->data, std::min(f->bytes, pre_pool_->frame_bytes()));
+        auto* copy = new Frame(*f);
+        copy->data = slot;
+        f.reset();   // the broker slot goes back now
+        auto pool = pre_pool_;
+        pre_roll_.emplace_back(copy, [pool, slot](const Frame* p) { pool->release(slot); delete p; });
+
+        const uint64_t pre = static_cast<uint64_t>(std::max(0, gate_.pre_ms)) * 1000000ull;
+        while (pre_roll_.front()->ts_ns + pre < pre_roll_.back()->ts_ns) {
+            pre_roll_.pop_front();
+            drop_gated();
+        }
+        return;
+    }
+
+    for (auto& p : pre_roll_) {
+        if (p->ts_ns >= windows_.front().first) count(write_one(p));
+        else drop_gated();
+    }
+    pre_roll_.clear();
+    count(write_one(f));
+}
+
+void Recorder::on_level_change(uint64_t ts_ns)
+{
+    const auto& c = policy_.last_change();
+    const std::string line = c.describe();
+    std::cerr << "Recorder " << thread_tag() << ": " << line << "\n";
+    level_ = c.to;
+
+    if (output_ == Output::Xraw) {
+        if (striped_.is_open()) striped_.write_event(ts_ns, line);
+        else xraw_.write_event(ts_ns, line);
+        return;
+    }
+    event_log_ += line;
+    event_log_ += '\n';
+    // The metadata tag is only written at close (and never with fragment_ms); the
+    // sidecar has each change on disk as it happens.
+    if (!event_file_) {
+        const std::string path = strip_extension(filename_) + ".degrade.log";
+        event_file_ = fopen(path.c_str(), "w");
+        if (!event_file_) perror(("Recorder: fopen " + path).c_str());
+    }
+    if (event_file_) {
+        fprintf(event_file_, "%s\n", line.c_str());
+        fflush(event_file_);
+    }
+    const double factor = policy_.active(DegradationPolicy::Step::Compress) ? degrade_.bitrate_factor : 1.0;
+    writer_.scale_bitrate(factor);
+    parallel_.scale_bitrate(factor);
+}
+
+std::string Recorder::degradation_state() const
+{
+    const int level = level_;
+    const auto& steps = degrade_.policy.steps;
+    if (level <= 0 || static_cast<size_t>(level) > steps.size()) return "normal";
+    return DegradationPolicy::step_name(steps[static_cast<size_t>(level - 1)]);
+}
+
+std::string Recorder::thread_tag() const
+{
+    // Thread names are capped at 15 chars: keep the file's base name.
+    const auto slash = filename_.find_last_of('/');
+    return slash == std::string::npos ? filename_ : filename_.substr(slash + 1);
+}
+
+size_t Recorder::queue_depth() const
+{
+    return source_ ? source_->depth() : 0;
+}
+
+void Recorder::close_event_file()
+{
+    if (event_file_) fclose(event_file_);
+    event_file_ = nullptr;
 }
 
 void Recorder::stop()
@@ -53,7 +456,10 @@ void Recorder::stop()
     running_ = false;
     if (worker_.joinable()) worker_.join();
     writer_.close();
+    parallel_.close();
+    xraw_.close();
+    striped_.close();
+    close_event_file();
 }
 
 } // namespace cambuffer_recorder_ng
-
@@ -0,0 +1,94 @@
+#include "cambuffer_recorder_ng/SegmentJoiner.hpp"
+#include <iostream>
+
+namespace cambuffer_recorder_ng {
+
+bool SegmentJoiner::open(const std::string& output, int fps)
+{
+    close();
+    avformat_alloc_output_context2(&out_, nullptr, nullptr, output.c_str());
+    if (!out_) {
+        std::cerr << "SegmentJoiner: could not allocate output context for " << output << "\n";
+        return false;
+    }
+    output_ = output;
+    fps_ = fps;
+    ok_ = true;
+    pkt_ = av_packet_alloc();
+    return true;
+}
+
+bool SegmentJoiner::write_header(const AVStream* ist)
+{
+    ost_ = avformat_new_stream(out_, nullptr);
+    avcodec_parameters_copy(ost_->codecpar, ist->codecpar);
+    ost_->codecpar->codec_tag = 0;
+    ost_->time_base = {1, fps_};
+    if (!(out_->oformat->flags & AVFMT_NOFILE) &&
+        avio_open(&out_->pb, output_.c_str(), AVIO_FLAG_WRITE) < 0) {
+        std::cerr << "SegmentJoiner: could not open output file " << output_ << "\n";
+        return false;
+    }
+    AVDictionary* mux_opts = nullptr;
+    av_dict_set(&mux_opts, "movflags", "use_metadata_tags", 0);
+    const bool ok = avformat_write_header(out_, &mux_opts) >= 0;
+    av_dict_free(&mux_opts);
+    if (!ok) std::cerr << "SegmentJoiner: could not write header of " << output_ << "\n";
+    return ok;
+}
+
+bool SegmentJoiner::append(const std::string& part, int64_t start_frame)
+{
+    if (!out_ || !ok_) return false;
+
+    AVFormatContext* in = nullptr;
+    if (avformat_open_input(&in, part.c_str(), nullptr, nullptr) < 0 ||
+        avformat_find_stream_info(in, nullptr) < 0 || in->nb_streams < 1) {
+        std::cerr << "SegmentJoiner: cannot read part " << part << "\n";
+        if (in) avformat_close_input(&in);
+        return ok_ = false;
+    }
+    AVStream* ist = in->streams[0];
+    if (!ost_ && !write_header(ist)) {
+        avformat_close_input(&in);
+        return ok_ = false;
+    }
+
+    const int64_t offset = av_rescale_q(start_frame, AVRational{1, fps_}, ist->time_base);
+    while (ok_ && av_read_frame(in, pkt_) >= 0) {
+        if (pkt_->stream_index == 0) {
+            if (pkt_->pts != AV_NOPTS_VALUE) pkt_->pts += offset;
+            if (pkt_->dts != AV_NOPTS_VALUE) pkt_->dts += offset;
+            av_packet_rescale_ts(pkt_, ist->time_base, ost_->time_base);
+            pkt_->stream_index = 0;
+            pkt_->pos = -1;
+            if (av_interleaved_write_frame(out_, pkt_) < 0) {
+                std::cerr << "SegmentJoiner: mux error in part " << part << "\n";
+                ok_ = false;
+            }
+        }
+        av_packet_unref(pkt_);
+    }
+    avformat_close_input(&in);
+    return ok_;
+}
+
+void SegmentJoiner::set_metadata(const std::string& key, const std::string& value)
+{
+    if (out_) av_dict_set(&out_->metadata, key.c_str(), value.c_str(), 0);
+}
+
+bool SegmentJoiner::close()
+{
+    if (!out_) return false;
+    const bool ok = ok_ && ost_;
+    if (ost_) av_write_trailer(out_);
+    if (out_->pb) avio_closep(&out_->pb);
+    avformat_free_context(out_);
+    av_packet_free(&pkt_);
+    out_ = nullptr;
+    ost_ = nullptr;
+    return ok;
+}
+
+} // namespace cambuffer_recorder_ng
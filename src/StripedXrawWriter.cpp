@@ -0,0 +1,339 @@
+#include "cambuffer_recorder_ng/StripedXrawWriter.hpp"
+#include "cambuffer_recorder_ng/FrameTrace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+namespace cambuffer_recorder_ng {
+
+static uint64_t now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+StripedXrawWriter::Balance StripedXrawWriter::parse_balance(const std::string& name)
+{
+    return name == "round_robin" ? Balance::RoundRobin : Balance::Throughput;
+}
+
+bool StripedXrawWriter::open(const std::string& name, int width, int height, const Options& opt)
+{
+    close();
+    if (opt.dirs.empty()) {
+        std::cerr << "StripedXrawWriter: no directories\n";
+        return false;
+    }
+    opt_ = opt;
+    opt_.lane_queue = std::max<size_t>(1, opt_.lane_queue);
+    name_ = name;
+    next_rr_ = 0;
+    next_seq_ = 0;
+    next_line_ = 0;
+
+    manifest_path_ = opt_.dirs.front() + "/" + name_ + ".xrawm";
+    manifest_ = fopen(manifest_path_.c_str(), "w");
+    if (!manifest_) { perror(("StripedXrawWriter: fopen " + manifest_path_).c_str()); return false; }
+    // Line-buffered: after a crash the manifest is short by at most the records in flight.
+    setvbuf(manifest_, nullptr, _IOLBF, 0);
+    fprintf(manifest_, "XRAWSTRIPE 1\n");
+
+    for (size_t k = 0; k < opt_.dirs.size(); ++k) {
+        auto lane = std::make_unique<Lane>();
+        // Absolute, so the manifest still resolves when read from another directory.
+        std::error_code ec;
+        const auto dir = std::filesystem::absolute(opt_.dirs[k], ec);
+        lane->prefix = (ec ? opt_.dirs[k] : dir.string()) + "/" + name_ + "_s" + std::to_string(k);
+        if (!lane->writer.open(lane->prefix, width, height, opt_.roll_bytes, opt_.data_format)) {
+            close();
+            return false;
+        }
+        fprintf(manifest_, "lane %zu %s\n", k, lane->prefix.c_str());
+        lanes_.push_back(std::move(lane));
+    }
+    for (size_t k = 0; k < lanes_.size(); ++k)
+        lanes_[k]->thread = std::thread(&StripedXrawWriter::lane_loop, this, std::ref(*lanes_[k]),
+                                        static_cast<int>(k));
+    return true;
+}
+
+int StripedXrawWriter::pick_lane(uint64_t bytes)
+{
+    const size_t n = lanes_.size();
+    int best = -1;
+    double best_eta = std::numeric_limits<double>::max();
+
+    // Scan from the round-robin cursor so ties (and RoundRobin) rotate evenly.
+    for (size_t i = 0; i < n; ++i) {
+        const size_t k = (next_rr_ + i) % n;
+        Lane& lane = *lanes_[k];
+        std::lock_guard<std::mutex> lock(lane.mtx);
+        if (lane.failed) continue;
+        if (opt_.balance == Balance::RoundRobin) { best = static_cast<int>(k); break; }
+
+        // Expected time until this record is on disk; a full queue means waiting anyway.
+        double eta = static_cast<double>(lane.queued_bytes + bytes) * lane.ns_per_byte;
+        if (lane.q.size() >= opt_.lane_queue) eta += 1e15;
+        if (eta < best_eta) { best_eta = eta; best = static_cast<int>(k); }
+    }
+    if (best >= 0) next_rr_ = static_cast<size_t>(best) + 1;
+    return best;
+}
+
+bool StripedXrawWriter::submit(int k, Record& r)
+{
+    Lane& lane = *lanes_[static_cast<size_t>(k)];
+    std::unique_lock<std::mutex> lock(lane.mtx);
+    lane.cv.wait(lock, [&] { return lane.q.size() < opt_.lane_queue || lane.failed; });
+    if (lane.failed) return false;
+    r.seq = next_seq_++;
+    lane.queued_bytes += r.bytes;
+    lane.q.push_back(std::move(r));
+    lane.cv.notify_all();
+    return true;
+}
+
+bool StripedXrawWriter::dispatch(Record& r)
+{
+    // submit() only fails on a lane that has just been disabled, which pick_lane() then skips.
+    while (true) {
+        const int k = pick_lane(r.bytes);
+        if (k < 0) return false;
+        if (submit(k, r)) return true;
+    }
+}
+
+void StripedXrawWriter::resubmit_orphans()
+{
+    std::vector<Record> orphans;
+    {
+        std::lock_guard<std::mutex> lock(manifest_mtx_);
+        orphans.swap(orphans_);
+    }
+    size_t lost = 0;
+    for (auto& r : orphans)
+        if (!dispatch(r)) lost++;
+    if (lost) std::cerr << "StripedXrawWriter: no healthy lane left, dropped " << lost << " records\n";
+}
+
+bool StripedXrawWriter::write_record(Lane& lane, const Record& r)
+{
+    switch (r.kind) {
+        case Record::Frame:
+            return lane.writer.write_frame(r.frame_index, r.ts_ns, r.data, r.stride,
+                                           r.width, r.height, r.flags);
+        case Record::Encoded:
+            return lane.writer.write_encoded(r.frame_index, r.ts_ns, r.data, r.bytes,
+                                             r.width, r.height, r.data_format, r.flags);
+        case Record::Event:
+            return lane.writer.write_event(r.ts_ns, r.text);
+    }
+    return false;
+}
+
+static std::string manifest_line(int lane, bool event, uint64_t frame_index)
+{
+    char buf[64];
+    if (event) snprintf(buf, sizeof(buf), "e %d\n", lane);
+    else snprintf(buf, sizeof(buf), "f %d %llu\n", lane, (unsigned long long)frame_index);
+    return buf;
+}
+
+void StripedXrawWriter::settle(uint64_t seq, const std::string& line)
+{
+    // Caller holds manifest_mtx_. Lines go out in submission order; an empty one
+    // is a record that moved to another lane under a new position.
+    done_.emplace(seq, line);
+    for (auto it = done_.begin(); it != done_.end() && it->first == next_line_; ++next_line_) {
+        if (!it->second.empty()) fputs(it->second.c_str(), manifest_);
+        it = done_.erase(it);
+    }
+}
+
+bool StripedXrawWriter::write_frame(uint64_t frame_index, uint64_t ts_ns, const uint8_t* data, int stride,
+                                    int width, int height, uint32_t flags,
+                                    std::shared_ptr<const void> owner)
+{
+    if (!manifest_) return false;
+
+    Record r;
+    r.kind = Record::Frame;
+    r.frame_index = frame_index;
+    r.ts_ns = ts_ns;
+    r.width = width;
+    r.height = height;
+    r.flags = flags;
+    r.bytes = static_cast<uint32_t>(width) * static_cast<uint32_t>(height);
+    if (owner) {
+        r.data = data;
+        r.stride = stride;
+        r.owner = std::move(owner);
+    } else {
+        r.copy.resize(r.bytes);
+        for (int y = 0; y < height; ++y)
+            std::memcpy(r.copy.data() + static_cast<size_t>(y) * width,
+                        data + static_cast<size_t>(y) * stride, static_cast<size_t>(width));
+        r.data = r.copy.data();
+        r.stride = width;
+    }
+
+    resubmit_orphans();
+    return dispatch(r);
+}
+
+bool StripedXrawWriter::write_encoded(uint64_t frame_index, uint64_t ts_ns, const uint8_t* payload,
+                                      uint32_t bytes, int width, int height, uint32_t data_format,
+                                      uint32_t flags)
+{
+    if (!manifest_) return false;
+
+    Record r;
+    r.kind = Record::Encoded;
+    r.frame_index = frame_index;
+    r.ts_ns = ts_ns;
+    r.width = width;
+    r.height = height;
+    r.data_format = data_format;
+    r.flags = flags;
+    r.bytes = bytes;
+    r.copy.assign(payload, payload + bytes);
+    r.data = r.copy.data();
+
+    resubmit_orphans();
+    return dispatch(r);
+}
+
+bool StripedXrawWriter::write_event(uint64_t ts_ns, const std::string& text)
+{
+    if (!manifest_) return false;
+
+    Record r;
+    r.kind = Record::Event;
+    r.ts_ns = ts_ns;
+    r.text = text;
+    r.bytes = static_cast<uint32_t>(text.size());
+
+    resubmit_orphans();
+    return dispatch(r);
+}
+
+void StripedXrawWriter::lane_loop(Lane& lane, int k)
+{
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Io, opt_.io, "io s" + std::to_string(k), &why))
+        std::cerr << "StripedXrawWriter: lane " << k << " thread policy: " << why << "\n";
+    FrameTracer::global().name_thread("xraw lane " + std::to_string(k));
+
+    while (true) {
+        Record r;
+        {
+            std::unique_lock<std::mutex> lock(lane.mtx);
+            lane.cv.wait(lock, [&] { return !lane.q.empty() || lane.stopping; });
+            if (lane.q.empty()) break;
+            r = std::move(lane.q.front());
+            lane.q.pop_front();
+        }
+
+        const uint64_t t0 = now_ns();
+        const bool ok = write_record(lane, r);
+        const uint64_t t1 = now_ns();
+        if (r.kind != Record::Event) stage_done(Stage::Write, r.frame_index, t0, t1);
+
+        std::vector<Record> orphans;
+        {
+            std::lock_guard<std::mutex> lock(lane.mtx);
+            lane.queued_bytes -= r.bytes;
+            if (ok && r.bytes) {
+                const double sample = static_cast<double>(t1 - t0) / r.bytes;
+                lane.ns_per_byte = lane.ns_per_byte > 0 ? 0.8 * lane.ns_per_byte + 0.2 * sample : sample;
+            }
+            if (ok) {
+                if (r.kind != Record::Event) lane.frames++;
+                lane.bytes += r.bytes;
+            } else if (!lane.failed) {
+                // Typically a full disk: take the lane out of rotation, the others carry on
+                // with this record and the ones queued behind it.
+                std::cerr << "StripedXrawWriter: lane " << k << " (" << lane.prefix << ") failed, disabling\n";
+                lane.failed = true;
+                orphans.push_back(std::move(r));
+                for (auto& q : lane.q) {
+                    lane.queued_bytes -= q.bytes;
+                    orphans.push_back(std::move(q));
+                }
+                lane.q.clear();
+            }
+            lane.cv.notify_all();
+        }
+
+        if (ok) r.owner.reset();   // hand the frame slot back before waiting again
+
+        std::lock_guard<std::mutex> lock(manifest_mtx_);
+        if (ok) settle(r.seq, manifest_line(k, r.kind == Record::Event, r.frame_index));
+        for (auto& o : orphans) {
+            settle(o.seq, std::string());
+            orphans_.push_back(std::move(o));
+        }
+    }
+}
+
+std::vector<StripedXrawWriter::LaneStats> StripedXrawWriter::lane_stats() const
+{
+    std::vector<LaneStats> out;
+    for (const auto& l : lanes_) {
+        std::lock_guard<std::mutex> lock(l->mtx);
+        LaneStats s;
+        s.prefix = l->prefix;
+        s.frames = l->frames;
+        s.bytes = l->bytes;
+        s.mib_per_s = l->ns_per_byte > 0 ? 1e9 / l->ns_per_byte / (1024.0 * 1024.0) : 0.0;
+        s.queued = l->q.size();
+        s.failed = l->failed;
+        out.push_back(s);
+    }
+    return out;
+}
+
+void StripedXrawWriter::close()
+{
+    for (auto& l : lanes_) {
+        {
+            std::lock_guard<std::mutex> lock(l->mtx);
+            l->stopping = true;
+        }
+        l->cv.notify_all();
+    }
+    for (auto& l : lanes_)
+        if (l->thread.joinable()) l->thread.join();
+
+    // Records orphaned after the last write_* call: write them here on whichever lane still works.
+    size_t lost = 0;
+    for (auto& r : orphans_) {
+        bool ok = false;
+        for (size_t k = 0; k < lanes_.size() && !ok; ++k) {
+            Lane& lane = *lanes_[k];
+            if (lane.failed) continue;
+            ok = write_record(lane, r);
+            if (!ok) {
+                std::cerr << "StripedXrawWriter: lane " << k << " (" << lane.prefix << ") failed, disabling\n";
+                lane.failed = true;
+                continue;
+            }
+            if (r.kind != Record::Event) lane.frames++;
+            lane.bytes += r.bytes;
+            settle(next_seq_++, manifest_line(static_cast<int>(k), r.kind == Record::Event, r.frame_index));
+        }
+        if (!ok) lost++;
+    }
+    if (lost) std::cerr << "StripedXrawWriter: no healthy lane left, dropped " << lost << " records\n";
+    orphans_.clear();
+    done_.clear();
+
+    for (auto& l : lanes_) l->writer.close();
+    lanes_.clear();
+    if (manifest_) { fclose(manifest_); manifest_ = nullptr; }
+}
+
+} // namespace cambuffer_recorder_ng
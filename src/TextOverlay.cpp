@@ -0,0 +1,255 @@
+#include "cambuffer_recorder_ng/TextOverlay.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+constexpr int kFontW = 5, kFontH = 7;
+constexpr int kChunk = 256;   // strip columns blended per pass, from stack buffers
+constexpr int64_t kUnanchored = std::numeric_limits<int64_t>::min();
+
+struct Glyph { char c; uint8_t rows[kFontH]; };   // bit 4 = leftmost column
+
+const Glyph kFont[] = {
+    {' ', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+    {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+    {'+', {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}},
+    {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+    {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {'m', {0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11}},
+    {'s', {0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E}},
+};
+constexpr int kGlyphs = static_cast<int>(sizeof(kFont) / sizeof(kFont[0]));
+
+// dst = (dst * (255 - a) + v * a) / 255, rounded.
+void blend_row(uint8_t* dst, const uint8_t* a, const uint8_t* v, int n)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255), c128 = _mm_set1_epi16(128);
+    auto half = [&](__m128i d, __m128i al, __m128i vl) {
+        __m128i r = _mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(c255, al)), _mm_mullo_epi16(vl, al));
+        r = _mm_add_epi16(r, c128);
+        return _mm_srli_epi16(_mm_add_epi16(r, _mm_srli_epi16(r, 8)), 8);   // exact /255 for 16-bit sums
+    };
+    for (; i + 16 <= n; i += 16) {
+        const __m128i av = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(av, zero)) == 0xFFFF) continue;   // gaps between glyphs
+        const __m128i dv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        const __m128i vv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        const __m128i lo = half(_mm_unpacklo_epi8(dv, zero), _mm_unpacklo_epi8(av, zero), _mm_unpacklo_epi8(vv, zero));
+        const __m128i hi = half(_mm_unpackhi_epi8(dv, zero), _mm_unpackhi_epi8(av, zero), _mm_unpackhi_epi8(vv, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i) {
+        const unsigned r = dst[i] * (255u - a[i]) + v[i] * a[i] + 128u;
+        dst[i] = static_cast<uint8_t>((r + (r >> 8)) >> 8);
+    }
+}
+
+// 3x3 box blur that never lowers a pixel: hard interiors, one pixel of soft edge.
+// Stays within each `cell`-wide glyph so neighbours in the atlas do not bleed in.
+std::vector<uint8_t> soften(const std::vector<uint8_t>& m, int w, int h, int cell)
+{
+    std::vector<uint8_t> out(m.size());
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            unsigned sum = 0;
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int yy = y + dy, xx = x + dx;
+                    if (yy >= 0 && yy < h && xx >= 0 && xx < w && xx / cell == x / cell)
+                        sum += m[static_cast<size_t>(yy) * w + xx];
+                }
+            const size_t i = static_cast<size_t>(y) * w + x;
+            out[i] = std::max<uint8_t>(m[i], static_cast<uint8_t>(sum / 9));
+        }
+    return out;
+}
+
+} // namespace
+
+bool TextOverlay::has_glyph(char c)
+{
+    for (const auto& g : kFont)
+        if (g.c == c) return true;
+    return false;
+}
+
+TextOverlay::TextOverlay(const Options& opt)
+    : opt_(opt), clock_offset_ns_(kUnanchored)
+{
+    // Bayer: build at half scale, then blow every pixel up to a 2x2 CFA cell.
+    const int rep = opt_.bayer ? 2 : 1;
+    const int s = std::max(1, opt_.bayer ? opt_.scale / 2 : opt_.scale);
+    const int pad = std::max(1, s / 2);            // room for the outline
+    const int gw = kFontW * s + s + 2 * pad;       // one font pixel of spacing
+    const int gh = kFontH * s + 2 * pad;
+    const int w = gw * kGlyphs;
+
+    std::fill(std::begin(glyph_of_), std::end(glyph_of_), 0);   // unknown -> space
+    std::vector<uint8_t> mask(static_cast<size_t>(w) * gh, 0);
+    for (int g = 0; g < kGlyphs; ++g) {
+        glyph_of_[static_cast<uint8_t>(kFont[g].c)] = g;
+        for (int fy = 0; fy < kFontH; ++fy)
+            for (int fx = 0; fx < kFontW; ++fx) {
+                if (!(kFont[g].rows[fy] & (0x10 >> fx))) continue;
+                for (int y = 0; y < s; ++y)
+                    std::memset(&mask[static_cast<size_t>(pad + fy * s + y) * w + g * gw + pad + fx * s], 255,
+                                static_cast<size_t>(s));
+            }
+    }
+
+    // Outline: the glyph grown by `pad` in every direction.
+    std::vector<uint8_t> grown(mask.size(), 0);
+    for (int y = 0; y < gh; ++y)
+        for (int x = 0; x < w; ++x) {
+            uint8_t m = 0;
+            for (int dy = -pad; dy <= pad && !m; ++dy)
+                for (int dx = -pad; dx <= pad && !m; ++dx) {
+                    const int yy = y + dy, xx = x + dx;
+                    if (yy >= 0 && yy < gh && xx >= 0 && xx < w && xx / gw == x / gw)
+                        m = mask[static_cast<size_t>(yy) * w + xx];
+                }
+            grown[static_cast<size_t>(y) * w + x] = m;
+        }
+    const auto text_a = soften(mask, w, gh, gw);
+    const auto line_a = soften(grown, w, gh, gw);
+
+    // Outline under text, folded into one (alpha, value) per pixel:
+    // A = 1 - (1 - ao)(1 - at), V * A = outline * ao * (1 - at) + text * at.
+    cell_w_ = gw * rep;
+    cell_h_ = gh * rep;
+    atlas_w_ = w * rep;
+    alpha_.assign(static_cast<size_t>(atlas_w_) * cell_h_, 0);
+    value_.assign(alpha_.size(), 0);
+    for (int y = 0; y < gh; ++y)
+        for (int x = 0; x < w; ++x) {
+            const double at = text_a[static_cast<size_t>(y) * w + x] / 255.0;
+            const double ao = line_a[static_cast<size_t>(y) * w + x] / 255.0 * 0.75;
+            const double A = 1.0 - (1.0 - ao) * (1.0 - at);
+            const double V = A > 0 ? (opt_.outline * ao * (1.0 - at) + opt_.text * at) / A : 0.0;
+            for (int ry = 0; ry < rep; ++ry)
+                for (int rx = 0; rx < rep; ++rx) {
+                    const size_t i = static_cast<size_t>(y * rep + ry) * atlas_w_ + x * rep + rx;
+                    alpha_[i] = static_cast<uint8_t>(A * 255.0 + 0.5);
+                    value_[i] = static_cast<uint8_t>(std::min(255.0, V + 0.5));
+                }
+        }
+}
+
+// Atlas alpha (and value, if `v`) of strip columns [c0, c1) in cell row `row`.
+void TextOverlay::fill_strip(const std::string& text, int row, int c0, int c1, uint8_t* a, uint8_t* v) const
+{
+    const size_t src = static_cast<size_t>(row) * atlas_w_;
+    for (int c = c0; c < c1;) {
+        const int gx = c % cell_w_;
+        const int n = std::min(cell_w_ - gx, c1 - c);
+        const size_t off = src + static_cast<size_t>(glyph_of_[static_cast<uint8_t>(text[c / cell_w_])]) * cell_w_ + gx;
+        std::memcpy(a + (c - c0), &alpha_[off], static_cast<size_t>(n));
+        if (v) std::memcpy(v + (c - c0), &value_[off], static_cast<size_t>(n));
+        c += n;
+    }
+}
+
+void TextOverlay::draw(uint8_t* plane, int stride, int w, int h, int x, int y, const std::string& text,
+                       const Chroma* chroma) const
+{
+    if (opt_.bayer) { x &= ~1; y &= ~1; }
+    const int tw = text_width(text);
+    const int x0 = std::max(0, x), x1 = std::min(w, x + tw);
+    const int y0 = std::max(0, y), y1 = std::min(h, y + cell_h_);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    uint8_t a[kChunk], v[kChunk];
+    for (int row = y0; row < y1; ++row)
+        for (int c0 = x0; c0 < x1; c0 += kChunk) {
+            const int c1 = std::min(x1, c0 + kChunk);
+            fill_strip(text, row - y, c0 - x, c1 - x, a, v);
+            blend_row(plane + static_cast<size_t>(row) * stride + c0, a, v, c1 - c0);
+        }
+    if (chroma && chroma->u && chroma->v && !opt_.bayer)
+        neutralize(*chroma, text, x, y, x0, x1, y0, y1);
+}
+
+// Each chroma sample is blended towards 128 by the strongest glyph alpha of
+// the luma block it covers, so edges shared with the scene lose their tint too.
+void TextOverlay::neutralize(const Chroma& c, const std::string& text, int x, int y,
+                             int x0, int x1, int y0, int y1) const
+{
+    static const struct Gray { uint8_t p[kChunk]; Gray() { std::memset(p, 128, sizeof(p)); } } gray;
+    const int sx = c.shift_x, sy = c.shift_y;
+    const int cx0 = x0 >> sx, cx1 = ((x1 - 1) >> sx) + 1;
+    const int cy0 = y0 >> sy, cy1 = ((y1 - 1) >> sy) + 1;
+    const int span = kChunk >> sx;    // chroma columns whose luma fits one strip
+
+    uint8_t a[kChunk], ca[kChunk];
+    for (int cy = cy0; cy < cy1; ++cy) {
+        const int ly0 = std::max(y0, cy << sy), ly1 = std::min(y1, (cy + 1) << sy);
+        for (int k0 = cx0; k0 < cx1; k0 += span) {
+            const int k1 = std::min(cx1, k0 + span);
+            const int lx0 = std::max(x0, k0 << sx), lx1 = std::min(x1, k1 << sx);
+            std::memset(ca, 0, static_cast<size_t>(k1 - k0));
+            for (int ly = ly0; ly < ly1; ++ly) {
+                fill_strip(text, ly - y, lx0 - x, lx1 - x, a, nullptr);
+                for (int i = 0; i < lx1 - lx0; ++i) {
+                    uint8_t& m = ca[((lx0 + i) >> sx) - k0];
+                    m = std::max(m, a[i]);
+                }
+            }
+            blend_row(c.u + static_cast<size_t>(cy) * c.u_stride + k0, ca, gray.p, k1 - k0);
+            blend_row(c.v + static_cast<size_t>(cy) * c.v_stride + k0, ca, gray.p, k1 - k0);
+        }
+    }
+}
+
+void TextOverlay::stamp(uint8_t* plane, int stride, int w, int h, uint64_t frame, uint64_t ts_ns,
+                        const Chroma* chroma) const
+{
+    int64_t offset = clock_offset_ns_.load(std::memory_order_relaxed);
+    if (offset == kUnanchored) {
+        const int64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        const int64_t mine = wall - static_cast<int64_t>(ts_ns);
+        // Whoever gets here first sets the anchor; on failure `offset` holds theirs.
+        if (clock_offset_ns_.compare_exchange_strong(offset, mine)) offset = mine;
+    }
+    const int64_t wall_ns = static_cast<int64_t>(ts_ns) + offset;
+    const time_t secs = static_cast<time_t>(wall_ns / 1000000000);
+    struct tm tm_local;
+    localtime_r(&secs, &tm_local);
+
+    char left[32], right[32];
+    snprintf(left, sizeof(left), "F%llu", static_cast<unsigned long long>(frame));
+    snprintf(right, sizeof(right), "%02d:%02d:%02d.%03d", tm_local.tm_hour, tm_local.tm_min, tm_local.tm_sec,
+             static_cast<int>((wall_ns / 1000000) % 1000));
+
+    draw(plane, stride, w, h, opt_.margin, opt_.margin, left, chroma);
+    draw(plane, stride, w, h, w - opt_.margin - text_width(right), opt_.margin, right, chroma);
+}
+
+} // namespace cambuffer_recorder_ng
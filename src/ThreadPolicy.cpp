@@ -0,0 +1,175 @@
+#include "cambuffer_recorder_ng/ThreadPolicy.hpp"
+#include <algorithm>
+#include <alloca.h>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+std::mutex report_mtx;
+std::vector<ThreadPolicyStatus> report;
+
+void add_report(ThreadPolicyStatus st)
+{
+    std::lock_guard<std::mutex> lock(report_mtx);
+    report.push_back(std::move(st));
+}
+
+std::string errno_text(int err)
+{
+    if (err == EPERM)
+        return "permission denied (raise rtprio/memlock in /etc/security/limits.conf or grant CAP_SYS_NICE)";
+    return std::strerror(err);
+}
+
+// Stack left below the caller's frame, less a margin for the frames still to come.
+size_t stack_room()
+{
+    constexpr size_t kMargin = 64 * 1024;
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) return 0;
+    void* lo = nullptr;
+    size_t size = 0;
+    const bool ok = pthread_attr_getstack(&attr, &lo, &size) == 0;
+    pthread_attr_destroy(&attr);
+    if (!ok) return 0;
+    char here;
+    const size_t used = static_cast<size_t>(static_cast<char*>(lo) + size - &here);
+    return size > used + kMargin ? size - used - kMargin : 0;
+}
+
+// Touch `bytes` below the current frame; noinline so the alloca is popped on return.
+// Clamped to the room the thread has, since alloca past the guard page is a crash.
+__attribute__((noinline)) void prefault_stack(size_t bytes)
+{
+    bytes = std::min(bytes, stack_room());
+    if (!bytes) return;
+    volatile char* p = static_cast<volatile char*>(alloca(bytes));
+    const long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < bytes; i += static_cast<size_t>(page)) p[i] = 0;
+}
+
+// From linux/ioprio.h, which glibc does not wrap.
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioClassShift = 13;
+
+int io_class_value(const std::string& cls)
+{
+    if (cls == "rt")   return 1;
+    if (cls == "be")   return 2;
+    if (cls == "idle") return 3;
+    return -1;
+}
+
+} // namespace
+
+const char* role_name(ThreadRole role)
+{
+    switch (role) {
+        case ThreadRole::Capture: return "capture";
+        case ThreadRole::Process: return "process";
+        case ThreadRole::Encode:  return "encode";
+        case ThreadRole::Io:      return "io";
+        case ThreadRole::Preview: return "preview";
+    }
+    return "?";
+}
+
+bool apply_thread_policy(ThreadRole role, const ThreadPolicy& policy, const std::string& thread_name,
+                         std::string* detail)
+{
+    ThreadPolicyStatus st;
+    st.thread = thread_name;
+    st.role = role_name(role);
+    auto fail = [&st](const std::string& what) {
+        st.ok = false;
+        st.detail += (st.detail.empty() ? "" : "; ") + what;
+    };
+
+    pthread_setname_np(pthread_self(), thread_name.substr(0, 15).c_str());
+
+    if (!policy.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : policy.cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err) fail("affinity: " + errno_text(err));
+    }
+
+    int sched = SCHED_OTHER;
+    if (policy.sched == "fifo")    sched = SCHED_FIFO;
+    else if (policy.sched == "rr") sched = SCHED_RR;
+    else if (policy.sched == "batch") sched = SCHED_BATCH;
+    else if (policy.sched == "idle")  sched = SCHED_IDLE;
+    else if (policy.sched != "other") fail("unknown sched '" + policy.sched + "'");
+    const bool rt = sched == SCHED_FIFO || sched == SCHED_RR;
+
+    sched_param sp{};
+    if (rt) {
+        const int lo = sched_get_priority_min(sched), hi = sched_get_priority_max(sched);
+        sp.sched_priority = policy.priority < lo ? lo : policy.priority > hi ? hi : policy.priority;
+    }
+    int err = pthread_setschedparam(pthread_self(), sched, &sp);
+    if (err) fail(policy.sched + " priority " + std::to_string(sp.sched_priority) + ": " + errno_text(err));
+
+    if (!policy.io_class.empty()) {
+        const int cls = io_class_value(policy.io_class);
+        const int level = policy.io_level < 0 ? 0 : policy.io_level > 7 ? 7 : policy.io_level;
+        // who = 0: the calling thread (I/O priority is per thread on Linux).
+        if (cls < 0)
+            fail("unknown io_class '" + policy.io_class + "'");
+        else if (syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, (cls << kIoprioClassShift) | (cls == 3 ? 0 : level)) != 0)
+            fail("ioprio " + policy.io_class + ": " + errno_text(errno));
+    }
+
+    if (policy.stack_kb) prefault_stack(policy.stack_kb * 1024);
+
+    if (st.ok)
+        st.detail = policy.sched + (rt ? " " + std::to_string(sp.sched_priority) : "")
+                    + (policy.cpus.empty() ? "" : ", " + std::to_string(policy.cpus.size()) + " cpu(s)")
+                    + (policy.io_class.empty() ? "" : ", io " + policy.io_class);
+    const bool ok = st.ok;
+    if (detail) *detail = st.detail;
+    add_report(std::move(st));
+    return ok;
+}
+
+bool lock_process_memory(std::string* detail)
+{
+    ThreadPolicyStatus st;
+    st.thread = "mlockall";
+    st.role = "process";
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        st.ok = false;
+        st.detail = errno_text(errno);
+    } else {
+        st.detail = "locked";
+    }
+    const bool ok = st.ok;
+    if (detail) *detail = st.detail;
+    add_report(std::move(st));
+    return ok;
+}
+
+std::vector<ThreadPolicyStatus> thread_policy_report()
+{
+    std::lock_guard<std::mutex> lock(report_mtx);
+    return report;
+}
+
+void clear_thread_policy_report()
+{
+    std::lock_guard<std::mutex> lock(report_mtx);
+    report.clear();
+}
+
+} // namespace cambuffer_recorder_ng
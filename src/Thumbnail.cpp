@@ -0,0 +1,195 @@
+#include "cambuffer_recorder_ng/Thumbnail.hpp"
+#include <cstring>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cambuffer_recorder_ng {
+
+namespace {
+
+// Per output column, sums of even- and odd-column bytes, split by row parity:
+// sums[row & 1][col & 1][block]. Those four are exactly the four CFA sites.
+struct BlockSums {
+    std::vector<uint32_t> s[2][2];
+
+    void reset(int blocks)
+    {
+        for (auto& r : s)
+            for (auto& c : r) c.assign(static_cast<size_t>(blocks), 0);
+    }
+};
+
+// Add one row's even/odd byte sums for each `factor`-wide block.
+void add_row(const uint8_t* row, int blocks, int factor, uint32_t* even, uint32_t* odd)
+{
+    int b = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i even_mask = _mm_set1_epi16(0x00FF);
+    auto lo = [](__m128i v) { return static_cast<uint32_t>(_mm_cvtsi128_si32(v)); };
+    auto hi = [](__m128i v) { return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(v, 8))); };
+
+    if (factor == 8) {
+        // 16 bytes = 2 blocks; psadbw sums each 8-byte half.
+        for (; b + 2 <= blocks; b += 2) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + b * 8));
+            const __m128i e = _mm_sad_epu8(_mm_and_si128(v, even_mask), zero);
+            const __m128i o = _mm_sad_epu8(_mm_andnot_si128(even_mask, v), zero);
+            even[b] += lo(e); even[b + 1] += hi(e);
+            odd[b] += lo(o);  odd[b + 1] += hi(o);
+        }
+    } else if (factor == 4) {
+        // 16 bytes = 4 blocks; mask to the low/high 4 bytes of each half first.
+        const __m128i lo4 = _mm_set1_epi64x(0x00000000FFFFFFFFll);
+        const __m128i e_lo = _mm_and_si128(even_mask, lo4), e_hi = _mm_andnot_si128(lo4, even_mask);
+        const __m128i o_lo = _mm_andnot_si128(even_mask, lo4);
+        const __m128i o_hi = _mm_andnot_si128(_mm_or_si128(even_mask, lo4), _mm_set1_epi8(-1));
+        for (; b + 4 <= blocks; b += 4) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + b * 4));
+            const __m128i el = _mm_sad_epu8(_mm_and_si128(v, e_lo), zero);
+            const __m128i eh = _mm_sad_epu8(_mm_and_si128(v, e_hi), zero);
+            const __m128i ol = _mm_sad_epu8(_mm_and_si128(v, o_lo), zero);
+            const __m128i oh = _mm_sad_epu8(_mm_and_si128(v, o_hi), zero);
+            even[b] += lo(el); even[b + 1] += lo(eh); even[b + 2] += hi(el); even[b + 3] += hi(eh);
+            odd[b] += lo(ol);  odd[b + 1] += lo(oh);  odd[b + 2] += hi(ol);  odd[b + 3] += hi(oh);
+        }
+    }
+#endif
+    for (; b < blocks; ++b) {
+        const uint8_t* p = row + b * factor;
+        for (int i = 0; i < factor; i += 2) {
+            even[b] += p[i];
+            odd[b] += p[i + 1];
+        }
+    }
+}
+
+// Accumulate one band of `factor` rows into sums.
+void accumulate_band(const uint8_t* band, int blocks, int stride, int factor, BlockSums& bs)
+{
+    bs.reset(blocks);
+    for (int r = 0; r < factor; ++r)
+        add_row(band + static_cast<size_t>(r) * stride, blocks, factor,
+                bs.s[r & 1][0].data(), bs.s[r & 1][1].data());
+}
+
+// [row parity][col parity] of R, G1, G2, B within a 2x2 cell.
+struct Sites { int r[2], g1[2], g2[2], b[2]; };
+
+Sites cfa_sites(BayerPattern p)
+{
+    switch (p) {
+        case BayerPattern::RGGB: return {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+        case BayerPattern::GRBG: return {{0, 1}, {0, 0}, {1, 1}, {1, 0}};
+        case BayerPattern::BGGR: return {{1, 1}, {0, 1}, {1, 0}, {0, 0}};
+        case BayerPattern::GBRG: break;
+    }
+    return {{1, 0}, {0, 0}, {1, 1}, {0, 1}};   // GBRG: row0 G B / row1 R G
+}
+
+thread_local BlockSums scratch;
+
+} // namespace
+
+void bayer_thumbnail_gray(const uint8_t* src, int w, int h, int stride, int factor,
+                          uint8_t* dst, int& out_w, int& out_h)
+{
+    factor &= ~1;
+    out_w = factor > 0 ? w / factor : 0;
+    out_h = factor > 0 ? h / factor : 0;
+    const uint32_t n = static_cast<uint32_t>(factor * factor);
+
+    for (int y = 0; y < out_h; ++y) {
+        accumulate_band(src + static_cast<size_t>(y) * factor * stride, out_w, stride, factor, scratch);
+        uint8_t* out = dst + static_cast<size_t>(y) * out_w;
+        for (int x = 0; x < out_w; ++x) {
+            const uint32_t sum = scratch.s[0][0][x] + scratch.s[0][1][x]
+                               + scratch.s[1][0][x] + scratch.s[1][1][x];
+            out[x] = static_cast<uint8_t>((sum + n / 2) / n);
+        }
+    }
+}
+
+void bayer_thumbnail_rgb(const uint8_t* src, int w, int h, int stride, int factor,
+                         BayerPattern pattern, uint8_t* dst, int& out_w, int& out_h)
+{
+    factor &= ~1;
+    out_w = factor > 0 ? w / factor : 0;
+    out_h = factor > 0 ? h / factor : 0;
+    const uint32_t n = static_cast<uint32_t>(factor * factor / 4);   // samples per CFA site
+    const Sites st = cfa_sites(pattern);
+
+    for (int y = 0; y < out_h; ++y) {
+        accumulate_band(src + static_cast<size_t>(y) * factor * stride, out_w, stride, factor, scratch);
+        const auto& R = scratch.s[st.r[0]][st.r[1]];
+        const auto& G1 = scratch.s[st.g1[0]][st.g1[1]];
+        const auto& G2 = scratch.s[st.g2[0]][st.g2[1]];
+        const auto& B = scratch.s[st.b[0]][st.b[1]];
+        uint8_t* out = dst + static_cast<size_t>(y) * out_w * 3;
+        for (int x = 0; x < out_w; ++x, out += 3) {
+            out[0] = static_cast<uint8_t>((R[x] + n / 2) / n);
+            out[1] = static_cast<uint8_t>((G1[x] + G2[x] + n) / (2 * n));
+            out[2] = static_cast<uint8_t>((B[x] + n / 2) / n);
+        }
+    }
+}
+
+void bayer_green_sparse(const uint8_t* src, int w, int h, int stride, int factor,
+                        BayerPattern pattern, uint8_t* dst, int& out_w, int& out_h)
+{
+    factor &= ~1;
+    out_w = factor > 0 ? w / factor : 0;
+    out_h = factor > 0 ? h / factor : 0;
+    const Sites st = cfa_sites(pattern);
+    const int n = factor;   // factor / 2 G sites from each row of the pair
+
+    for (int y = 0; y < out_h; ++y) {
+        // G1 and G2 sit on different rows of the pair, in opposite columns.
+        const uint8_t* a = src + static_cast<size_t>(y * factor + st.g1[0]) * stride + st.g1[1];
+        const uint8_t* b = src + static_cast<size_t>(y * factor + st.g2[0]) * stride + st.g2[1];
+        uint8_t* out = dst + static_cast<size_t>(y) * out_w;
+        int x = 0;
+#if defined(__SSE2__)
+        // Starting at the G column makes both rows' greens the even bytes.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i even = _mm_set1_epi16(0x00FF);
+        const int span = out_w * factor - 16;   // last full load inside the row
+        auto sums = [&](int off, __m128i mask) {   // per 8 bytes: greens of both rows
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + off));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + off));
+            return _mm_add_epi64(_mm_sad_epu8(_mm_and_si128(va, mask), zero),
+                                 _mm_sad_epu8(_mm_and_si128(vb, mask), zero));
+        };
+        auto mean = [n](__m128i v, int half) {
+            const uint32_t s = static_cast<uint32_t>(_mm_cvtsi128_si32(half ? _mm_srli_si128(v, 8) : v));
+            return static_cast<uint8_t>((s + n / 2) / n);
+        };
+        if (factor == 8) {
+            for (; x + 2 <= out_w && x * 8 <= span - 1; x += 2) {
+                const __m128i s = sums(x * 8, even);
+                out[x] = mean(s, 0);
+                out[x + 1] = mean(s, 1);
+            }
+        } else if (factor == 4) {
+            const __m128i lo4 = _mm_set1_epi64x(0x00000000FFFFFFFFll);
+            const __m128i e_lo = _mm_and_si128(even, lo4), e_hi = _mm_andnot_si128(lo4, even);
+            for (; x + 4 <= out_w && x * 4 <= span - 1; x += 4) {
+                const __m128i l = sums(x * 4, e_lo), hs = sums(x * 4, e_hi);
+                out[x] = mean(l, 0);
+                out[x + 1] = mean(hs, 0);
+                out[x + 2] = mean(l, 1);
+                out[x + 3] = mean(hs, 1);
+            }
+        }
+#endif
+        for (; x < out_w; ++x) {
+            uint32_t sum = 0;
+            for (int i = 0; i < factor; i += 2) sum += a[x * factor + i] + b[x * factor + i];
+            out[x] = static_cast<uint8_t>((sum + n / 2) / n);
+        }
+    }
+}
+
+} // namespace cambuffer_recorder_ng
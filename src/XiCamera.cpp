@@ -1,8 +1,11 @@
 #include <m3api/xiApi.h> 
 #include "cambuffer_recorder_ng/XiCamera.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstring>
 #include <iostream>
+#include <string>
 
 namespace cambuffer_recorder_ng {
 
@@ -15,13 +18,26 @@ void XiCamera::open(int device_index)
     std::memset(&image_, 0, sizeof(image_));
     image_.size = sizeof(XI_IMG);
 
-    xiGetParamInt(handle_, XI_PRM_WIDTH, &width_);
-    xiGetParamInt(handle_, XI_PRM_HEIGHT, &height_);
+    apply_bit_depth();
 
-    // Configure RAW8 format
-    xiSetParamInt(handle_, XI_PRM_IMAGE_DATA_FORMAT, XI_RAW8);
-    xiSetParamInt(handle_, XI_PRM_EXPOSURE, 10000);
-    xiSetParamInt(handle_, XI_PRM_GAIN, 0);
+    // Exposure/gain as last requested through set_exposure() (10000 us, 0 dB if never).
+    exposure_range_ = query_range(XI_PRM_EXPOSURE);
+    xiGetParamFloat(handle_, XI_PRM_GAIN XI_PRM_INFO_MIN, &gain_min_);
+    xiGetParamFloat(handle_, XI_PRM_GAIN XI_PRM_INFO_MAX, &gain_max_);
+    {
+        std::lock_guard<std::mutex> lock(exposure_mtx_);
+        apply_exposure(exposure_us_, gain_db_);
+    }
+
+    if (hw_trigger_) {
+        // External trigger on rising edge, one frame per edge, GPI pin 1 as source
+        xiSetParamInt(handle_, XI_PRM_TRG_SOURCE, XI_TRG_EDGE_RISING);
+        xiSetParamInt(handle_, XI_PRM_TRG_SELECTOR, XI_TRG_SEL_FRAME_START);
+        xiSetParamInt(handle_, XI_PRM_GPI_SELECTOR, 1);
+        xiSetParamInt(handle_, XI_PRM_GPI_MODE, XI_GPI_TRIGGER);
+    }
+
+    query_sensor();
 }
 
 void XiCamera::start()
@@ -46,23 +62,230 @@ void XiCamera::close()
     running_ = false;
 }
 
+bool XiCamera::set_roi(int& width, int& height, int& offset_x, int& offset_y)
+{
+    if (!handle_) return false;
+
+    Roi r = clamp_roi(Roi{width, height, offset_x, offset_y});
+    if (running_ && (r.width != width_ || r.height != height_)) {
+        std::cerr << "XiCamera: ROI size " << r.width << "x" << r.height
+                  << " refused while streaming (" << width_ << "x" << height_ << ")\n";
+        return false;
+    }
+    width = r.width; height = r.height; offset_x = r.offset_x; offset_y = r.offset_y;
+
+    if (!running_) {
+        apply_roi(r);
+        return true;
+    }
+
+    // Streaming: hand the window move to the grab thread so it lands between two frames.
+    std::lock_guard<std::mutex> lock(roi_mtx_);
+    pending_roi_ = r;
+    roi_pending_ = true;
+    return true;
+}
+
+bool XiCamera::set_exposure(double& exposure_us, double& gain_db)
+{
+    int e = static_cast<int>(std::lround(exposure_us));
+    float g = static_cast<float>(gain_db);
+    if (handle_) {
+        if (exposure_range_.max > exposure_range_.min)
+            e = std::clamp(e, exposure_range_.min, exposure_range_.max);
+        if (gain_max_ > gain_min_)
+            g = std::clamp(g, gain_min_, gain_max_);
+    }
+    exposure_us = e;
+    gain_db = g;
+
+    std::lock_guard<std::mutex> lock(exposure_mtx_);
+    exposure_us_ = e;
+    gain_db_ = g;
+    if (running_) exposure_pending_ = true;   // grab() writes it between frames
+    else if (handle_) apply_exposure(e, g);
+    return true;
+}
+
+bool XiCamera::set_downsampling(int factor, Downsampling mode, int& width, int& height)
+{
+    if (!handle_ || running_ || factor < 1) return false;
+
+    const int type = mode == Downsampling::Skipping ? XI_SKIPPING : XI_BINNING;
+    // On failure the camera goes back to exactly what it had, type included.
+    int prev_type = XI_BINNING, prev_factor = XI_DWN_1x1;
+    const bool have_type = xiGetParamInt(handle_, XI_PRM_DOWNSAMPLING_TYPE, &prev_type) == XI_OK;
+    if (xiGetParamInt(handle_, XI_PRM_DOWNSAMPLING, &prev_factor) != XI_OK) prev_factor = XI_DWN_1x1;
+    int got = 0;
+    if (factor > 1 && xiSetParamInt(handle_, XI_PRM_DOWNSAMPLING_TYPE, type) != XI_OK) {
+        std::cerr << "XiCamera: no " << (mode == Downsampling::Skipping ? "skipping" : "binning") << " mode\n";
+        return false;
+    }
+    if (xiSetParamInt(handle_, XI_PRM_DOWNSAMPLING, factor) != XI_OK ||
+        xiGetParamInt(handle_, XI_PRM_DOWNSAMPLING, &got) != XI_OK || got != factor) {
+        std::cerr << "XiCamera: no " << factor << "x" << factor << " downsampling\n";
+        xiSetParamInt(handle_, XI_PRM_DOWNSAMPLING, prev_factor);
+        if (have_type && factor > 1) xiSetParamInt(handle_, XI_PRM_DOWNSAMPLING_TYPE, prev_type);
+        query_sensor();
+        return false;
+    }
+    query_sensor();
+    width = width_;
+    height = height_;
+    return true;
+}
+
 bool XiCamera::grab(uint8_t*& data, size_t& size, uint64_t& ts,
                     int& width, int& height, int& stride, int timeout_ms)
 {
     if (!running_) return false;
+    if (roi_pending_) apply_pending_roi();
+    if (exposure_pending_) {
+        // Never wait on the controller: if it is mid-update, the next frame picks it up.
+        std::unique_lock<std::mutex> lock(exposure_mtx_, std::try_to_lock);
+        if (lock) {
+            exposure_pending_ = false;
+            apply_exposure(exposure_us_, gain_db_);
+        }
+    }
 
     XI_RETURN stat = xiGetImage(handle_, timeout_ms, &image_);
     if (stat != XI_OK) return false;
 
     data = static_cast<uint8_t*>(image_.bp);
-    size = image_.width * image_.height;
     width = image_.width;
     height = image_.height;
-    stride = image_.width;  // assume 1 byte per pixel for RAW8
+    // RAW8 / RAW16: 1 / 2 bytes per pixel, plus row padding in bytes
+    stride = static_cast<int>(image_.width) * (bit_depth_ > 8 ? 2 : 1) + static_cast<int>(image_.padding_x);
+    size = static_cast<size_t>(stride) * image_.height;
     ts = static_cast<uint64_t>(image_.tsSec) * 1'000'000'000ULL +
          static_cast<uint64_t>(image_.tsUSec) * 1000ULL;
     return true;
 }
 
-} // namespace cambuffer_recorder_ng
+// --------------- ROI helpers ---------------
+XiCamera::Range XiCamera::query_range(const char* prm) const
+{
+    Range r;
+    const std::string p(prm);
+    xiGetParamInt(handle_, (p + XI_PRM_INFO_MIN).c_str(), &r.min);
+    xiGetParamInt(handle_, (p + XI_PRM_INFO_MAX).c_str(), &r.max);
+    if (xiGetParamInt(handle_, (p + XI_PRM_INFO_INCREMENT).c_str(), &r.inc) != XI_OK || r.inc < 1)
+        r.inc = 1;
+    return r;
+}
 
+// Full-frame limits at the current downsampling; resets the ROI to all of it.
+void XiCamera::query_sensor()
+{
+    // Width/height limits are only the full sensor while the offsets are zero.
+    xiSetParamInt(handle_, XI_PRM_OFFSET_X, 0);
+    xiSetParamInt(handle_, XI_PRM_OFFSET_Y, 0);
+    sensor_w_ = query_range(XI_PRM_WIDTH);
+    sensor_h_ = query_range(XI_PRM_HEIGHT);
+    xiSetParamInt(handle_, XI_PRM_WIDTH, sensor_w_.max);
+    xiSetParamInt(handle_, XI_PRM_HEIGHT, sensor_h_.max);
+    off_x_    = query_range(XI_PRM_OFFSET_X);
+    off_y_    = query_range(XI_PRM_OFFSET_Y);
+
+    xiGetParamInt(handle_, XI_PRM_WIDTH, &width_);
+    xiGetParamInt(handle_, XI_PRM_HEIGHT, &height_);
+    roi_ = Roi{width_, height_, 0, 0};
+}
+
+XiCamera::Roi XiCamera::clamp_roi(Roi r) const
+{
+    auto fit = [](int v, const Range& rng, int max) {
+        if (v <= 0 || v > max) v = max;               // 0 = full sensor
+        v -= (v - rng.min) % rng.inc;                 // round down onto the increment grid
+        return std::max(v, rng.min);
+    };
+    r.width  = fit(r.width,  sensor_w_, sensor_w_.max);
+    r.height = fit(r.height, sensor_h_, sensor_h_.max);
+
+    auto place = [](int v, const Range& rng, int room) {
+        v = std::clamp(v, 0, std::max(room, 0));
+        return v - v % rng.inc;
+    };
+    r.offset_x = place(r.offset_x, off_x_, sensor_w_.max - r.width);
+    r.offset_y = place(r.offset_y, off_y_, sensor_h_.max - r.height);
+    return r;
+}
+
+// Must be called with acquisition stopped.
+void XiCamera::apply_roi(const Roi& r)
+{
+    // Zero the offsets first so the new size always fits, then place the window.
+    xiSetParamInt(handle_, XI_PRM_OFFSET_X, 0);
+    xiSetParamInt(handle_, XI_PRM_OFFSET_Y, 0);
+    xiSetParamInt(handle_, XI_PRM_WIDTH,  r.width);
+    xiSetParamInt(handle_, XI_PRM_HEIGHT, r.height);
+    xiSetParamInt(handle_, XI_PRM_OFFSET_X, r.offset_x);
+    xiSetParamInt(handle_, XI_PRM_OFFSET_Y, r.offset_y);
+
+    xiGetParamInt(handle_, XI_PRM_WIDTH, &width_);
+    xiGetParamInt(handle_, XI_PRM_HEIGHT, &height_);
+    roi_ = r;
+    roi_.width = width_;
+    roi_.height = height_;
+}
+
+void XiCamera::apply_pending_roi()
+{
+    Roi r;
+    {
+        std::lock_guard<std::mutex> lock(roi_mtx_);
+        r = pending_roi_;
+        roi_pending_ = false;
+    }
+
+    // set_roi() only queues window moves: the size stays what start() had.
+    // Most sensors accept the move while streaming; try that first.
+    if (xiSetParamInt(handle_, XI_PRM_OFFSET_X, r.offset_x) == XI_OK &&
+        xiSetParamInt(handle_, XI_PRM_OFFSET_Y, r.offset_y) == XI_OK) {
+        roi_ = r;
+        return;
+    }
+
+    // Sensors without live offsets need a short restart, at the same size.
+    xiStopAcquisition(handle_);
+    apply_roi(r);
+    xiStartAcquisition(handle_);
+}
+
+// RAW8, or RAW16 with the sensor ADC and output at bit_depth_ (10 / 12 on
+// most models). Falls back to RAW8 if the camera has no deeper mode.
+void XiCamera::apply_bit_depth()
+{
+    if (bits_requested_ > 8) {
+        int max_bits = 8;
+        xiGetParamInt(handle_, XI_PRM_SENSOR_DATA_BIT_DEPTH XI_PRM_INFO_MAX, &max_bits);
+        const int bits = std::min(bits_requested_, max_bits);
+        if (bits > 8 &&
+            xiSetParamInt(handle_, XI_PRM_IMAGE_DATA_FORMAT, XI_RAW16) == XI_OK &&
+            xiSetParamInt(handle_, XI_PRM_SENSOR_DATA_BIT_DEPTH, bits) == XI_OK &&
+            xiSetParamInt(handle_, XI_PRM_OUTPUT_DATA_BIT_DEPTH, bits) == XI_OK) {
+            // The camera may still round (e.g. 14 -> 12); believe what it reports.
+            int got = bits;
+            if (xiGetParamInt(handle_, XI_PRM_OUTPUT_DATA_BIT_DEPTH, &got) != XI_OK || got <= 8) got = bits;
+            if (got != bits_requested_)
+                std::cerr << "XiCamera: " << bits_requested_ << "-bit requested, using " << got << "\n";
+            bit_depth_ = got;
+            return;
+        }
+        std::cerr << "XiCamera: no " << bits_requested_ << "-bit mode, falling back to RAW8\n";
+    }
+    bit_depth_ = 8;
+    xiSetParamInt(handle_, XI_PRM_IMAGE_DATA_FORMAT, XI_RAW8);
+}
+
+// Called with exposure_mtx_ held.
+void XiCamera::apply_exposure(int exposure_us, float gain_db)
+{
+    if (xiSetParamInt(handle_, XI_PRM_EXPOSURE, exposure_us) != XI_OK)
+        std::cerr << "XiCamera: cannot set exposure " << exposure_us << " us\n";
+    if (xiSetParamFloat(handle_, XI_PRM_GAIN, gain_db) != XI_OK)
+        std::cerr << "XiCamera: cannot set gain " << gain_db << " dB\n";
+}
+
+} // namespace cambuffer_recorder_ng
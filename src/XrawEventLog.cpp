@@ -0,0 +1,87 @@
+#include "cambuffer_recorder_ng/XrawEventLog.hpp"
+#include "cambuffer_recorder_ng/XrawReader.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace cambuffer_recorder_ng {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::vector<std::string> lines_for(const XrawReader& reader)
+{
+    const size_t n = reader.size();
+    std::vector<std::string> out;
+    for (const auto& ev : reader.events()) {
+        const uint64_t next = ev.before_frame < n ? reader.frame(ev.before_frame).frame_index
+                            : n ? reader.frame(n - 1).frame_index + 1 : 0;
+        std::string text = ev.text;
+        for (auto& c : text)
+            if (c == '\n' || c == '\r') c = ' ';
+        out.push_back(std::to_string(ev.ts_ns) + " " + std::to_string(next) + " " + text);
+    }
+    return out;
+}
+
+} // namespace
+
+std::string XrawEventLog::path_for(const std::string& output)
+{
+    const fs::path p(output);
+    return (p.parent_path() / p.stem()).string() + ".events.log";
+}
+
+bool XrawEventLog::write(const XrawReader& reader, const std::string& path)
+{
+    std::error_code ec;
+    const auto lines = lines_for(reader);
+    if (lines.empty()) {
+        fs::remove(path, ec);
+        return true;
+    }
+
+    // Via a temporary name, so a sidecar that exists is always complete.
+    const std::string tmp = path + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "w");
+    if (!fp) { perror(("XrawEventLog: fopen " + tmp).c_str()); return false; }
+    for (const auto& l : lines) fprintf(fp, "%s\n", l.c_str());
+    const bool ok = !ferror(fp);
+    if (fclose(fp) != 0 || !ok) {
+        perror(("XrawEventLog: write " + tmp).c_str());
+        std::remove(tmp.c_str());
+        return false;
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "XrawEventLog: rename " << tmp << ": " << ec.message() << "\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool XrawEventLog::matches(const XrawReader& reader, const std::string& path, std::string* why)
+{
+    const auto want = lines_for(reader);
+    std::vector<std::string> got;
+    std::ifstream in(path);
+    for (std::string line; std::getline(in, line);) got.push_back(line);
+
+    if (got.size() != want.size()) {
+        if (why) *why = std::to_string(want.size()) + " events recorded, " + std::to_string(got.size()) +
+                        " in " + path;
+        return false;
+    }
+    for (size_t i = 0; i < want.size(); ++i)
+        if (got[i] != want[i]) {
+            if (why) *why = "event " + std::to_string(i) + " differs in " + path;
+            return false;
+        }
+    return true;
+}
+
+} // namespace cambuffer_recorder_ng
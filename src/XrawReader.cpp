@@ -0,0 +1,367 @@
+#include "cambuffer_recorder_ng/XrawReader.hpp"
+#include "cambuffer_recorder_ng/RawPack.hpp"
+#include "cambuffer_recorder_ng/XrawFormat.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#include <lz4frame.h>
+#endif
+
+namespace cambuffer_recorder_ng {
+
+namespace fs = std::filesystem;
+
+std::vector<std::string> XrawReader::expand(const std::string& path)
+{
+    std::vector<std::string> out;
+    std::error_code ec;
+
+    if (fs::is_directory(path, ec)) {
+        for (const auto& e : fs::directory_iterator(path, ec))
+            if (e.path().extension() == ".xraw") out.push_back(e.path().string());
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    // prefix_0003.xraw -> prefix_0003.xraw, prefix_0004.xraw, ... while they exist
+    const std::string ext = ".xraw";
+    const size_t n = path.size();
+    if (n > ext.size() + 5 && path.compare(n - ext.size(), ext.size(), ext) == 0 &&
+        path[n - ext.size() - 5] == '_' &&
+        std::all_of(path.end() - ext.size() - 4, path.end() - ext.size(), ::isdigit)) {
+        const std::string prefix = path.substr(0, n - ext.size() - 5);
+        unsigned idx = std::stoul(path.substr(n - ext.size() - 4, 4));
+        char name[4096];
+        for (;; ++idx) {
+            snprintf(name, sizeof(name), "%s_%04u.xraw", prefix.c_str(), idx);
+            if (!fs::exists(name, ec)) break;
+            out.emplace_back(name);
+        }
+        return out;
+    }
+
+    out.push_back(path);
+    return out;
+}
+
+bool XrawReader::open(const std::string& path)
+{
+    const std::string ext = ".xrawm";
+    if (path.size() > ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0)
+        return open_manifest(path);
+    return open(expand(path));
+}
+
+bool XrawReader::open_manifest(const std::string& path)
+{
+    close();
+    std::ifstream in(path);
+    std::string line;
+    if (!in || !std::getline(in, line) || line.rfind("XRAWSTRIPE", 0) != 0) {
+        std::cerr << "XrawReader: " << path << " is not an XRAW stripe manifest\n";
+        return false;
+    }
+
+    struct Entry { bool frame; size_t lane; uint64_t frame_index; };
+    std::vector<std::string> prefixes;
+    std::vector<Entry> order;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string tag;
+        Entry e{};
+        ls >> tag >> e.lane;
+        if (!ls) break;                                    // torn last line
+        if (tag == "lane") {
+            std::string prefix;
+            std::getline(ls >> std::ws, prefix);
+            if (prefixes.size() <= e.lane) prefixes.resize(e.lane + 1);
+            prefixes[e.lane] = prefix;
+        } else if (tag == "f" && (ls >> e.frame_index)) {
+            e.frame = true;
+            order.push_back(e);
+        } else if (tag == "e") {
+            order.push_back(e);
+        }
+    }
+
+    // Lanes are looked up where they were written, then next to the manifest
+    // (for a recording copied off its disks into one directory).
+    const fs::path here = fs::path(path).parent_path();
+    std::vector<std::string> files;
+    std::vector<size_t> file_lane;
+    for (size_t k = 0; k < prefixes.size(); ++k) {
+        auto lane_files = expand(prefixes[k] + "_0000.xraw");
+        if (lane_files.empty())
+            lane_files = expand((here / fs::path(prefixes[k]).filename()).string() + "_0000.xraw");
+        if (lane_files.empty())
+            std::cerr << "XrawReader: lane " << k << " (" << prefixes[k] << ") not found\n";
+        for (auto& f : lane_files) {
+            files.push_back(std::move(f));
+            file_lane.push_back(k);
+        }
+    }
+    if (!open(files)) return false;
+
+    const size_t lanes = prefixes.size();
+    std::vector<std::vector<Frame>> lane_frames(lanes);
+    std::vector<std::vector<Event>> lane_events(lanes);
+    for (const auto& f : index_) lane_frames[file_lane[f.file]].push_back(f);
+    for (const auto& ev : events_) lane_events[file_lane[ev.file]].push_back(ev);
+
+    // Replay the manifest, taking each lane's records in the order it wrote them.
+    std::vector<Frame> merged;
+    std::vector<Event> merged_events;
+    std::vector<size_t> fpos(lanes, 0), epos(lanes, 0);
+    size_t mismatched = 0;
+    for (const auto& e : order) {
+        if (e.lane >= lanes) continue;
+        if (e.frame) {
+            if (fpos[e.lane] >= lane_frames[e.lane].size()) continue;   // lost with a failed lane
+            const Frame& f = lane_frames[e.lane][fpos[e.lane]++];
+            if (f.frame_index != e.frame_index) mismatched++;
+            merged.push_back(f);
+        } else if (epos[e.lane] < lane_events[e.lane].size()) {
+            Event ev = lane_events[e.lane][epos[e.lane]++];
+            ev.before_frame = merged.size();
+            merged_events.push_back(std::move(ev));
+        }
+    }
+
+    // Records past the manifest's end (torn by a crash) follow in timestamp order.
+    const size_t listed = merged.size();
+    for (size_t k = 0; k < lanes; ++k)
+        merged.insert(merged.end(), lane_frames[k].begin() + static_cast<std::ptrdiff_t>(fpos[k]),
+                      lane_frames[k].end());
+    std::stable_sort(merged.begin() + static_cast<std::ptrdiff_t>(listed), merged.end(),
+                     [](const Frame& a, const Frame& b) { return a.ts_ns < b.ts_ns; });
+    for (size_t k = 0; k < lanes; ++k)
+        for (size_t i = epos[k]; i < lane_events[k].size(); ++i) {
+            Event ev = lane_events[k][i];
+            ev.before_frame = listed;
+            while (ev.before_frame < merged.size() && merged[ev.before_frame].ts_ns < ev.ts_ns)
+                ev.before_frame++;
+            merged_events.push_back(std::move(ev));
+        }
+    std::stable_sort(merged_events.begin(), merged_events.end(),
+                     [](const Event& a, const Event& b) { return a.before_frame < b.before_frame; });
+
+    if (mismatched)
+        std::cerr << "XrawReader: " << mismatched << " frames differ from the manifest's frame index\n";
+    if (merged.size() > listed)
+        std::cerr << "XrawReader: " << merged.size() - listed << " frames not in the manifest, ordered by timestamp\n";
+    index_ = std::move(merged);
+    events_ = std::move(merged_events);
+    return true;
+}
+
+bool XrawReader::open(const std::vector<std::string>& files)
+{
+    close();
+    if (files.empty()) {
+        std::cerr << "XrawReader: no input files\n";
+        return false;
+    }
+
+    for (const auto& f : files) {
+        int fd = ::open(f.c_str(), O_RDONLY);
+        if (fd < 0) { perror(("XrawReader: open " + f).c_str()); close(); return false; }
+
+        struct stat st{};
+        fstat(fd, &st);
+        Mapping m;
+        m.len = static_cast<size_t>(st.st_size);
+        void* p = m.len ? mmap(nullptr, m.len, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);   // the mapping keeps the file referenced
+        if (p == MAP_FAILED) { perror(("XrawReader: mmap " + f).c_str()); close(); return false; }
+
+        m.base = static_cast<const uint8_t*>(p);
+        madvise(const_cast<uint8_t*>(m.base), m.len, MADV_SEQUENTIAL);
+
+        files_.push_back(f);
+        maps_.push_back(m);
+        if (!index_file(static_cast<uint32_t>(maps_.size() - 1), m)) { close(); return false; }
+    }
+
+    if (index_.empty()) {
+        std::cerr << "XrawReader: no frames found\n";
+        return false;
+    }
+    return true;
+}
+
+bool XrawReader::index_file(uint32_t file_no, const Mapping& m)
+{
+    if (m.len < 8) { std::cerr << "XrawReader: " << files_[file_no] << " too short\n"; return false; }
+
+    uint32_t magic; uint16_t hdr_sz;
+    std::memcpy(&magic, m.base, 4);
+    std::memcpy(&hdr_sz, m.base + 6, 2);
+    if (magic != xraw::MAGIC_FILE || hdr_sz > m.len) {
+        std::cerr << "XrawReader: " << files_[file_no] << " is not an XRAW file\n";
+        return false;
+    }
+
+    const bool legacy = hdr_sz == sizeof(xraw::LegacyFileHeader);
+    uint32_t file_w = 0, file_h = 0;
+    if (legacy) {
+        xraw::LegacyFileHeader fh;
+        std::memcpy(&fh, m.base, sizeof(fh));
+        file_w = fh.w; file_h = fh.h;
+    } else {
+        xraw::FileHeader fh{};
+        std::memcpy(&fh, m.base, std::min<size_t>(sizeof(fh), hdr_sz));
+        file_w = fh.width; file_h = fh.height;
+    }
+
+    // Frame headers before `flags` was added end where it starts.
+    constexpr size_t kMinFrameHeader = offsetof(xraw::FrameHeader, flags);
+    auto corrupt = [&](size_t at) {
+        std::cerr << "XrawReader: " << files_[file_no] << ": bad record header at offset " << at
+                  << ", ignoring the rest of the file\n";
+    };
+
+    size_t off = hdr_sz;
+    while (off + 8 <= m.len) {
+        const uint8_t* rec = m.base + off;
+        uint16_t rec_hdr;
+        std::memcpy(&magic, rec, 4);
+        std::memcpy(&rec_hdr, rec + 6, 2);
+        // A header shorter than its fixed part (e.g. a zeroed one) would never advance `off`.
+        if ((magic == xraw::MAGIC_EVENT && rec_hdr < sizeof(xraw::EventHeader)) ||
+            (magic == xraw::MAGIC_FRAME && rec_hdr != sizeof(xraw::LegacyFrameHeader) &&
+             rec_hdr < kMinFrameHeader)) {
+            corrupt(off);
+            break;
+        }
+        if (magic == xraw::MAGIC_EVENT && off + sizeof(xraw::EventHeader) <= m.len) {
+            xraw::EventHeader eh;
+            std::memcpy(&eh, rec, sizeof(eh));
+            if (off + rec_hdr + eh.payload_bytes > m.len) break;
+            Event ev;
+            ev.ts_ns = eh.ts_mono_ns;
+            ev.before_frame = index_.size();
+            ev.file = file_no;
+            ev.text.assign(reinterpret_cast<const char*>(rec + rec_hdr), eh.payload_bytes);
+            events_.push_back(std::move(ev));
+            off += rec_hdr + eh.payload_bytes;
+            continue;
+        }
+        if (magic != xraw::MAGIC_FRAME || off + rec_hdr > m.len) break;   // truncated tail
+
+        Frame f;
+        f.file = file_no;
+        if (rec_hdr == sizeof(xraw::LegacyFrameHeader)) {
+            xraw::LegacyFrameHeader h;
+            std::memcpy(&h, rec, sizeof(h));
+            f.frame_index = h.frame_index;
+            f.ts_ns = h.ts_ns;
+            f.bytes = h.bytes;
+            f.width = file_w;
+            f.height = file_h;
+            f.lz4 = h.ver >= 2;
+        } else {
+            xraw::FrameHeader h{};
+            std::memcpy(&h, rec, std::min<size_t>(sizeof(h), rec_hdr));
+            f.frame_index = h.frame_index;
+            f.ts_ns = h.ts_mono_ns;
+            f.bytes = h.payload_bytes;
+            f.width = h.width;
+            f.height = h.height;
+            f.flags = h.flags;
+            f.data_format = h.data_format;
+            f.lz4 = h.data_format == xraw::FMT_RAW8_LZ4;
+            f.packed = h.data_format == xraw::FMT_RAW10_PACKED || h.data_format == xraw::FMT_RAW12_PACKED;
+            f.bit_depth = xraw::format_bit_depth(h.data_format, h.flags);
+        }
+
+        if (off + rec_hdr + f.bytes > m.len) break;                        // truncated payload
+        f.data = rec + rec_hdr;
+        index_.push_back(f);
+        off += rec_hdr + f.bytes;
+    }
+    return true;
+}
+
+bool XrawReader::decode(size_t i, std::vector<uint8_t>& out) const
+{
+    const Frame& f = index_[i];
+    const size_t pixels = static_cast<size_t>(f.width) * f.height;
+    const size_t raw = pixels * (f.bit_depth > 8 ? 2 : 1);
+    out.resize(raw);
+    if (f.packed) {
+        auto* px = reinterpret_cast<uint16_t*>(out.data());
+        if (f.data_format == xraw::FMT_RAW10_PACKED) {
+            if (f.bytes < raw10_bytes(pixels)) return false;
+            unpack_raw10(f.data, pixels, px);
+        } else {
+            if (f.bytes < raw12_bytes(pixels)) return false;
+            unpack_raw12(f.data, pixels, px);
+        }
+        return true;
+    }
+    if (!f.lz4) {
+        if (f.bytes < raw) return false;
+        std::memcpy(out.data(), f.data, raw);
+        return true;
+    }
+#ifdef HAVE_LZ4
+    // Ring-buffer v2 frames are LZ4 frame format (magic 0x184D2204); rolling ones a bare block.
+    uint32_t magic = 0;
+    if (f.bytes >= 4) std::memcpy(&magic, f.data, 4);
+    if (magic == 0x184D2204u) {
+        LZ4F_dctx* dctx = nullptr;
+        if (LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION))) return false;
+        size_t dst = raw, src = f.bytes;
+        const size_t rc = LZ4F_decompress(dctx, out.data(), &dst, f.data, &src, nullptr);
+        LZ4F_freeDecompressionContext(dctx);
+        return !LZ4F_isError(rc) && dst == raw;
+    }
+    return LZ4_decompress_safe(reinterpret_cast<const char*>(f.data), reinterpret_cast<char*>(out.data()),
+                               static_cast<int>(f.bytes), static_cast<int>(raw)) == static_cast<int>(raw);
+#else
+    return false;
+#endif
+}
+
+void XrawReader::advise(size_t first, size_t count, int advice) const
+{
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t last = std::min(first + count, index_.size());
+    for (size_t i = first; i < last; ) {
+        // Coalesce consecutive frames of the same file into one call.
+        const uint32_t file = index_[i].file;
+        const uint8_t* lo = index_[i].data;
+        const uint8_t* hi = lo + index_[i].bytes;
+        for (++i; i < last && index_[i].file == file; ++i)
+            hi = index_[i].data + index_[i].bytes;
+
+        auto a = reinterpret_cast<uintptr_t>(lo) & ~(page - 1);
+        madvise(reinterpret_cast<void*>(a), reinterpret_cast<uintptr_t>(hi) - a, advice);
+    }
+}
+
+void XrawReader::prefetch(size_t first, size_t count) const { advise(first, count, MADV_WILLNEED); }
+void XrawReader::release(size_t first, size_t count) const  { advise(first, count, MADV_DONTNEED); }
+
+void XrawReader::close()
+{
+    for (auto& m : maps_)
+        if (m.base) munmap(const_cast<uint8_t*>(m.base), m.len);
+    maps_.clear();
+    files_.clear();
+    index_.clear();
+    events_.clear();
+}
+
+} // namespace cambuffer_recorder_ng
@@ -0,0 +1,115 @@
+#include "cambuffer_recorder_ng/XrawReplayCamera.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace cambuffer_recorder_ng {
+
+void XrawReplayCamera::open(int)
+{
+    if (!reader_.open(opt_.path))
+        throw std::runtime_error("XrawReplayCamera: cannot read " + opt_.path);
+#ifndef HAVE_LZ4
+    if (reader_.frame(0).lz4)
+        throw std::runtime_error("XrawReplayCamera: LZ4-compressed XRAW needs a build with liblz4");
+#endif
+    if (opt_.speed <= 0) opt_.speed = 1.0;
+
+    const auto& first = reader_.frame(0);
+    const auto& last = reader_.frame(reader_.size() - 1);
+    const uint64_t n = reader_.size();
+    // Signed: a clock step or an edited file can leave the last stamp before the first.
+    const int64_t span = static_cast<int64_t>(last.ts_ns - first.ts_ns);
+    if (span > 0) {
+        const uint64_t period = n > 1 ? static_cast<uint64_t>(span) / (n - 1) : 10'000'000ULL;
+        ts_span_ns_ = static_cast<uint64_t>(span) + period;
+    } else {
+        ts_span_ns_ = n * 10'000'000ULL;
+    }
+    const int64_t indices = static_cast<int64_t>(last.frame_index - first.frame_index);
+    index_span_ = indices > 0 ? static_cast<uint64_t>(indices) + 1 : n;
+}
+
+bool XrawReplayCamera::set_roi(int& width, int& height, int& offset_x, int& offset_y)
+{
+    if (reader_.size() == 0) return false;
+    width = static_cast<int>(reader_.frame(0).width);
+    height = static_cast<int>(reader_.frame(0).height);
+    offset_x = offset_y = 0;
+    return true;
+}
+
+void XrawReplayCamera::start()
+{
+    if (reader_.size() == 0) throw std::runtime_error("XrawReplayCamera not opened");
+    next_ = 0;
+    prefetched_ = 0;
+    released_ = 0;
+    loops_ = 0;
+    t0_ = Clock::now();
+    running_ = true;
+}
+
+bool XrawReplayCamera::grab(uint8_t*& data, size_t& size, uint64_t& ts,
+                            int& width, int& height, int& stride, int timeout_ms)
+{
+    if (!running_) return false;
+
+    if (next_ >= reader_.size()) {
+        if (!opt_.loop) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+            return false;   // end of recording behaves like a silent camera
+        }
+        reader_.release(0, reader_.size());
+        next_ = 0;
+        prefetched_ = 0;
+        released_ = 0;
+        loops_++;
+        t0_ = Clock::now();
+    }
+
+    // Keep the read-ahead window full; drop what we have handed out.
+    if (prefetched_ < next_ + opt_.prefetch_frames / 2) {
+        const size_t from = std::max(prefetched_, next_);
+        reader_.prefetch(from, next_ + opt_.prefetch_frames - from);
+        prefetched_ = next_ + opt_.prefetch_frames;
+        if (next_ > released_ + 1) {
+            reader_.release(released_, next_ - 1 - released_);
+            released_ = next_ - 1;
+        }
+    }
+
+    const auto& first = reader_.frame(0);
+    const auto& f = reader_.frame(next_);
+    const uint8_t* pixels = f.data;
+    if (f.lz4 || f.packed) {
+        if (f.bit_depth != first.bit_depth || !reader_.decode(next_, unpacked_)) {
+            next_++;   // without liblz4 (or corrupt), a compressed stretch replays as drops
+            return false;
+        }
+        pixels = unpacked_.data();
+    }
+
+    if (opt_.realtime) {
+        const auto due = t0_ + std::chrono::nanoseconds(
+            static_cast<int64_t>(std::max<int64_t>(0, static_cast<int64_t>(f.ts_ns - first.ts_ns)) / opt_.speed));
+        if (due - Clock::now() > std::chrono::milliseconds(timeout_ms)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+            return false;
+        }
+        std::this_thread::sleep_until(due);
+    }
+
+    data = const_cast<uint8_t*>(pixels);
+    width = static_cast<int>(f.width);
+    height = static_cast<int>(f.height);
+    stride = width * (first.bit_depth > 8 ? 2 : 1);     // XRAW payloads are packed
+    size = static_cast<size_t>(stride) * height;
+    ts = f.ts_ns + loops_ * ts_span_ns_;
+    frame_number_ = f.frame_index + loops_ * index_span_;
+
+    next_++;
+    return true;
+}
+
+} // namespace cambuffer_recorder_ng
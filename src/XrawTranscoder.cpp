@@ -0,0 +1,289 @@
+#include "cambuffer_recorder_ng/XrawTranscoder.hpp"
+#include "cambuffer_recorder_ng/FfmpegWriter.hpp"
+#include "cambuffer_recorder_ng/SegmentJoiner.hpp"
+#include "cambuffer_recorder_ng/XrawEventLog.hpp"
+#include "cambuffer_recorder_ng/XrawReader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace cambuffer_recorder_ng {
+
+static const char* pattern_name(BayerPattern p)
+{
+    switch (p) {
+        case BayerPattern::RGGB: return "rggb";
+        case BayerPattern::GRBG: return "grbg";
+        case BayerPattern::BGGR: return "bggr";
+        case BayerPattern::GBRG: break;
+    }
+    return "gbrg";
+}
+
+// ".mp4" for out.mp4; Matroska when the name has no extension.
+static std::string container_ext(const std::string& output)
+{
+    const auto dot = output.find_last_of('.');
+    const auto slash = output.find_last_of('/');
+    return (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? output.substr(dot) : ".mkv";
+}
+
+static std::string part_name(const std::string& output, size_t i)
+{
+    // out.mp4 -> out.mp4.part0003.mp4, so the container is still known from the name.
+    const std::string ext = container_ext(output);
+    char idx[24];
+    snprintf(idx, sizeof(idx), ".part%04zu", i);
+    return output + idx + ext;
+}
+
+bool XrawTranscoder::run(const std::string& input, const std::string& output,
+                         const Options& opt, Result* result)
+{
+    const auto t_start = std::chrono::steady_clock::now();
+    XrawReader reader;
+    if (!reader.open(input)) return false;
+
+    const size_t n = reader.size();
+    const auto& first = reader.frame(0);
+    const auto& last = reader.frame(n - 1);
+    const int width = static_cast<int>(first.width);
+    const int height = static_cast<int>(first.height);
+    const bool deep = first.bit_depth > 8;
+    const int row_bytes = width * (deep ? 2 : 1);
+
+    // Output timeline: one tick per recorded frame index, so drops stay gaps.
+    std::vector<int64_t> pts(n, 0);
+    for (size_t i = 1; i < n; ++i) {
+        const int64_t gap = static_cast<int64_t>(reader.frame(i).frame_index) -
+                            static_cast<int64_t>(reader.frame(i - 1).frame_index);
+        pts[i] = pts[i - 1] + (gap >= 1 && gap <= 1000 ? gap : 1);   // no counter, or a reset
+    }
+
+    int fps = opt.fps;
+    if (fps <= 0) {
+        const double period = n > 1 && pts[n - 1] > 0
+            ? static_cast<double>(last.ts_ns - first.ts_ns) / static_cast<double>(pts[n - 1]) : 1e7;
+        fps = std::max(1, static_cast<int>(std::lround(1e9 / period)));
+    }
+
+    const bool lossless = opt.codec == "ffv1";
+    if (lossless && container_ext(output) == ".mp4") {
+        std::cerr << "XrawTranscoder: ffv1 needs a Matroska (.mkv) output, not " << output << "\n";
+        return false;
+    }
+    const size_t chunk = static_cast<size_t>(opt.chunk_frames > 0 ? opt.chunk_frames : fps * 10);
+    const size_t parts = (n + chunk - 1) / chunk;
+    size_t workers = opt.threads > 0 ? static_cast<size_t>(opt.threads)
+                                     : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, parts);
+
+    std::atomic<size_t> next_part{0};
+    std::atomic<size_t> running{workers};
+    std::atomic<uint64_t> done{0}, skipped{0};
+    std::atomic<bool> failed{false}, aborted{false};
+
+    auto encode_part = [&](size_t p) {
+        const size_t b = p * chunk, e = std::min(n, b + chunk);
+        FfmpegWriter w;
+        // Parallelism comes from the parts; one codec thread each keeps every core busy.
+        w.set_codec_option("threads", "1");
+        for (const auto& [k, v] : opt.codec_opts) w.set_codec_option(k, v);
+        AVPixelFormat in_fmt = to_av_format(deep ? PixelFormat::Bayer16 : PixelFormat::Bayer8, opt.pattern);
+        if (lossless) {
+            // Samples stay as recorded, 10/12-bit ones too (gray16le, unshifted).
+            in_fmt = deep ? AV_PIX_FMT_GRAY16LE : AV_PIX_FMT_GRAY8;
+            w.set_encoder_format(in_fmt);
+        } else if (deep) {
+            w.set_input_bit_depth(first.bit_depth);
+        }
+        if (!w.open(part_name(output, p), width, height, fps, opt.codec, in_fmt)) {
+            failed = true;
+            return;
+        }
+
+        reader.prefetch(b, e - b);
+        std::vector<uint8_t> unpacked;
+        int64_t next_pts = pts[b];
+        for (size_t i = b; i < e && !failed && !aborted; ++i) {
+            if (opt.gate && !opt.gate()) { aborted = true; break; }
+
+            const auto& f = reader.frame(i);
+            const uint8_t* px = f.data;
+            if (f.width != first.width || f.height != first.height || f.bit_depth != first.bit_depth ||
+                ((f.lz4 || f.packed) && !reader.decode(i, unpacked))) {
+                skipped++;
+                continue;
+            }
+            if (f.lz4 || f.packed) px = unpacked.data();
+
+            if (pts[i] > next_pts) w.skip_frames(static_cast<int>(pts[i] - next_pts));
+            w.write_frame(px, row_bytes, static_cast<int64_t>(f.ts_ns));
+            next_pts = pts[i] + 1;
+            done++;
+        }
+        w.close();
+        reader.release(b, e - b);
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t k = 0; k < workers; ++k) {
+        pool.emplace_back([&, k] {
+            std::string why;
+            if (!apply_thread_policy(ThreadRole::Encode, opt.policy, "xcode " + std::to_string(k), &why))
+                std::cerr << "XrawTranscoder: worker policy: " << why << "\n";
+            for (size_t p; (p = next_part++) < parts && !failed && !aborted; )
+                encode_part(p);
+            running--;
+        });
+    }
+
+    auto last_report = std::chrono::steady_clock::now();
+    while (running > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (opt.progress && std::chrono::steady_clock::now() - last_report >= std::chrono::seconds(1)) {
+            last_report = std::chrono::steady_clock::now();
+            opt.progress(done, n);
+        }
+    }
+    for (auto& t : pool) t.join();
+
+    std::vector<std::string> names;
+    std::vector<int64_t> starts;
+    for (size_t p = 0; p < parts; ++p) {
+        names.push_back(part_name(output, p));
+        starts.push_back(pts[p * chunk]);
+    }
+
+    bool ok = !failed && !aborted;
+    if (ok) {
+        std::vector<std::pair<std::string, std::string>> meta{{"source", input}};
+        if (lossless) meta.emplace_back("bayer_pattern", pattern_name(opt.pattern));
+        ok = concat(names, starts, fps, output, meta);
+    }
+    // The container has no place for the XEVT records; they go next to it.
+    if (ok) ok = XrawEventLog::write(reader, XrawEventLog::path_for(output));
+    if (!ok || !opt.keep_parts)
+        for (const auto& name : names) std::remove(name.c_str());
+    if (!ok) std::remove(output.c_str());
+
+    if (result) {
+        result->frames = done;
+        result->skipped = skipped;
+        result->parts = parts;
+        result->events = reader.events().size();
+        result->fps = fps;
+        result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+    }
+    return ok;
+}
+
+bool XrawTranscoder::verify(const std::string& input, const std::string& output,
+                            const Options& opt, std::string* why)
+{
+    auto fail = [why](const std::string& msg) {
+        if (why) *why = msg;
+        return false;
+    };
+
+    XrawReader reader;
+    if (!reader.open(input) || reader.size() == 0) return fail("cannot read " + input);
+
+    // The frames run() encodes, in output order.
+    const auto& first = reader.frame(0);
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < reader.size(); ++i)
+        if (reader.frame(i).width == first.width && reader.frame(i).height == first.height &&
+            reader.frame(i).bit_depth == first.bit_depth)
+            expected.push_back(i);
+
+    AVFormatContext* in = nullptr;
+    if (avformat_open_input(&in, output.c_str(), nullptr, nullptr) < 0 ||
+        avformat_find_stream_info(in, nullptr) < 0 || in->nb_streams < 1) {
+        if (in) avformat_close_input(&in);
+        return fail("cannot open " + output);
+    }
+    const AVCodec* codec = avcodec_find_decoder(in->streams[0]->codecpar->codec_id);
+    AVCodecContext* dec = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (!dec || avcodec_parameters_to_context(dec, in->streams[0]->codecpar) < 0 ||
+        avcodec_open2(dec, codec, nullptr) < 0) {
+        avcodec_free_context(&dec);
+        avformat_close_input(&in);
+        return fail("no decoder for " + output);
+    }
+
+    const bool lossless = opt.codec == "ffv1";
+    const size_t width = first.width, height = first.height;
+    const size_t row_bytes = width * (first.bit_depth > 8 ? 2 : 1);
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frm = av_frame_alloc();
+    std::vector<uint8_t> unpacked;
+    size_t got = 0;
+    std::string err;
+
+    auto drain = [&] {
+        while (err.empty() && avcodec_receive_frame(dec, frm) == 0) {
+            if (lossless) {
+                if (got >= expected.size()) {
+                    err = "more frames than recorded";
+                } else {
+                    const size_t i = expected[got];
+                    const auto& f = reader.frame(i);
+                    const uint8_t* px = f.data;
+                    if (f.lz4 || f.packed) px = reader.decode(i, unpacked) ? unpacked.data() : nullptr;
+                    if (!px || static_cast<size_t>(frm->width) != width ||
+                        static_cast<size_t>(frm->height) != height) {
+                        err = "frame " + std::to_string(got) + " does not match";
+                    } else {
+                        for (size_t y = 0; y < height && err.empty(); ++y)
+                            if (std::memcmp(frm->data[0] + y * static_cast<size_t>(frm->linesize[0]),
+                                            px + y * row_bytes, row_bytes) != 0)
+                                err = "frame " + std::to_string(got) + " differs";
+                    }
+                    reader.release(i, 1);
+                }
+            }
+            ++got;
+            av_frame_unref(frm);
+        }
+    };
+
+    while (err.empty()) {
+        if (opt.gate && !opt.gate()) { err = "aborted"; break; }
+        if (av_read_frame(in, pkt) < 0) break;
+        if (pkt->stream_index == 0 && avcodec_send_packet(dec, pkt) < 0)
+            err = "decode error after frame " + std::to_string(got);
+        av_packet_unref(pkt);
+        drain();
+    }
+    if (err.empty()) {
+        avcodec_send_packet(dec, nullptr);   // flush
+        drain();
+    }
+    if (err.empty() && got != expected.size())
+        err = std::to_string(got) + " frames decoded, " + std::to_string(expected.size()) + " expected";
+
+    av_frame_free(&frm);
+    av_packet_free(&pkt);
+    avcodec_free_context(&dec);
+    avformat_close_input(&in);
+    return err.empty() || fail(err);
+}
+
+bool XrawTranscoder::concat(const std::vector<std::string>& parts, const std::vector<int64_t>& start_frames,
+                            int fps, const std::string& output,
+                            const std::vector<std::pair<std::string, std::string>>& metadata)
+{
+    SegmentJoiner joiner;
+    if (!joiner.open(output, fps)) return false;
+    for (const auto& [k, v] : metadata) joiner.set_metadata(k, v);
+    for (size_t i = 0; i < parts.size(); ++i)
+        if (!joiner.append(parts[i], start_frames[i])) break;
+    return joiner.close();
+}
+
+} // namespace cambuffer_recorder_ng
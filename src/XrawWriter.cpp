@@ -0,0 +1,165 @@
+#include "cambuffer_recorder_ng/XrawWriter.hpp"
+#include "cambuffer_recorder_ng/XrawFormat.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace cambuffer_recorder_ng {
+
+bool XrawWriter::open(const std::string& prefix, int width, int height, uint64_t roll_bytes,
+                      uint32_t data_format)
+{
+    close();
+    prefix_ = prefix;
+    width_ = static_cast<uint32_t>(width);
+    height_ = static_cast<uint32_t>(height);
+    roll_bytes_ = roll_bytes;
+    data_format_ = data_format;
+    file_index_ = 0;
+    bytes_total_ = 0;
+    iobuf_.resize(4 * 1024 * 1024);
+    return open_new_file();
+}
+
+bool XrawWriter::open_new_file()
+{
+    if (fp_) { fflush(fp_); fclose(fp_); fp_ = nullptr; }
+
+    char name[4096];
+    snprintf(name, sizeof(name), "%s_%04u.xraw", prefix_.c_str(), file_index_++);
+    fp_ = fopen(name, "wb");
+    if (!fp_) { perror(("XrawWriter: fopen " + std::string(name)).c_str()); return false; }
+    setvbuf(fp_, iobuf_.data(), _IOFBF, iobuf_.size());
+    current_name_ = name;
+
+    xraw::FileHeader fh{};
+    fh.magic         = xraw::MAGIC_FILE;
+    fh.version       = xraw::VER_FILE;
+    fh.header_size   = static_cast<uint16_t>(sizeof(fh));
+    fh.file_index    = file_index_ - 1;
+    fh.start_mono_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count();
+    fh.width         = width_;
+    fh.height        = height_;
+    fh.stride_bytes  = width_;
+    fh.data_format   = data_format_;
+
+    if (fwrite(&fh, 1, sizeof(fh), fp_) != sizeof(fh)) {
+        perror("XrawWriter: fwrite file header");
+        fclose(fp_); fp_ = nullptr;
+        return false;
+    }
+    bytes_in_file_ = sizeof(fh);
+    bytes_total_ += sizeof(fh);
+    return true;
+}
+
+bool XrawWriter::reserve(uint64_t record_bytes)
+{
+    if (bytes_in_file_ + record_bytes > roll_bytes_ && bytes_in_file_ > sizeof(xraw::FileHeader))
+        return open_new_file();
+    return true;
+}
+
+bool XrawWriter::write_frame(uint64_t frame_index, uint64_t ts_ns, const uint8_t* data, int stride)
+{
+    return write_frame(frame_index, ts_ns, data, stride,
+                       static_cast<int>(width_), static_cast<int>(height_), 0);
+}
+
+bool XrawWriter::write_frame(uint64_t frame_index, uint64_t ts_ns, const uint8_t* data, int stride,
+                             int width, int height, uint32_t flags)
+{
+    if (!fp_) return false;
+
+    const uint32_t w = static_cast<uint32_t>(width), h = static_cast<uint32_t>(height);
+    const uint32_t payload = w * h;
+    xraw::FrameHeader rh{};
+    rh.magic         = xraw::MAGIC_FRAME;
+    rh.version       = xraw::VER_FRAME;
+    rh.header_size   = static_cast<uint16_t>(sizeof(rh));
+    rh.frame_index   = frame_index;
+    rh.ts_mono_ns    = ts_ns;
+    rh.width         = w;
+    rh.height        = h;
+    rh.stride_bytes  = static_cast<uint32_t>(stride);
+    rh.payload_bytes = payload;
+    rh.data_format   = xraw::FMT_RAW8;
+    rh.flags         = flags;
+
+    const uint64_t total = sizeof(rh) + payload;
+    if (!reserve(total)) return false;
+
+    if (fwrite(&rh, 1, sizeof(rh), fp_) != sizeof(rh)) { perror("XrawWriter: fwrite header"); return false; }
+    if (static_cast<uint32_t>(stride) == w) {
+        if (fwrite(data, 1, payload, fp_) != payload) { perror("XrawWriter: fwrite payload"); return false; }
+    } else {
+        // pack active width per row (ignore padding)
+        for (uint32_t y = 0; y < h; ++y)
+            if (fwrite(data + static_cast<size_t>(y) * stride, 1, w, fp_) != w) {
+                perror("XrawWriter: fwrite payload");
+                return false;
+            }
+    }
+    bytes_in_file_ += total;
+    bytes_total_ += total;
+    return true;
+}
+
+bool XrawWriter::write_encoded(uint64_t frame_index, uint64_t ts_ns, const uint8_t* payload, uint32_t bytes,
+                               int width, int height, uint32_t data_format, uint32_t flags)
+{
+    if (!fp_) return false;
+
+    xraw::FrameHeader rh{};
+    rh.magic         = xraw::MAGIC_FRAME;
+    rh.version       = xraw::VER_FRAME;
+    rh.header_size   = static_cast<uint16_t>(sizeof(rh));
+    rh.frame_index   = frame_index;
+    rh.ts_mono_ns    = ts_ns;
+    rh.width         = static_cast<uint32_t>(width);
+    rh.height        = static_cast<uint32_t>(height);
+    rh.stride_bytes  = static_cast<uint32_t>(width);
+    rh.payload_bytes = bytes;
+    rh.data_format   = data_format;
+    rh.flags         = flags;
+
+    const uint64_t total = sizeof(rh) + bytes;
+    if (!reserve(total)) return false;
+    if (fwrite(&rh, 1, sizeof(rh), fp_) != sizeof(rh) || fwrite(payload, 1, bytes, fp_) != bytes) {
+        perror("XrawWriter: fwrite encoded frame");
+        return false;
+    }
+    bytes_in_file_ += total;
+    bytes_total_ += total;
+    return true;
+}
+
+bool XrawWriter::write_event(uint64_t ts_ns, const std::string& text)
+{
+    if (!fp_) return false;
+
+    xraw::EventHeader eh{};
+    eh.magic         = xraw::MAGIC_EVENT;
+    eh.version       = xraw::VER_EVENT;
+    eh.header_size   = static_cast<uint16_t>(sizeof(eh));
+    eh.ts_mono_ns    = ts_ns;
+    eh.payload_bytes = static_cast<uint32_t>(text.size());
+
+    const uint64_t total = sizeof(eh) + text.size();
+    if (!reserve(total)) return false;
+    if (fwrite(&eh, 1, sizeof(eh), fp_) != sizeof(eh) ||
+        fwrite(text.data(), 1, text.size(), fp_) != text.size()) {
+        perror("XrawWriter: fwrite event");
+        return false;
+    }
+    bytes_in_file_ += total;
+    bytes_total_ += total;
+    return true;
+}
+
+void XrawWriter::close()
+{
+    if (fp_) { fflush(fp_); fclose(fp_); fp_ = nullptr; }
+}
+
+} // namespace cambuffer_recorder_ng
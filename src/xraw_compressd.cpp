@@ -0,0 +1,278 @@
+// Background XRAW compressor: converts finished recordings with XrawTranscoder
+// at idle CPU and I/O priority, and only while no recorder is capturing.
+//
+// A recorder holds the activity lock (node parameter activity_lock) from
+// activation until its files are flushed. The daemon polls it every 50 ms;
+// while it is held every worker parks between frames, and carries on where it
+// stopped once capture ends. Originals are only deleted (--delete) after the
+// output decoded completely and, for ffv1, compared bit-exact, and after the
+// event records read back from the <prefix>.events.log sidecar.
+//
+// Usage:  xraw_compressd dir [dir ...] [options]
+//   dir                watched directories: rolls (<prefix>_0000.xraw, ...) and
+//                      stripe manifests (.xrawm, watch the first of xraw_dirs)
+//   --codec NAME       ffv1 (default, lossless .mkv) or libx264 (.mp4)
+//   --preset P --crf N libx264 quality (default slow / 18)
+//   --delete           remove the originals once the output verified
+//   --lock PATH        recorder activity lock (default /tmp/cambuffer_recorder_ng.active)
+//   --threads N        workers (default: all cores)
+//   --settle S         only take recordings untouched for S seconds (default 30)
+//   --interval S       rescan period in seconds (default 10)
+//   --once             one pass, then exit
+
+#include "cambuffer_recorder_ng/ActivityLock.hpp"
+#include "cambuffer_recorder_ng/XrawEventLog.hpp"
+#include "cambuffer_recorder_ng/XrawReader.hpp"
+#include "cambuffer_recorder_ng/XrawTranscoder.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cambuffer_recorder_ng;
+namespace fs = std::filesystem;
+
+static std::atomic<bool> g_stop{false};
+static std::atomic<bool> g_recorder_active{false};
+
+static void on_signal(int) { g_stop = true; }
+
+static bool ends_with(const std::string& s, const std::string& tail)
+{
+    return s.size() >= tail.size() && s.compare(s.size() - tail.size(), tail.size(), tail) == 0;
+}
+
+namespace {
+
+struct Job {
+    std::string input;                 // first roll or manifest
+    std::string output;
+    std::vector<std::string> files;    // everything the recording consists of
+    std::vector<std::pair<uintmax_t, fs::file_time_type>> stamp;   // size, mtime of each
+};
+
+std::vector<std::string> lane_prefixes(const std::string& manifest)
+{
+    std::vector<std::string> out;
+    std::ifstream in(manifest);
+    std::string line;
+    std::getline(in, line);   // XRAWSTRIPE 1
+    while (std::getline(in, line) && line.rfind("lane ", 0) == 0) {
+        const auto sp = line.find(' ', 5);
+        if (sp != std::string::npos) out.push_back(line.substr(sp + 1));
+    }
+    return out;
+}
+
+std::vector<std::string> series_files(const std::string& input)
+{
+    if (!ends_with(input, ".xrawm")) return XrawReader::expand(input);
+
+    // Same lookup as XrawReader: where the lane was written, else next to the manifest.
+    std::vector<std::string> files{input};
+    const fs::path here = fs::path(input).parent_path();
+    for (const auto& prefix : lane_prefixes(input)) {
+        auto lane = XrawReader::expand(prefix + "_0000.xraw");
+        if (lane.empty()) lane = XrawReader::expand((here / fs::path(prefix).filename()).string() + "_0000.xraw");
+        files.insert(files.end(), lane.begin(), lane.end());
+    }
+    return files;
+}
+
+std::vector<Job> scan(const std::vector<std::string>& dirs, const std::string& ext,
+                      std::chrono::seconds settle, const std::set<std::string>& skip)
+{
+    std::vector<std::string> heads;
+    std::set<std::string> lane_heads;   // file names of rolls that belong to a manifest
+    for (const auto& dir : dirs) {
+        std::error_code ec;
+        for (const auto& e : fs::directory_iterator(dir, ec)) {
+            const std::string p = e.path().string();
+            if (ends_with(p, ".xrawm")) {
+                heads.push_back(p);
+                for (const auto& prefix : lane_prefixes(p))
+                    lane_heads.insert(fs::path(prefix).filename().string() + "_0000.xraw");
+            } else if (ends_with(p, "_0000.xraw")) {
+                heads.push_back(p);
+            }
+        }
+    }
+    std::sort(heads.begin(), heads.end());
+
+    std::vector<Job> jobs;
+    const auto now = fs::file_time_type::clock::now();
+    for (const auto& head : heads) {
+        if (skip.count(head) || lane_heads.count(fs::path(head).filename().string())) continue;
+
+        Job job;
+        job.input = head;
+        const std::string base = ends_with(head, ".xrawm") ? head.substr(0, head.size() - 6)
+                                                           : head.substr(0, head.size() - 10);
+        job.output = base + ext;
+        std::error_code ec;
+        if (fs::exists(job.output, ec)) continue;
+
+        job.files = series_files(head);
+        bool settled = !job.files.empty();
+        for (const auto& f : job.files) {
+            const auto size = fs::file_size(f, ec);
+            const auto mtime = fs::last_write_time(f, ec);
+            if (ec || now - mtime < settle) { settled = false; break; }
+            job.stamp.emplace_back(size, mtime);
+        }
+        if (settled) jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+bool unchanged(const Job& job)
+{
+    std::error_code ec;
+    for (size_t i = 0; i < job.files.size(); ++i)
+        if (fs::file_size(job.files[i], ec) != job.stamp[i].first ||
+            fs::last_write_time(job.files[i], ec) != job.stamp[i].second || ec)
+            return false;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> dirs;
+    XrawTranscoder::Options opt;
+    opt.codec = "ffv1";
+    std::string preset = "slow", crf = "18";
+    std::string lock_path = "/tmp/cambuffer_recorder_ng.active";
+    bool remove_originals = false, once = false;
+    int settle_s = 30, interval_s = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a.rfind("--", 0) != 0) { dirs.push_back(a); continue; }
+        if (a == "--delete") { remove_originals = true; continue; }
+        if (a == "--once")   { once = true; continue; }
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) { std::cerr << "missing value for " << a << "\n"; return 1; }
+        if      (a == "--codec")    opt.codec = v;
+        else if (a == "--preset")   preset = v;
+        else if (a == "--crf")      crf = v;
+        else if (a == "--lock")     lock_path = v;
+        else if (a == "--threads")  opt.threads = std::atoi(v);
+        else if (a == "--settle")   settle_s = std::atoi(v);
+        else if (a == "--interval") interval_s = std::max(1, std::atoi(v));
+        else { std::cerr << "unknown option " << a << "\n"; return 1; }
+        ++i;
+    }
+    if (dirs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " dir [dir ...] [--codec ffv1|libx264] [--preset P] [--crf N] "
+                  << "[--delete] [--lock PATH] [--threads N] [--settle S] [--interval S] [--once]\n";
+        return 1;
+    }
+    opt.codec_opts.clear();
+    if (opt.codec == "libx264") opt.codec_opts = {{"preset", preset}, {"crf", crf}};
+    else if (opt.codec == "ffv1") opt.codec_opts = {{"level", "3"}, {"slicecrc", "1"}};
+    const std::string ext = opt.codec == "ffv1" ? ".mkv" : ".mp4";
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    // The monitor keeps normal priority so a starting recorder is noticed at
+    // once; everything created after the policy below inherits idle.
+    std::thread monitor([&] {
+        bool was = false;
+        while (!g_stop) {
+            const bool now = ActivityLock::busy(lock_path);
+            if (now != was) {
+                std::cerr << "xraw_compressd: recorder " << (now ? "active, pausing" : "idle, resuming") << "\n";
+                was = now;
+            }
+            g_recorder_active = now;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    });
+
+    opt.policy.sched = "idle";
+    opt.policy.io_class = "idle";
+    std::string why;
+    if (!apply_thread_policy(ThreadRole::Io, opt.policy, "compressd", &why))
+        std::cerr << "xraw_compressd: thread policy: " << why << "\n";
+
+    opt.gate = [] {
+        while (g_recorder_active && !g_stop) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return !g_stop.load();
+    };
+
+    std::set<std::string> given_up;
+    while (!g_stop) {
+        for (auto& job : scan(dirs, ext, std::chrono::seconds(settle_s), given_up)) {
+            if (!opt.gate()) break;
+
+            const std::string tmp = job.output.substr(0, job.output.size() - ext.size()) + ".partial" + ext;
+            std::cerr << "xraw_compressd: " << job.input << " -> " << job.output << "\n";
+            XrawTranscoder::Result r;
+            if (!XrawTranscoder::run(job.input, tmp, opt, &r)) {
+                if (g_stop) break;
+                std::cerr << "xraw_compressd: " << job.input << ": transcode failed, skipping it from now on\n";
+                given_up.insert(job.input);
+                continue;
+            }
+            const std::string tmp_events = XrawEventLog::path_for(tmp);
+            const std::string events = XrawEventLog::path_for(job.output);
+            if (!XrawTranscoder::verify(job.input, tmp, opt, &why)) {
+                std::remove(tmp.c_str());
+                std::remove(tmp_events.c_str());
+                if (g_stop) break;
+                std::cerr << "xraw_compressd: " << job.input << ": verification failed (" << why << ")\n";
+                given_up.insert(job.input);
+                continue;
+            }
+            std::error_code ec;
+            if (r.events) fs::rename(tmp_events, events, ec);
+            if (!ec) fs::rename(tmp, job.output, ec);
+            if (ec) {
+                std::cerr << "xraw_compressd: rename " << tmp << ": " << ec.message() << "\n";
+                given_up.insert(job.input);
+                continue;
+            }
+
+            uintmax_t in_bytes = 0;
+            for (const auto& s : job.stamp) in_bytes += s.first;
+            const uintmax_t out_bytes = fs::file_size(job.output, ec);
+            std::cerr << "xraw_compressd: " << job.output << ": " << r.frames << " frames, "
+                      << r.events << " events, "
+                      << (out_bytes ? static_cast<double>(in_bytes) / out_bytes : 0.0) << "x smaller, "
+                      << r.seconds << " s\n";
+            if (!remove_originals) continue;
+
+            // Frames that could not go into the output (size changes, bad blocks) exist only in
+            // the XRAW, and so do events unless the sidecar reads back complete.
+            XrawReader reader;
+            if (r.skipped == 0 && unchanged(job) && reader.open(job.input) &&
+                XrawEventLog::matches(reader, events, &why)) {
+                reader.close();
+                for (const auto& f : job.files) fs::remove(f, ec);
+            } else {
+                std::cerr << "xraw_compressd: keeping " << job.input << " (" << r.skipped
+                          << " frames not in the output, the files changed, or events missing from "
+                          << events << ")\n";
+            }
+        }
+        if (once) break;
+        for (int s = 0; s < interval_s * 10 && !g_stop; ++s)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    g_stop = true;
+    monitor.join();
+    return 0;
+}
@@ -0,0 +1,79 @@
+// CFA-preserving 4x4-to-2x2 binning against a scalar reference: odd sizes,
+// widths that leave every SIMD tail length, row padding and full-scale input.
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "cambuffer_recorder_ng/DebayerHalf.hpp"
+
+using namespace cambuffer_recorder_ng;
+
+namespace {
+
+std::vector<uint8_t> noise(size_t n, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> v(n);
+    for (auto& x : v) x = static_cast<uint8_t>(rng());
+    return v;
+}
+
+// Sum of the four same-colour sites feeding output (x, y): block (x / 2, y / 2), phase (x & 1, y & 1).
+int ref_sum4(const std::vector<uint8_t>& src, int stride, int x, int y)
+{
+    const int sx = 4 * (x / 2) + (x & 1), sy = 4 * (y / 2) + (y & 1);
+    auto at = [&](int yy, int xx) { return int(src[static_cast<size_t>(yy) * stride + xx]); };
+    return at(sy, sx) + at(sy, sx + 2) + at(sy + 2, sx) + at(sy + 2, sx + 2);
+}
+
+} // namespace
+
+TEST(DebayerHalf, Additive16MatchesReference)
+{
+    for (int w = 4; w <= 90; w += 3)            // out_w 2..44: every tail of the 8-wide loop
+        for (int h : {4, 7, 9, 12})
+            for (int pad : {0, 5}) {
+                const int stride = w + pad;
+                const auto src = noise(static_cast<size_t>(stride) * h, w * 13 + h + pad);
+                int ow = 0, oh = 0;
+                std::vector<uint16_t> got(static_cast<size_t>(w) * h, 0xEEEE);
+                bayer_half_preserve_cfa(src.data(), w, h, stride, got.data(), ow, oh, BayerPattern::GBRG);
+                ASSERT_EQ(ow, w / 4 * 2);
+                ASSERT_EQ(oh, h / 4 * 2);
+
+                for (int y = 0; y < oh; ++y)
+                    for (int x = 0; x < ow; ++x)
+                        ASSERT_EQ(got[static_cast<size_t>(y) * ow + x], ref_sum4(src, stride, x, y))
+                            << "w " << w << " h " << h << " pad " << pad << " at " << x << "," << y;
+                EXPECT_EQ(got[static_cast<size_t>(ow) * oh], 0xEEEE) << "wrote past the output";
+            }
+}
+
+TEST(DebayerHalf, Additive16FullScaleReaches1020)
+{
+    const int w = 37, h = 9;                    // odd sizes, one full vector plus a tail
+    const std::vector<uint8_t> src(static_cast<size_t>(w) * h, 255);
+    int ow = 0, oh = 0;
+    std::vector<uint16_t> got(static_cast<size_t>(w) * h, 0);
+    bayer_half_preserve_cfa(src.data(), w, h, w, got.data(), ow, oh, BayerPattern::RGGB);
+    ASSERT_EQ(ow, 18);
+    ASSERT_EQ(oh, 4);
+    for (int i = 0; i < ow * oh; ++i) ASSERT_EQ(got[i], 1020) << "at " << i;
+}
+
+TEST(DebayerHalf, Averaged8IsTheRoundedMean)
+{
+    for (int w = 4; w <= 70; w += 5)
+        for (int h : {5, 8}) {
+            const int stride = w + 3;
+            const auto src = noise(static_cast<size_t>(stride) * h, w * 7 + h);
+            int ow = 0, oh = 0;
+            std::vector<uint8_t> got(static_cast<size_t>(w) * h, 0xEE);
+            bayer_half_preserve_cfa(src.data(), w, h, stride, got.data(), ow, oh, BayerPattern::GBRG);
+            ASSERT_EQ(ow, w / 4 * 2);
+            ASSERT_EQ(oh, h / 4 * 2);
+            for (int y = 0; y < oh; ++y)
+                for (int x = 0; x < ow; ++x)
+                    ASSERT_EQ(got[static_cast<size_t>(y) * ow + x], (ref_sum4(src, stride, x, y) + 2) >> 2)
+                        << "w " << w << " h " << h << " at " << x << "," << y;
+        }
+}
@@ -0,0 +1,88 @@
+// Host stand-ins for on-sensor 2x2 skipping and binning against a scalar
+// reference: both CFA periods, all pixel widths, SIMD tails and row padding.
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "cambuffer_recorder_ng/Decimate.hpp"
+
+using namespace cambuffer_recorder_ng;
+
+namespace {
+
+std::vector<uint8_t> noise(size_t n, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> v(n);
+    for (auto& x : v) x = static_cast<uint8_t>(rng());
+    return v;
+}
+
+// Input site feeding output (x, y) along one axis: block start plus the CFA phase.
+int site(int o, int period) { return 2 * period * (o / period) + o % period; }
+
+} // namespace
+
+TEST(Downsample, SkipKeepsFirstSiteOfEachColour)
+{
+    for (int period : {1, 2})
+        for (int bpp : {1, 2, 3})
+            for (int w = 2 * period; w <= 80; w += 3)
+                for (int h : {4, 7, 10}) {
+                    const int stride = w * bpp + 5;
+                    const auto src = noise(static_cast<size_t>(stride) * h, w * 7 + h + bpp);
+                    const int ow = w / (2 * period) * period, oh = h / (2 * period) * period;
+                    const int dst_stride = ow * bpp + 3;
+                    std::vector<uint8_t> got(static_cast<size_t>(dst_stride) * oh, 0xEE);
+                    skip_2x2(src.data(), w, h, stride, bpp, period, got.data(), dst_stride);
+
+                    for (int y = 0; y < oh; ++y) {
+                        for (int x = 0; x < ow; ++x)
+                            ASSERT_EQ(0, std::memcmp(&got[static_cast<size_t>(y) * dst_stride + x * bpp],
+                                                     &src[static_cast<size_t>(site(y, period)) * stride
+                                                          + site(x, period) * bpp],
+                                                     static_cast<size_t>(bpp)))
+                                << "period " << period << " bpp " << bpp << " w " << w << " h " << h
+                                << " at " << x << "," << y;
+                        for (int pad = ow * bpp; pad < dst_stride; ++pad)
+                            ASSERT_EQ(got[static_cast<size_t>(y) * dst_stride + pad], 0xEE) << "wrote into padding";
+                    }
+                }
+}
+
+TEST(Downsample, Bin16IsRoundedMeanOfSameColourSites)
+{
+    for (int period : {1, 2})
+        for (int w = 2 * period; w <= 80; w += 3)
+            for (int h : {4, 7, 10}) {
+                const int stride = w * 2 + 6;
+                auto src = noise(static_cast<size_t>(stride) * h, w * 13 + h);
+                // Full-scale corners: a four-site sum overflows 16 bits.
+                std::memset(src.data(), 0xFF, static_cast<size_t>(stride));
+                const int ow = w / (2 * period) * period, oh = h / (2 * period) * period;
+                const int dst_stride = ow * 2 + 4;
+                std::vector<uint8_t> got(static_cast<size_t>(dst_stride) * oh, 0xEE);
+                bin_2x2_16(reinterpret_cast<const uint16_t*>(src.data()), w, h, stride, period,
+                           reinterpret_cast<uint16_t*>(got.data()), dst_stride);
+
+                auto at = [&](int yy, int xx) {
+                    uint16_t v;
+                    std::memcpy(&v, &src[static_cast<size_t>(yy) * stride + xx * 2], 2);
+                    return static_cast<uint32_t>(v);
+                };
+                for (int y = 0; y < oh; ++y) {
+                    const int sy = site(y, period);
+                    for (int x = 0; x < ow; ++x) {
+                        const int sx = site(x, period);
+                        const uint32_t ref = (at(sy, sx) + at(sy, sx + period) + at(sy + period, sx)
+                                              + at(sy + period, sx + period) + 2) >> 2;
+                        uint16_t v;
+                        std::memcpy(&v, &got[static_cast<size_t>(y) * dst_stride + x * 2], 2);
+                        ASSERT_EQ(v, ref) << "period " << period << " w " << w << " h " << h
+                                          << " at " << x << "," << y;
+                    }
+                    for (int pad = ow * 2; pad < dst_stride; ++pad)
+                        ASSERT_EQ(got[static_cast<size_t>(y) * dst_stride + pad], 0xEE) << "wrote into padding";
+                }
+            }
+}
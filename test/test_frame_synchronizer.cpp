@@ -0,0 +1,128 @@
+// Frame-set matching for hardware-triggered cameras whose frame counters start
+// at unrelated values, join late, lose frames or slip a count.
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <vector>
+#include "cambuffer_recorder_ng/FrameSynchronizer.hpp"
+
+using namespace cambuffer_recorder_ng;
+
+namespace {
+
+constexpr uint64_t kPeriod = 10'000'000;    // 100 Hz trigger
+constexpr int64_t kMaxSkew = 2'000'000;
+
+struct Set { uint64_t key; std::vector<uint64_t> ts; };
+
+// Trigger a frame was taken on, from its timestamp (cameras lag by < 1 ms).
+uint64_t trigger_of(uint64_t ts) { return ts / kPeriod; }
+
+void collect(FrameSynchronizer& sync, std::vector<Set>& sets)
+{
+    sync.set_callback([&sets](uint64_t key, const std::vector<uint64_t>& ts) { sets.push_back({key, ts}); });
+}
+
+bool same_trigger(const Set& s)
+{
+    for (uint64_t t : s.ts)
+        if (trigger_of(t) != trigger_of(s.ts[0])) return false;
+    return true;
+}
+
+} // namespace
+
+TEST(FrameSynchronizer, MatchesCamerasWithUnrelatedCounters)
+{
+    FrameSynchronizer sync;
+    sync.reset(3, kMaxSkew);
+    std::vector<Set> sets;
+    collect(sync, sets);
+
+    const uint64_t first[3] = {100, 7, 5000};
+    for (uint64_t t = 0; t < 100; ++t)
+        for (size_t k = 0; k < 3; ++k) {
+            const size_t cam = (k + t) % 3;   // report order varies from trigger to trigger
+            sync.observe(cam, first[cam] + t, t * kPeriod + cam * 300'000);
+        }
+
+    const auto st = sync.stats();
+    EXPECT_EQ(st.matched_sets, 100u);
+    EXPECT_EQ(st.incomplete_sets, 0u);
+    EXPECT_EQ(st.skew_violations, 0u);
+    EXPECT_EQ(st.resyncs, 0u);
+    ASSERT_EQ(sets.size(), 100u);
+    for (size_t i = 0; i < sets.size(); ++i) {
+        EXPECT_TRUE(same_trigger(sets[i])) << "set " << i;
+        if (i) {
+            EXPECT_EQ(sets[i].key, sets[i - 1].key + 1);
+        }
+    }
+}
+
+TEST(FrameSynchronizer, LateCameraIsLinedUpByTimestamp)
+{
+    FrameSynchronizer sync;
+    sync.reset(2, kMaxSkew, 8);
+    std::vector<Set> sets;
+    collect(sync, sets);
+
+    // Camera 1 comes up three triggers late, its counter starting from 0.
+    for (uint64_t t = 0; t < 50; ++t) {
+        if (t >= 3) sync.observe(1, t - 3, t * kPeriod + 500'000);
+        sync.observe(0, 1000 + t, t * kPeriod);
+    }
+
+    const auto st = sync.stats();
+    EXPECT_EQ(st.matched_sets, 47u);
+    EXPECT_EQ(st.incomplete_sets, 3u);   // triggers 0..2, aged out of the window
+    EXPECT_EQ(st.cameras[1].unaligned, 0u);
+    EXPECT_EQ(st.resyncs, 0u);
+    ASSERT_EQ(sets.size(), 47u);
+    for (const auto& s : sets) EXPECT_TRUE(same_trigger(s)) << "key " << s.key;
+    EXPECT_EQ(trigger_of(sets.front().ts[0]), 3u);
+}
+
+TEST(FrameSynchronizer, CounterGapCountsAsDrop)
+{
+    FrameSynchronizer sync;
+    sync.reset(2, kMaxSkew, 8);
+    std::vector<Set> sets;
+    collect(sync, sets);
+
+    // Camera 1 loses the frame of trigger 20; its counter still saw the pulse.
+    for (uint64_t t = 0; t < 50; ++t) {
+        sync.observe(0, t, t * kPeriod);
+        if (t != 20) sync.observe(1, 40 + t, t * kPeriod + 200'000);
+    }
+
+    const auto st = sync.stats();
+    EXPECT_EQ(st.cameras[1].dropped, 1u);
+    EXPECT_EQ(st.cameras[0].dropped, 0u);
+    EXPECT_EQ(st.matched_sets, 49u);
+    EXPECT_EQ(st.incomplete_sets, 1u);
+    EXPECT_EQ(st.resyncs, 0u);
+    for (const auto& s : sets) EXPECT_TRUE(same_trigger(s)) << "key " << s.key;
+}
+
+TEST(FrameSynchronizer, ResyncsAfterCounterSlip)
+{
+    FrameSynchronizer sync;
+    sync.reset(2, kMaxSkew);
+    std::vector<Set> sets;
+    collect(sync, sets);
+
+    // From trigger 30 camera 1's counter is one behind: it missed a count.
+    for (uint64_t t = 0; t < 60; ++t) {
+        sync.observe(0, 100 + t, t * kPeriod);
+        sync.observe(1, 7 + t - (t >= 30 ? 1 : 0), t * kPeriod + 500'000);
+    }
+
+    const auto st = sync.stats();
+    EXPECT_EQ(st.resyncs, 1u);
+    EXPECT_EQ(st.skew_violations, 3u);   // kResyncAfter sets paired one trigger apart
+    ASSERT_GE(sets.size(), 20u);
+    // Lined up again: the tail pairs frames of the same trigger.
+    for (size_t i = sets.size() - 20; i < sets.size(); ++i)
+        EXPECT_TRUE(same_trigger(sets[i])) << "set " << i;
+    EXPECT_EQ(trigger_of(sets.back().ts[0]), 59u);
+}
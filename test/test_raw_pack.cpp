@@ -0,0 +1,100 @@
+// RAW10/RAW12 packing against a scalar reference and back. The AVX2 path does
+// 16 pixels per step with overlapping stores, so the sizes straddle 16 and 24
+// and the buffers are guarded and deliberately misaligned.
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "cambuffer_recorder_ng/RawPack.hpp"
+
+using namespace cambuffer_recorder_ng;
+
+namespace {
+
+constexpr uint8_t kGuard = 0xA5;
+
+void ref_pack10(const uint16_t* s, size_t n, uint8_t* d)
+{
+    for (size_t i = 0; i < n; i += 4) {
+        uint16_t p[4] = {};
+        for (size_t k = 0; k < 4 && i + k < n; ++k) p[k] = std::min<uint16_t>(s[i + k], 1023);
+        uint8_t* o = d + i / 4 * 5;
+        for (int k = 0; k < 4; ++k) o[k] = static_cast<uint8_t>(p[k] >> 2);
+        o[4] = static_cast<uint8_t>((p[0] & 3) | (p[1] & 3) << 2 | (p[2] & 3) << 4 | (p[3] & 3) << 6);
+    }
+}
+
+void ref_pack12(const uint16_t* s, size_t n, uint8_t* d)
+{
+    for (size_t i = 0; i < n; i += 2) {
+        const uint16_t a = std::min<uint16_t>(s[i], 4095);
+        const uint16_t b = i + 1 < n ? std::min<uint16_t>(s[i + 1], 4095) : 0;
+        uint8_t* o = d + i / 2 * 3;
+        o[0] = static_cast<uint8_t>(a >> 4);
+        o[1] = static_cast<uint8_t>(b >> 4);
+        o[2] = static_cast<uint8_t>((a & 15) | (b & 15) << 4);
+    }
+}
+
+const size_t kSizes[] = {1, 2, 3, 15, 16, 17, 23, 24, 25, 31, 32, 33, 47, 48, 49, 1000, 65537};
+
+// Samples up to 5000, so about a fifth of them exercise the saturation.
+std::vector<uint16_t> samples(size_t n, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint16_t> v(n);
+    for (auto& x : v) x = static_cast<uint16_t>(rng() % 5000);
+    return v;
+}
+
+void round_trip(int bits, size_t n)
+{
+    const size_t bytes = bits == 10 ? raw10_bytes(n) : raw12_bytes(n);
+    const auto src = samples(n, static_cast<unsigned>(n * bits));
+    std::vector<uint8_t> ref(bytes);
+    (bits == 10 ? ref_pack10 : ref_pack12)(src.data(), n, ref.data());
+
+    // One byte in front of the output so the kernels see odd addresses.
+    std::vector<uint8_t> packed(bytes + 64, kGuard);
+    uint8_t* dst = packed.data() + 1;
+    (bits == 10 ? pack_raw10 : pack_raw12)(src.data(), n, dst);
+    ASSERT_TRUE(std::equal(ref.begin(), ref.end(), dst)) << "RAW" << bits << " pack, n " << n;
+    ASSERT_EQ(packed[0], kGuard);
+    for (size_t i = bytes + 1; i < packed.size(); ++i)
+        ASSERT_EQ(packed[i], kGuard) << "RAW" << bits << " pack wrote past the end, n " << n;
+
+    std::vector<uint16_t> unpacked(n + 32, 0xBEEF);
+    (bits == 10 ? unpack_raw10 : unpack_raw12)(dst, n, unpacked.data());
+    const uint16_t max = static_cast<uint16_t>((1 << bits) - 1);
+    for (size_t i = 0; i < n; ++i)
+        ASSERT_EQ(unpacked[i], std::min(src[i], max)) << "RAW" << bits << " unpack, n " << n << " at " << i;
+    for (size_t i = n; i < unpacked.size(); ++i)
+        ASSERT_EQ(unpacked[i], 0xBEEF) << "RAW" << bits << " unpack wrote past the end, n " << n;
+}
+
+} // namespace
+
+TEST(RawPack, Raw10RoundTrip)
+{
+    if (!raw_pack_avx2()) std::cout << "[ NOTE     ] no AVX2 on this CPU, scalar path only\n";
+    for (size_t n : kSizes) round_trip(10, n);
+}
+
+TEST(RawPack, Raw12RoundTrip)
+{
+    for (size_t n : kSizes) round_trip(12, n);
+}
+
+TEST(RawPack, NarrowTakesTopEightBits)
+{
+    const int w = 37, h = 5;
+    const auto src = samples(static_cast<size_t>(w) * h, 7);
+    std::vector<uint8_t> got(static_cast<size_t>(w) * h);
+    for (int bits : {8, 10, 12, 16}) {
+        narrow_to_8bit(src.data(), w, h, w * 2, bits, got.data(), w);
+        const unsigned max = (1u << bits) - 1;
+        for (int i = 0; i < w * h; ++i)
+            ASSERT_EQ(got[i], std::min<unsigned>(src[i], max) >> (bits - 8)) << "bits " << bits << " at " << i;
+    }
+}
@@ -0,0 +1,115 @@
+// Event records carried past transcoding in the .events.log sidecar, and the
+// check xraw_compressd makes before it deletes the originals.
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "cambuffer_recorder_ng/XrawEventLog.hpp"
+#include "cambuffer_recorder_ng/XrawReader.hpp"
+#include "cambuffer_recorder_ng/XrawWriter.hpp"
+
+using namespace cambuffer_recorder_ng;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int kW = 16, kH = 8;
+
+class XrawEventLogTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        dir_ = fs::temp_directory_path() / ("xraw_event_log_test_" + std::to_string(getpid()));
+        fs::create_directories(dir_);
+    }
+    void TearDown() override { fs::remove_all(dir_); }
+
+    // Frames 10..14; `events` as (frame before which it is written, text).
+    std::string record(const std::vector<std::pair<int, std::string>>& events)
+    {
+        XrawWriter w;
+        EXPECT_TRUE(w.open((dir_ / "r").string(), kW, kH));
+        std::vector<uint8_t> px(kW * kH, 1);
+        for (int i = 0; i <= 5; ++i) {
+            for (const auto& [before, text] : events) {
+                if (before == i) {
+                    EXPECT_TRUE(w.write_event(1000 + i, text));
+                }
+            }
+            if (i < 5) {
+                EXPECT_TRUE(w.write_frame(10 + i, 1000 + i, px.data(), kW));
+            }
+        }
+        w.close();
+        return (dir_ / "r_0000.xraw").string();
+    }
+
+    static std::vector<std::string> lines(const std::string& path)
+    {
+        std::vector<std::string> out;
+        std::ifstream in(path);
+        for (std::string l; std::getline(in, l);) out.push_back(l);
+        return out;
+    }
+
+    fs::path dir_;
+};
+
+} // namespace
+
+TEST_F(XrawEventLogTest, PathSitsNextToTheOutput)
+{
+    EXPECT_EQ(XrawEventLog::path_for("/data/run1.mkv"), "/data/run1.events.log");
+    EXPECT_EQ(XrawEventLog::path_for("/data/run1.partial.mp4"), "/data/run1.partial.events.log");
+}
+
+TEST_F(XrawEventLogTest, EveryEventSurvives)
+{
+    XrawReader r;
+    ASSERT_TRUE(r.open(record({{0, "motion start"}, {2, "degrade 0->1\nsecond line"}, {5, "motion end"}})));
+    ASSERT_EQ(r.events().size(), 3u);
+
+    const std::string log = XrawEventLog::path_for((dir_ / "r.mkv").string());
+    ASSERT_TRUE(XrawEventLog::write(r, log));
+    std::string why;
+    EXPECT_TRUE(XrawEventLog::matches(r, log, &why)) << why;
+
+    const auto got = lines(log);
+    ASSERT_EQ(got.size(), 3u);
+    EXPECT_EQ(got[0], "1000 10 motion start");
+    EXPECT_EQ(got[1], "1002 12 degrade 0->1 second line");
+    EXPECT_EQ(got[2], "1005 15 motion end");          // after the last frame
+    EXPECT_FALSE(fs::exists(log + ".tmp"));
+}
+
+TEST_F(XrawEventLogTest, IncompleteSidecarDoesNotMatch)
+{
+    XrawReader r;
+    ASSERT_TRUE(r.open(record({{1, "a"}, {3, "b"}})));
+    const std::string log = (dir_ / "r.events.log").string();
+    std::string why;
+    EXPECT_FALSE(XrawEventLog::matches(r, log, &why));   // not written at all
+    EXPECT_FALSE(why.empty());
+
+    ASSERT_TRUE(XrawEventLog::write(r, log));
+    auto got = lines(log);
+    got.pop_back();
+    {
+        std::ofstream out(log, std::ios::trunc);
+        for (const auto& l : got) out << l << "\n";
+    }
+    EXPECT_FALSE(XrawEventLog::matches(r, log));
+}
+
+TEST_F(XrawEventLogTest, NoEventsNoSidecar)
+{
+    XrawReader r;
+    ASSERT_TRUE(r.open(record({})));
+    const std::string log = (dir_ / "r.events.log").string();
+    { std::ofstream(log) << "stale\n"; }
+    ASSERT_TRUE(XrawEventLog::write(r, log));
+    EXPECT_FALSE(fs::exists(log));
+    EXPECT_TRUE(XrawEventLog::matches(r, log));
+}
@@ -0,0 +1,122 @@
+// XrawReader on damaged rolls: a record header that claims zero size must end
+// the index instead of being re-read forever.
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "cambuffer_recorder_ng/XrawFormat.hpp"
+#include "cambuffer_recorder_ng/XrawReader.hpp"
+#include "cambuffer_recorder_ng/XrawWriter.hpp"
+
+using namespace cambuffer_recorder_ng;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int kW = 16, kH = 8;
+
+class XrawReaderTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        dir_ = fs::temp_directory_path() / ("xraw_reader_test_" + std::to_string(getpid()));
+        fs::create_directories(dir_);
+    }
+    void TearDown() override { fs::remove_all(dir_); }
+
+    // Three frames and one event, then `tail` appended raw after close.
+    std::string roll(const std::vector<uint8_t>& tail)
+    {
+        XrawWriter w;
+        EXPECT_TRUE(w.open((dir_ / "r").string(), kW, kH));
+        std::vector<uint8_t> px(kW * kH, 7);
+        for (uint64_t i = 0; i < 3; ++i) {
+            EXPECT_TRUE(w.write_frame(i, 1000 + i, px.data(), kW));
+            if (i == 1) {
+                EXPECT_TRUE(w.write_event(1001, "degrade 0->1"));
+            }
+        }
+        const std::string path = w.current_file();
+        w.close();
+        FILE* fp = fopen(path.c_str(), "ab");
+        fwrite(tail.data(), 1, tail.size(), fp);
+        fclose(fp);
+        return path;
+    }
+
+    // A well-formed frame record, appended after any damage.
+    static void append_valid_frame(std::vector<uint8_t>& tail)
+    {
+        xraw::FrameHeader h{};
+        h.magic = xraw::MAGIC_FRAME;
+        h.version = xraw::VER_FRAME;
+        h.header_size = sizeof(h);
+        h.width = kW;
+        h.height = kH;
+        h.stride_bytes = kW;
+        h.payload_bytes = kW * kH;
+        h.data_format = xraw::FMT_RAW8;
+        const auto* p = reinterpret_cast<const uint8_t*>(&h);
+        tail.insert(tail.end(), p, p + sizeof(h));
+        tail.insert(tail.end(), kW * kH, 0);
+    }
+
+    static std::vector<uint8_t> zero_size_record(uint32_t magic)
+    {
+        std::vector<uint8_t> rec(sizeof(xraw::FrameHeader), 0);
+        std::memcpy(rec.data(), &magic, 4);   // header_size and payload stay 0
+        append_valid_frame(rec);
+        return rec;
+    }
+
+    fs::path dir_;
+};
+
+} // namespace
+
+TEST_F(XrawReaderTest, IntactRollIndexesEverything)
+{
+    XrawReader r;
+    ASSERT_TRUE(r.open(roll({})));
+    EXPECT_EQ(r.size(), 3u);
+    ASSERT_EQ(r.events().size(), 1u);
+    EXPECT_EQ(r.events()[0].text, "degrade 0->1");
+}
+
+TEST_F(XrawReaderTest, AppendedFrameIsIndexed)
+{
+    // The damage below is appended the same way, so the reader does get to it.
+    std::vector<uint8_t> tail;
+    append_valid_frame(tail);
+    XrawReader r;
+    ASSERT_TRUE(r.open(roll(tail)));
+    EXPECT_EQ(r.size(), 4u);
+}
+
+TEST_F(XrawReaderTest, ZeroSizeFrameRecordEndsTheIndex)
+{
+    XrawReader r;
+    ASSERT_TRUE(r.open(roll(zero_size_record(xraw::MAGIC_FRAME))));
+    EXPECT_EQ(r.size(), 3u);
+    EXPECT_EQ(r.events().size(), 1u);
+}
+
+TEST_F(XrawReaderTest, ZeroSizeEventRecordEndsTheIndex)
+{
+    XrawReader r;
+    ASSERT_TRUE(r.open(roll(zero_size_record(xraw::MAGIC_EVENT))));
+    EXPECT_EQ(r.size(), 3u);
+    EXPECT_EQ(r.events().size(), 1u);
+}
+
+TEST_F(XrawReaderTest, ZeroedRecordEndsTheIndex)
+{
+    std::vector<uint8_t> tail(sizeof(xraw::FrameHeader), 0);
+    append_valid_frame(tail);
+    XrawReader r;
+    ASSERT_TRUE(r.open(roll(tail)));
+    EXPECT_EQ(r.size(), 3u);
+}